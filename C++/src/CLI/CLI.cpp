@@ -15,7 +15,18 @@ CLI::CLI(int argc, char* argv[])
 
 	_cliParams.push_back(CLIParam("--obj", "Convert a CityGML file into OBJ file.", std::vector<bool>({ 0 })));
 	_cliParams.push_back(CLIParam("--cut", "Cut a CityGML file into smaller CityGML file or OBJ file.", std::vector<bool>({ 1, 1, 1, 1, 0, 0 })));
+	_cliParams.push_back(CLIParam("--cut-windows", "Cut a CityGML file into one CityGML file per window of a file (\"xmin ymin xmax ymax [name]\" per line), in a single pass.", std::vector<bool>({ 1, 0 })));
+	_cliParams.push_back(CLIParam("--cut-grid", "Cut a CityGML file into one CityGML file per tile of the grid (xmin ymin xmax ymax tileX tileY), in a single pass.", std::vector<bool>({ 1, 1, 1, 1, 1, 1, 0 })));
 	_cliParams.push_back(CLIParam("--split", "Split a CityGML file into multiple OBJ files.", std::vector<bool>({ 1, 1, 0 })));
+	_cliParams.push_back(CLIParam("--cityjson", "Convert the input file into a CityJSON (.json) file.", std::vector<bool>({ 0 })));
+	_cliParams.push_back(CLIParam("--qmesh", "With --obj, --cut or --split : also write a quantised and compressed mesh (.qmesh) next to every OBJ file."));
+	_cliParams.push_back(CLIParam("--atlas", "With --cut (default mode) or --split : pack the parts of the textures used by every tile into texture atlases written next to its OBJ file."));
+	_cliParams.push_back(CLIParam("--gml", "With --cut (default mode) or --split : also write every tile as a CityGML file next to its OBJ file, from the parsed model."));
+	_cliParams.push_back(CLIParam("--types", "Parse only the city objects of these types, ex: \"Building&BuildingPart\" or \"All&~LandUse&~TINRelief\" (default All).", std::vector<bool>({ 1 })));
+	_cliParams.push_back(CLIParam("--lod", "Parse only the geometries of LOD <min> to <max> (default 0 4).", std::vector<bool>({ 1, 1 })));
+	_cliParams.push_back(CLIParam("--optimize", "Merge the geometries and the polygons of an object which share the same appearance (only the geometries with --gml, --split or --cityjson)."));
+	_cliParams.push_back(CLIParam("--prune", "Remove the objects without geometry."));
+	_cliParams.push_back(CLIParam("--no-tesselate", "Keep the polygons as parsed, without triangulating them."));
 
 }
 
@@ -93,10 +104,74 @@ void CLI::parseCmdLine()
 	}
 }
 
+// Options which only change how the conversions are done : they don't need the CityModel by themselves
+static bool isOption(const std::string& name)
+{
+	return name == "--qmesh" || name == "--atlas" || name == "--gml"
+		|| name == "--types" || name == "--lod" || name == "--optimize" || name == "--prune" || name == "--no-tesselate";
+}
+
 void CLI::processCmdLine()
 {
-	// Parse the CityGML file
-	_citygmltool->parse(_gmlFilename);
+	// Parse the CityGML file, unless only the streaming cuts (which read the file themselves) are asked
+	bool needsCityModel = false;
+	for (int i = 0; i < _cliParams.size(); i++)
+	{
+		if (!_cliParams[i]._found)
+			continue;
+
+		std::string name = _cliParams[i]._name;
+		bool streamingCut = name == "--cut-windows" || name == "--cut-grid"
+			|| (name == "--cut" && _cliParams[i]._args.size() > 4 && _cliParams[i]._args[4] == "CUT");
+		if (!streamingCut && !isOption(name))
+			needsCityModel = true;
+	}
+
+	// Parser options, before the parsing
+	citygml::ParserParams params;
+	bool writesModel = false;
+	for (int i = 0; i < _cliParams.size(); i++)
+	{
+		if (!_cliParams[i]._found)
+			continue;
+
+		std::string name = _cliParams[i]._name;
+		if (name == "--types")
+			params.objectsMask = _cliParams[i]._args[0];
+		else if (name == "--lod") {
+			params.minLOD = std::stoi(_cliParams[i]._args[0]);
+			params.maxLOD = std::stoi(_cliParams[i]._args[1]);
+		}
+		else if (name == "--optimize")
+			params.optimize = true;
+		else if (name == "--prune")
+			params.pruneEmptyObjects = true;
+		else if (name == "--no-tesselate")
+			params.tesselate = false;
+		else if (name == "--gml" || name == "--split" || name == "--cityjson")
+			writesModel = true;
+	}
+	// The model written back keeps its polygons as parsed : only the geometries are merged
+	if (params.optimize && writesModel)
+	{
+		params.mergePolygons = false;
+		std::cout << "[OPTIMIZE]: the model is written back (--gml, --split or --cityjson), only its geometries are merged." << std::endl;
+	}
+	_citygmltool->setParserParams(params);
+
+	if (needsCityModel)
+		_citygmltool->parse(_gmlFilename);
+
+	// Output options first, they apply to all the conversions below
+	for (int i = 0; i < _cliParams.size(); i++)
+	{
+		if (_cliParams[i]._found && _cliParams[i]._name == "--qmesh")
+			_citygmltool->setQuantizedMeshOutput(true);
+		if (_cliParams[i]._found && _cliParams[i]._name == "--atlas")
+			_citygmltool->setTextureAtlas(true);
+		if (_cliParams[i]._found && _cliParams[i]._name == "--gml")
+			_citygmltool->setGMLOutput(true);
+	}
 
 	// Process found arguments
 	for (int i = 0; i < _cliParams.size(); i++)
@@ -136,6 +211,27 @@ void CLI::processCmdLine()
 						: true
 				);
 			}
+			else if (name == "--cut-windows") {
+				_citygmltool->gmlCutWindows(
+					_gmlFilename,
+					GMLCut::readWindows(_cliParams[i]._args[0]),
+					(_cliParams[i]._args.size() > 1) ? _cliParams[i]._args[1] : ""
+				);
+			}
+			else if (name == "--cut-grid") {
+				_citygmltool->gmlCutWindows(
+					_gmlFilename,
+					GMLCut::gridWindows(
+						std::stod(_cliParams[i]._args[0]),
+						std::stod(_cliParams[i]._args[1]),
+						std::stod(_cliParams[i]._args[2]),
+						std::stod(_cliParams[i]._args[3]),
+						std::stod(_cliParams[i]._args[4]),		// tileX
+						std::stod(_cliParams[i]._args[5])		// tileY
+					),
+					(_cliParams[i]._args.size() > 6) ? _cliParams[i]._args[6] : ""
+				);
+			}
 			else if (name == "--split") {
 				//TODO: handle stoi exception with invalid argument
 				//TODO: handle optional output parameter
@@ -145,14 +241,23 @@ void CLI::processCmdLine()
 					std::stoi(_cliParams[i]._args[1])		// tileY
 				);
 			}
+			else if (name == "--cityjson") {
+				if (_cliParams[i]._args.size() > 0)
+					_citygmltool->createCityJSON(_gmlFilename, _cliParams[i]._args[0]);
+				else
+					_citygmltool->createCityJSON(_gmlFilename);
+			}
 		}
 	}
 }
 
 bool CLI::assertCityGMLFile()
 {
+	// CityGML (.gml) or CityJSON (.json) input
 	std::string toMatch = ".gml";
-	if (_argv[1].size() >= toMatch.size() && _argv[1].compare(_argv[1].size() - toMatch.size(), toMatch.size(), toMatch) == 0)
+	std::string toMatchJSON = ".json";
+	if ((_argv[1].size() >= toMatch.size() && _argv[1].compare(_argv[1].size() - toMatch.size(), toMatch.size(), toMatch) == 0)
+		|| (_argv[1].size() >= toMatchJSON.size() && _argv[1].compare(_argv[1].size() - toMatchJSON.size(), toMatchJSON.size(), toMatchJSON) == 0))
 	{
 		this->_gmlFilename = this->_argv[1];
 
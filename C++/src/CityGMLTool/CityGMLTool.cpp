@@ -3,9 +3,12 @@
 CityGMLTool::CityGMLTool()
 {
 	this->modules.push_back(new XMLParser("xmlparser"));
+	this->modules.push_back(new CityGMLWriter("citygmlwriter"));
 	this->modules.push_back(new GMLtoOBJ("objcreator"));
 	this->modules.push_back(new GMLCut("gmlcut"));
 	this->modules.push_back(new GMLSplit("gmlsplit"));
+	this->modules.push_back(new CityJSONParser("cityjsonparser"));
+	this->modules.push_back(new CityJSONWriter("cityjsonwriter"));
 
 	// Init the GMLtoOBJ module with the global bounding box Lower Bound Coordinates (from DataProfile)
 	GMLtoOBJ * gmlToObj = static_cast<GMLtoOBJ*>(this->findModuleByName("objcreator"));
@@ -41,10 +44,20 @@ Module* CityGMLTool::findModuleByName(const std::string name)
 
 void CityGMLTool::parse(std::string & filename)
 {	
-	XMLParser* xmlparser = static_cast<XMLParser*>(this->findModuleByName("xmlparser"));
+	citygml::ParserParams params = this->parserParams;
 
-	citygml::ParserParams params = citygml::ParserParams();
-	cityModel = xmlparser->load(filename, params);
+	// CityJSON files (.json) produce the same CityModel as CityGML ones
+	std::string json = ".json";
+	if (filename.size() >= json.size() && filename.compare(filename.size() - json.size(), json.size(), json) == 0)
+	{
+		CityJSONParser* cityjsonparser = static_cast<CityJSONParser*>(this->findModuleByName("cityjsonparser"));
+		cityModel = cityjsonparser->load(filename, params);
+	}
+	else
+	{
+		XMLParser* xmlparser = static_cast<XMLParser*>(this->findModuleByName("xmlparser"));
+		cityModel = xmlparser->load(filename, params);
+	}
 
 	// == 0 if the parsing failed, file name/location may be wrong
 	if (cityModel == 0)
@@ -75,16 +88,31 @@ void CityGMLTool::gmlCut(std::string & gmlFilename, double xmin, double ymin, do
 	GMLtoOBJ* gmlToObj = static_cast<GMLtoOBJ*>(this->findModuleByName("objcreator"));
 
 	if (assignOrCut) {
-		std::vector<TextureCityGML*> texturesList;
+		TexturesCityGML texturesList;
 		CityModel* tile = gmlcut->assign(this->cityModel, &texturesList, TVec2d(xmin, ymin), TVec2d(xmin + xmax, ymin + ymax), gmlFilename);
 
 		// Convert to .obj only if there is at least one CityObject
 		if (tile->getCityObjectsRoots().size() > 0) {
 			std::string outputFolder = "cut_output_obj";
-			std::string filename = outputFolder + "/" + std::to_string((int)(xmin / xmax)) + "_" + std::to_string((int)(ymin / ymax)) + ".gml";
+			std::string name = std::to_string((int)(xmin / xmax)) + "_" + std::to_string((int)(ymin / ymax));
+			std::string filename = outputFolder + "/" + name + ".gml";
+
+			TextureAtlas atlas;
+			if (textureAtlas) {
+				std::string folderIN = gmlFilename.find_last_of("/\\") != std::string::npos ? gmlFilename.substr(0, gmlFilename.find_last_of("/\\")) : ".";
+				atlas.pack(&texturesList, folderIN, outputFolder, name);
+				atlas.apply(tile, texturesList);
+			}
 
 			gmlToObj->setGMLFilename(filename);
+			gmlToObj->setQuantizationBounds(TVec3d(xmin, ymin, cityModel->getEnvelope().getLowerBound().z),
+				TVec3d(xmin + xmax, ymin + ymax, cityModel->getEnvelope().getUpperBound().z));
 			gmlToObj->createMyOBJ(*tile, outputFolder);
+
+			if (gmlOutput) {
+				CityGMLWriter* writer = static_cast<CityGMLWriter*>(this->findModuleByName("citygmlwriter"));
+				writer->write(*tile, filename);
+			}
 		}
 	}
 	else {
@@ -92,6 +120,18 @@ void CityGMLTool::gmlCut(std::string & gmlFilename, double xmin, double ymin, do
 	}
 }
 
+void CityGMLTool::gmlCutWindows(std::string & gmlFilename, const std::vector<CUT_WINDOW>& windows, std::string output)
+{
+	GMLCut* gmlcut = static_cast<GMLCut*>(this->findModuleByName("gmlcut"));
+
+	if (windows.empty()) {
+		std::cout << "GMLCut:.............................:[FAILED]: No window" << std::endl;
+		return;
+	}
+
+	gmlcut->cut(gmlFilename, windows, output);
+}
+
 void CityGMLTool::gmlSplit(std::string & gmlFilename, int tileX, int tileY, std::string output)
 {
 	GMLSplit* gmlSplit = static_cast<GMLSplit*>(this->findModuleByName("gmlsplit"));
@@ -101,6 +141,47 @@ void CityGMLTool::gmlSplit(std::string & gmlFilename, int tileX, int tileY, std:
 	gmlSplit->split(gmlFilename, this->cityModel, gmlcut, gmlToObj, tileX, tileY, output);
 }
 
+void CityGMLTool::setQuantizedMeshOutput(bool quantized)
+{
+	GMLtoOBJ* gmlToObj = static_cast<GMLtoOBJ*>(this->findModuleByName("objcreator"));
+	gmlToObj->setQuantizedOutput(quantized);
+}
+
+void CityGMLTool::setTextureAtlas(bool textureAtlas)
+{
+	GMLSplit* gmlSplit = static_cast<GMLSplit*>(this->findModuleByName("gmlsplit"));
+	gmlSplit->setTextureAtlas(textureAtlas);
+	this->textureAtlas = textureAtlas;
+}
+
+void CityGMLTool::setGMLOutput(bool gmlOutput)
+{
+	GMLSplit* gmlSplit = static_cast<GMLSplit*>(this->findModuleByName("gmlsplit"));
+	gmlSplit->setGMLOutput(gmlOutput);
+	this->gmlOutput = gmlOutput;
+}
+
+void CityGMLTool::createCityJSON(std::string & gmlFilename, std::string output)
+{
+	CityJSONWriter* writer = static_cast<CityJSONWriter*>(this->findModuleByName("cityjsonwriter"));
+
+	if (!cityModel) {
+		std::cout << "CityJSONWriter:.............................:[FAILED]: CityModel NULL" << std::endl;
+		return;
+	}
+
+	// Default output : input file name with the .json extension, next to the input file
+	if (output.empty())
+		output = gmlFilename.substr(0, gmlFilename.find_last_of('.')) + ".json";
+
+	writer->write(*cityModel, output);
+}
+
 void CityGMLTool::setFileName(std::string& filename) {
 	this->filename = filename;
 }
+
+void CityGMLTool::setParserParams(const citygml::ParserParams& params)
+{
+	this->parserParams = params;
+}
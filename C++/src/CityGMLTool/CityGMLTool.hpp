@@ -6,12 +6,16 @@
 
 #include "../Modules/Module.hpp"
 #include "../Modules/XMLParser/XMLParser.hpp"
+#include "../Modules/XMLParser/CityGMLWriter.hpp"
 #include "../Modules/GMLtoOBJ/GMLtoOBJ.hpp"
 #include "../Modules/GMLtoOBJ/DataProfile.hpp"
 #include "../Modules/GMLCut/GMLCut.hpp"
 #include "../Modules/GMLSplit/GMLSplit.hpp"
+#include "../Modules/CityJSONParser/CityJSONParser.hpp"
+#include "../Modules/CityJSONParser/CityJSONWriter.hpp"
 
 #include "../Modules/GMLCut/TextureCityGML.hpp"
+#include "../Modules/GMLCut/TextureAtlas.hpp"
 
 class CityGMLTool
 {
@@ -23,14 +27,30 @@ public:
 	void parse(std::string & filename);
 	void createOBJ(std::string & gmlFilename, std::string output = "");
 	void gmlCut(std::string & gmlFilename, double xmin, double ymin, double xmax, double ymax, bool assignOrCut = true, std::string output = "");
+	// Streaming cut of many windows, one CityGML file per window in the output folder
+	void gmlCutWindows(std::string & gmlFilename, const std::vector<CUT_WINDOW>& windows, std::string output = "");
 	void gmlSplit(std::string & gmlFilename, int tileX, int tileY, std::string output = "");
+	void createCityJSON(std::string & gmlFilename, std::string output = "");
+
+	// --obj, --cut and --split also write a compressed .qmesh next to every .obj
+	void setQuantizedMeshOutput(bool quantized);
+	// --cut (default mode) and --split pack the textures of every tile into atlases
+	void setTextureAtlas(bool textureAtlas);
+	// --cut (default mode) and --split also write every tile as a CityGML file, from the parsed model
+	void setGMLOutput(bool gmlOutput);
 
 	void setFileName(std::string& filename);
 
+	// Parameters of the parsing of the input file (types, LODs, ...), defaults otherwise
+	void setParserParams(const citygml::ParserParams& params);
+
 private:
 	std::vector<Module*> modules;
-	CityModel* cityModel;
+	CityModel* cityModel = nullptr;
 	std::string filename;
+	bool textureAtlas = false;
+	bool gmlOutput = false;
+	citygml::ParserParams parserParams;
 
 	DataProfile dataProfile = DataProfile::createDataProfileLyon();
 
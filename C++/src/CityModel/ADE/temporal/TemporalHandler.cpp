@@ -81,7 +81,11 @@ void TempHandler::startElement(std::string name, void* attributes)
 			_currentVersion->_isXlink = citygml::xLinkState::UNLINKED;
 			_currentVersion->setAttribute("xlink", getAttribute(attributes, "xlink:href", ""), false);
 		}
-		else _versions.push_back(_currentVersion);
+		else
+		{
+			_versions.push_back(_currentVersion);
+			_versionsById[_currentVersion->getId()] = _currentVersion;
+		}
 		if (_inFromTags) _currentTransition->setFrom(_currentVersion);
 		if (_inToTags) _currentTransition->setTo(_currentVersion);
 	}
@@ -108,15 +112,16 @@ void TempHandler::startElement(std::string name, void* attributes)
 		temporal::Transaction* nTransaction = new temporal::Transaction(getGmlIdAttribute(attributes));
 		_currentTransaction = nTransaction;
 	}
-	if (name == "oldFeature")
-	{
-		pushCityObject(new citygml::GenericCityObject(getGmlIdAttribute(attributes)));
-		pushObject(*getCurrentCityObject());
-	}
-	if (name == "newFeature")
+	if (name == "oldFeature" || name == "newFeature")
 	{
 		pushCityObject(new citygml::GenericCityObject(getGmlIdAttribute(attributes)));
 		pushObject(*getCurrentCityObject());
+		// feature given by reference (<oldFeature xlink:href="#id"/>) : the wrapper is kept as the xlink
+		if (getAttribute(attributes, "xlink:href", "") != "")
+		{
+			(*getCurrentCityObject())->_isXlink = citygml::xLinkState::UNLINKED;
+			(*getCurrentCityObject())->setAttribute("xlink", getAttribute(attributes, "xlink:href", ""), false);
+		}
 	}
 }
 /******************************************************/
@@ -168,6 +173,7 @@ void TempHandler::endElement(std::string name)
 		//if the cityobject is not a xLink, then it should not appear anywhere else in the document, so it should be added as root
 		if (child->_isXlink == citygml::xLinkState::NONE)
 		{
+			child->_parent = nullptr;
 			citygml::CityModel** model = getModel();
 			(*model)->addCityObjectAsRoot(child);
 		}
@@ -227,64 +233,44 @@ void TempHandler::endElement(std::string name)
 			if (buff == "merge") _currentTransition->setType(temporal::TransitionValue::MERGE);
 		}
 	}
-	if (name == "newFeature")
-	{
-		citygml::CityObject* tempCObj = *getCurrentCityObject();
-		citygml::CityObject* child = tempCObj->getChild(0);
-		_currentTransaction->setNewFeature(child);
-		tempCObj->clearChildren();
-		popCityObject();
-		popObject();
-		delete tempCObj;
-	}
-	if (name == "oldFeature")
+	if (name == "newFeature" || name == "oldFeature")
 	{
 		citygml::CityObject* tempCObj = *getCurrentCityObject();
 		citygml::CityObject* child = tempCObj->getChild(0);
-		_currentTransaction->setOldFeature(child);
-		tempCObj->clearChildren();
 		popCityObject();
 		popObject();
-		delete tempCObj;
+		if (child)
+		{
+			// the feature has no parent until a transition inserts it in the model
+			child->_parent = nullptr;
+			tempCObj->clearChildren();
+			delete tempCObj;
+		}
+		else if (tempCObj->_isXlink == citygml::xLinkState::UNLINKED) child = tempCObj;
+		else delete tempCObj;
+		if (name == "newFeature") _currentTransaction->setNewFeature(child);
+		else _currentTransaction->setOldFeature(child);
 	}
 }
 /******************************************************/
 void TempHandler::endDocument()
 {
+	// Transitions : the xlinks to versions are resolved by id
 	for (temporal::VersionTransition* transition : _transitions)
 	{
-		if (transition->from()->_isXlink == citygml::xLinkState::UNLINKED)
-		{
-			std::string id = getIDfromQuery(transition->from()->getAttribute("xlink"));
-			if (!(id == ""))
-			{
-				for (temporal::Version* version : _versions)
-				{
-					if (id == version->getId()) transition->setFrom(version);
-				}
-			}
-			else { std::cerr << "ERROR: XLink expression not supported! : \"" << transition->from()->getAttribute("xlink") << "\"" << std::endl; }
-		}
-		if (transition->to()->_isXlink == citygml::xLinkState::UNLINKED)
-		{
-			std::string id = getIDfromQuery(transition->to()->getAttribute("xlink"));
-			if (!(id == ""))
-			{
-				for (temporal::Version* version : _versions)
-				{
-					if (id == version->getId()) transition->setTo(version);
-				}
-			}
-			else { std::cerr << "ERROR: XLink expression not supported! : \"" << transition->to()->getAttribute("xlink") << "\"" << std::endl; }
-		}
-		//std::cout<<"Transition \""<<transition->getId()<<"\" :"<<std::endl;
-		//std::cout<<"    - from: "<<transition->from()->getId()<<std::endl;
-		//std::cout<<"    - to: "<<transition->to()->getId()<<std::endl;
+		temporal::Version* from = transition->from();
+		temporal::Version* to = transition->to();
+		if (from) linkVersion(from, from);
+		if (to) linkVersion(to, to);
+		transition->setFrom(from);
+		transition->setTo(to);
 	}
-	//std::cout<<std::endl;
+
+	// Version members : the xlinks to city objects are resolved through an index of the whole tree, built once
+	std::unordered_map<std::string, citygml::CityObject*> nodesById;
+	bool indexed = false;
 	for (temporal::Version* version : _versions)
 	{
-		//std::cout<<"Version \""<<version->getId()<<"\" :"<<std::endl;
 		std::vector<citygml::CityObject*>* members = version->getVersionMembers();
 		for (std::vector<citygml::CityObject*>::iterator it = members->begin(); it != members->end(); it++)
 		{
@@ -294,15 +280,19 @@ void TempHandler::endDocument()
 				std::string id = getIDfromQuery(query);
 				if (!(id == ""))
 				{
-					citygml::CityObject* target = (*getModel())->getNodeById(id);
-					if (target) (*it) = target;
+					if (!indexed)
+					{
+						(*getModel())->getNodesById(nodesById);
+						indexed = true;
+					}
+					std::unordered_map<std::string, citygml::CityObject*>::const_iterator target = nodesById.find(id);
+					if (target != nodesById.end()) (*it) = target->second;
 				}
 				else { std::cerr << "ERROR: XLink expression not supported! : \"" << query << "\"" << std::endl; }
 			}
 		}
 		for (std::vector<citygml::CityObject*>::iterator it = members->begin(); it != members->end(); it++)
 		{
-			//std::cout<<"    - member: "<<(*it)->getId()<<std::endl;
 			(*it)->_isInVersion = true;
 		}
 	}
@@ -311,3 +301,16 @@ void TempHandler::endDocument()
 	(*model)->setVersions(_versions, _transitions);
 	(*model)->setWorkspaces(_workspaces);
 }
+/******************************************************/
+void TempHandler::linkVersion(temporal::Version* link, temporal::Version*& version)
+{
+	if (link->_isXlink != citygml::xLinkState::UNLINKED) return;
+
+	std::string id = getIDfromQuery(link->getAttribute("xlink"));
+	if (!(id == ""))
+	{
+		std::unordered_map<std::string, temporal::Version*>::const_iterator it = _versionsById.find(id);
+		if (it != _versionsById.end()) version = it->second;
+	}
+	else { std::cerr << "ERROR: XLink expression not supported! : \"" << link->getAttribute("xlink") << "\"" << std::endl; }
+}
@@ -6,6 +6,8 @@
 #ifndef _TEMPORALHANDLER_HPP_
 #define _TEMPORALHANDLER_HPP_
 
+#include <unordered_map>
+
 #include "../ADE.hpp"
 #include "Version.hpp"
 #include "VersionTransition.hpp"
@@ -21,6 +23,7 @@ protected:
 	bool _inFromTags;
 	bool _inToTags;
 	std::vector<temporal::Version*> _versions;
+	std::unordered_map<std::string, temporal::Version*> _versionsById; // filled with _versions : the last version of an id
 	std::vector<temporal::VersionTransition*> _transitions;
 	std::map<std::string, temporal::Workspace> _workspaces;
 
@@ -34,6 +37,7 @@ protected:
 	std::string getAttribute(void*, const std::string&, const std::string&);
 	std::string removeNamespace(std::string);
 	std::string getIDfromQuery(std::string);
+	void linkVersion(temporal::Version*, temporal::Version*&);
 	//private:
 		//  JE 17/02/2016: DISCARDED BECAUSE PROBLEMS WITH RECENT VERSIONS OF UBUNTU:
 		//Adding to ADE register (template in ADE.hpp)
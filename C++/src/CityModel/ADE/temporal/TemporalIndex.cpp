@@ -0,0 +1,261 @@
+// Copyright University of Lyon, 2012 - 2017
+// Distributed under the GNU Lesser General Public License Version 2.1 (LGPLv2)
+// (Refer to accompanying file LICENSE.md or copy at
+//  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
+
+#include "TemporalIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace temporal
+{
+	static const uint32_t NONE = (uint32_t)-1;
+
+	TemporalIndex::TemporalIndex() : _root(NONE)
+	{}
+
+	void TemporalIndex::build(const std::vector<citygml::CityObject*>& roots, const std::vector<Version*>& versions,
+		const std::unordered_set<const citygml::CityObject*>& excluded)
+	{
+		_features.clear();
+		_start.clear();
+		_end.clear();
+		_nodes.clear();
+		_byStart.clear();
+		_byEnd.clear();
+		_members.clear();
+		_root = NONE;
+
+		// Features : roots, then the members of the versions (a member may be an unresolved xlink)
+		std::unordered_map<const citygml::CityObject*, uint32_t> featureIndex;
+		featureIndex.reserve(roots.size());
+		for (citygml::CityObject* root : roots)
+			if (featureIndex.emplace(root, (uint32_t)_features.size()).second)
+				_features.push_back(root);
+		for (Version* version : versions)
+			for (citygml::CityObject* member : *version->getVersionMembers())
+				if (featureIndex.emplace(member, (uint32_t)_features.size()).second)
+					_features.push_back(member);
+
+		// Validity intervals, open when the date is missing or unreadable. The excluded features have none.
+		std::vector<uint32_t> intervals;
+		intervals.reserve(_features.size());
+		_start.resize(_features.size());
+		_end.resize(_features.size());
+		for (uint32_t i = 0; i < _features.size(); ++i)
+		{
+			if (!parseDate(_features[i]->getAttribute("creationDate"), _start[i]))
+				_start[i] = std::numeric_limits<int64_t>::min();
+			if (!parseDate(_features[i]->getAttribute("terminationDate"), _end[i]))
+				_end[i] = std::numeric_limits<int64_t>::max();
+			if (_start[i] < _end[i] && !excluded.count(_features[i]))
+				intervals.push_back(i);
+		}
+		_root = build(intervals);
+
+		// Members of the versions
+		size_t words = (_features.size() + 63) / 64;
+		for (Version* version : versions)
+		{
+			std::vector<uint64_t>& bits = _members[version];
+			bits.assign(words, 0);
+			for (citygml::CityObject* member : *version->getVersionMembers())
+			{
+				uint32_t i = featureIndex[member];
+				bits[i / 64] |= (uint64_t)1 << (i % 64);
+			}
+		}
+	}
+
+	uint32_t TemporalIndex::build(std::vector<uint32_t>& intervals)
+	{
+		if (intervals.empty())
+			return NONE;
+
+		// Center : median start. The interval of the median start contains it, so both sides are smaller.
+		std::vector<uint32_t>::iterator median = intervals.begin() + intervals.size() / 2;
+		std::nth_element(intervals.begin(), median, intervals.end(), [this](uint32_t a, uint32_t b) { return _start[a] < _start[b]; });
+		int64_t center = _start[*median];
+
+		std::vector<uint32_t> left, right;
+		uint32_t first = (uint32_t)_byStart.size();
+		for (uint32_t i : intervals)
+		{
+			if (_end[i] <= center)
+				left.push_back(i);
+			else if (_start[i] > center)
+				right.push_back(i);
+			else
+				_byStart.push_back(i);
+		}
+		uint32_t count = (uint32_t)_byStart.size() - first;
+		_byEnd.insert(_byEnd.end(), _byStart.begin() + first, _byStart.end());
+		std::sort(_byStart.begin() + first, _byStart.end(), [this](uint32_t a, uint32_t b) { return _start[a] < _start[b]; });
+		std::sort(_byEnd.begin() + first, _byEnd.end(), [this](uint32_t a, uint32_t b) { return _end[a] > _end[b]; });
+
+		intervals.clear();
+		intervals.shrink_to_fit();
+
+		uint32_t node = (uint32_t)_nodes.size();
+		_nodes.push_back(Node{ center, NONE, NONE, first, count });
+		uint32_t leftNode = build(left);
+		uint32_t rightNode = build(right);
+		_nodes[node].left = leftNode;
+		_nodes[node].right = rightNode;
+		return node;
+	}
+
+	void TemporalIndex::queryAt(int64_t date, std::vector<citygml::CityObject*>& result) const
+	{
+		// features found marked in a bitset : read back in the order of the index without sorting
+		std::vector<uint64_t> found((_features.size() + 63) / 64, 0);
+		for (uint32_t n = _root; n != NONE;)
+		{
+			const Node& node = _nodes[n];
+			if (date < node.center)
+			{
+				// the intervals of the node end after center : they contain date if they start before
+				for (uint32_t i = node.first; i < node.first + node.count && _start[_byStart[i]] <= date; ++i)
+					found[_byStart[i] / 64] |= (uint64_t)1 << (_byStart[i] % 64);
+				n = node.left;
+			}
+			else
+			{
+				// the intervals of the node start before center : they contain date if they end after
+				for (uint32_t i = node.first; i < node.first + node.count && _end[_byEnd[i]] > date; ++i)
+					found[_byEnd[i] / 64] |= (uint64_t)1 << (_byEnd[i] % 64);
+				n = node.right;
+			}
+		}
+		getFeatures(found, result);
+	}
+
+	const std::vector<uint64_t>* TemporalIndex::getMembers(const Version* version) const
+	{
+		std::unordered_map<const Version*, std::vector<uint64_t>>::const_iterator it = _members.find(version);
+		return (it != _members.end()) ? &it->second : nullptr;
+	}
+
+	// Index of the lowest bit set in word (not 0)
+	static inline unsigned lowestBit(uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long bit;
+		_BitScanForward64(&bit, word);
+		return (unsigned)bit;
+#else
+		return (unsigned)__builtin_ctzll(word);
+#endif
+	}
+
+	void TemporalIndex::getFeatures(const std::vector<uint64_t>& bits, std::vector<citygml::CityObject*>& result) const
+	{
+		for (size_t w = 0; w < bits.size(); ++w)
+			for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+				result.push_back(_features[w * 64 + lowestBit(word)]);
+	}
+
+	void TemporalIndex::queryVersion(const Version* version, std::vector<citygml::CityObject*>& result) const
+	{
+		const std::vector<uint64_t>* members = getMembers(version);
+		if (members)
+			getFeatures(*members, result);
+	}
+
+	void TemporalIndex::diff(const Version* from, const Version* to, std::vector<citygml::CityObject*>& removed, std::vector<citygml::CityObject*>& added) const
+	{
+		const std::vector<uint64_t>* fromMembers = getMembers(from);
+		const std::vector<uint64_t>* toMembers = getMembers(to);
+		std::vector<uint64_t> empty((_features.size() + 63) / 64, 0);
+		if (!fromMembers) fromMembers = &empty;
+		if (!toMembers) toMembers = &empty;
+
+		std::vector<uint64_t> bits(empty.size());
+		for (size_t w = 0; w < bits.size(); ++w)
+			bits[w] = (*fromMembers)[w] & ~(*toMembers)[w];
+		getFeatures(bits, removed);
+		for (size_t w = 0; w < bits.size(); ++w)
+			bits[w] = (*toMembers)[w] & ~(*fromMembers)[w];
+		getFeatures(bits, added);
+	}
+
+	// Days from 1970-01-01 of a date of the proleptic Gregorian calendar (H. Hinnant, days_from_civil)
+	static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+	{
+		y -= m <= 2;
+		const int64_t era = (y >= 0 ? y : y - 399) / 400;
+		const unsigned yoe = (unsigned)(y - era * 400);
+		const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+		const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + (int64_t)doe - 719468;
+	}
+
+	// Read exactly count digits at s[pos]
+	static bool readDigits(const std::string& s, size_t& pos, size_t count, int& value)
+	{
+		value = 0;
+		for (size_t i = 0; i < count; ++i, ++pos)
+		{
+			if (pos >= s.size() || !isdigit((unsigned char)s[pos]))
+				return false;
+			value = value * 10 + (s[pos] - '0');
+		}
+		return true;
+	}
+
+	bool TemporalIndex::parseDate(const std::string& date, int64_t& seconds)
+	{
+		size_t pos = 0;
+		int year, month = 1, day = 1, hour = 0, minute = 0, second = 0;
+		bool negative = !date.empty() && date[0] == '-';
+		if (negative) ++pos;
+		if (!readDigits(date, pos, 4, year))
+			return false;
+		while (pos < date.size() && isdigit((unsigned char)date[pos]))
+			year = year * 10 + (date[pos++] - '0');
+		if (negative) year = -year;
+
+		if (pos < date.size() && date[pos] == '-')
+		{
+			if (!readDigits(date, ++pos, 2, month) || month < 1 || month > 12)
+				return false;
+			if (pos < date.size() && date[pos] == '-' && !readDigits(date, ++pos, 2, day))
+				return false;
+			if (day < 1 || day > 31)
+				return false;
+		}
+		if (pos < date.size() && date[pos] == 'T')
+		{
+			if (!readDigits(date, ++pos, 2, hour) || pos >= date.size() || date[pos] != ':' || !readDigits(date, ++pos, 2, minute))
+				return false;
+			if (pos < date.size() && date[pos] == ':' && !readDigits(date, ++pos, 2, second))
+				return false;
+			if (pos < date.size() && date[pos] == '.') // fraction of second, ignored
+				for (++pos; pos < date.size() && isdigit((unsigned char)date[pos]); ++pos);
+		}
+
+		int64_t offset = 0;
+		if (pos < date.size() && date[pos] == 'Z')
+			++pos;
+		else if (pos < date.size() && (date[pos] == '+' || date[pos] == '-'))
+		{
+			int sign = (date[pos] == '-') ? -1 : 1;
+			int offsetHour, offsetMinute;
+			if (!readDigits(date, ++pos, 2, offsetHour) || pos >= date.size() || date[pos] != ':' || !readDigits(date, ++pos, 2, offsetMinute))
+				return false;
+			offset = sign * (offsetHour * 3600 + offsetMinute * 60);
+		}
+		if (pos != date.size())
+			return false;
+
+		seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+		return true;
+	}
+
+} //namespace temporal
@@ -0,0 +1,76 @@
+// Copyright University of Lyon, 2012 - 2017
+// Distributed under the GNU Lesser General Public License Version 2.1 (LGPLv2)
+// (Refer to accompanying file LICENSE.md or copy at
+//  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
+
+#ifndef _TEMPORAL_INDEX_HPP_
+#define _TEMPORAL_INDEX_HPP_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Version.hpp"
+
+namespace temporal
+{
+	/// Snapshot queries over the features of a model : the roots and the members of the versions.
+	///
+	/// The validity intervals [creationDate, terminationDate) of the features are stored in a centered interval tree
+	/// (a missing date is an open bound), and the members of every version in a bitset over the features : a
+	/// query returns the features (no copy), in the order of the index, in O(log n + k + n / 64) for a date and
+	/// O(n / 64) for a version or the difference of two versions.
+	class TemporalIndex
+	{
+	public:
+		TemporalIndex();
+
+		/// Index roots, then the members of versions which are not roots. The excluded features (taken out of the model)
+		/// are left out of the date queries, they remain members of their versions.
+		void build(const std::vector<citygml::CityObject*>& roots, const std::vector<Version*>& versions,
+			const std::unordered_set<const citygml::CityObject*>& excluded = std::unordered_set<const citygml::CityObject*>());
+
+		/// Features alive at date (creationDate <= date < terminationDate), in the order of the index
+		void queryAt(int64_t date, std::vector<citygml::CityObject*>& result) const;
+
+		/// Members of version, in the order of the index
+		void queryVersion(const Version* version, std::vector<citygml::CityObject*>& result) const;
+
+		/// Members of from which are not in to (removed) and members of to which are not in from (added)
+		void diff(const Version* from, const Version* to, std::vector<citygml::CityObject*>& removed, std::vector<citygml::CityObject*>& added) const;
+
+		/// Seconds since 1970-01-01T00:00:00Z of an xs:date / xs:dateTime ("2012", "2012-05", "2012-05-31",
+		/// "2012-05-31T10:20:30.5+02:00", ...). Returns false if date is not one of these forms.
+		static bool parseDate(const std::string& date, int64_t& seconds);
+
+	private:
+		struct Node
+		{
+			int64_t center;
+			uint32_t left;		// child nodes (NONE if empty)
+			uint32_t right;
+			uint32_t first;		// intervals containing center : _byStart / _byEnd [first, first + count)
+			uint32_t count;
+		};
+
+		uint32_t build(std::vector<uint32_t>& intervals);
+		const std::vector<uint64_t>* getMembers(const Version* version) const;
+		void getFeatures(const std::vector<uint64_t>& bits, std::vector<citygml::CityObject*>& result) const;
+
+		std::vector<citygml::CityObject*> _features;
+		std::vector<int64_t> _start;	// validity of the features
+		std::vector<int64_t> _end;
+
+		std::vector<Node> _nodes;
+		uint32_t _root;
+		std::vector<uint32_t> _byStart;	// features of the nodes by increasing start
+		std::vector<uint32_t> _byEnd;	// features of the nodes by decreasing end
+
+		std::unordered_map<const Version*, std::vector<uint64_t>> _members;	// bitset of the features of every version
+	};
+
+} //namespace temporal
+
+#endif //_TEMPORAL_INDEX_HPP_
@@ -8,7 +8,7 @@
 namespace temporal
 {
 
-	Transaction::Transaction(const std::string& id) : Object(id)
+	Transaction::Transaction(const std::string& id) : Object(id), _type(INSERT), _newFeature(nullptr), _oldFeature(nullptr)
 	{}
 
 	void Transaction::setType(TransactionValue param)
@@ -26,5 +26,20 @@ namespace temporal
 		_newFeature = object;
 	}
 
+	TransactionValue Transaction::getType() const
+	{
+		return _type;
+	}
+
+	citygml::CityObject* Transaction::getOldFeature() const
+	{
+		return _oldFeature;
+	}
+
+	citygml::CityObject* Transaction::getNewFeature() const
+	{
+		return _newFeature;
+	}
+
 
 }//namespace temporal
@@ -24,6 +24,11 @@ namespace temporal
 		void setType(TransactionValue);
 		void setOldFeature(citygml::CityObject*);
 		void setNewFeature(citygml::CityObject*);
+		TransactionValue getType() const;
+		/// Feature removed or replaced (delete, replace) : the node of the model or an xlink to it
+		citygml::CityObject* getOldFeature() const;
+		/// Feature added (insert, replace)
+		citygml::CityObject* getNewFeature() const;
 	private:
 		TransactionValue _type;
 		citygml::CityObject* _newFeature;
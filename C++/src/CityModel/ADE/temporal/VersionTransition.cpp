@@ -7,7 +7,7 @@
 
 namespace temporal {
 
-	VersionTransition::VersionTransition(const std::string& id) : Object(id)
+	VersionTransition::VersionTransition(const std::string& id) : Object(id), _clonePredecessor(false), _type(PLANNED), _from(nullptr), _to(nullptr)
 	{}
 
 	VersionTransition::~VersionTransition()
@@ -58,4 +58,9 @@ namespace temporal {
 		_transactions.push_back(transaction);
 	}
 
+	std::vector<Transaction*>* VersionTransition::getTransactions()
+	{
+		return &_transactions;
+	}
+
 } //namespace temporal
@@ -26,12 +26,13 @@
 #include <iterator>
 #include <set>
 #include <algorithm>
+#include <functional>
 
 namespace citygml
 {
 	////////////////////////////////////////////////////////////////////////////////
 	CityModel::CityModel(const std::string& id)
-		: Object(id)
+		: Object(id), _rootsIndexSize((size_t)-1), _nodesByIdRoots((size_t)-1), _geometryLoader(nullptr), _temporalIndexRoots((size_t)-1), _temporalIndexVersions((size_t)-1)
 	{
 	}
 	////////////////////////////////////////////////////////////////////////////////
@@ -48,6 +49,7 @@ namespace citygml
 		}
 		for (temporal::Version* version : _versions) delete version;
 		for (temporal::VersionTransition* trans : _versionTransitions) delete trans;
+		delete _geometryLoader;
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	// Return the envelope (ie. the bounding box) of the model
@@ -162,6 +164,20 @@ namespace citygml
 		return res;
 	}
 	////////////////////////////////////////////////////////////////////////////////
+	void CityModel::getNodesById(std::unordered_map<std::string, CityObject*>& nodes)
+	{
+		// depth first, in the order of getNodeById : the first node of an id is kept
+		std::vector<CityObject*> stack(_roots.rbegin(), _roots.rend());
+		while (!stack.empty())
+		{
+			CityObject* node = stack.back();
+			stack.pop_back();
+			if (!node->getId().empty())
+				nodes.emplace(node->getId(), node);
+			stack.insert(stack.end(), node->getChildren().rbegin(), node->getChildren().rend());
+		}
+	}
+	////////////////////////////////////////////////////////////////////////////////
 	CityObject* CityModel::getNode(const vcity::URI& uri, bool inPickingMode)
 	{
 		std::string sNode;
@@ -209,12 +225,22 @@ namespace citygml
 	void CityModel::finish(const ParserParams& params)
 	{
 		// Assign appearances to cityobjects => geometries => polygons
+		// (the geometries not parsed yet are finished when they are loaded)
 		CityObjectsMap::const_iterator it = _cityObjectsMap.begin();
 		for (; it != _cityObjectsMap.end(); ++it)
 			for (unsigned int i = 0; i < it->second.size(); i++)
-				it->second[i]->finish(_appearanceManager, params);
+				if (!it->second[i]->getGeometryLoader())
+					it->second[i]->finish(_appearanceManager, params);
 
-		_appearanceManager.finish();
+		// The texture coordinates are kept for the geometries to load
+		if (!params.lazyGeometry)
+			_appearanceManager.finish();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	void CityModel::setGeometryLoader(GeometryLoader* loader)
+	{
+		delete _geometryLoader;
+		_geometryLoader = loader;
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	void CityModel::computeEnvelope()
@@ -246,6 +272,326 @@ namespace citygml
 		}
 	}
 	////////////////////////////////////////////////////////////////////////////////
+	void CityModel::buildSpatialIndex()
+	{
+		std::vector< std::pair<Envelope, size_t> > items;
+		items.reserve(_roots.size());
+		for (size_t i = 0; i < _roots.size(); i++)
+		{
+			CityObject* obj = _roots[i];
+
+			// Envelopes are not always read from the file (gml:boundedBy is optional)
+			const Envelope& envelope = obj->getEnvelope();
+			if (envelope.getLowerBound().x > envelope.getUpperBound().x)
+				obj->computeEnvelope();
+			if (envelope.getLowerBound().x > envelope.getUpperBound().x)
+				continue; // no geometry
+
+			items.push_back(std::make_pair(envelope, i));
+		}
+
+		_rootsIndex.build(items);
+		_rootsIndexSize = _roots.size();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	std::vector<CityObject*> CityModel::query(const Envelope& envelope)
+	{
+		if (_rootsIndexSize != _roots.size())
+			buildSpatialIndex();
+
+		std::vector<size_t> indices;
+		_rootsIndex.query(envelope, indices);
+		std::sort(indices.begin(), indices.end());
+
+		std::vector<CityObject*> result;
+		result.reserve(indices.size());
+		for (size_t i : indices)
+			result.push_back(_roots[i]);
+		return result;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	std::vector<CityObject*> CityModel::nearest(const TVec3d& point, size_t k)
+	{
+		if (_rootsIndexSize != _roots.size())
+			buildSpatialIndex();
+
+		std::vector<CityObject*> result;
+		for (size_t i : _rootsIndex.nearest(point, k))
+			result.push_back(_roots[i]);
+		return result;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	void CityModel::buildTemporalIndex()
+	{
+		_temporalIndex.build(_roots, _versions, _removedNodes);
+		_temporalIndexRoots = _roots.size();
+		_temporalIndexVersions = _versions.size();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	std::vector<CityObject*> CityModel::queryAt(const std::string& date)
+	{
+		std::vector<CityObject*> result;
+		int64_t seconds;
+		if (!temporal::TemporalIndex::parseDate(date, seconds))
+			return result;
+
+		if (_temporalIndexRoots != _roots.size() || _temporalIndexVersions != _versions.size())
+			buildTemporalIndex();
+		_temporalIndex.queryAt(seconds, result);
+		return result;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	std::vector<CityObject*> CityModel::queryVersion(const temporal::Version* version)
+	{
+		if (_temporalIndexRoots != _roots.size() || _temporalIndexVersions != _versions.size())
+			buildTemporalIndex();
+
+		std::vector<CityObject*> result;
+		_temporalIndex.queryVersion(version, result);
+		return result;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	void CityModel::diffVersions(const temporal::Version* from, const temporal::Version* to, std::vector<CityObject*>& removed, std::vector<CityObject*>& added)
+	{
+		if (_temporalIndexRoots != _roots.size() || _temporalIndexVersions != _versions.size())
+			buildTemporalIndex();
+
+		_temporalIndex.diff(from, to, removed, added);
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	// Id of the node a transaction feature stands for : the target of an xlink (#id or //*[@id='id']), its own id otherwise
+	static std::string getFeatureId(CityObject* feature)
+	{
+		if (feature->_isXlink != xLinkState::UNLINKED)
+			return feature->getId();
+
+		std::string query = feature->getAttribute("xlink");
+		size_t pos1 = query.find("//*[@id='");
+		size_t pos2 = query.find("']", pos1);
+		if (pos1 != std::string::npos && pos2 != std::string::npos)
+			return query.substr(pos1 + 9, pos2 - (pos1 + 9));
+		if (query.find("#") == 0)
+			return query.substr(1);
+		return "";
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	static bool isEmpty(const Envelope& envelope)
+	{
+		return envelope.getLowerBound().x > envelope.getUpperBound().x;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	std::vector<Envelope> CityModel::applyTransition(temporal::VersionTransition* transition, std::vector<CityObject*>& removed)
+	{
+		std::vector<Envelope> changed;
+		if (!transition)
+			return changed;
+
+		if (_nodesByIdRoots != _roots.size())
+		{
+			_nodesById.clear();
+			_nodesById.reserve(size());
+			getNodesById(_nodesById);
+		}
+		bool spatialIndexed = (_rootsIndexSize == _roots.size());
+
+		std::vector<std::pair<CityObject*, bool>> typeChanges;	// node added (true) or removed (false)
+		bool rootsRemoved = false;
+
+		// Position of a root in _roots, through the spatial index when it is up to date. The slots of the removed
+		// roots are emptied and compacted at the end : the positions don't move until then.
+		auto findRoot = [this, spatialIndexed](CityObject* root) -> size_t
+		{
+			if (spatialIndexed && !isEmpty(root->getEnvelope()))
+			{
+				std::vector<size_t> candidates;
+				_rootsIndex.query(root->getEnvelope(), candidates);
+				for (size_t i : candidates)
+					if (_roots[i] == root)
+						return i;
+			}
+			return std::find(_roots.begin(), _roots.end(), root) - _roots.begin();
+		};
+
+		auto find = [this](const std::string& id) -> CityObject*
+		{
+			std::unordered_map<std::string, CityObject*>::const_iterator it = _nodesById.find(id);
+			return (!id.empty() && it != _nodesById.end()) ? it->second : nullptr;
+		};
+		// Apply f to node and all its descendants
+		auto forSubtree = [](CityObject* node, const std::function<void(CityObject*)>& f)
+		{
+			std::vector<CityObject*> stack(1, node);
+			while (!stack.empty())
+			{
+				CityObject* current = stack.back();
+				stack.pop_back();
+				f(current);
+				stack.insert(stack.end(), current->getChildren().begin(), current->getChildren().end());
+			}
+		};
+
+		for (temporal::Transaction* transaction : *transition->getTransactions())
+		{
+			CityObject* oldNode = nullptr;
+			CityObject* newNode = nullptr;
+			if (transaction->getType() != temporal::INSERT && transaction->getOldFeature())
+				oldNode = find(getFeatureId(transaction->getOldFeature()));
+			if (transaction->getType() != temporal::DEL && transaction->getNewFeature())
+			{
+				// an xlink names a node of the model : it is already in place
+				newNode = transaction->getNewFeature();
+				if (newNode->_isXlink == xLinkState::UNLINKED || find(newNode->getId()) == newNode)
+					newNode = nullptr;
+				else if (transaction->getType() == temporal::INSERT)
+					oldNode = find(newNode->getId());
+			}
+			if ((!oldNode && !newNode) || oldNode == newNode)
+				continue;
+
+			CityObject* parent = oldNode ? oldNode->_parent : nullptr;
+			CityObject* root = oldNode ? oldNode : newNode;
+			while (root->_parent)
+				root = root->_parent;
+			size_t position = oldNode ? findRoot(root) : _roots.size();
+			if (position == _roots.size() && oldNode)
+				continue; // not reachable from the roots
+
+			if (oldNode)
+			{
+				if (isEmpty(oldNode->getEnvelope()))
+					oldNode->computeEnvelope();
+				if (!isEmpty(oldNode->getEnvelope()))
+					changed.push_back(oldNode->getEnvelope());
+			}
+			if (newNode)
+			{
+				newNode->_parent = parent;
+				if (isEmpty(newNode->getEnvelope()))
+					newNode->computeEnvelope();
+				if (!isEmpty(newNode->getEnvelope()))
+				{
+					changed.push_back(newNode->getEnvelope());
+					if (!isEmpty(_envelope))
+						_envelope.merge(newNode->getEnvelope());
+				}
+			}
+
+			if (!parent)
+			{
+				// change of a root : the slot of the old root is kept
+				if (oldNode)
+				{
+					if (spatialIndexed)
+						_rootsIndex.remove(oldNode->getEnvelope(), position);
+					_roots[position] = newNode;
+					rootsRemoved = rootsRemoved || !newNode;
+				}
+				else
+					_roots.push_back(newNode);
+
+				if (newNode)
+				{
+					if (spatialIndexed && !isEmpty(newNode->getEnvelope()))
+						_rootsIndex.insert(newNode->getEnvelope(), position);
+				}
+			}
+			else
+			{
+				// change under a root : the new node takes the place of the old one, the envelopes of its ancestors
+				// are recomputed
+				if (spatialIndexed)
+					_rootsIndex.remove(root->getEnvelope(), position);
+
+				if (newNode)
+				{
+					std::vector<CityObject*>& children = parent->getChildren();
+					std::vector<CityObject*>::iterator it = std::find(children.begin(), children.end(), oldNode);
+					if (it != children.end())
+						*it = newNode;
+					else
+						parent->insertNode(newNode);
+				}
+				else
+					parent->deleteNode(oldNode);
+
+				for (CityObject* node = parent; node; node = node->_parent)
+					node->_envelope = Envelope();
+				root->computeEnvelope();
+				if (spatialIndexed && !isEmpty(root->getEnvelope()))
+					_rootsIndex.insert(root->getEnvelope(), position);
+			}
+
+			if (oldNode)
+			{
+				oldNode->_parent = nullptr;
+				removed.push_back(oldNode);
+				forSubtree(oldNode, [&](CityObject* node)
+				{
+					std::unordered_map<std::string, CityObject*>::const_iterator it = _nodesById.find(node->getId());
+					if (it != _nodesById.end() && it->second == node)
+						_nodesById.erase(it);
+					_removedNodes.insert(node);
+					typeChanges.push_back(std::make_pair(node, false));
+				});
+			}
+			if (newNode)
+			{
+				forSubtree(newNode, [&](CityObject* node)
+				{
+					if (!node->getId().empty())
+						_nodesById.emplace(node->getId(), node);
+					_removedNodes.erase(node);
+					typeChanges.push_back(std::make_pair(node, true));
+				});
+			}
+		}
+
+		if (rootsRemoved)
+		{
+			std::vector<size_t> positions(_roots.size());
+			size_t count = 0;
+			for (size_t i = 0; i < _roots.size(); i++)
+			{
+				positions[i] = count;
+				if (_roots[i])
+					_roots[count++] = _roots[i];
+			}
+			_roots.resize(count);
+			if (spatialIndexed)
+				_rootsIndex.renumber([&positions](size_t i) { return positions[i]; });
+		}
+
+		// Objects by type : the changed nodes are taken out of the lists of their types, then the nodes added
+		// (by their last change) are appended
+		std::unordered_map<CityObject*, bool> added;
+		std::set<CityObjectsType> types;
+		for (const std::pair<CityObject*, bool>& change : typeChanges)
+		{
+			added[change.first] = change.second;
+			types.insert(change.first->getType());
+		}
+		for (CityObjectsType type : types)
+		{
+			CityObjects& objects = _cityObjectsMap[type];
+			objects.erase(std::remove_if(objects.begin(), objects.end(), [&added](CityObject* node) { return added.count(node) > 0; }), objects.end());
+		}
+		for (const std::pair<CityObject*, bool>& change : typeChanges)
+		{
+			std::unordered_map<CityObject*, bool>::iterator it = added.find(change.first);
+			if (it != added.end() && it->second)
+			{
+				_cityObjectsMap[change.first->getType()].push_back(change.first);
+				added.erase(it); // once
+			}
+		}
+
+		if (spatialIndexed)
+			_rootsIndexSize = _roots.size();
+		_nodesByIdRoots = _roots.size();
+		_temporalIndexRoots = (size_t)-1;
+		return changed;
+	}
+	////////////////////////////////////////////////////////////////////////////////
 	std::ostream& operator<<(std::ostream& out, const CityModel& model)
 	{
 		out << "  Envelope: " << model.getEnvelope() << std::endl;
@@ -267,6 +613,7 @@ namespace citygml
 	{
 		_versions = versionsList;
 		_versionTransitions = transitionsList;
+		_temporalIndexVersions = (size_t)-1;
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	const std::vector<temporal::Version*> CityModel::getVersions() const
@@ -19,9 +19,12 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <ostream>
 #include "Object.hpp"
 #include "Envelope.hpp"
+#include "RTree.hpp"
 #include "CityObject.hpp"
 #include "AppearanceManager.hpp"
 #include "Vecs.hpp"
@@ -29,6 +32,7 @@
 #include "ADE/temporal/Version.hpp"
 #include "ADE/temporal/VersionTransition.hpp"
 #include "ADE/temporal/Workspace.hpp"
+#include "ADE/temporal/TemporalIndex.hpp"
 #include "ADE/document/DocumentObject.hpp"
 #include "ADE/document/Reference.hpp"
 #include <vector>
@@ -40,6 +44,9 @@
 	#pragma warning(disable: 4251) // export problem on STL members
 #endif
 
+//forward declaration
+class CityJSONParser;
+
 ////////////////////////////////////////////////////////////////////////////////
 namespace citygml
 {
@@ -50,6 +57,7 @@ namespace citygml
 	class /*CITYGML_EXPORT*/ CityModel : public Object
 	{
 		friend class CityGMLHandler;
+		friend class ::CityJSONParser;
 	public:
 		CityModel(const std::string& id = "CityModel");
 
@@ -78,6 +86,17 @@ namespace citygml
 
 		void computeEnvelope();
 
+		/// Return the roots whose envelope intersects envelope (bounds included), in the order of getCityObjectsRoots().
+		/// Use -DBL_MAX / DBL_MAX as z bounds for a 2D query.
+		std::vector<CityObject*> query(const Envelope& envelope);
+
+		/// Return the k roots closest to point (distance to their envelope), closest first
+		std::vector<CityObject*> nearest(const TVec3d& point, size_t k);
+
+		/// (Re)build the spatial index used by query and nearest. It is built on the first query and rebuilt
+		/// when the number of roots changes : call it after moving or editing roots.
+		void buildSpatialIndex();
+
 		AppearanceManager* getAppearanceManager();
 
 		/// Add a direct child
@@ -102,8 +121,15 @@ namespace citygml
 		/// Get node by name
 		CityObject* getNodeById(const std::string& id);
 
+		/// Index the nodes of the whole tree by id, in one pass : for a duplicated id, the node returned by
+		/// getNodeById is kept. Nodes without id are skipped.
+		void getNodesById(std::unordered_map<std::string, CityObject*>& nodes);
+
 		void finish(const ParserParams&);
 
+		/// Set the loader of the geometries not parsed (see ParserParams::lazyGeometry), owned by the model
+		void setGeometryLoader(GeometryLoader* loader);
+
 		std::string m_basePath;
 
 		void setVersions(std::vector<temporal::Version*>, std::vector<temporal::VersionTransition*>);
@@ -111,6 +137,35 @@ namespace citygml
 		std::vector<temporal::Version*> getVersions();
 		std::vector<temporal::VersionTransition*> getTransitions();
 
+		/// Return the roots and version members alive at date (xs:date or xs:dateTime) : creationDate <= date <
+		/// terminationDate, a missing date being an open bound. The nodes taken out of the model by applyTransition
+		/// are left out. Empty if date can't be read.
+		std::vector<CityObject*> queryAt(const std::string& date);
+
+		/// Return the members of version
+		std::vector<CityObject*> queryVersion(const temporal::Version* version);
+
+		/// Members of from missing in to (removed) and members of to missing in from (added)
+		void diffVersions(const temporal::Version* from, const temporal::Version* to, std::vector<CityObject*>& removed, std::vector<CityObject*>& added);
+
+		/// (Re)build the temporal index used by queryAt, queryVersion and diffVersions. It is built on the first query
+		/// and rebuilt when the roots or the versions change in number : call it after editing dates or members.
+		void buildTemporalIndex();
+
+		/// Apply the transactions of transition to the loaded model, in place of parsing the new version :
+		/// - insert : the new feature becomes a root (or replaces the node of the same id),
+		/// - delete : the old feature is taken out of its parent or of the roots,
+		/// - replace : the new feature takes the place of the old one.
+		/// Features are matched by id, xlinks (#id, //*[@id='id']) included. The id index, the envelope (which only
+		/// grows, see computeEnvelope), the spatial index and the objects by type are updated for the changed
+		/// features only, the temporal index is rebuilt on its next query.
+		/// The nodes taken out of the model are not deleted (versions may still reference them) : they are appended
+		/// to removed. The caller must not delete them while the versions of the model reference them, and they are
+		/// no longer returned by queryAt (they remain members of their versions).
+		/// Returns the envelopes of the changed features, before and after the transition : the areas whose exports
+		/// are outdated (see GMLSplit::setChangedAreas).
+		std::vector<Envelope> applyTransition(temporal::VersionTransition* transition, std::vector<CityObject*>& removed);
+
 		void setWorkspaces(std::map<std::string, temporal::Workspace>);
 		void setDocuments(std::vector<documentADE::DocumentObject*>);
 		void setReferences(std::vector<documentADE::Reference*>);
@@ -124,16 +179,29 @@ namespace citygml
 
 		CityObjects _roots;
 
+		RTree<size_t> _rootsIndex;		// index of the roots in _roots
+		size_t _rootsIndexSize;			// number of roots when _rootsIndex was built
+
 		CityObjectsMap _cityObjectsMap;
 
+		std::unordered_map<std::string, CityObject*> _nodesById;	// index of the tree used by applyTransition
+		size_t _nodesByIdRoots;			// number of roots when _nodesById was built
+
 		AppearanceManager _appearanceManager;
 
+		GeometryLoader* _geometryLoader;
+
 		std::string _srsName;
 
 		TVec3d _translation;
 
 		std::vector<temporal::Version*> _versions;
 		std::vector<temporal::VersionTransition*> _versionTransitions;
+
+		temporal::TemporalIndex _temporalIndex;
+		size_t _temporalIndexRoots;		// number of roots when _temporalIndex was built
+		size_t _temporalIndexVersions;	// number of versions when _temporalIndex was built
+		std::unordered_set<const CityObject*> _removedNodes;	// taken out of the model by applyTransition
 		std::map<std::string, temporal::Workspace> _workspaces;
 		std::vector<documentADE::DocumentObject*> _documents;
 		std::vector<documentADE::Reference*> _references;
@@ -14,7 +14,10 @@
 * GNU Lesser General Public License for more details.
 */
 ////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <unordered_map>
 #include "CityObject.hpp"
 #include "Utils.hpp"
 
@@ -23,7 +26,7 @@ namespace citygml
 {
 	////////////////////////////////////////////////////////////////////////////////
 	CityObject::CityObject(const std::string& id, CityObjectsType type)
-		: Object(id), _type(type), m_path(""), m_temporalUse(false)
+		: Object(id), _type(type), _geometryLoader(nullptr), _parent(nullptr), m_path(""), m_temporalUse(false)
 	{}
 	////////////////////////////////////////////////////////////////////////////////
 	CityObject::~CityObject()
@@ -56,22 +59,26 @@ namespace citygml
 	// Get the number of geometries contains in the object
 	size_t CityObject::size(void) const
 	{
+		loadGeometries();
 		return _geometries.size();
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	// Access the geometries
 	const Geometry* CityObject::getGeometry(unsigned int i) const
 	{
+		loadGeometries();
 		return _geometries[i];
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	std::vector< Geometry* >& CityObject::getGeometries()
 	{
+		loadGeometries();
 		return _geometries;
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	const std::vector< Geometry* >& CityObject::getGeometries() const
 	{
+		loadGeometries();
 		return _geometries;
 	}
 	////////////////////////////////////////////////////////////////////////////////
@@ -109,6 +116,7 @@ namespace citygml
 	////////////////////////////////////////////////////////////////////////////////
 	void CityObject::addGeometry(Geometry* geom)
 	{
+		loadGeometries();
 		_geometries.push_back(geom);
 	}
 	////////////////////////////////////////////////////////////////////////////////
@@ -117,14 +125,16 @@ namespace citygml
 		return _parent;
 	}
 	////////////////////////////////////////////////////////////////////////////////
+	// remove the children named node (without deleting them)
 	void CityObject::deleteNode(const std::string& node)
 	{
-
+		_children.erase(std::remove_if(_children.begin(), _children.end(), [&node](CityObject* child) { return child->getId() == node; }), _children.end());
 	}
 	////////////////////////////////////////////////////////////////////////////////
+	// remove the child node (without deleting it)
 	void CityObject::deleteNode(CityObject* node)
 	{
-
+		_children.erase(std::remove(_children.begin(), _children.end(), node), _children.end());
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	void CityObject::insertNode(CityObject* node)
@@ -175,22 +185,49 @@ namespace citygml
 			(*it)->finish(appearanceManager, myappearance ? myappearance : 0, params);
 		}
 
-		bool finish = false;
-		while (!finish && params.optimize)
+		if (params.optimize && _geometries.size() > 1)
 		{
-			finish = true;
-			size_t len = _geometries.size();
-			for (size_t i = 0; finish && i < len - 2; i++)
+			// geometries of the same LOD and type merged into the first one, in a single pass
+			std::unordered_map<uint64_t, size_t> groupIndex;
+			std::vector<std::vector<Geometry*>> groups;
+			size_t count = 0;
+			for (Geometry* geom : _geometries)
 			{
-				for (size_t j = i + 1; finish && j < len - 1; j++)
+				uint64_t key = ((uint64_t)geom->getLOD() << 32) | (uint32_t)geom->getType();
+				std::pair<std::unordered_map<uint64_t, size_t>::iterator, bool> group = groupIndex.emplace(key, groups.size());
+				if (group.second)
 				{
-					if (!_geometries[i]->merge(_geometries[j])) continue;
-					delete _geometries[j];
-					_geometries.erase(_geometries.begin() + j);
-					finish = false;
+					groups.emplace_back();
+					_geometries[count++] = geom;
 				}
+				else
+					groups[group.first->second].push_back(geom);
+			}
+			_geometries.resize(count);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				if (groups[i].empty()) continue;
+				_geometries[i]->merge(groups[i]);
+				for (Geometry* geom : groups[i])
+					delete geom;
 			}
 		}
+
+		// then the polygons of each geometry, once the geometries of the same LOD and type are gathered
+		if (params.optimize && params.mergePolygons)
+			for (Geometry* geom : _geometries)
+				geom->mergePolygons();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	GeometryLoader* CityObject::getGeometryLoader() const
+	{
+		return _geometryLoader.load();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	void CityObject::setGeometryLoader(GeometryLoader* loader)
+	{
+		_geometryLoader.store(loader);
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	/*void CityObject::finish()
@@ -222,6 +259,7 @@ namespace citygml
 	////////////////////////////////////////////////////////////////////////////////
 	bool CityObject::IsEmpty()
 	{
+		loadGeometries();
 		_isEmpty = true;
 
 		for (Geometry* geom : _geometries)
@@ -246,10 +284,11 @@ namespace citygml
 	void CityObject::computeEnvelope()
 	{
 		// compute envelope
+		loadGeometries();
 
 		for (Geometry* geom : _geometries) // geometry
 		{
-			for (Polygon* poly : geom->getPolygons())
+			for (Polygon* poly : geom->getParsedPolygons())
 			{
 				for (const TVec3d& v : poly->getExteriorRing()->getVertices())
 				{
@@ -286,11 +325,12 @@ namespace citygml
 			it++;
 		}
 
-		std::vector< Geometry* >::const_iterator itp = o._geometries.begin();
-		for (; itp != o._geometries.end(); itp++)
+		const std::vector< Geometry* >& geometries = o.getGeometries();
+		std::vector< Geometry* >::const_iterator itp = geometries.begin();
+		for (; itp != geometries.end(); itp++)
 			os << **itp;
 
-		os << "  * " << o._geometries.size() << " geometries." << std::endl;
+		os << "  * " << geometries.size() << " geometries." << std::endl;
 
 		return os;
 	}
@@ -17,6 +17,7 @@
 #ifndef __CITYGML_CITYOBJECT_HPP__
 #define __CITYGML_CITYOBJECT_HPP__
 
+#include <atomic>
 #include <ostream>
 #include "Object.hpp"
 #include "Geometry.hpp"
@@ -70,6 +71,20 @@ namespace citygml
 	};
 	typedef unsigned int CityObjectsTypeMask;
 
+	class CityObject;
+	////////////////////////////////////////////////////////////////////////////////
+	/// \brief Source of the geometries of city objects parsed without them (see ParserParams::lazyGeometry)
+	///
+	/// The geometries of an object are loaded on the first access (CityObject::getGeometries, size, ...) : load
+	/// must add them to the object and reset its loader (setGeometryLoader(nullptr)) once they are complete. It may
+	/// be called from concurrent threads, which must wait for a load of the object in progress.
+	class GeometryLoader
+	{
+	public:
+		virtual ~GeometryLoader() {}
+
+		virtual void load(CityObject* object) = 0;
+	};
 	////////////////////////////////////////////////////////////////////////////////
 	class /*CITYGML_EXPORT*/ CityObject : public Object
 	{
@@ -139,6 +154,10 @@ namespace citygml
 		//protected:
 		void finish(AppearanceManager&, const ParserParams&);
 
+		/// Loader of the geometries not parsed yet, nullptr once they are loaded (the loader is owned by the model)
+		GeometryLoader* getGeometryLoader() const;
+		void setGeometryLoader(GeometryLoader* loader);
+
 	protected:
 		CityObjectsType _type;
 
@@ -149,6 +168,15 @@ namespace citygml
 		std::vector< Geometry* > _geometries;
 		std::vector< CityObject* > _children;
 
+		std::atomic<GeometryLoader*> _geometryLoader;
+
+		// Load the geometries if they were not parsed
+		inline void loadGeometries() const
+		{
+			if (GeometryLoader* loader = _geometryLoader.load())
+				loader->load(const_cast<CityObject*>(this));
+		}
+
 	public:
 		CityObject* _parent; // MT (MAC OS X problem...)
 
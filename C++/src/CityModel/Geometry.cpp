@@ -16,6 +16,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "Geometry.hpp"
 #include "Polygon.hpp"
+#include <unordered_map>
 ////////////////////////////////////////////////////////////////////////////////
 namespace citygml
 {
@@ -68,6 +69,20 @@ namespace citygml
 		return _polygons;
 	};
 	////////////////////////////////////////////////////////////////////////////////
+	std::vector< Polygon* > Geometry::getParsedPolygons() const
+	{
+		std::vector< Polygon* > polygons;
+		polygons.reserve(_polygons.size());
+		for (Polygon* poly : _polygons)
+		{
+			if (poly->getMergedPolygons().empty())
+				polygons.push_back(poly);
+			else
+				polygons.insert(polygons.end(), poly->getMergedPolygons().begin(), poly->getMergedPolygons().end());
+		}
+		return polygons;
+	}
+	////////////////////////////////////////////////////////////////////////////////
 	GeometryType Geometry::getType(void) const
 	{
 		return _type;
@@ -94,22 +109,65 @@ namespace citygml
 		Appearance* myappearance = appearanceManager.getAppearance(getId());
 		std::vector< Polygon* >::const_iterator it = _polygons.begin();
 		for (; it != _polygons.end(); ++it) (*it)->finish(appearanceManager, myappearance ? myappearance : defAppearance, params.tesselate);
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	// Appearance, texture and materials of a polygon : the polygons drawn with the same state
+	struct PolygonAppearance
+	{
+		const Appearance* appearance;
+		const Texture* texture;
+		const Material* front;
+		const Material* back;
+
+		bool operator==(const PolygonAppearance& other) const
+		{
+			return appearance == other.appearance && texture == other.texture && front == other.front && back == other.back;
+		}
+	};
+	struct PolygonAppearanceHash
+	{
+		size_t operator()(const PolygonAppearance& a) const
+		{
+			std::hash<const void*> h;
+			return ((h(a.appearance) * 31 + h(a.texture)) * 31 + h(a.front)) * 31 + h(a.back);
+		}
+	};
+	////////////////////////////////////////////////////////////////////////////////
+	// Merge the polygons of the same appearance, in a single pass, into a new polygon which keeps them (see Polygon::getMergedPolygons)
+	void Geometry::mergePolygons()
+	{
+		if (_polygons.size() < 2) return;
+
+		std::unordered_map<PolygonAppearance, size_t, PolygonAppearanceHash> groupIndex;
+		std::vector<std::vector<Polygon*>> groups;
+		for (Polygon* poly : _polygons)
+		{
+			PolygonAppearance key = { poly->getAppearance(), poly->getTexture(), poly->getMaterialFront(), poly->getMaterialBack() };
+			std::pair<std::unordered_map<PolygonAppearance, size_t, PolygonAppearanceHash>::iterator, bool> group = groupIndex.emplace(key, groups.size());
+			if (group.second)
+				groups.emplace_back();
+			groups[group.first->second].push_back(poly);
+		}
+		if (groups.size() == _polygons.size()) return;
 
-		bool finish = false;
-		while (!finish && params.optimize)
+		_polygons.resize(groups.size());
+		for (size_t i = 0; i < groups.size(); i++)
 		{
-			finish = true;
-			int len = (int)_polygons.size();
-			for (int i = 0; finish && i < len - 1; i++)
+			Polygon* first = groups[i][0];
+			if (groups[i].size() == 1)
 			{
-				for (int j = i + 1; finish && j < len - 1; j++)
-				{
-					if (!_polygons[i]->merge(_polygons[j])) continue;
-					delete _polygons[j];
-					_polygons.erase(_polygons.begin() + j);
-					finish = false;
-				}
+				_polygons[i] = first;
+				continue;
 			}
+
+			Polygon* merged = new Polygon("");
+			merged->_appearance = first->_appearance;
+			merged->_texture = first->_texture;
+			merged->_materials[Polygon::FRONT] = first->_materials[Polygon::FRONT];
+			merged->_materials[Polygon::BACK] = first->_materials[Polygon::BACK];
+			merged->_geometry = this;
+			merged->merge(groups[i]);
+			_polygons[i] = merged;
 		}
 	}
 	////////////////////////////////////////////////////////////////////////////////
@@ -117,15 +175,35 @@ namespace citygml
 	{
 		if (!g || g->_lod != _lod || g->_type != _type) return false;
 
-		size_t pSize = g->_polygons.size();
-		for (size_t i = 0; i < pSize; i++)
-			_polygons.push_back(g->_polygons[i]);
-
-		g->_polygons.clear();
+		merge(std::vector<Geometry*>(1, g));
+		return true;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	// Merge geometries, of the LOD and type of the current geometry, into the current geometry
+	void Geometry::merge(const std::vector<Geometry*>& geometries)
+	{
+		size_t pSize = _polygons.size();
+		size_t idSize = _id.size();
+		for (const Geometry* g : geometries)
+		{
+			pSize += g->_polygons.size();
+			idSize += 1 + g->_id.size();
+		}
+		_polygons.reserve(pSize);
+		_id.reserve(idSize);
 
-		_id += "+" + g->_id;
+		for (Geometry* g : geometries)
+		{
+			for (Polygon* poly : g->_polygons)
+			{
+				poly->_geometry = this;
+				_polygons.push_back(poly);
+			}
+			g->_polygons.clear();
 
-		return true;
+			_id += '+';
+			_id += g->_id;
+		}
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	std::ostream& operator<<(std::ostream& os, const citygml::Geometry& s)
@@ -69,6 +69,9 @@ namespace citygml
 		const std::vector< Polygon* >& getPolygons() const;
 		std::vector< Polygon* >& getPolygons();
 
+		// Get the polygons as parsed, with their rings : the merged polygons (see mergePolygons) are replaced by the polygons they keep
+		std::vector< Polygon* > getParsedPolygons() const;
+
 		GeometryType getType(void) const;
 
 		const CityObject* getParent() const;
@@ -79,6 +82,8 @@ namespace citygml
 		void finish(AppearanceManager&, Appearance*, const ParserParams&);
 
 		bool merge(Geometry*);
+		void merge(const std::vector<Geometry*>&);
+		void mergePolygons();
 
 	protected:
 		GeometryType _type;
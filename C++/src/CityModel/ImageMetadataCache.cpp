@@ -0,0 +1,134 @@
+// Copyright University of Lyon, 2012 - 2017
+// Distributed under the GNU Lesser General Public License Version 2.1 (LGPLv2)
+// (Refer to accompanying file LICENSE.md or copy at
+//  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
+////////////////////////////////////////////////////////////////////////////////
+#include "ImageMetadataCache.hpp"
+#include <cstring>
+#include <fstream>
+////////////////////////////////////////////////////////////////////////////////
+namespace citygml
+{
+	////////////////////////////////////////////////////////////////////////////////
+	ImageMetadataCache& ImageMetadataCache::getInstance()
+	{
+		static ImageMetadataCache instance;
+		return instance;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	std::shared_ptr<ImageMetadataCache::Entry> ImageMetadataCache::getEntry(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::shared_ptr<Entry>& entry = m_entries[path];
+		if (!entry)
+			entry = std::make_shared<Entry>();
+		return entry;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	bool ImageMetadataCache::getImageSize(const std::string& path, int& width, int& height)
+	{
+		std::shared_ptr<Entry> entry = getEntry(path);
+		std::call_once(entry->sizeRead, [&]()
+		{
+			entry->hasSize = readImageSize(path, entry->width, entry->height);
+		});
+
+		width = entry->width;
+		height = entry->height;
+		return entry->hasSize;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	bool ImageMetadataCache::getWorldParams(const std::string& path, GeoreferencedTexture::WorldParams& params)
+	{
+		std::shared_ptr<Entry> entry = getEntry(path);
+		std::call_once(entry->worldFileRead, [&]()
+		{
+			entry->hasWorldFile = readWorldFile(path, entry->worldParams);
+		});
+
+		params = entry->worldParams;
+		return entry->hasWorldFile;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	void ImageMetadataCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries.clear();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	bool ImageMetadataCache::readImageSize(const std::string& path, int& width, int& height)
+	{
+		std::ifstream file(path, std::ios::binary);
+		unsigned char header[24];
+		if (!file.read((char*)header, 2))
+			return false;
+
+		// PNG : signature, then the IHDR chunk (length, "IHDR", width, height, big endian)
+		if (header[0] == 0x89 && header[1] == 'P')
+		{
+			if (!file.read((char*)header + 2, 22) || memcmp(header + 12, "IHDR", 4) != 0)
+				return false;
+			width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+			height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+			return width > 0 && height > 0;
+		}
+
+		// JPEG : segments up to the first SOFn (start of frame), which holds the size
+		if (header[0] != 0xFF || header[1] != 0xD8)
+			return false;
+		while (file.read((char*)header, 4))
+		{
+			if (header[0] != 0xFF)
+				return false;
+			unsigned char marker = header[1];
+			if (marker == 0xFF) // fill byte, the marker starts at the next one
+			{
+				file.seekg(-3, std::ios::cur);
+				continue;
+			}
+			int length = (header[2] << 8) | header[3];
+			if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+			{
+				// precision, height, width
+				if (!file.read((char*)header, 5))
+					return false;
+				height = (header[1] << 8) | header[2];
+				width = (header[3] << 8) | header[4];
+				return width > 0 && height > 0;
+			}
+			if (marker == 0xD9 || marker == 0xDA || length < 2) // end of image or start of scan : no frame header
+				return false;
+			file.seekg(length - 2, std::ios::cur);
+		}
+		return false;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	bool ImageMetadataCache::readWorldFile(const std::string& path, GeoreferencedTexture::WorldParams& params)
+	{
+		// image.jpg -> image.jgw
+		std::string worldFileUrl(path);
+		if (worldFileUrl.size() < 2)
+			return false;
+		char lastChar = worldFileUrl.back();
+		worldFileUrl.pop_back();
+		worldFileUrl.pop_back();
+		worldFileUrl.push_back(lastChar);
+		worldFileUrl.push_back('w');
+
+		std::ifstream worldFile(worldFileUrl);
+		GeoreferencedTexture::WorldParams read;
+		worldFile >> read.xPixelSize;
+		worldFile >> read.yRotation;
+		worldFile >> read.xRotation;
+		worldFile >> read.yPixelSize;
+		worldFile >> read.xOrigin;
+		worldFile >> read.yOrigin;
+		if (!worldFile)
+			return false;
+
+		params = read;
+		return true;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+} // namespace citygml
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,64 @@
+// Copyright University of Lyon, 2012 - 2017
+// Distributed under the GNU Lesser General Public License Version 2.1 (LGPLv2)
+// (Refer to accompanying file LICENSE.md or copy at
+//  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
+////////////////////////////////////////////////////////////////////////////////
+#ifndef __IMAGEMETADATACACHE_HPP__
+#define __IMAGEMETADATACACHE_HPP__
+////////////////////////////////////////////////////////////////////////////////
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "GeoReferencedTexture.hpp"
+////////////////////////////////////////////////////////////////////////////////
+namespace citygml
+{
+	////////////////////////////////////////////////////////////////////////////////
+	/// \brief Size and world file of the texture images, shared by the whole process
+	///
+	/// The size is read from the image header only (JPEG SOF or PNG IHDR segment), the world file
+	/// (.jgw, .pgw, .tfw... : first and last letters of the image extension followed by 'w') is parsed once.
+	/// Both are read lazily, the first time they are asked for an image path, and are then kept.
+	/// Thread safe : different images are read concurrently, an image is read by a single thread.
+	///
+	class ImageMetadataCache
+	{
+	public:
+		static ImageMetadataCache& getInstance();
+
+		/// Size in pixels of the image, false if the file cannot be read or its format is not supported
+		bool getImageSize(const std::string& path, int& width, int& height);
+
+		/// Parameters of the world file of the image, false (and null parameters) if there is none
+		bool getWorldParams(const std::string& path, GeoreferencedTexture::WorldParams& params);
+
+		void clear();
+
+	private:
+		struct Entry
+		{
+			std::once_flag sizeRead;
+			bool hasSize = false;
+			int width = 0;
+			int height = 0;
+
+			std::once_flag worldFileRead;
+			bool hasWorldFile = false;
+			GeoreferencedTexture::WorldParams worldParams;
+		};
+
+		ImageMetadataCache() {}
+
+		std::shared_ptr<Entry> getEntry(const std::string& path);
+
+		static bool readImageSize(const std::string& path, int& width, int& height);
+		static bool readWorldFile(const std::string& path, GeoreferencedTexture::WorldParams& params);
+
+		std::mutex m_mutex;	///< protects m_entries only, the files are read outside of it
+		std::unordered_map< std::string, std::shared_ptr<Entry> > m_entries;
+	};
+	////////////////////////////////////////////////////////////////////////////////
+} // namespace citygml
+////////////////////////////////////////////////////////////////////////////////
+#endif // __IMAGEMETADATACACHE_HPP__
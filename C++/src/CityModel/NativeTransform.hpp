@@ -0,0 +1,258 @@
+// Copyright University of Lyon, 2012 - 2017
+// Distributed under the GNU Lesser General Public License Version 2.1 (LGPLv2)
+// (Refer to accompanying file LICENSE.md or copy at
+//  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
+////////////////////////////////////////////////////////////////////////////////
+#ifndef __NATIVETRANSFORM_HPP__
+#define __NATIVETRANSFORM_HPP__
+////////////////////////////////////////////////////////////////////////////////
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+////////////////////////////////////////////////////////////////////////////////
+namespace citygml
+{
+	////////////////////////////////////////////////////////////////////////////////
+	/// \brief Coordinate reference system handled without GDAL/PROJ
+	///
+	/// The French Lambert systems on RGF93 (Lambert-93, EPSG:2154, and the conic conformal zones CC42 to CC50,
+	/// EPSG:3942 to 3950), the geographic systems RGF93 (EPSG:4171), ETRS89 (EPSG:4258) and WGS84 (EPSG:4326), with
+	/// x = longitude and y = latitude in degrees, and the geocentric systems RGF93 (EPSG:4964) and WGS84 (EPSG:4978).
+	/// RGF93, ETRS89 and WGS84 are taken as the same datum (null transformation, as PROJ does).
+	struct NativeCRS
+	{
+		enum Kind { Unknown, Lambert, Geographic, Geocentric };
+
+		Kind kind = Unknown;
+
+		// Ellipsoid
+		double a = 0;
+		double e2 = 0;
+		double e = 0;
+		double latCoefs[4] = { 0, 0, 0, 0 };	// conformal to geodetic latitude : coefficients of sin(2 chi) ... sin(8 chi)
+
+		// Lambert conic conformal with 2 standard parallels (Snyder, Map Projections - A Working Manual, 15)
+		double lon0 = 0;	// central meridian (radians)
+		double x0 = 0;		// false easting
+		double y0 = 0;		// false northing
+		double n = 0;		// cone constant
+		double c = 0;		// projection constant (a F in Snyder)
+		double rho0 = 0;	// radius of the parallel of origin
+
+		/// Build the system of an EPSG code, returns false for the codes not handled
+		bool setEPSG(int code)
+		{
+			static const double GRS80_A = 6378137.0, GRS80_F = 1 / 298.257222101;
+			static const double WGS84_A = 6378137.0, WGS84_F = 1 / 298.257223563;
+
+			if (code == 2154)
+				setLambert(GRS80_A, GRS80_F, 46.5, 44, 49, 3, 700000, 6600000);
+			else if (code >= 3942 && code <= 3950)
+			{
+				double lat0 = code - 3900;	// CCxx : xx is the latitude of origin
+				setLambert(GRS80_A, GRS80_F, lat0, lat0 - 0.75, lat0 + 0.75, 3, 1700000, (lat0 - 41) * 1000000 + 200000);
+			}
+			else if (code == 4171 || code == 4258)
+				setEllipsoid(Geographic, GRS80_A, GRS80_F);
+			else if (code == 4326)
+				setEllipsoid(Geographic, WGS84_A, WGS84_F);
+			else if (code == 4964)
+				setEllipsoid(Geocentric, GRS80_A, GRS80_F);
+			else if (code == 4978)
+				setEllipsoid(Geocentric, WGS84_A, WGS84_F);
+			else
+				return false;
+			return true;
+		}
+
+		/// Build the system of a definition naming an EPSG code ("EPSG:3946", "urn:ogc:def:crs:EPSG::3946",
+		/// "http://www.opengis.net/def/crs/EPSG/0/3946", ...), returns false for the other definitions
+		bool setDefinition(const std::string& definition)
+		{
+			std::string upper(definition);
+			for (char& ch : upper) ch = (char)toupper((unsigned char)ch);
+			if (upper.find("EPSG") == std::string::npos || upper.find(',') != std::string::npos)
+				return false;
+
+			// code : digits after the last separator
+			size_t start = upper.find_last_of(":#/");
+			start = (start == std::string::npos) ? 0 : start + 1;
+			if (start >= upper.size())
+				return false;
+			for (size_t i = start; i < upper.size(); i++)
+				if (!isdigit((unsigned char)upper[i]))
+					return false;
+			return setEPSG(atoi(upper.c_str() + start));
+		}
+
+		/// Projected (x, y) to longitude, latitude (radians)
+		inline void inverse(double x, double y, double& lon, double& lat) const
+		{
+			double dx = x - x0;
+			double dy = rho0 - (y - y0);
+			lon = lon0 + atan2(dx, dy) / n;
+
+			// conformal latitude of the isometric latitude, then geodetic latitude by its series in e^2 (1e-11 rad)
+			// refined by one fixed point step (1e-13 rad) : no iteration until convergence
+			double L = log(c / sqrt(dx * dx + dy * dy)) / n;
+			double chi = atan(sinh(L));
+			double s2 = sin(2 * chi), c2 = cos(2 * chi);
+			lat = chi + s2 * (latCoefs[0] + 2 * latCoefs[1] * c2 + latCoefs[2] * (4 * c2 * c2 - 1) + 4 * latCoefs[3] * c2 * (2 * c2 * c2 - 1));
+			lat = atan(sinh(L + e * atanh(e * sin(lat))));
+		}
+
+		/// Longitude, latitude (radians) to projected (x, y)
+		inline void forward(double lon, double lat, double& x, double& y) const
+		{
+			double rho = c * exp(-n * isometricLatitude(lat));
+			double theta = n * (lon - lon0);
+			x = x0 + rho * sin(theta);
+			y = y0 + rho0 - rho * cos(theta);
+		}
+
+		/// Longitude, latitude (radians), ellipsoidal height to geocentric coordinates
+		inline void toGeocentric(double lon, double lat, double h, double& X, double& Y, double& Z) const
+		{
+			double sinLat = sin(lat), cosLat = cos(lat);
+			double N = a / sqrt(1 - e2 * sinLat * sinLat);
+			X = (N + h) * cosLat * cos(lon);
+			Y = (N + h) * cosLat * sin(lon);
+			Z = (N * (1 - e2) + h) * sinLat;
+		}
+
+		/// Geocentric coordinates to longitude, latitude (radians), ellipsoidal height, after Bowring
+		/// (sub-millimetric for the heights of the ground)
+		inline void fromGeocentric(double X, double Y, double Z, double& lon, double& lat, double& h) const
+		{
+			const double b = a * sqrt(1 - e2);
+			const double ep2 = e2 / (1 - e2);
+			double p = sqrt(X * X + Y * Y);
+			double theta = atan2(Z * a, p * b);
+			double sinTheta = sin(theta), cosTheta = cos(theta);
+			lon = atan2(Y, X);
+			lat = atan2(Z + ep2 * b * sinTheta * sinTheta * sinTheta, p - e2 * a * cosTheta * cosTheta * cosTheta);
+			double sinLat = sin(lat);
+			double N = a / sqrt(1 - e2 * sinLat * sinLat);
+			h = (fabs(lat) < M_PI / 4) ? p / cos(lat) - N : Z / sinLat - N * (1 - e2);
+		}
+
+	private:
+		void setEllipsoid(Kind k, double axis, double flattening)
+		{
+			kind = k;
+			a = axis;
+			e2 = flattening * (2 - flattening);
+			e = sqrt(e2);
+
+			double e4 = e2 * e2, e6 = e4 * e2, e8 = e6 * e2;
+			latCoefs[0] = e2 / 2 + 5 * e4 / 24 + e6 / 12 + 13 * e8 / 360;
+			latCoefs[1] = 7 * e4 / 48 + 29 * e6 / 240 + 811 * e8 / 11520;
+			latCoefs[2] = 7 * e6 / 120 + 81 * e8 / 1120;
+			latCoefs[3] = 4279 * e8 / 161280;
+		}
+
+		void setLambert(double axis, double flattening, double lat0, double lat1, double lat2, double lon0Deg, double falseEasting, double falseNorthing)
+		{
+			setEllipsoid(Lambert, axis, flattening);
+			lat0 *= M_PI / 180;
+			lat1 *= M_PI / 180;
+			lat2 *= M_PI / 180;
+			lon0 = lon0Deg * M_PI / 180;
+			x0 = falseEasting;
+			y0 = falseNorthing;
+
+			double m1 = cos(lat1) / sqrt(1 - e2 * sin(lat1) * sin(lat1));
+			double m2 = cos(lat2) / sqrt(1 - e2 * sin(lat2) * sin(lat2));
+			double L1 = isometricLatitude(lat1), L2 = isometricLatitude(lat2);
+			n = log(m1 / m2) / (L2 - L1);
+			c = a * m1 / n * exp(n * L1);
+			rho0 = c * exp(-n * isometricLatitude(lat0));
+		}
+
+		// Isometric latitude
+		inline double isometricLatitude(double lat) const
+		{
+			double sinLat = sin(lat);
+			return atanh(sinLat) - e * atanh(e * sinLat);
+		}
+	};
+	////////////////////////////////////////////////////////////////////////////////
+	/// \brief Transformation between two systems of NativeCRS, backend of GeoTransform for these systems
+	///
+	/// The points are transformed by arrays of coordinates, through longitude and latitude : the Lambert systems
+	/// and the geographic systems keep z, the geocentric systems take z as the ellipsoidal height.
+	/// Read only once set : the same transformation can be used by concurrent threads.
+	class NativeTransform
+	{
+	public:
+		/// Returns false if one of the systems is not handled
+		bool set(const std::string& sourceDefinition, const std::string& destDefinition)
+		{
+			return _source.setDefinition(sourceDefinition) && _dest.setDefinition(destDefinition);
+		}
+
+		/// Transform count points in place, z may be null (height 0)
+		void transform(size_t count, double* x, double* y, double* z) const
+		{
+			// source -> longitude (x), latitude (y), height (z) in radians
+			switch (_source.kind)
+			{
+			case NativeCRS::Lambert:
+				for (size_t i = 0; i < count; i++)
+					_source.inverse(x[i], y[i], x[i], y[i]);
+				break;
+			case NativeCRS::Geographic:
+				for (size_t i = 0; i < count; i++)
+				{
+					x[i] *= M_PI / 180;
+					y[i] *= M_PI / 180;
+				}
+				break;
+			case NativeCRS::Geocentric:
+				for (size_t i = 0; i < count; i++)
+				{
+					double h;
+					_source.fromGeocentric(x[i], y[i], z ? z[i] : 0, x[i], y[i], h);
+					if (z) z[i] = h;
+				}
+				break;
+			default:
+				return;
+			}
+
+			// longitude, latitude, height -> destination
+			switch (_dest.kind)
+			{
+			case NativeCRS::Lambert:
+				for (size_t i = 0; i < count; i++)
+					_dest.forward(x[i], y[i], x[i], y[i]);
+				break;
+			case NativeCRS::Geographic:
+				for (size_t i = 0; i < count; i++)
+				{
+					x[i] *= 180 / M_PI;
+					y[i] *= 180 / M_PI;
+				}
+				break;
+			case NativeCRS::Geocentric:
+				for (size_t i = 0; i < count; i++)
+				{
+					double Z;
+					_dest.toGeocentric(x[i], y[i], z ? z[i] : 0, x[i], y[i], Z);
+					if (z) z[i] = Z;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+	private:
+		NativeCRS _source;
+		NativeCRS _dest;
+	};
+}
+////////////////////////////////////////////////////////////////////////////////
+#endif // __NATIVETRANSFORM_HPP__
@@ -15,6 +15,7 @@
 */
 ////////////////////////////////////////////////////////////////////////////////
 #include "Polygon.hpp"
+#include "ImageMetadataCache.hpp"
 #include <fstream>
 
 #include <iterator> // MT 15/02/2016 (vs2015)
@@ -38,6 +39,7 @@ namespace citygml
 		delete _exteriorRing;
 		std::vector< LinearRing* >::const_iterator it = _interiorRings.begin();
 		for (; it != _interiorRings.end(); ++it) delete *it;
+		for (Polygon* p : _mergedPolygons) delete p;
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	Polygon* Polygon::Clone()
@@ -111,6 +113,11 @@ namespace citygml
 		return _texture;
 	}
 	////////////////////////////////////////////////////////////////////////////////
+	void Polygon::setTexture(Texture* texture)
+	{
+		_texture = texture;
+	}
+	////////////////////////////////////////////////////////////////////////////////
 	const Material* Polygon::getMaterialFront(void) const
 	{
 		return _materials[FRONT];
@@ -141,6 +148,11 @@ namespace citygml
 		return _exteriorRing;
 	}
 	////////////////////////////////////////////////////////////////////////////////
+	const std::vector<Polygon*>& Polygon::getMergedPolygons() const
+	{
+		return _mergedPolygons;
+	}
+	////////////////////////////////////////////////////////////////////////////////
 	const Envelope& Polygon::getEnvelope(void) const
 	{
 		return _envelope;
@@ -248,57 +260,66 @@ namespace citygml
 		_interiorRings.clear();
 	}
 	////////////////////////////////////////////////////////////////////////////////
-	// Merge polygon p into the current polygon
+	// Merge polygon p into the current polygon, which takes ownership of p
 	bool Polygon::merge(Polygon* p)
 	{
 		if (!p) return false;
 
-		if (p->getAppearance() != getAppearance()) return false;
-
-		if (p->getVertices().size() == 0) return true;
-
-		// merge vertices
-		size_t oldVSize = _vertices.size();
-		size_t pVSize = p->_vertices.size();
-		_vertices.resize(oldVSize + pVSize);
-		for (size_t i = 0; i < pVSize; i++)
-			_vertices[oldVSize + i] = p->_vertices[i];
-		p->_vertices.clear();
+		if (p->getAppearance() != getAppearance() || p->_texture != _texture) return false;
+		if (p->_materials[FRONT] != _materials[FRONT] || p->_materials[BACK] != _materials[BACK]) return false;
 
-		// merge indices
-		{
-			size_t oldSize = _indices.size();
-			size_t pSize = p->_indices.size();
-			_indices.resize(oldSize + pSize);
-			for (size_t i = 0; i < pSize; i++)
-				_indices[oldSize + i] = (int)(oldVSize + p->_indices[i]);
-			p->_indices.clear();
-		}
-
-		// merge normals
+		merge(std::vector<Polygon*>(1, p));
+		return true;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	// Merge polygons, of the appearance, texture and materials of the current polygon, into the current polygon : the buffers are grown once.
+	// The merged polygons are kept, without their triangles, in _mergedPolygons : their rings are still those of the file
+	void Polygon::merge(const std::vector<Polygon*>& polygons)
+	{
+		size_t vSize = _vertices.size();
+		size_t iSize = _indices.size();
+		size_t nSize = _normals.size();
+		size_t tSize = min(_texCoords.size(), vSize);
+		size_t idSize = _id.size();
+		for (const Polygon* p : polygons)
 		{
-			size_t oldSize = _normals.size();
-			size_t pSize = p->_normals.size();
-			_normals.resize(oldSize + pSize);
-			for (size_t i = 0; i < pSize; i++)
-				_normals[oldSize + i] = p->_normals[i];
-			p->_normals.clear();
+			idSize += 1 + p->_id.size();
+			if (p->_vertices.empty()) continue;
+			vSize += p->_vertices.size();
+			iSize += p->_indices.size();
+			nSize += p->_normals.size();
+			tSize += min(p->_texCoords.size(), p->_vertices.size());
 		}
-
-		// merge texcoords
+		_vertices.reserve(vSize);
+		_indices.reserve(iSize);
+		_normals.reserve(nSize);
+		_texCoords.reserve(tSize);
+		_id.reserve(idSize);
+		_mergedPolygons.reserve(_mergedPolygons.size() + polygons.size());
+
+		for (Polygon* p : polygons)
 		{
-			size_t oldSize = min(_texCoords.size(), oldVSize);
-			size_t pSize = min(p->_texCoords.size(), pVSize);
-			_texCoords.resize(oldSize + pSize);
-			for (size_t i = 0; i < pSize; i++)
-				_texCoords[oldSize + i] = p->_texCoords[i];
-			p->_texCoords.clear();
+			if (!_id.empty()) _id += '+';
+			_id += p->_id;
+			_mergedPolygons.push_back(p);
+
+			if (p->_vertices.empty()) continue;
+
+			// texture coordinates follow the vertices, the missing ones of the current polygon are dropped.
+			// Those of p are copied : they go with its rings
+			size_t offset = _vertices.size();
+			if (_texCoords.size() > offset) _texCoords.resize(offset);
+			_texCoords.insert(_texCoords.end(), p->_texCoords.begin(), p->_texCoords.begin() + min(p->_texCoords.size(), p->_vertices.size()));
+
+			_vertices.insert(_vertices.end(), p->_vertices.begin(), p->_vertices.end());
+			for (unsigned int index : p->_indices)
+				_indices.push_back((unsigned int)(offset + index));
+			_normals.insert(_normals.end(), p->_normals.begin(), p->_normals.end());
+
+			std::vector<TVec3d>().swap(p->_vertices);
+			std::vector<unsigned int>().swap(p->_indices);
+			std::vector<TVec3f>().swap(p->_normals);
 		}
-
-		// merge ids
-		_id += "+" + p->_id;
-
-		return true;
 	}
 	////////////////////////////////////////////////////////////////////////////////
 	void Polygon::finish(AppearanceManager& appearanceManager, bool doTesselate)
@@ -340,31 +361,8 @@ namespace citygml
 
 			if (!geoTexture->m_initWParams)
 			{
-				// open world file file
-				std::string basePath = appearanceManager.m_basePath;
-				//std::string basePath = "/mnt/docs/data/dd_backup/Donnees_GrandLyon/MNT_CITYGML/";
-				//std::string basePath = "/mnt/docs/data/dd_backup/Donnees_Sathonay/";
-				std::string worldFileUrl(basePath);
-				worldFileUrl.append(_texture->getUrl());
-				char lastChar = worldFileUrl.back();
-				worldFileUrl.pop_back();
-				worldFileUrl.pop_back();
-				worldFileUrl.push_back(lastChar);
-				worldFileUrl.push_back('w');
-				//worldFileUrl = worldFileUrl.substr(0, worldFileUrl.find_last_of('.')) + ".jgw";
-				//std::cout << "worldFileUrl : " << worldFileUrl << std::endl;
-				std::ifstream worldFile(worldFileUrl);
-
-				worldFile >> geoTexture->m_wParams.xPixelSize;
-				worldFile >> geoTexture->m_wParams.yRotation;
-				worldFile >> geoTexture->m_wParams.xRotation;
-				worldFile >> geoTexture->m_wParams.yPixelSize;
-				worldFile >> geoTexture->m_wParams.xOrigin;
-				worldFile >> geoTexture->m_wParams.yOrigin;
-
-				//std::cout << geoTexture->m_wParams;
-
-				worldFile.close();
+				// world file of the image, read once for all the polygons (and threads) using it
+				ImageMetadataCache::getInstance().getWorldParams(appearanceManager.m_basePath + _texture->getUrl(), geoTexture->m_wParams);
 
 				geoTexture->m_initWParams = true;
 			}
@@ -74,6 +74,7 @@ namespace citygml
 		const Appearance* getAppearance(void) const; // Deprecated! Use getMaterial and getTexture instead
 		const Material* getMaterial(void) const;
 		const Texture* getTexture(void) const;
+		void setTexture(Texture* texture);
 		const Material* getMaterialFront(void) const;
 		const Material* getMaterialBack(void) const;
 
@@ -83,6 +84,10 @@ namespace citygml
 		const LinearRing* getExteriorRing() const;
 		LinearRing* getExteriorRing();
 
+		// Polygons merged into this one (see Geometry::mergePolygons) : they keep their id, rings and texture coordinates,
+		// their triangles are moved into this polygon
+		const std::vector<Polygon*>& getMergedPolygons() const;
+
 		// Return the envelope (ie. the bounding box) of the object
 		const Envelope& getEnvelope(void) const;
 
@@ -99,6 +104,7 @@ namespace citygml
 		TVec3d computeNormal(void);
 
 		bool merge(Polygon*);
+		void merge(const std::vector<Polygon*>&);
 
 	protected:
 		std::vector<TVec3d> _vertices;
@@ -114,6 +120,8 @@ namespace citygml
 		LinearRing* _exteriorRing;
 		std::vector<LinearRing*> _interiorRings;
 
+		std::vector<Polygon*> _mergedPolygons;
+
 		bool _negNormal;
 
 		Geometry *_geometry;
@@ -0,0 +1,343 @@
+// Copyright University of Lyon, 2012 - 2017
+// Distributed under the GNU Lesser General Public License Version 2.1 (LGPLv2)
+// (Refer to accompanying file LICENSE.md or copy at
+//  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
+////////////////////////////////////////////////////////////////////////////////
+#ifndef __RTREE_HPP__
+#define __RTREE_HPP__
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "Envelope.hpp"
+////////////////////////////////////////////////////////////////////////////////
+namespace citygml
+{
+	////////////////////////////////////////////////////////////////////////////////
+	/// \brief Static R-tree over envelopes, bulk loaded with Sort-Tile-Recursive (Leutenegger et al. 1997)
+	///
+	/// Items are sorted on the x then y of their envelope center and packed by NodeCapacity,
+	/// the parent levels are built the same way. The tree is rebuilt from scratch by build().
+	///
+	/// Small updates don't rebuild it : inserted items are kept aside and searched linearly, removed items are
+	/// flagged in place. The tree is repacked once these changes reach 1/8 of its items.
+	///
+	template< class T > class RTree
+	{
+	public:
+		static constexpr size_t NodeCapacity = 16;
+
+		RTree() : m_removedCount(0) {}
+
+		/// Build the tree, replacing the previous items
+		void build(const std::vector< std::pair<Envelope, T> >& items);
+
+		/// Add an item
+		void insert(const Envelope& envelope, const T& value);
+
+		/// Remove the item value, stored with envelope. Returns false if there is no such item.
+		bool remove(const Envelope& envelope, const T& value);
+
+		/// Replace the value of every item by f(value), without moving the items (the indices of a container
+		/// shifted by an erase, ...)
+		template< class F > void renumber(F f);
+
+		bool empty() const { return size() == 0; }
+		size_t size() const { return m_items.size() - m_removedCount + m_pending.size(); }
+
+		/// Append to result the items whose envelope intersects envelope (bounds included), in tree order
+		void query(const Envelope& envelope, std::vector<T>& result) const;
+
+		/// Return the k items closest to point (distance from point to their envelope), closest first
+		std::vector<T> nearest(const TVec3d& point, size_t k) const;
+
+	private:
+		struct Node
+		{
+			Envelope envelope;
+			size_t first;	///< first child node, or first item for the leaves
+			size_t count;
+			bool leaf;
+		};
+
+		static bool intersects(const Envelope& a, const Envelope& b);
+		static double sqrDistance(const Envelope& e, const TVec3d& p);
+		static TVec3d center(const Envelope& e);
+
+		/// Sort-Tile-Recursive packing of entries [0, n) : reorder envelopes (and order) so that
+		/// every run of NodeCapacity entries is a spatially coherent node
+		static void sortTileRecursive(std::vector< std::pair<Envelope, size_t> >& entries);
+
+		/// Rebuild the tree from its current items once the changes since build() are too many
+		void repack();
+
+		std::vector< std::pair<Envelope, T> > m_items;
+		std::vector<Node> m_nodes;	///< all levels, root last
+
+		std::vector<char> m_removed;	///< items removed since build()
+		size_t m_removedCount;
+		std::vector< std::pair<Envelope, T> > m_pending;	///< items inserted since build()
+	};
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > bool RTree<T>::intersects(const Envelope& a, const Envelope& b)
+	{
+		return a.getLowerBound().x <= b.getUpperBound().x && b.getLowerBound().x <= a.getUpperBound().x
+			&& a.getLowerBound().y <= b.getUpperBound().y && b.getLowerBound().y <= a.getUpperBound().y
+			&& a.getLowerBound().z <= b.getUpperBound().z && b.getLowerBound().z <= a.getUpperBound().z;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > double RTree<T>::sqrDistance(const Envelope& e, const TVec3d& p)
+	{
+		double d = 0.;
+		for (int i = 0; i < 3; i++)
+		{
+			double v = 0.;
+			if (p.xyz[i] < e.getLowerBound().xyz[i]) v = e.getLowerBound().xyz[i] - p.xyz[i];
+			else if (p.xyz[i] > e.getUpperBound().xyz[i]) v = p.xyz[i] - e.getUpperBound().xyz[i];
+			d += v * v;
+		}
+		return d;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > TVec3d RTree<T>::center(const Envelope& e)
+	{
+		return (e.getLowerBound() + e.getUpperBound()) * 0.5;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > void RTree<T>::sortTileRecursive(std::vector< std::pair<Envelope, size_t> >& entries)
+	{
+		size_t n = entries.size();
+		size_t leafCount = (n + NodeCapacity - 1) / NodeCapacity;
+		size_t sliceCount = (size_t)std::ceil(std::sqrt((double)leafCount));
+		size_t sliceSize = sliceCount * NodeCapacity;
+
+		std::sort(entries.begin(), entries.end(), [](const std::pair<Envelope, size_t>& a, const std::pair<Envelope, size_t>& b)
+		{
+			return center(a.first).x < center(b.first).x;
+		});
+
+		for (size_t start = 0; start < n; start += sliceSize)
+		{
+			size_t end = std::min(n, start + sliceSize);
+			std::sort(entries.begin() + start, entries.begin() + end, [](const std::pair<Envelope, size_t>& a, const std::pair<Envelope, size_t>& b)
+			{
+				return center(a.first).y < center(b.first).y;
+			});
+		}
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > void RTree<T>::build(const std::vector< std::pair<Envelope, T> >& items)
+	{
+		m_items.clear();
+		m_nodes.clear();
+		m_removed.clear();
+		m_removedCount = 0;
+		m_pending.clear();
+		if (items.empty())
+			return;
+
+		// Leaves
+		std::vector< std::pair<Envelope, size_t> > entries;
+		entries.reserve(items.size());
+		for (size_t i = 0; i < items.size(); i++)
+			entries.push_back(std::make_pair(items[i].first, i));
+		sortTileRecursive(entries);
+
+		m_items.reserve(items.size());
+		for (const std::pair<Envelope, size_t>& entry : entries)
+			m_items.push_back(items[entry.second]);
+		m_removed.assign(m_items.size(), 0);
+
+		size_t levelStart = 0;
+		for (size_t i = 0; i < m_items.size(); i += NodeCapacity)
+		{
+			Node node;
+			node.first = i;
+			node.count = std::min(NodeCapacity, m_items.size() - i);
+			node.leaf = true;
+			node.envelope = m_items[i].first;
+			for (size_t j = i + 1; j < i + node.count; j++)
+				node.envelope.merge(m_items[j].first);
+			m_nodes.push_back(node);
+		}
+
+		// Parent levels, until there is only one root
+		while (m_nodes.size() - levelStart > 1)
+		{
+			size_t levelEnd = m_nodes.size();
+
+			entries.clear();
+			for (size_t i = levelStart; i < levelEnd; i++)
+				entries.push_back(std::make_pair(m_nodes[i].envelope, i));
+			sortTileRecursive(entries);
+
+			// Children of a parent must be contiguous : the level is reordered
+			std::vector<Node> level;
+			level.reserve(entries.size());
+			for (const std::pair<Envelope, size_t>& entry : entries)
+				level.push_back(m_nodes[entry.second]);
+			std::copy(level.begin(), level.end(), m_nodes.begin() + levelStart);
+
+			for (size_t i = levelStart; i < levelEnd; i += NodeCapacity)
+			{
+				Node node;
+				node.first = i;
+				node.count = std::min(NodeCapacity, levelEnd - i);
+				node.leaf = false;
+				node.envelope = m_nodes[i].envelope;
+				for (size_t j = i + 1; j < i + node.count; j++)
+					node.envelope.merge(m_nodes[j].envelope);
+				m_nodes.push_back(node);
+			}
+			levelStart = levelEnd;
+		}
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > void RTree<T>::insert(const Envelope& envelope, const T& value)
+	{
+		m_pending.push_back(std::make_pair(envelope, value));
+		repack();
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > bool RTree<T>::remove(const Envelope& envelope, const T& value)
+	{
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			if (m_pending[i].second == value)
+			{
+				m_pending[i] = m_pending.back();
+				m_pending.pop_back();
+				return true;
+			}
+		}
+
+		// Only the nodes containing envelope can hold the item
+		std::vector<size_t> stack;
+		if (!m_nodes.empty())
+			stack.push_back(m_nodes.size() - 1);
+		while (!stack.empty())
+		{
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (!intersects(node.envelope, envelope))
+				continue;
+
+			for (size_t i = node.first; i < node.first + node.count; i++)
+			{
+				if (!node.leaf)
+					stack.push_back(i);
+				else if (!m_removed[i] && m_items[i].second == value)
+				{
+					m_removed[i] = 1;
+					m_removedCount++;
+					repack();
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > template< class F > void RTree<T>::renumber(F f)
+	{
+		for (std::pair<Envelope, T>& item : m_items)
+			item.second = f(item.second);
+		for (std::pair<Envelope, T>& item : m_pending)
+			item.second = f(item.second);
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > void RTree<T>::repack()
+	{
+		if (m_pending.size() + m_removedCount <= NodeCapacity + m_items.size() / 8)
+			return;
+
+		std::vector< std::pair<Envelope, T> > items;
+		items.reserve(size());
+		for (size_t i = 0; i < m_items.size(); i++)
+			if (!m_removed[i])
+				items.push_back(m_items[i]);
+		items.insert(items.end(), m_pending.begin(), m_pending.end());
+		build(items);
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > void RTree<T>::query(const Envelope& envelope, std::vector<T>& result) const
+	{
+		for (const std::pair<Envelope, T>& item : m_pending)
+			if (intersects(item.first, envelope))
+				result.push_back(item.second);
+
+		if (m_nodes.empty())
+			return;
+
+		std::vector<size_t> stack(1, m_nodes.size() - 1);
+		while (!stack.empty())
+		{
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (!intersects(node.envelope, envelope))
+				continue;
+
+			if (node.leaf)
+			{
+				for (size_t i = node.first; i < node.first + node.count; i++)
+					if (!m_removed[i] && intersects(m_items[i].first, envelope))
+						result.push_back(m_items[i].second);
+			}
+			else
+			{
+				for (size_t i = node.first + node.count; i-- > node.first;)
+					stack.push_back(i);
+			}
+		}
+	}
+	////////////////////////////////////////////////////////////////////////////////
+	template< class T > std::vector<T> RTree<T>::nearest(const TVec3d& point, size_t k) const
+	{
+		std::vector<T> result;
+		if (empty() || k == 0)
+			return result;
+
+		// Best-first search : nodes and items share the queue, items are flagged by the sign
+		// (the items inserted since build() follow the items of the tree)
+		typedef std::pair<double, long long> Entry;	// (squared distance, node index or -1 - item index)
+		std::priority_queue< Entry, std::vector<Entry>, std::greater<Entry> > queue;
+		if (!m_nodes.empty())
+			queue.push(Entry(sqrDistance(m_nodes.back().envelope, point), (long long)m_nodes.size() - 1));
+		for (size_t i = 0; i < m_pending.size(); i++)
+			queue.push(Entry(sqrDistance(m_pending[i].first, point), -1 - (long long)(m_items.size() + i)));
+
+		while (!queue.empty() && result.size() < k)
+		{
+			Entry entry = queue.top();
+			queue.pop();
+
+			if (entry.second < 0)
+			{
+				size_t i = (size_t)(-1 - entry.second);
+				result.push_back(i < m_items.size() ? m_items[i].second : m_pending[i - m_items.size()].second);
+				continue;
+			}
+
+			const Node& node = m_nodes[(size_t)entry.second];
+			for (size_t i = node.first; i < node.first + node.count; i++)
+			{
+				if (node.leaf)
+				{
+					if (!m_removed[i])
+						queue.push(Entry(sqrDistance(m_items[i].first, point), -1 - (long long)i));
+				}
+				else
+					queue.push(Entry(sqrDistance(m_nodes[i].envelope, point), (long long)i));
+			}
+		}
+
+		return result;
+	}
+	////////////////////////////////////////////////////////////////////////////////
+} // namespace citygml
+////////////////////////////////////////////////////////////////////////////////
+#endif // __RTREE_HPP__
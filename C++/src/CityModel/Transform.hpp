@@ -17,24 +17,37 @@
 #ifndef __TRANSFORM_H__
 #define __TRANSFORM_H__
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "CityGML.hpp"
+#include "NativeTransform.hpp"
 #ifdef USE_GDAL
 #	include "ogrsf_frmts.h"
 #endif
 
+// Transformation of the coordinates from sourceURN to destURN. The French Lambert, geographic and geocentric systems
+// of citygml::NativeCRS are transformed natively (with or without GDAL), the other ones through GDAL/PROJ when
+// USE_GDAL is defined (x, y only).
 class GeoTransform
 {
 public:
 	GeoTransform(const std::string& sourceURN, const std::string& destURN) : _sourceURN(sourceURN), _destURN(destURN)
 	{
+		_sourceSRS = 0;
+		_destSRS = 0;
+		_trans = 0;
+		_isNative = _native.set(_sourceURN, _destURN);
 #ifdef USE_GDAL
+		if (_isNative) return;
 		_sourceSRS = getProjection(_sourceURN);
 		_destSRS = getProjection(_destURN);
 		_trans = (_sourceSRS && _destSRS) ? OGRCreateCoordinateTransformation((OGRSpatialReference*)_sourceSRS, (OGRSpatialReference*)_destSRS) : 0;
-#else
-		_sourceSRS = 0;
-		_destSRS = 0;
-		_trans = 0;
 #endif
 	}
 
@@ -47,30 +60,102 @@ public:
 #endif
 	}
 
-#ifdef USE_GDAL
 	inline void transform(TVec3d &p) const
 	{
-		if (_trans) ((OGRCoordinateTransformation*)_trans)->Transform(1, &p.x, &p.y);
-#else
-	inline void transform(TVec3d &) const
-	{
+		if (_isNative) _native.transform(1, &p.x, &p.y, &p.z);
+#ifdef USE_GDAL
+		else if (_trans) ((OGRCoordinateTransformation*)_trans)->Transform(1, &p.x, &p.y);
 #endif
 	}
 
-#ifdef USE_GDAL
 	inline void transform(TVec2d &p) const
 	{
-		if (_trans) ((OGRCoordinateTransformation*)_trans)->Transform(1, &p.x, &p.y);
-#else
-	inline void transform(TVec2d &) const
-	{
+		if (_isNative) _native.transform(1, &p.x, &p.y, 0);
+#ifdef USE_GDAL
+		else if (_trans) ((OGRCoordinateTransformation*)_trans)->Transform(1, &p.x, &p.y);
 #endif
 	}
 
+	// Transform the points [first, end) of the array, as above. The coordinates go through the transformation by
+	// blocks of TRANSFORM_BLOCK points, and arrays larger than TRANSFORM_CHUNK points are split in chunks transformed
+	// by concurrent threads (each with a GDAL transformation taken from the pool, see acquire).
+	inline void transform(std::vector<TVec3d> &points, size_t first = 0) const
+	{
+		if ((!_isNative && !_trans) || first >= points.size()) return;
+
+		size_t count = points.size() - first;
+		size_t chunkCount = (count + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK;
+		unsigned int threadCount = (unsigned int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), chunkCount);
+		if (threadCount <= 1)
+		{
+			transformBlocks(&points[first], count);
+			return;
+		}
+
+		std::atomic<size_t> nextChunk(0);
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threadCount; t++)
+		{
+			threads.push_back(std::thread([&]()
+			{
+				std::unique_ptr<GeoTransform> pooled;
+				if (!_isNative) pooled = acquire(_sourceURN, _destURN);
+				const GeoTransform* trans = pooled ? pooled.get() : this;
+				for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+				{
+					size_t begin = chunk * TRANSFORM_CHUNK;
+					trans->transformBlocks(&points[first + begin], std::min(count - begin, TRANSFORM_CHUNK));
+				}
+				if (pooled) release(std::move(pooled));
+			}));
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// Transformation from sourceURN to destURN, created on the first request of the calling thread and kept until
+	// it ends : the GDAL transformations are not thread safe, and creating one costs far more than parsing a posList.
+	static GeoTransform* get(const std::string& sourceURN, const std::string& destURN)
+	{
+		static thread_local std::map<std::pair<std::string, std::string>, std::unique_ptr<GeoTransform>> transforms;
+
+		std::unique_ptr<GeoTransform>& trans = transforms[std::make_pair(sourceURN, destURN)];
+		if (!trans) trans.reset(new GeoTransform(sourceURN, destURN));
+		return trans.get();
+	}
+
+	// Transformation from sourceURN to destURN owned by the caller until it is released. The released ones are kept
+	// until the process ends : the short-lived chunk threads of transform reuse them instead of creating their own.
+	static std::unique_ptr<GeoTransform> acquire(const std::string& sourceURN, const std::string& destURN)
+	{
+		Pool& pool = getPool();
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			std::vector<std::unique_ptr<GeoTransform>>& free = pool.transforms[std::make_pair(sourceURN, destURN)];
+			if (!free.empty())
+			{
+				std::unique_ptr<GeoTransform> trans = std::move(free.back());
+				free.pop_back();
+				return trans;
+			}
+		}
+		return std::unique_ptr<GeoTransform>(new GeoTransform(sourceURN, destURN));
+	}
+
+	static void release(std::unique_ptr<GeoTransform> trans)
+	{
+		Pool& pool = getPool();
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.transforms[std::make_pair(trans->_sourceURN, trans->_destURN)].push_back(std::move(trans));
+	}
+
 	inline const std::string& getSourceURN(void) const { return _sourceURN; }
 
 	inline const std::string& getDestURN(void) const { return _destURN; }
 
+	// true if the transformation does not go through GDAL
+	inline bool isNative(void) const { return _isNative; }
+
 #ifdef USE_GDAL
 	static void* getProjection(const std::string &str)
 	{
@@ -86,11 +171,58 @@ public:
 #endif
 
 private:
+	struct Pool
+	{
+		std::mutex mutex;
+		std::map<std::pair<std::string, std::string>, std::vector<std::unique_ptr<GeoTransform>>> transforms;	// free ones
+	};
+
+	static Pool& getPool()
+	{
+		static Pool pool;
+		return pool;
+	}
+
+	static constexpr size_t TRANSFORM_BLOCK = 1024;
+	static constexpr size_t TRANSFORM_CHUNK = 65536;
+
+	// Transform count points, gathered by blocks in the coordinate arrays expected by the transformations
+	void transformBlocks(TVec3d* points, size_t count) const
+	{
+		double x[TRANSFORM_BLOCK];
+		double y[TRANSFORM_BLOCK];
+		double z[TRANSFORM_BLOCK];
+		for (size_t begin = 0; begin < count; begin += TRANSFORM_BLOCK)
+		{
+			size_t n = std::min(count - begin, TRANSFORM_BLOCK);
+			for (size_t i = 0; i < n; i++)
+			{
+				x[i] = points[begin + i].x;
+				y[i] = points[begin + i].y;
+				z[i] = points[begin + i].z;
+			}
+			if (_isNative)
+				_native.transform(n, x, y, z);
+#ifdef USE_GDAL
+			else
+				((OGRCoordinateTransformation*)_trans)->Transform((int)n, x, y);
+#endif
+			for (size_t i = 0; i < n; i++)
+			{
+				points[begin + i].x = x[i];
+				points[begin + i].y = y[i];
+				points[begin + i].z = z[i];
+			}
+		}
+	}
+
 	std::string _sourceURN;
 	std::string _destURN;
+	citygml::NativeTransform _native;
+	bool _isNative;
 	void* _sourceSRS;
 	void* _destSRS;
 	void* _trans;
-	};
+};
 
 #endif // __TRANSFORM_H__
@@ -0,0 +1,835 @@
+#include "CityJSONParser.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../CityModel/CityGML.hpp"
+
+const JSONValue* JSONValue::find(const std::string& key) const
+{
+	if (type != JSON_OBJECT)
+		return nullptr;
+
+	for (const std::pair<std::string, JSONValue>& member : members)
+	{
+		if (member.first == key)
+			return &member.second;
+	}
+
+	return nullptr;
+}
+
+bool JSONValue::isNumberAt(size_t i) const
+{
+	if (type == JSON_NUMBERS)
+		return i < numbers.size();
+	return type == JSON_ARRAY && i < array.size() && array[i].type == JSON_NUMBER;
+}
+
+double JSONValue::getNumber(size_t i) const
+{
+	if (type == JSON_NUMBERS)
+		return numbers[i];
+	return array[i].number;
+}
+
+// Convert a scalar JSON value to the string stored in the CityObject attributes
+static bool scalarToString(const JSONValue& value, std::string& out)
+{
+	std::ostringstream ss;
+	switch (value.type)
+	{
+	case JSONValue::JSON_STRING:
+		out = value.string;
+		return true;
+	case JSONValue::JSON_BOOL:
+		out = value.boolean ? "true" : "false";
+		return true;
+	case JSONValue::JSON_NUMBER:
+		ss.precision(15);
+		ss << value.number;
+		out = ss.str();
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool isBoundarySurface(CityObjectsType type)
+{
+	return type >= COT_WallSurface && type <= COT_CeilingSurface;
+}
+
+// CityGML boundary surfaces are stored as child CityObjects, the other semantic surfaces stay on their parent
+static GeometryType getGeometryTypeFromSemantic(const std::string& semantic)
+{
+	if (semantic == "RoofSurface") return GT_Roof;
+	if (semantic == "WallSurface") return GT_Wall;
+	if (semantic == "GroundSurface") return GT_Ground;
+	if (semantic == "ClosureSurface") return GT_Closure;
+	if (semantic == "FloorSurface") return GT_Floor;
+	if (semantic == "InteriorWallSurface") return GT_InteriorWall;
+	if (semantic == "CeilingSurface") return GT_Ceiling;
+	return GT_Unknown;
+}
+
+// Flatten the boundaries of a (Multi/Composite)Solid down to a list of surfaces,
+// each surface coming with its semantic index (-1 when there is none)
+static void flattenSurfaces(const JSONValue& boundaries, const JSONValue* values, int depth,
+	std::vector<std::pair<const JSONValue*, int>>& surfaces)
+{
+	for (size_t i = 0; i < boundaries.array.size(); i++)
+	{
+		if (depth == 0)
+		{
+			int s = (values && values->isNumberAt(i)) ? (int)values->getNumber(i) : -1;
+			surfaces.push_back(std::make_pair(&boundaries.array[i], s));
+		}
+		else if (boundaries.array[i].type == JSONValue::JSON_ARRAY)
+		{
+			const JSONValue* value = (values && values->type == JSONValue::JSON_ARRAY && i < values->array.size()) ? &values->array[i] : nullptr;
+			flattenSurfaces(boundaries.array[i], value, depth - 1, surfaces);
+		}
+	}
+}
+
+CityJSONParser::CityJSONParser(std::string name) : Module(name), _cur(nullptr), _end(nullptr), _objectsMask(COT_All)
+{
+}
+
+CityModel * CityJSONParser::load(const std::string & fname, ParserParams & params)
+{
+	this->_filename = fname;
+	params.m_basePath = fname.substr(0, fname.find_last_of('/') + 1);
+	params.m_basePath.push_back('/');
+
+	std::ifstream file(fname, std::ios::in | std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "ERROR with file: " << fname.c_str() << std::endl;
+		return nullptr;
+	}
+
+	// The whole file is read at once, everything else works on this buffer
+	std::string buffer;
+	file.seekg(0, std::ios::end);
+	buffer.resize((size_t)file.tellg());
+	file.seekg(0, std::ios::beg);
+	file.read(&buffer[0], buffer.size());
+	file.close();
+
+	const char* begin = buffer.c_str();
+	_cur = begin;
+	_end = begin + buffer.size();
+	_vertices.clear();
+	_objectsMask = getCityObjectsTypeMaskFromString(params.objectsMask);
+
+	if (!params.destSRS.empty())
+		std::cerr << "Warning: CityJSON coordinates are not transformed to " << params.destSRS << std::endl;
+
+	// Walk the root members once. "vertices" is decoded as soon as "transform" is known,
+	// "CityObjects" is always read last because it needs the vertices.
+	std::string type;
+	JSONValue metadata;
+	JSONValue transform;
+	TVec3d scale(1., 1., 1.);
+	TVec3d translate(0., 0., 0.);
+	const char* verticesPos = nullptr;
+	const char* cityObjectsPos = nullptr;
+	bool hasTransform = false;
+	bool ok = expect('{');
+
+	while (ok && skipWhitespaces() && *_cur != '}')
+	{
+		std::string key;
+		ok = parseString(key) && expect(':') && skipWhitespaces();
+		if (!ok) break;
+
+		if (key == "type") ok = parseString(type);
+		else if (key == "metadata") ok = parseValue(metadata);
+		else if (key == "transform")
+		{
+			ok = parseValue(transform);
+			hasTransform = true;
+
+			const JSONValue* s = transform.find("scale");
+			const JSONValue* t = transform.find("translate");
+			if (s && s->type == JSONValue::JSON_NUMBERS && s->size() == 3)
+				scale = TVec3d(s->numbers[0], s->numbers[1], s->numbers[2]);
+			if (t && t->type == JSONValue::JSON_NUMBERS && t->size() == 3)
+				translate = TVec3d(t->numbers[0], t->numbers[1], t->numbers[2]);
+
+			// vertices seen before the transform are decoded now
+			if (ok && verticesPos)
+			{
+				const char* pos = _cur;
+				_cur = verticesPos;
+				ok = readVertices(scale, translate);
+				_cur = pos;
+				verticesPos = nullptr;
+			}
+		}
+		else if (key == "vertices")
+		{
+			if (hasTransform) ok = readVertices(scale, translate);
+			else { verticesPos = _cur; ok = skipValue(); }
+		}
+		else if (key == "CityObjects") { cityObjectsPos = _cur; ok = skipValue(); }
+		else ok = skipValue();
+
+		if (ok && skipWhitespaces() && *_cur == ',') _cur++;
+	}
+
+	if (!ok || type != "CityJSON")
+	{
+		std::cerr << "CityJSON: parsing error in " << fname << " at offset " << (_cur - begin) << std::endl;
+		return nullptr;
+	}
+
+	// No transform (CityJSON 1.0 files may have real coordinates)
+	if (verticesPos)
+	{
+		_cur = verticesPos;
+		if (!readVertices(scale, translate))
+		{
+			std::cerr << "CityJSON: invalid vertices in " << fname << " at offset " << (_cur - begin) << std::endl;
+			return nullptr;
+		}
+	}
+
+	CityModel* model = new CityModel();
+	model->m_basePath = params.m_basePath;
+	model->getAppearanceManager()->m_basePath = model->m_basePath;
+
+	if (cityObjectsPos)
+	{
+		_cur = cityObjectsPos;
+		if (!readCityObjects(model, params))
+		{
+			std::cerr << "CityJSON: invalid CityObjects in " << fname << " at offset " << (_cur - begin) << std::endl;
+			delete model;
+			return nullptr;
+		}
+	}
+
+	model->finish(params);
+
+	const JSONValue* srs = metadata.find("referenceSystem");
+	if (srs && srs->isString())
+		model->_srsName = srs->string;
+	if (model->_srsName == "")
+	{
+		model->_srsName = params.destSRS;
+		std::cerr << "Warning: No SRS was set in the file. The model SRS has been set "
+			"without transformation to " << params.destSRS << std::endl;
+	}
+
+	const JSONValue* extent = metadata.find("geographicalExtent");
+	if (extent && extent->type == JSONValue::JSON_NUMBERS && extent->size() == 6)
+	{
+		const std::vector<double>& e = extent->numbers;
+		model->getEnvelope() = Envelope(TVec3d(e[0], e[1], e[2]), TVec3d(e[3], e[4], e[5]));
+	}
+	else
+		model->computeEnvelope();
+
+	_vertices.clear();
+	_vertices.shrink_to_fit();
+
+	return model;
+}
+
+bool CityJSONParser::skipWhitespaces()
+{
+	while (_cur < _end && (*_cur == ' ' || *_cur == '\n' || *_cur == '\r' || *_cur == '\t'))
+		_cur++;
+	return _cur < _end;
+}
+
+bool CityJSONParser::expect(char c)
+{
+	if (!skipWhitespaces() || *_cur != c)
+		return false;
+	_cur++;
+	return true;
+}
+
+bool CityJSONParser::parseString(std::string& out)
+{
+	if (!expect('"'))
+		return false;
+
+	out.clear();
+	while (_cur < _end)
+	{
+		// copy the plain characters by chunks
+		const char* start = _cur;
+		while (_cur < _end && *_cur != '"' && *_cur != '\\')
+			_cur++;
+		out.append(start, _cur - start);
+
+		if (_cur >= _end)
+			return false;
+		if (*_cur == '"')
+		{
+			_cur++;
+			return true;
+		}
+
+		// escape sequence
+		if (++_cur >= _end)
+			return false;
+		switch (*_cur++)
+		{
+		case '"': out.push_back('"'); break;
+		case '\\': out.push_back('\\'); break;
+		case '/': out.push_back('/'); break;
+		case 'b': out.push_back('\b'); break;
+		case 'f': out.push_back('\f'); break;
+		case 'n': out.push_back('\n'); break;
+		case 'r': out.push_back('\r'); break;
+		case 't': out.push_back('\t'); break;
+		case 'u':
+		{
+			if (_end - _cur < 4)
+				return false;
+			unsigned int code = (unsigned int)strtoul(std::string(_cur, 4).c_str(), nullptr, 16);
+			_cur += 4;
+			// surrogate pair
+			if (code >= 0xD800 && code <= 0xDBFF && _end - _cur >= 6 && _cur[0] == '\\' && _cur[1] == 'u')
+			{
+				unsigned int low = (unsigned int)strtoul(std::string(_cur + 2, 4).c_str(), nullptr, 16);
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				_cur += 6;
+			}
+			// UTF-8 encoding
+			if (code < 0x80)
+				out.push_back((char)code);
+			else if (code < 0x800)
+			{
+				out.push_back((char)(0xC0 | (code >> 6)));
+				out.push_back((char)(0x80 | (code & 0x3F)));
+			}
+			else if (code < 0x10000)
+			{
+				out.push_back((char)(0xE0 | (code >> 12)));
+				out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (code & 0x3F)));
+			}
+			else
+			{
+				out.push_back((char)(0xF0 | (code >> 18)));
+				out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+				out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (code & 0x3F)));
+			}
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+
+	return false;
+}
+
+bool CityJSONParser::parseNumber(double& out)
+{
+	if (!skipWhitespaces())
+		return false;
+
+	// Fast path for integers (quantised coordinates and vertex indices)
+	const char* p = _cur;
+	bool negative = false;
+	if (*p == '-')
+	{
+		negative = true;
+		p++;
+	}
+
+	if (p >= _end || *p < '0' || *p > '9')
+		return false;
+
+	long long value = 0;
+	int digits = 0;
+	while (p < _end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p - '0');
+		digits++;
+		p++;
+	}
+
+	if (digits < 18 && (p >= _end || (*p != '.' && *p != 'e' && *p != 'E')))
+	{
+		out = (double)(negative ? -value : value);
+		_cur = p;
+		return true;
+	}
+
+	// Decimal numbers : the buffer is null terminated so strtod can be used in place
+	char* end = nullptr;
+	out = strtod(_cur, &end);
+	if (end == _cur)
+		return false;
+	_cur = end;
+	return true;
+}
+
+bool CityJSONParser::parseValue(JSONValue& out)
+{
+	if (!skipWhitespaces())
+		return false;
+
+	switch (*_cur)
+	{
+	case '"':
+		out.type = JSONValue::JSON_STRING;
+		return parseString(out.string);
+
+	case '{':
+		out.type = JSONValue::JSON_OBJECT;
+		_cur++;
+		while (skipWhitespaces() && *_cur != '}')
+		{
+			out.members.push_back(std::make_pair(std::string(), JSONValue()));
+			if (!parseString(out.members.back().first) || !expect(':') || !parseValue(out.members.back().second))
+				return false;
+			if (skipWhitespaces() && *_cur == ',') _cur++;
+		}
+		return expect('}');
+
+	case '[':
+		out.type = JSONValue::JSON_ARRAY;
+		_cur++;
+
+		// Arrays of numbers are stored packed, until an element which is not a number is found
+		if (skipWhitespaces() && (*_cur == '-' || (*_cur >= '0' && *_cur <= '9')))
+		{
+			out.type = JSONValue::JSON_NUMBERS;
+			double number;
+			while (skipWhitespaces() && (*_cur == '-' || (*_cur >= '0' && *_cur <= '9')))
+			{
+				if (!parseNumber(number))
+					return false;
+				out.numbers.push_back(number);
+				if (skipWhitespaces() && *_cur == ',') _cur++;
+			}
+
+			if (_cur < _end && *_cur == ']')
+			{
+				_cur++;
+				return true;
+			}
+
+			// mixed array : back to one JSONValue per element
+			out.type = JSONValue::JSON_ARRAY;
+			for (double n : out.numbers)
+			{
+				out.array.push_back(JSONValue());
+				out.array.back().type = JSONValue::JSON_NUMBER;
+				out.array.back().number = n;
+			}
+			out.numbers.clear();
+		}
+
+		while (skipWhitespaces() && *_cur != ']')
+		{
+			out.array.push_back(JSONValue());
+			if (!parseValue(out.array.back()))
+				return false;
+			if (skipWhitespaces() && *_cur == ',') _cur++;
+		}
+		return expect(']');
+
+	case 't':
+	case 'f':
+	case 'n':
+		if (_end - _cur >= 4 && strncmp(_cur, "true", 4) == 0)
+		{
+			out.type = JSONValue::JSON_BOOL;
+			out.boolean = true;
+			_cur += 4;
+			return true;
+		}
+		if (_end - _cur >= 5 && strncmp(_cur, "false", 5) == 0)
+		{
+			out.type = JSONValue::JSON_BOOL;
+			out.boolean = false;
+			_cur += 5;
+			return true;
+		}
+		if (_end - _cur >= 4 && strncmp(_cur, "null", 4) == 0)
+		{
+			out.type = JSONValue::JSON_NULL;
+			_cur += 4;
+			return true;
+		}
+		return false;
+
+	default:
+		out.type = JSONValue::JSON_NUMBER;
+		return parseNumber(out.number);
+	}
+}
+
+bool CityJSONParser::skipValue()
+{
+	if (!skipWhitespaces())
+		return false;
+
+	if (*_cur == '"')
+	{
+		std::string dummy;
+		return parseString(dummy);
+	}
+
+	if (*_cur != '{' && *_cur != '[')
+	{
+		// scalar value
+		while (_cur < _end && *_cur != ',' && *_cur != '}' && *_cur != ']' && *_cur != ' ' && *_cur != '\n' && *_cur != '\r' && *_cur != '\t')
+			_cur++;
+		return true;
+	}
+
+	// objects and arrays : only count the brackets, strings are skipped as they may contain some
+	int depth = 0;
+	while (_cur < _end)
+	{
+		char c = *_cur++;
+		if (c == '{' || c == '[')
+			depth++;
+		else if (c == '}' || c == ']')
+		{
+			if (--depth == 0)
+				return true;
+		}
+		else if (c == '"')
+		{
+			while (_cur < _end && *_cur != '"')
+				_cur += (*_cur == '\\') ? 2 : 1;
+			_cur++;
+		}
+	}
+
+	return false;
+}
+
+bool CityJSONParser::readVertices(const TVec3d& scale, const TVec3d& translate)
+{
+	if (!expect('['))
+		return false;
+
+	while (skipWhitespaces() && *_cur != ']')
+	{
+		double x, y, z;
+		if (!expect('[') || !parseNumber(x) || !expect(',') || !parseNumber(y) || !expect(',') || !parseNumber(z) || !expect(']'))
+			return false;
+
+		_vertices.push_back(TVec3d(x * scale.x + translate.x, y * scale.y + translate.y, z * scale.z + translate.z));
+
+		if (skipWhitespaces() && *_cur == ',') _cur++;
+	}
+
+	return expect(']');
+}
+
+bool CityJSONParser::readCityObjects(CityModel* model, const ParserParams& params)
+{
+	if (!expect('{'))
+		return false;
+
+	std::vector<CityObject*> objects;
+	std::map<std::string, CityObject*> objectsById;
+	std::map<std::string, std::vector<std::string>> parentsById;
+
+	while (skipWhitespaces() && *_cur != '}')
+	{
+		std::string id;
+		JSONValue value;
+		if (!parseString(id) || !expect(':') || !parseValue(value))
+			return false;
+		if (skipWhitespaces() && *_cur == ',') _cur++;
+
+		// Keep the hierarchy of every object, even filtered ones, so their children can be filtered too
+		const JSONValue* parents = value.find("parents");
+		if (parents && parents->isArray())
+		{
+			for (const JSONValue& parent : parents->array)
+				if (parent.isString()) parentsById[id].push_back(parent.string);
+		}
+
+		const JSONValue* type = value.find("type");
+		CityObject* obj = createCityObject(type && type->isString() ? type->string : "", id);
+		if (obj && !(_objectsMask & obj->getType()))
+		{
+			delete obj;
+			obj = nullptr;
+		}
+		objectsById[id] = obj;
+		if (!obj)
+			continue;
+
+		obj->_parent = nullptr;
+
+		const JSONValue* attributes = value.find("attributes");
+		if (attributes)
+			readAttributes(obj, *attributes);
+
+		const JSONValue* geometries = value.find("geometry");
+		if (geometries && geometries->type == JSONValue::JSON_ARRAY)
+		{
+			for (size_t i = 0; i < geometries->array.size(); i++)
+				readGeometry(obj, geometries->array[i], (unsigned int)i, params);
+		}
+
+		objects.push_back(obj);
+	}
+
+	if (!expect('}'))
+		return false;
+
+	// Second pass : hierarchy. An object whose ancestor has been filtered out is dropped, like in XMLParser.
+	std::set<std::string> dropped;
+	for (CityObject* obj : objects)
+	{
+		std::vector<std::string> ancestors(1, obj->getId());
+		std::set<std::string> visited;
+		bool filtered = false;
+		while (!ancestors.empty() && !filtered)
+		{
+			std::string current = ancestors.back();
+			ancestors.pop_back();
+			if (!visited.insert(current).second) continue;
+
+			std::map<std::string, std::vector<std::string>>::const_iterator it = parentsById.find(current);
+			if (it == parentsById.end()) continue;
+			for (const std::string& parent : it->second)
+			{
+				std::map<std::string, CityObject*>::const_iterator p = objectsById.find(parent);
+				if (p != objectsById.end() && p->second == nullptr) filtered = true;
+				ancestors.push_back(parent);
+			}
+		}
+		if (filtered) dropped.insert(obj->getId());
+	}
+
+	for (CityObject* obj : objects)
+	{
+		if (dropped.count(obj->getId()))
+			continue;
+
+		std::map<std::string, std::vector<std::string>>::const_iterator it = parentsById.find(obj->getId());
+		if (it != parentsById.end())
+		{
+			for (const std::string& parentId : it->second)
+			{
+				std::map<std::string, CityObject*>::const_iterator p = objectsById.find(parentId);
+				if (p != objectsById.end() && p->second)
+				{
+					obj->_parent = p->second;
+					p->second->insertNode(obj);
+					break;
+				}
+			}
+		}
+	}
+
+	// Registration in the model, roots keep the file order.
+	// Dropped objects were never linked, so they only own their boundary surfaces.
+	for (CityObject* obj : objects)
+	{
+		bool empty = obj->size() == 0 && obj->getChildCount() == 0;
+		if (dropped.count(obj->getId()) || (empty && params.pruneEmptyObjects && !obj->_parent))
+		{
+			delete obj;
+			continue;
+		}
+
+		model->addCityObject(obj);
+		for (CityObject* child : obj->getChildren())
+			if (isBoundarySurface(child->getType())) model->addCityObject(child);
+
+		if (!obj->_parent)
+			model->addCityObjectAsRoot(obj);
+	}
+
+	return true;
+}
+
+CityObject* CityJSONParser::createCityObject(const std::string& type, const std::string& id) const
+{
+#define CREATE_OBJECT( _name_, _t_ ) if ( type == _name_ ) return new _t_( id );
+	CREATE_OBJECT("Building", Building);
+	CREATE_OBJECT("BuildingPart", BuildingPart);
+	CREATE_OBJECT("BuildingInstallation", BuildingInstallation);
+	CREATE_OBJECT("BuildingRoom", Room);
+	CREATE_OBJECT("BuildingFurniture", BuildingFurniture);
+	CREATE_OBJECT("Door", Door);
+	CREATE_OBJECT("Window", Window);
+	CREATE_OBJECT("CityFurniture", CityFurniture);
+	CREATE_OBJECT("Road", Road);
+	CREATE_OBJECT("Railway", Railway);
+	CREATE_OBJECT("TransportSquare", Square);
+	CREATE_OBJECT("PlantCover", PlantCover);
+	CREATE_OBJECT("SolitaryVegetationObject", SolitaryVegetationObject);
+	CREATE_OBJECT("WaterBody", WaterBody);
+	CREATE_OBJECT("TINRelief", TINRelief);
+	CREATE_OBJECT("LandUse", LandUse);
+	CREATE_OBJECT("Tunnel", Tunnel);
+	CREATE_OBJECT("TunnelPart", Tunnel);
+	CREATE_OBJECT("Bridge", Bridge);
+	CREATE_OBJECT("BridgePart", BridgePart);
+	CREATE_OBJECT("BridgeInstallation", BridgeInstallation);
+	CREATE_OBJECT("BridgeConstructiveElement", BridgeConstructionElement);
+	CREATE_OBJECT("GenericCityObject", GenericCityObject);
+	// Semantic surfaces
+	CREATE_OBJECT("WallSurface", WallSurface);
+	CREATE_OBJECT("RoofSurface", RoofSurface);
+	CREATE_OBJECT("GroundSurface", GroundSurface);
+	CREATE_OBJECT("ClosureSurface", ClosureSurface);
+	CREATE_OBJECT("FloorSurface", FloorSurface);
+	CREATE_OBJECT("InteriorWallSurface", InteriorWallSurface);
+	CREATE_OBJECT("CeilingSurface", CeilingSurface);
+#undef CREATE_OBJECT
+
+	// Extensions ("+NoiseBuilding", ...) are kept as generic objects
+	if (!type.empty() && type[0] == '+')
+		return new GenericCityObject(id);
+
+	std::cerr << "CityJSON: unsupported CityObject type '" << type << "' for " << id << std::endl;
+	return nullptr;
+}
+
+void CityJSONParser::readAttributes(CityObject* obj, const JSONValue& attributes) const
+{
+	for (const std::pair<std::string, JSONValue>& member : attributes.members)
+	{
+		std::string value;
+		if (member.first == "type" || member.first == "id" || member.first == "parent" || member.first == "children")
+			continue;
+		if (scalarToString(member.second, value))
+			obj->setAttribute(member.first, value);
+	}
+}
+
+void CityJSONParser::readGeometry(CityObject* obj, const JSONValue& geometry, unsigned int index, const ParserParams& params)
+{
+	const JSONValue* type = geometry.find("type");
+	const JSONValue* boundaries = geometry.find("boundaries");
+	if (!type || !type->isString() || !boundaries || boundaries->type != JSONValue::JSON_ARRAY)
+		return;
+
+	// Number of nesting levels above the surfaces
+	int depth;
+	if (type->string == "MultiSurface" || type->string == "CompositeSurface") depth = 0;
+	else if (type->string == "Solid") depth = 1;
+	else if (type->string == "MultiSolid" || type->string == "CompositeSolid") depth = 2;
+	else return; // points, lines and geometry instances have no CityModel equivalent
+
+	// "lod" is a number in CityJSON 1.0 and a string ("2.2") in 1.1
+	unsigned int lod = 0;
+	const JSONValue* lodValue = geometry.find("lod");
+	if (lodValue && lodValue->isString()) lod = (unsigned int)atoi(lodValue->string.c_str());
+	else if (lodValue && lodValue->isNumber()) lod = (unsigned int)lodValue->number;
+	if (lod < params.minLOD || lod > params.maxLOD)
+		return;
+
+	const JSONValue* semantics = geometry.find("semantics");
+	const JSONValue* semSurfaces = semantics ? semantics->find("surfaces") : nullptr;
+	const JSONValue* semValues = semantics ? semantics->find("values") : nullptr;
+
+	std::vector<std::pair<const JSONValue*, int>> flat;
+	flattenSurfaces(*boundaries, semValues, depth, flat);
+
+	std::string geomId = obj->getId() + "_lod" + std::to_string(lod) + "_" + std::to_string(index);
+	Geometry* geom = nullptr;
+	std::map<int, Geometry*> semanticGeometries;
+
+	for (size_t k = 0; k < flat.size(); k++)
+	{
+		Polygon* poly = readSurface(*flat[k].first, geomId + "_" + std::to_string(k));
+		if (!poly)
+			continue;
+
+		int s = flat[k].second;
+		const JSONValue* semantic = (s >= 0 && semSurfaces && semSurfaces->type == JSONValue::JSON_ARRAY && s < (int)semSurfaces->array.size()) ? &semSurfaces->array[s] : nullptr;
+		const JSONValue* semType = semantic ? semantic->find("type") : nullptr;
+		GeometryType gt = (semType && semType->isString()) ? getGeometryTypeFromSemantic(semType->string) : GT_Unknown;
+
+		if (gt == GT_Unknown)
+		{
+			if (!geom) geom = new Geometry(geomId, GT_Unknown, lod);
+			geom->addPolygon(poly);
+			continue;
+		}
+
+		std::map<int, Geometry*>::iterator it = semanticGeometries.find(s);
+		if (it == semanticGeometries.end())
+		{
+			const JSONValue* semId = semantic->find("id");
+			std::string surfaceId = (semId && semId->isString()) ? semId->string : geomId + "_" + semType->string + "_" + std::to_string(s);
+
+			Geometry* surfaceGeom = nullptr;
+			CityObject* surface = createCityObject(semType->string, surfaceId);
+			if (surface && (_objectsMask & surface->getType()))
+			{
+				readAttributes(surface, *semantic);
+				surface->_parent = obj;
+				obj->insertNode(surface);
+
+				surfaceGeom = new Geometry(surfaceId + "_geom", gt, lod);
+				surface->addGeometry(surfaceGeom);
+			}
+			else
+				delete surface;
+
+			it = semanticGeometries.insert(std::make_pair(s, surfaceGeom)).first;
+		}
+
+		if (it->second) it->second->addPolygon(poly);
+		else delete poly;
+	}
+
+	if (geom)
+		obj->addGeometry(geom);
+}
+
+Polygon* CityJSONParser::readSurface(const JSONValue& surface, const std::string& id) const
+{
+	if (surface.type != JSONValue::JSON_ARRAY || surface.array.empty())
+		return nullptr;
+
+	Polygon* poly = new Polygon(id);
+	for (size_t r = 0; r < surface.array.size(); r++)
+	{
+		// rings are packed arrays of indices in the shared vertex buffer
+		const JSONValue& ring = surface.array[r];
+		if (ring.type != JSONValue::JSON_NUMBERS)
+			continue;
+
+		LinearRing* linearRing = new LinearRing(id + "_" + std::to_string(r), r == 0);
+		std::vector<TVec3d>& vertices = linearRing->getVertices();
+		vertices.reserve(ring.numbers.size());
+		for (double index : ring.numbers)
+		{
+			if (index < 0 || (size_t)index >= _vertices.size())
+			{
+				std::cerr << "CityJSON: invalid vertex index in " << id << std::endl;
+				continue;
+			}
+			vertices.push_back(_vertices[(size_t)index]);
+		}
+		poly->addRing(linearRing);
+	}
+
+	if (!poly->getExteriorRing())
+	{
+		delete poly;
+		return nullptr;
+	}
+
+	return poly;
+}
@@ -0,0 +1,82 @@
+#ifndef CITYJSONPARSER_HPP
+#define CITYJSONPARSER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "../Module.hpp"
+#include "../XMLParser/ParserParams.hpp"
+#include "../../CityModel/CityModel.hpp"
+
+using namespace citygml;
+
+// Minimal JSON value, only used for the (small) CityObjects entries.
+// The shared "vertices" array is never stored as JSON values : it is decoded
+// directly into the vertex buffer (see CityJSONParser::readVertices).
+struct JSONValue
+{
+	// JSON_NUMBERS is an array holding only numbers (rings of vertex indices, semantic values, ...),
+	// stored packed in numbers instead of one JSONValue per element
+	enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_NUMBERS, JSON_OBJECT };
+
+	Type type = JSON_NULL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JSONValue> array;
+	std::vector<double> numbers;
+	std::vector<std::pair<std::string, JSONValue>> members;
+
+	// Return the member named key, nullptr if not found or not an object
+	const JSONValue* find(const std::string& key) const;
+
+	// Array accessors working on both array representations
+	size_t size() const { return type == JSON_NUMBERS ? numbers.size() : array.size(); }
+	bool isNumberAt(size_t i) const;
+	double getNumber(size_t i) const;
+
+	bool isNull() const { return type == JSON_NULL; }
+	bool isArray() const { return type == JSON_ARRAY || type == JSON_NUMBERS; }
+	bool isObject() const { return type == JSON_OBJECT; }
+	bool isString() const { return type == JSON_STRING; }
+	bool isNumber() const { return type == JSON_NUMBER; }
+};
+
+class CityJSONParser : public Module
+{
+public:
+	CityJSONParser(std::string name);
+
+	// Parse a CityJSON (.json) file and return the same CityModel as XMLParser::load, nullptr on failure
+	CityModel* load(const std::string& fname, ParserParams& params);
+
+private:
+	// Cursor on the file buffer
+	bool skipWhitespaces();
+	bool expect(char c);
+	bool parseString(std::string& out);
+	bool parseNumber(double& out);
+	bool parseValue(JSONValue& out);
+	bool skipValue();
+
+	// Decode the "vertices" array at the current position into the shared vertex buffer
+	bool readVertices(const TVec3d& scale, const TVec3d& translate);
+
+	// Build the CityObjects entries (first pass : objects & geometries, second pass : hierarchy)
+	bool readCityObjects(CityModel* model, const ParserParams& params);
+	CityObject* createCityObject(const std::string& type, const std::string& id) const;
+	void readAttributes(CityObject* obj, const JSONValue& attributes) const;
+	void readGeometry(CityObject* obj, const JSONValue& geometry, unsigned int index, const ParserParams& params);
+	Polygon* readSurface(const JSONValue& surface, const std::string& id) const;
+
+	std::string _filename;
+
+	const char* _cur;
+	const char* _end;
+
+	std::vector<TVec3d> _vertices;
+	CityObjectsTypeMask _objectsMask;
+};
+
+#endif // !CITYJSONPARSER_HPP
@@ -0,0 +1,340 @@
+#include "CityJSONWriter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <map>
+
+static bool isBoundarySurface(CityObjectsType type)
+{
+	return type >= COT_WallSurface && type <= COT_CeilingSurface;
+}
+
+// CityJSON names of the CityObject types which differ from CityGML
+static std::string getCityJSONType(const CityObject& obj)
+{
+	switch (obj.getType())
+	{
+	case COT_Square: return "TransportSquare";
+	case COT_Room: return "BuildingRoom";
+	case COT_BridgeConstructionElement: return "BridgeConstructiveElement";
+	default: return obj.getTypeAsString();
+	}
+}
+
+CityJSONWriter::CityJSONWriter(std::string name) : Module(name), _scale(0.001)
+{
+}
+
+bool CityJSONWriter::write(const CityModel& model, const std::string& filename, double scale)
+{
+	std::cout << "[CITYJSON WRITER]...............................[START]" << std::endl;
+
+	_file.open(filename, std::ios::out | std::ios::binary);
+	if (!_file)
+	{
+		std::cout << "[CITYJSON WRITER]...............................[FAILED]: Problem with filepath: '" << filename << "'" << std::endl;
+		return false;
+	}
+
+	_scale = scale;
+	_vertexIndex.clear();
+	_vertices.clear();
+
+	// Translation = lower corner of all the ring vertices, so that the quantised coordinates stay small
+	_translate = TVec3d(std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+	for (const CityObject* root : model.getCityObjectsRoots())
+		computeTranslate(root);
+	if (_translate.x == std::numeric_limits<double>::max())
+		_translate = TVec3d(0., 0., 0.);
+
+	std::vector<std::pair<const CityObject*, const CityObject*>> objects;
+	for (const CityObject* root : model.getCityObjectsRoots())
+		collectCityObjects(root, nullptr, objects);
+
+	_file.precision(std::numeric_limits<double>::digits10 + 2);
+	_file << "{\"type\":\"CityJSON\",\"version\":\"1.1\",\n";
+
+	_file << "\"metadata\":{";
+	bool first = true;
+	if (!model.getSRSName().empty())
+	{
+		_file << "\"referenceSystem\":";
+		writeString(model.getSRSName());
+		first = false;
+	}
+	const TVec3d& lower = model.getEnvelope().getLowerBound();
+	const TVec3d& upper = model.getEnvelope().getUpperBound();
+	if (lower.x <= upper.x && lower.y <= upper.y && lower.z <= upper.z)
+	{
+		if (!first) _file << ",";
+		_file << "\"geographicalExtent\":[" << lower.x << "," << lower.y << "," << lower.z << ","
+			<< upper.x << "," << upper.y << "," << upper.z << "]";
+	}
+	_file << "},\n";
+
+	_file << "\"transform\":{\"scale\":[" << _scale << "," << _scale << "," << _scale << "],\"translate\":["
+		<< _translate.x << "," << _translate.y << "," << _translate.z << "]},\n";
+
+	// One CityObject per line, the vertices are collected on the fly
+	_file << "\"CityObjects\":{";
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		_file << (i == 0 ? "\n" : ",\n");
+		writeCityObject(*objects[i].first, objects[i].second);
+	}
+	_file << "\n},\n";
+
+	_file << "\"vertices\":[";
+	for (size_t i = 0; i < _vertices.size(); i++)
+	{
+		if (i > 0) _file << ",";
+		_file << "[" << _vertices[i].x << "," << _vertices[i].y << "," << _vertices[i].z << "]";
+	}
+	_file << "]\n}\n";
+
+	_file.close();
+
+	std::cout << "\t [CITYOBJECTS]....................[" << objects.size() << "]" << std::endl;
+	std::cout << "\t [VERTICES]....................[" << _vertices.size() << "]" << std::endl;
+	std::cout << "[CITYJSON WRITER]...............................[DONE]" << std::endl;
+
+	_vertexIndex.clear();
+	_vertices.clear();
+
+	return true;
+}
+
+void CityJSONWriter::collectCityObjects(const CityObject* obj, const CityObject* parent, std::vector<std::pair<const CityObject*, const CityObject*>>& objects) const
+{
+	if (isBoundarySurface(obj->getType()))
+		return;
+
+	objects.push_back(std::make_pair(obj, parent));
+	for (const CityObject* child : obj->getChildren())
+		collectCityObjects(child, obj, objects);
+}
+
+void CityJSONWriter::computeTranslate(const CityObject* obj)
+{
+	for (const Geometry* geom : obj->getGeometries())
+	{
+		for (const Polygon* poly : geom->getParsedPolygons())
+		{
+			if (!poly->getExteriorRing())
+				continue;
+
+			for (const TVec3d& v : poly->getExteriorRing()->getVertices())
+			{
+				_translate.x = std::min(_translate.x, v.x);
+				_translate.y = std::min(_translate.y, v.y);
+				_translate.z = std::min(_translate.z, v.z);
+			}
+		}
+	}
+
+	for (const CityObject* child : obj->getChildren())
+		computeTranslate(child);
+}
+
+void CityJSONWriter::writeCityObject(const CityObject& obj, const CityObject* parent)
+{
+	writeString(obj.getId());
+	_file << ":{\"type\":";
+	writeString(getCityJSONType(obj));
+
+	bool first = true;
+	for (const std::pair<const std::string, std::string>& attribute : obj.getAttributes())
+	{
+		if (attribute.first == "xlink")
+			continue;
+		_file << (first ? ",\"attributes\":{" : ",");
+		writeString(attribute.first);
+		_file << ":";
+		writeString(attribute.second);
+		first = false;
+	}
+	if (!first) _file << "}";
+
+	writeGeometries(obj);
+
+	first = true;
+	for (const CityObject* child : obj.getChildren())
+	{
+		if (isBoundarySurface(child->getType()))
+			continue;
+		_file << (first ? ",\"children\":[" : ",");
+		writeString(child->getId());
+		first = false;
+	}
+	if (!first) _file << "]";
+
+	if (parent)
+	{
+		_file << ",\"parents\":[";
+		writeString(parent->getId());
+		_file << "]";
+	}
+
+	_file << "}";
+}
+
+void CityJSONWriter::writeGeometries(const CityObject& obj)
+{
+	// One MultiSurface per LOD : polygons of the object itself have no semantic,
+	// polygons of its boundary surfaces get the index of the surface in the semantics array
+	std::map<unsigned int, std::vector<std::pair<const Polygon*, int>>> polygonsByLOD;
+	std::map<unsigned int, std::vector<const CityObject*>> semanticsByLOD;
+
+	for (const Geometry* geom : obj.getGeometries())
+		for (const Polygon* poly : geom->getParsedPolygons())
+			polygonsByLOD[geom->getLOD()].push_back(std::make_pair(poly, -1));
+
+	for (const CityObject* child : obj.getChildren())
+	{
+		if (!isBoundarySurface(child->getType()))
+			continue;
+
+		for (const Geometry* geom : child->getGeometries())
+		{
+			std::vector<const CityObject*>& semantics = semanticsByLOD[geom->getLOD()];
+			int s = (int)(std::find(semantics.begin(), semantics.end(), child) - semantics.begin());
+			if (s == (int)semantics.size())
+				semantics.push_back(child);
+
+			for (const Polygon* poly : geom->getParsedPolygons())
+				polygonsByLOD[geom->getLOD()].push_back(std::make_pair(poly, s));
+		}
+	}
+
+	if (polygonsByLOD.empty())
+		return;
+
+	_file << ",\"geometry\":[";
+	bool firstGeometry = true;
+	for (const std::pair<const unsigned int, std::vector<std::pair<const Polygon*, int>>>& lod : polygonsByLOD)
+	{
+		_file << (firstGeometry ? "" : ",") << "{\"type\":\"MultiSurface\",\"lod\":\"" << lod.first << "\",\"boundaries\":[";
+		firstGeometry = false;
+
+		bool first = true;
+		for (const std::pair<const Polygon*, int>& polygon : lod.second)
+		{
+			if (!polygon.first->getExteriorRing())
+				continue;
+
+			_file << (first ? "[" : ",[");
+			writeRing(polygon.first->getExteriorRing()->getVertices());
+			for (const LinearRing* ring : polygon.first->getInteriorRings())
+			{
+				_file << ",";
+				writeRing(ring->getVertices());
+			}
+			_file << "]";
+			first = false;
+		}
+		_file << "]";
+
+		const std::vector<const CityObject*>& semantics = semanticsByLOD[lod.first];
+		if (!semantics.empty())
+		{
+			_file << ",\"semantics\":{\"surfaces\":[";
+			for (size_t i = 0; i < semantics.size(); i++)
+			{
+				_file << (i == 0 ? "{\"type\":" : ",{\"type\":");
+				writeString(getCityJSONType(*semantics[i]));
+				_file << ",\"id\":";
+				writeString(semantics[i]->getId());
+				for (const std::pair<const std::string, std::string>& attribute : semantics[i]->getAttributes())
+				{
+					if (attribute.first == "xlink" || attribute.first == "id" || attribute.first == "type")
+						continue;
+					_file << ",";
+					writeString(attribute.first);
+					_file << ":";
+					writeString(attribute.second);
+				}
+				_file << "}";
+			}
+			_file << "],\"values\":[";
+			first = true;
+			for (const std::pair<const Polygon*, int>& polygon : lod.second)
+			{
+				if (!polygon.first->getExteriorRing())
+					continue;
+				_file << (first ? "" : ",");
+				if (polygon.second < 0) _file << "null";
+				else _file << polygon.second;
+				first = false;
+			}
+			_file << "]}";
+		}
+
+		_file << "}";
+	}
+	_file << "]";
+}
+
+void CityJSONWriter::writeRing(const std::vector<TVec3d>& ring)
+{
+	std::vector<unsigned int> indices;
+	indices.reserve(ring.size());
+	for (const TVec3d& v : ring)
+		indices.push_back(addVertex(v));
+
+	// CityJSON rings are not closed : also drops closing vertices which only match the first one once quantised
+	while (indices.size() > 1 && indices.back() == indices.front())
+		indices.pop_back();
+
+	_file << "[";
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (i > 0) _file << ",";
+		_file << indices[i];
+	}
+	_file << "]";
+}
+
+void CityJSONWriter::writeString(const std::string& str)
+{
+	_file << '"';
+	for (char c : str)
+	{
+		switch (c)
+		{
+		case '"': _file << "\\\""; break;
+		case '\\': _file << "\\\\"; break;
+		case '\n': _file << "\\n"; break;
+		case '\r': _file << "\\r"; break;
+		case '\t': _file << "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char)c);
+				_file << buffer;
+			}
+			else
+				_file << c;
+		}
+	}
+	_file << '"';
+}
+
+unsigned int CityJSONWriter::addVertex(const TVec3d& v)
+{
+	QuantisedVertex q;
+	q.x = llround((v.x - _translate.x) / _scale);
+	q.y = llround((v.y - _translate.y) / _scale);
+	q.z = llround((v.z - _translate.z) / _scale);
+
+	std::unordered_map<QuantisedVertex, unsigned int, QuantisedVertexHash>::const_iterator it = _vertexIndex.find(q);
+	if (it != _vertexIndex.end())
+		return it->second;
+
+	unsigned int index = (unsigned int)_vertices.size();
+	_vertexIndex[q] = index;
+	_vertices.push_back(q);
+	return index;
+}
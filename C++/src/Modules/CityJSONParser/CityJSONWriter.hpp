@@ -0,0 +1,63 @@
+#ifndef CITYJSONWRITER_HPP
+#define CITYJSONWRITER_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../Module.hpp"
+#include "../../CityModel/CityModel.hpp"
+
+using namespace citygml;
+
+// Vertex quantised with the "transform" of the output file
+struct QuantisedVertex
+{
+	long long x, y, z;
+
+	bool operator==(const QuantisedVertex& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct QuantisedVertexHash
+{
+	size_t operator()(const QuantisedVertex& v) const
+	{
+		size_t h = std::hash<long long>()(v.x);
+		h ^= std::hash<long long>()(v.y) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= std::hash<long long>()(v.z) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
+class CityJSONWriter : public Module
+{
+public:
+	CityJSONWriter(std::string name);
+
+	// Write the CityModel as a CityJSON 1.1 file. Vertices are shared and quantised with scale (default : 1 mm).
+	// Boundary surfaces (WallSurface, RoofSurface, ...) are written as semantics of their parent.
+	bool write(const CityModel& model, const std::string& filename, double scale = 0.001);
+
+private:
+	// Flatten the hierarchy to (object, parent) pairs, boundary surfaces excluded
+	void collectCityObjects(const CityObject* obj, const CityObject* parent, std::vector<std::pair<const CityObject*, const CityObject*>>& objects) const;
+	void computeTranslate(const CityObject* obj);
+
+	void writeCityObject(const CityObject& obj, const CityObject* parent);
+	void writeGeometries(const CityObject& obj);
+	void writeRing(const std::vector<TVec3d>& ring);
+	void writeString(const std::string& str);
+
+	unsigned int addVertex(const TVec3d& v);
+
+	std::ofstream _file;
+
+	double _scale;
+	TVec3d _translate;
+
+	std::unordered_map<QuantisedVertex, unsigned int, QuantisedVertexHash> _vertexIndex;
+	std::vector<QuantisedVertex> _vertices;
+};
+
+#endif // !CITYJSONWRITER_HPP
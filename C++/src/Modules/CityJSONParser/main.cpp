@@ -0,0 +1,63 @@
+#include <string.h>
+#include <iostream>
+#include <chrono>
+#include "CityJSONParser.hpp"
+#include "CityJSONWriter.hpp"
+#include "../XMLParser/XMLParser.hpp"
+#include "../../CityModel/CityModel.hpp"
+
+/* Return true if the file name ends with ext, false otherwise */
+bool assertExtension(const std::string& filename, const std::string& ext)
+{
+	return filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	// Check if there is a CityJSON (.json) or CityGML (.gml) file, exit if not
+	if (argc < 2 || !(assertExtension(argv[1], ".json") || assertExtension(argv[1], ".gml"))) {
+		std::cout << "[ERROR]:.............................:[CityJSON or CityGML file not found] " << std::endl;
+		exit(1);
+	}
+
+	std::string filename(argv[1]);
+
+	citygml::ParserParams params = citygml::ParserParams();
+	CityModel * cityModel = nullptr;
+
+	// The parsing time is printed to compare both formats on the same data
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (assertExtension(filename, ".json")) {
+		CityJSONParser * parser = new CityJSONParser("cityjsonparser");
+		cityModel = parser->load(filename, params);
+		delete parser;
+	}
+	else {
+		XMLParser * parser = new XMLParser("xmlparser");
+		cityModel = parser->load(filename, params);
+		delete parser;
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	// == 0 if the parsing failed, file name/location may be wrong
+	if (cityModel == 0)
+	{
+		std::cout << "[PARSING]:.............................:[FAILED]" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "[PARSING]:.............................:[DONE] ("
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms, "
+		<< cityModel->size() << " CityObjects)" << std::endl;
+
+	// Optional CityJSON output
+	if (argc > 2) {
+		CityJSONWriter * writer = new CityJSONWriter("cityjsonwriter");
+		writer->write(*cityModel, argv[2]);
+		delete writer;
+	}
+
+	delete cityModel;
+
+	return 0;
+}
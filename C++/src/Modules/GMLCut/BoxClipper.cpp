@@ -0,0 +1,116 @@
+#include "BoxClipper.hpp"
+
+#include <algorithm>
+
+BoxClipper::BoxClipper() : _xmin(0.), _ymin(0.), _xmax(0.), _ymax(0.)
+{
+}
+
+void BoxClipper::setBox(double xmin, double ymin, double xmax, double ymax)
+{
+	_xmin = xmin;
+	_ymin = ymin;
+	_xmax = xmax;
+	_ymax = ymax;
+}
+
+bool BoxClipper::clip(const MyVectorOfVertices& ring, MyVectorOfVertices& result)
+{
+	result.clear();
+	if (ring.empty())
+		return false;
+
+	// Bounding box of the ring : most of the polygons of a dense TIN are entirely inside or outside the window
+	double xmin = ring[0].x, ymin = ring[0].y, xmax = ring[0].x, ymax = ring[0].y;
+	for (std::size_t k = 1; k < ring.size(); k++)
+	{
+		xmin = std::min(xmin, ring[k].x);
+		ymin = std::min(ymin, ring[k].y);
+		xmax = std::max(xmax, ring[k].x);
+		ymax = std::max(ymax, ring[k].y);
+	}
+
+	if (xmax < _xmin || ymax < _ymin || xmin > _xmax || ymin > _ymax)
+		return false;
+
+	// Only the half-planes crossed by the ring are clipped, alternating between result and _buffer
+	const MyVectorOfVertices* in = &ring;
+	MyVectorOfVertices* out = &_buffer;
+	bool crossed = false;
+
+	const double bounds[4] = { _xmin, _xmax, _ymin, _ymax };
+	const bool crosses[4] = { xmin < _xmin, xmax > _xmax, ymin < _ymin, ymax > _ymax };
+	for (int p = 0; p < 4; p++)
+	{
+		if (!crosses[p])
+			continue;
+
+		clipHalfPlane(*in, *out, p / 2, bounds[p], (p % 2 == 0) ? 1. : -1.);
+		crossed = true;
+
+		in = out;
+		out = (out == &_buffer) ? &result : &_buffer;
+	}
+
+	if (!crossed)
+		result.assign(ring.begin(), ring.end());
+	else if (in != &result)
+		result.swap(_buffer);
+
+	// Consecutive duplicated points (vertices on the window border)
+	std::size_t n = 0;
+	for (std::size_t k = 0; k < result.size(); k++)
+	{
+		const TVec5d& v = result[k];
+		if (n > 0 && v.x == result[n - 1].x && v.y == result[n - 1].y && v.z == result[n - 1].z)
+			continue;
+		result[n++] = v;
+	}
+	while (n > 1 && result[n - 1].x == result[0].x && result[n - 1].y == result[0].y && result[n - 1].z == result[0].z)
+		n--;
+	result.resize(n);
+
+	return n >= 3;
+}
+
+void BoxClipper::clipHalfPlane(const MyVectorOfVertices& in, MyVectorOfVertices& out, int axis, double bound, double sign)
+{
+	out.clear();
+	std::size_t n = in.size();
+	if (n == 0)
+		return;
+
+	// Classification of all the vertices first, without branches
+	_distances.resize(n);
+	double* distances = _distances.data();
+	if (axis == 0)
+		for (std::size_t k = 0; k < n; k++)
+			distances[k] = sign * (in[k].x - bound);
+	else
+		for (std::size_t k = 0; k < n; k++)
+			distances[k] = sign * (in[k].y - bound);
+
+	for (std::size_t k = 0, prev = n - 1; k < n; prev = k++)
+	{
+		bool inside = distances[k] >= 0.;
+		bool prevInside = distances[prev] >= 0.;
+
+		if (inside != prevInside)
+		{
+			// Intersection of the edge with the border, the clipped coordinate is set exactly on it
+			const TVec5d& a = in[prev];
+			const TVec5d& b = in[k];
+			double t = distances[prev] / (distances[prev] - distances[k]);
+
+			TVec5d v(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z), a.U + t * (b.U - a.U), a.V + t * (b.V - a.V));
+			if (axis == 0)
+				v.x = bound;
+			else
+				v.y = bound;
+			out.push_back(v);
+		}
+
+		if (inside)
+			out.push_back(in[k]);
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef BOXCLIPPER_HPP
+#define BOXCLIPPER_HPP
+
+#include <vector>
+#include "Triangulate.hpp"
+
+// Sutherland-Hodgman clipping of 3D polygons with texture coordinates by an axis-aligned window :
+// the polygon is clipped successively by the half-planes x >= xmin, x <= xmax, y >= ymin and y <= ymax
+// (vertical prism of the window). Z and UV are interpolated along the clipped edges, which is exact for
+// planar polygons, and the corners of the window inside the polygon come out of two successive clips.
+//
+// Polygons are open rings of TVec5d (x, y, z, U, V), as expected by Triangulate::Process.
+// The buffers are reused from one polygon to the next : use one BoxClipper per thread.
+class BoxClipper
+{
+public:
+	BoxClipper();
+
+	void setBox(double xmin, double ymin, double xmax, double ymax);
+
+	// Clip ring into result (both without closing point). Points on the window border are kept,
+	// consecutive duplicated points are removed. Returns false if less than 3 points remain.
+	bool clip(const MyVectorOfVertices& ring, MyVectorOfVertices& result);
+
+private:
+	// Keep the part of in where sign * (coordinate axis - bound) >= 0
+	void clipHalfPlane(const MyVectorOfVertices& in, MyVectorOfVertices& out, int axis, double bound, double sign);
+
+	double _xmin;
+	double _ymin;
+	double _xmax;
+	double _ymax;
+
+	std::vector<double> _distances;	// signed distances of the vertices to the current half-plane
+	MyVectorOfVertices _buffer;
+};
+
+#endif // !BOXCLIPPER_HPP
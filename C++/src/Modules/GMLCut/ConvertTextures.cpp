@@ -4,21 +4,23 @@
 //  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
 
 #include "ConvertTextures.hpp"
+#include "../../CityModel/ImageMetadataCache.hpp"
 
-std::vector<TVec2f> ConvertGeoreferencedTextures(std::vector<TVec2f> texUV)
+std::vector<TVec2f> ConvertGeoreferencedTextures(const std::vector<TVec2f>& texUV, const std::string& imagePath)
 {
 	std::vector<TVec2f> texUV_Converted;
+	texUV_Converted.reserve(texUV.size());
 
-	float size_X;
-	float size_Y;
+	//Only the header of the image is read, once per image. If it cannot be read, we use the size of the images of the
+	//Lyon CityGML datasets (4096x4096)
+	int width, height;
+	if (!citygml::ImageMetadataCache::getInstance().getImageSize(imagePath, width, height))
+		width = height = 4096;
 
-	//Here, we should open the corresponding image file to read its dimension. However, it would take too much time for process 
-	//involving hundreds of files. That's why we choose here to set the value corresponding to Lyon CityGML datasets (4096x4096)
+	float size_X = (float)width;
+	float size_Y = (float)height;
 
-	size_X = 4096;
-	size_Y = 4096;
-
-	//In the same idea, we choose to not read jgw files that give information about the coordinates (fr.wikipedia.org/wiki/World_file)
+	//The texture coordinates were computed in pixels from the jgw files when parsing (fr.wikipedia.org/wiki/World_file, see Polygon::finish)
 	//In jgw file, the E is negative, which means that uv.y are negatives so we have to flip the y coordinate because of the orientation
 	//of the picture
 
@@ -14,9 +14,10 @@
 /**
 *	@brief Convert a vector of georeferenced texture coordinates to local textures coordinates (between 0 and 1)
 *  @param texUV : Input vector of georeferenced texture coordinates
+*  @param imagePath : Path of the texture image, its size is read from its header (once per image, see citygml::ImageMetadataCache)
 *  @return Vectr of local texture coordinates
 */
-std::vector<TVec2f> ConvertGeoreferencedTextures(std::vector<TVec2f> texUV);
+std::vector<TVec2f> ConvertGeoreferencedTextures(const std::vector<TVec2f>& texUV, const std::string& imagePath);
 
 
 #endif
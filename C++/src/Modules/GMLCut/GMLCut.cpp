@@ -1,5 +1,107 @@
 #include "GMLCut.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "../../CityModel/RTree.hpp"
+
+// Same text as std::to_string(value) + " ", without a temporary string
+static void appendCoordinate(std::string& list, double value)
+{
+	char buffer[64];
+	int size = snprintf(buffer, sizeof(buffer), "%f ", value);
+	list.append(buffer, size > 0 ? std::min<size_t>(size, sizeof(buffer) - 1) : 0);
+}
+
+// Rings checked natively by checkRing, longer rings are left to OGR / GEOS (the self-intersection test is quadratic)
+static const size_t MaxNativeRingSize = 256;
+
+enum RingCheck { RING_INVALID, RING_VALID, RING_UNCHECKED };
+
+// Orientation of c relative to the line (a, b) : > 0 on the left, < 0 on the right, 0 if aligned
+static double orientation(const TVec2d& a, const TVec2d& b, const TVec2d& c)
+{
+	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// c is on the segment [a, b], knowing it is aligned with it
+static bool onSegment(const TVec2d& a, const TVec2d& b, const TVec2d& c)
+{
+	return std::min(a.x, b.x) <= c.x && c.x <= std::max(a.x, b.x) && std::min(a.y, b.y) <= c.y && c.y <= std::max(a.y, b.y);
+}
+
+static bool segmentsIntersect(const TVec2d& a, const TVec2d& b, const TVec2d& c, const TVec2d& d)
+{
+	double o1 = orientation(a, b, c), o2 = orientation(a, b, d), o3 = orientation(c, d, a), o4 = orientation(c, d, b);
+	if (((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)) && ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0)))
+		return true;
+	return (o1 == 0 && onSegment(a, b, c)) || (o2 == 0 && onSegment(a, b, d)) || (o3 == 0 && onSegment(c, d, a)) || (o4 == 0 && onSegment(c, d, b));
+}
+
+// Planar (x, y) validity of a ring as a polygon (at least 3 distinct points, not flat, no self-intersection) and, when it is valid,
+// its area and centroid. Same result as the IsValid / Centroid of OGR, without building any geometry. The points are taken relative
+// to the first one, so that the orientation tests keep their precision with projected coordinates.
+static RingCheck checkRing(const std::vector<TVec3d>& vertices, std::vector<TVec2d>& points, double& area, TVec2d& centroid)
+{
+	if (vertices.size() > MaxNativeRingSize)
+		return RING_UNCHECKED;
+
+	// Open ring without consecutive duplicates
+	points.clear();
+	for (const TVec3d& v : vertices)
+	{
+		TVec2d p(v.x - vertices[0].x, v.y - vertices[0].y);
+		if (points.empty() || p.x != points.back().x || p.y != points.back().y)
+			points.push_back(p);
+	}
+	while (points.size() > 1 && points.back().x == points.front().x && points.back().y == points.front().y)
+		points.pop_back();
+
+	size_t n = points.size();
+	if (n < 3)
+		return RING_INVALID;
+
+	// Shoelace area and centroid
+	double a2 = 0., cx = 0., cy = 0.;
+	for (size_t i = 0; i < n; i++)
+	{
+		const TVec2d& p = points[i];
+		const TVec2d& q = points[(i + 1) % n];
+		double cross = p.x * q.y - q.x * p.y;
+		a2 += cross;
+		cx += (p.x + q.x) * cross;
+		cy += (p.y + q.y) * cross;
+	}
+	if (a2 == 0.)
+		return RING_INVALID;
+
+	// Non adjacent edges must not touch, adjacent edges must not fold back on each other
+	for (size_t i = 0; i < n; i++)
+	{
+		const TVec2d& a = points[i];
+		const TVec2d& b = points[(i + 1) % n];
+		const TVec2d& c = points[(i + 2) % n];
+		if (orientation(a, b, c) == 0 && (b.x - a.x) * (c.x - b.x) + (b.y - a.y) * (c.y - b.y) < 0)
+			return RING_INVALID;
+
+		for (size_t j = i + 2; j < n; j++)
+		{
+			if (i == 0 && j == n - 1)
+				continue; // adjacent through the closing point
+			if (segmentsIntersect(a, b, points[j], points[(j + 1) % n]))
+				return RING_INVALID;
+		}
+	}
+
+	area = std::fabs(a2) / 2.;
+	centroid = TVec2d(cx / (3. * a2) + vertices[0].x, cy / (3. * a2) + vertices[0].y);
+	return RING_VALID;
+}
+
 GMLCut::GMLCut(std::string name) : Module(name)
 {
 }
@@ -8,405 +110,410 @@ GMLCut::GMLCut(std::string name) : Module(name)
 /**
 * @brief Decoupe le fichier CityGML en un ensemble de tuiles dont la taille est definie en entree. Les geometries sont ici assignees a une tuile selon leur centre de gravite.
 * @param model : Contient les donnees du fichier CityGML ouvert : il doit contenir un ensemble de batiments LOD2 ou du terrain
-* @param texturesList : La fonction va remplir ce vector avec tous les appels de texture qu'il faudra enregistrer dans le CityGML en sortie;
+* @param texturesList : La fonction va remplir cette liste avec tous les appels de texture qu'il faudra enregistrer dans le CityGML en sortie (une texture par URL);
 * @param minTile : Coordonnee du coin bas gauche de la tuile
 * @param maxTile : Coordonnee du coin haut droit de la tuile
 */
-citygml::CityModel * GMLCut::assign(citygml::CityModel * model, std::vector<TextureCityGML*>* texturesList, TVec2d minTile, TVec2d maxTile, std::string pathFolder)
+citygml::CityModel * GMLCut::assign(citygml::CityModel * model, TexturesCityGML* texturesList, TVec2d minTile, TVec2d maxTile, std::string pathFolder)
 {
 	citygml::CityModel* Tuile = new citygml::CityModel();
 
-	OGRPolygon* PolyTile = (OGRPolygon*)OGRGeometryFactory::createGeometry(wkbPolygon);
-	OGRLinearRing* RingTile = (OGRLinearRing*)OGRGeometryFactory::createGeometry(wkbLinearRing);
-	RingTile->addPoint(minTile.x, minTile.y);
-	RingTile->addPoint(minTile.x, maxTile.y);
-	RingTile->addPoint(maxTile.x, maxTile.y);
-	RingTile->addPoint(maxTile.x, minTile.y);
-	RingTile->addPoint(minTile.x, minTile.y);
-	PolyTile->addRing(RingTile);
+	// Only the objects whose envelope intersects the tile can have their centroid in it
+	citygml::Envelope tileEnvelope(TVec3d(minTile.x, minTile.y, -DBL_MAX), TVec3d(maxTile.x, maxTile.y, DBL_MAX));
 
-	for (citygml::CityObject* obj : model->getCityObjectsRoots())
+	assignObjects(model->query(tileEnvelope), model->m_basePath, [&](const TVec2d& centroid, TexturesCityGML*& textures) -> citygml::CityModel*
 	{
-		if (obj->getType() == citygml::COT_TINRelief || obj->getType() == citygml::COT_WaterBody)
+		if (centroid.x < minTile.x || centroid.x > maxTile.x || centroid.y < minTile.y || centroid.y > maxTile.y) //Si le centroid n'est pas dans la tuile courante, on passe a la suivante.
+			return nullptr;
+		textures = texturesList;
+		return Tuile;
+	}, [&](const TVec2d& lower, const TVec2d& upper) -> bool
+	{
+		bool inside = lower.x >= minTile.x && upper.x <= maxTile.x && lower.y >= minTile.y && upper.y <= maxTile.y;
+		bool outside = upper.x < minTile.x || lower.x > maxTile.x || upper.y < minTile.y || lower.y > maxTile.y;
+		return !inside && !outside;
+	});
+
+	return Tuile;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::map<std::pair<int, int>, citygml::CityModel*> GMLCut::assignTiles(citygml::CityModel* model, std::map<std::pair<int, int>, TexturesCityGML>* texturesLists, TVec2d origin, TVec2d tileSize, const std::set<std::pair<int, int>>* only)
+{
+	std::map<std::pair<int, int>, citygml::CityModel*> tiles;
+
+	// A centroid lies in the envelope of its object : the objects of a tile overlap it
+	citygml::CityObjects objects;
+	if (only)
+	{
+		std::set<citygml::CityObject*> found;
+		for (const std::pair<int, int>& index : *only)
 		{
-			std::string Name = obj->getId();
-			citygml::CityObject* TIN_CO = nullptr;
-			if (obj->getType() == citygml::COT_TINRelief)
-				TIN_CO = new citygml::TINRelief(Name);
-			else if (obj->getType() == citygml::COT_WaterBody)
-				TIN_CO = new citygml::WaterBody(Name);
+			citygml::Envelope tile(TVec3d(origin.x + index.first * tileSize.x, origin.y + index.second * tileSize.y, -DBL_MAX),
+				TVec3d(origin.x + (index.first + 1) * tileSize.x, origin.y + (index.second + 1) * tileSize.y, DBL_MAX));
+			for (citygml::CityObject* obj : model->query(tile))
+				if (found.insert(obj).second)
+					objects.push_back(obj);
+		}
+	}
+	const citygml::CityObjects& roots = only ? objects : model->getCityObjectsRoots();
+
+	// Each centroid is computed once and goes to exactly one tile
+	assignObjects(roots, model->m_basePath, [&](const TVec2d& centroid, TexturesCityGML*& textures) -> citygml::CityModel*
+	{
+		std::pair<int, int> index((int)std::floor((centroid.x - origin.x) / tileSize.x), (int)std::floor((centroid.y - origin.y) / tileSize.y));
+		if (only && !only->count(index))
+			return nullptr;
+
+		textures = &(*texturesLists)[index];
+		citygml::CityModel*& tile = tiles[index];
+		if (!tile)
+			tile = new citygml::CityModel();
+		return tile;
+	}, [&](const TVec2d& lower, const TVec2d& upper) -> bool
+	{
+		return std::floor((lower.x - origin.x) / tileSize.x) != std::floor((upper.x - origin.x) / tileSize.x)
+			|| std::floor((lower.y - origin.y) / tileSize.y) != std::floor((upper.y - origin.y) / tileSize.y);
+	});
+
+	return tiles;
+}
 
-			citygml::Geometry* TIN = new citygml::Geometry(Name, citygml::GT_Unknown, 2);
+////////////////////////////////////////////////////////////////////////////////
+void GMLCut::assignObjects(const citygml::CityObjects& objects, const std::string& basePath, const std::function<citygml::CityModel*(const TVec2d&, TexturesCityGML*&)>& tileOf, const std::function<bool(const TVec2d&, const TVec2d&)>& straddles)
+{
+	for (citygml::CityObject* obj : objects)
+	{
+		TexturesCityGML* texturesList = nullptr;
+		TVec2d centroid;
+
+		if (obj->getType() == citygml::COT_TINRelief || obj->getType() == citygml::COT_WaterBody)
+		{
+			// Terrain and water are assigned polygon by polygon : one TIN geometry per receiving tile
+			std::vector<std::pair<citygml::CityModel*, citygml::Geometry*>> tins;
 
 			for (citygml::Geometry* Geometry : obj->getGeometries())
 			{
 				for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons())
 				{
-					OGRLinearRing * OgrRing = (OGRLinearRing*)OGRGeometryFactory::createGeometry(wkbLinearRing);
-					for (TVec3d Point : PolygonCityGML->getExteriorRing()->getVertices())
-						OgrRing->addPoint(Point.x, Point.y, Point.z);
-
-					OgrRing->closeRings();
-
-					if (OgrRing->getNumPoints() < 4)
-					{
-						OGRGeometryFactory::destroyGeometry(OgrRing);
+					// A merged polygon (see Geometry::mergePolygons) goes as a whole, at the centroid of the polygons it keeps
+					const std::vector<citygml::Polygon*>& merged = PolygonCityGML->getMergedPolygons();
+					if (merged.empty() ? !computePolygonCentroid(PolygonCityGML, centroid)
+						: !computeFootprintCentroid(std::vector<const citygml::Polygon*>(merged.begin(), merged.end()), straddles, centroid))
 						continue;
-					}
 
-					OGRPolygon * OgrPoly = (OGRPolygon*)OGRGeometryFactory::createGeometry(wkbPolygon);
-					OgrPoly->addRingDirectly(OgrRing);
-					if (!OgrPoly->IsValid())
-					{
-						OGRGeometryFactory::destroyGeometry(OgrPoly);
+					citygml::CityModel* tile = tileOf(centroid, texturesList);
+					if (!tile)
 						continue;
-					}
-
-					OGRPoint* Centroid = (OGRPoint*)OGRGeometryFactory::createGeometry(wkbPoint);
-					OgrPoly->Centroid(Centroid);
 
-					if (Centroid == nullptr || Centroid->getX() < minTile.x || Centroid->getX() > maxTile.x || Centroid->getY() < minTile.y || Centroid->getY() > maxTile.y) //Si le centroid n'est pas dans la tuile courante, on passe a la suivante.
+					citygml::Geometry* TIN = nullptr;
+					for (const std::pair<citygml::CityModel*, citygml::Geometry*>& tin : tins)
+						if (tin.first == tile)
+							TIN = tin.second;
+					if (!TIN)
 					{
-						OGRGeometryFactory::destroyGeometry(OgrPoly);
-						OGRGeometryFactory::destroyGeometry(Centroid);
-						continue;
-					}
-					OGRGeometryFactory::destroyGeometry(Centroid);
-					OGRGeometryFactory::destroyGeometry(OgrPoly);
-
-					std::vector<TVec2f> TexUV = PolygonCityGML->getTexCoords();
-
-					bool HasTexture = (PolygonCityGML->getTexture() != nullptr);
-
-					if (HasTexture && PolygonCityGML->getTexture()->getType() == "GeoreferencedTexture") //Ce sont des coordonnees georeferences qu'il faut convertir en coordonnees de texture standard
-						TexUV = ConvertGeoreferencedTextures(TexUV);
-
-					std::string Url;
-					citygml::Texture::WrapMode WrapMode;
-					if (HasTexture)
-					{
-						Url = PolygonCityGML->getTexture()->getUrl();
-						WrapMode = PolygonCityGML->getTexture()->getWrapMode();
+						TIN = new citygml::Geometry(obj->getId(), citygml::GT_Unknown, 2);
+						tins.push_back(std::make_pair(tile, TIN));
 					}
 
-					citygml::Polygon* pol = new citygml::Polygon(*PolygonCityGML);
-					TIN->addPolygon(pol);
-
-					if (HasTexture)
-					{
-						TexturePolygonCityGML Poly;
-
-						Poly.Id = PolygonCityGML->getId();
-						Poly.IdRing = PolygonCityGML->getExteriorRing()->getId();
-						Poly.TexUV = TexUV;
+					TIN->addPolygon(new citygml::Polygon(*PolygonCityGML));
 
-						bool URLTest = false;//Permet de dire si l'URL existe deja dans TexturesList ou non. Si elle n'existe pas, il faut creer un nouveau TextureCityGML pour la stocker.
-						for (TextureCityGML* Tex : *texturesList)
-						{
-							if (Tex->Url == Url)
-							{
-								URLTest = true;
-								Tex->ListPolygons.push_back(Poly);
-								break;
-							}
-						}
-						if (!URLTest)
-						{
-							TextureCityGML* Texture = new TextureCityGML;
-							Texture->Wrap = WrapMode;
-							Texture->Url = Url;
-							Texture->ListPolygons.push_back(Poly);
-							texturesList->push_back(Texture);
-						}
-					}
+					if (PolygonCityGML->getTexture() && PolygonCityGML->getTexture()->getType() == "GeoreferencedTexture") //Ce sont des coordonnees georeferences qu'il faut convertir en coordonnees de texture standard
+						addTexture(PolygonCityGML, ConvertGeoreferencedTextures(PolygonCityGML->getTexCoords(), basePath + PolygonCityGML->getTexture()->getUrl()), texturesList);
+					else
+						addTexture(PolygonCityGML, PolygonCityGML->getTexCoords(), texturesList);
 				}
 			}
 
-			if (TIN->getPolygons().size() > 0)
+			for (const std::pair<citygml::CityModel*, citygml::Geometry*>& tin : tins)
 			{
-				TIN_CO->addGeometry(TIN);
-				Tuile->addCityObject(TIN_CO);
-				Tuile->addCityObjectAsRoot(TIN_CO);
+				citygml::CityObject* TIN_CO = nullptr;
+				if (obj->getType() == citygml::COT_TINRelief)
+					TIN_CO = new citygml::TINRelief(obj->getId());
+				else
+					TIN_CO = new citygml::WaterBody(obj->getId());
+
+				TIN_CO->addGeometry(tin.second);
+				tin.first->addCityObject(TIN_CO);
+				tin.first->addCityObjectAsRoot(TIN_CO);
 			}
 		}
 		else if (obj->getType() == citygml::COT_Building)
 		{
 			std::string Name = obj->getId();
-			citygml::CityObject* BuildingCO = new citygml::Building(Name);
-			citygml::CityObject* RoofCO = new citygml::RoofSurface(Name + "_Roof");
-			citygml::Geometry* Roof = new citygml::Geometry(Name + "_RoofGeometry", citygml::GT_Roof, 2);
-			citygml::CityObject* WallCO = new citygml::WallSurface(Name + "_Wall");
-			citygml::Geometry* Wall = new citygml::Geometry(Name + "_WallGeometry", citygml::GT_Wall, 2);
-			citygml::CityObject* GroundCO = new citygml::GroundSurface(Name + "_Ground");
-			citygml::Geometry* Ground = new citygml::Geometry(Name + "_GroundGeometry", citygml::GT_Ground, 2);
-
-			OGRMultiPolygon* Building = (OGRMultiPolygon*)OGRGeometryFactory::createGeometry(wkbMultiPolygon);//Version OGR du batiment qui va etre remplie
 
 			// Not very elegant ... (seen only in 'LYON_1ER_BATI_2015.gml' Building with one BuildingPart)
-			if (obj->getChildren().at(0)->getType() == citygml::COT_BuildingPart) {
+			if (!obj->getChildren().empty() && obj->getChildren().at(0)->getType() == citygml::COT_BuildingPart) {
 				obj = obj->getChildren().at(0);
 			}
-			for (citygml::CityObject* object : obj->getChildren())//On parcourt les objets (Wall, Roof, ...) du batiment
-			{
+
+			// The building is assigned according to the centroid of its roofs footprint
+			std::vector<const citygml::Polygon*> roofs;
+			for (citygml::CityObject* object : obj->getChildren())
 				if (object->getType() == citygml::COT_RoofSurface)
-				{
-					for (citygml::Geometry* Geometry : object->getGeometries()) //pour chaque geometrie
+					for (citygml::Geometry* Geometry : object->getGeometries())
 					{
-						for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons()) //Pour chaque polygone
-						{
-							OGRLinearRing * OgrRing = (OGRLinearRing*)OGRGeometryFactory::createGeometry(wkbLinearRing);
-							for (TVec3d Point : PolygonCityGML->getExteriorRing()->getVertices())
-								OgrRing->addPoint(Point.x, Point.y, Point.z);
-
-							OgrRing->closeRings();
-							if (OgrRing->getNumPoints() > 3)
-							{
-								OGRPolygon* OgrPoly = (OGRPolygon*)OGRGeometryFactory::createGeometry(wkbPolygon);
-								OgrPoly->addRingDirectly(OgrRing);
-								if (OgrPoly->IsValid())
-								{
-									Building->addGeometryDirectly(OgrPoly);
-								}
-							}
-							else
-								OGRGeometryFactory::destroyGeometry(OgrRing);
-						}
+						std::vector<citygml::Polygon*> parsed = Geometry->getParsedPolygons();
+						roofs.insert(roofs.end(), parsed.begin(), parsed.end());
 					}
-				}
-			}
 
-			if (Building->IsEmpty())
+			if (!computeFootprintCentroid(roofs, straddles, centroid))
 				continue;
 
-			OGRMultiPolygon * Enveloppe = GetEnveloppe(Building);
-
-			if (Enveloppe->IsEmpty() || !Enveloppe->IsValid())
+			citygml::CityModel* tile = tileOf(centroid, texturesList);
+			if (tile)
+				assignBuilding(tile, Name, obj, texturesList);
+		}
+		else if (obj->getType() == citygml::COT_Bridge)
+		{
+			// For Bridge node type, we go through Geometries directly
+			std::vector<const citygml::Polygon*> polygons;
+			for (citygml::Geometry* Geometry : obj->getGeometries())
 			{
-				OGRGeometryFactory::destroyGeometry(Enveloppe);
-				continue;
+				std::vector<citygml::Polygon*> parsed = Geometry->getParsedPolygons();
+				polygons.insert(polygons.end(), parsed.begin(), parsed.end());
 			}
-			
-			OGRPoint* Centroid = (OGRPoint*)OGRGeometryFactory::createGeometry(wkbPoint);
-			Enveloppe->Centroid(Centroid);
-			if (Centroid->getX() < minTile.x || Centroid->getX() > maxTile.x || Centroid->getY() < minTile.y || Centroid->getY() > maxTile.y) //Si le centroid n'est pas dans la tuile courante, on passe a la suivante.
-			{
-				OGRGeometryFactory::destroyGeometry(Enveloppe);
-				OGRGeometryFactory::destroyGeometry(Centroid);
+
+			if (!computeFootprintCentroid(polygons, straddles, centroid))
 				continue;
-			}
-			OGRGeometryFactory::destroyGeometry(Centroid);
-			OGRGeometryFactory::destroyGeometry(Enveloppe);
 
-			for (citygml::CityObject* object : obj->getChildren())//On parcourt les objets (Wall, Roof, ...) du batiment
-			{
-				for (citygml::Geometry* Geometry : object->getGeometries()) //pour chaque geometrie
-				{
-					for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons()) //Pour chaque polygone
-					{
-						std::vector<TVec2f> TexUV = PolygonCityGML->getTexCoords();
+			citygml::CityModel* tile = tileOf(centroid, texturesList);
+			if (tile)
+				assignBridge(tile, obj, texturesList);
+		}
+	}
+}
 
-						bool HasTexture = (PolygonCityGML->getTexture() != nullptr);
+////////////////////////////////////////////////////////////////////////////////
+bool GMLCut::computePolygonCentroid(const citygml::Polygon* polygon, TVec2d& centroid)
+{
+	double area;
+	RingCheck check = checkRing(polygon->getExteriorRing()->getVertices(), _ringPoints, area, centroid);
+	if (check != RING_UNCHECKED)
+		return check == RING_VALID;
 
-						std::string Url;
-						citygml::Texture::WrapMode WrapMode;
-						if (HasTexture)
-						{
-							Url = PolygonCityGML->getTexture()->getUrl();
-							WrapMode = PolygonCityGML->getTexture()->getWrapMode();
-						}
+	OGRLinearRing * OgrRing = (OGRLinearRing*)OGRGeometryFactory::createGeometry(wkbLinearRing);
+	for (const TVec3d& Point : polygon->getExteriorRing()->getVertices())
+		OgrRing->addPoint(Point.x, Point.y, Point.z);
 
-						if (object->getType() == citygml::COT_RoofSurface) {
+	OgrRing->closeRings();
 
-							citygml::Polygon* pol = new citygml::Polygon(*PolygonCityGML);
-							Roof->addPolygon(pol);
-						}
+	if (OgrRing->getNumPoints() < 4)
+	{
+		OGRGeometryFactory::destroyGeometry(OgrRing);
+		return false;
+	}
 
-						else if (object->getType() == citygml::COT_WallSurface) {
-							citygml::Polygon* pol = new citygml::Polygon(*PolygonCityGML);
-							Wall->addPolygon(pol);
-						}
-						else if (object->getType() == citygml::COT_GroundSurface) {
-							citygml::Polygon* pol = new citygml::Polygon(*PolygonCityGML);
-							Ground->addPolygon(pol);
-						}
+	OGRPolygon * OgrPoly = (OGRPolygon*)OGRGeometryFactory::createGeometry(wkbPolygon);
+	OgrPoly->addRingDirectly(OgrRing);
 
-						if (HasTexture)
-						{
-							TexturePolygonCityGML Poly;
+	bool valid = OgrPoly->IsValid();
+	if (valid)
+	{
+		OGRPoint Centroid;
+		valid = (OgrPoly->Centroid(&Centroid) == OGRERR_NONE);
+		centroid = TVec2d(Centroid.getX(), Centroid.getY());
+	}
 
-							Poly.Id = PolygonCityGML->getId();
-							Poly.IdRing = PolygonCityGML->getExteriorRing()->getId();
-							Poly.TexUV = TexUV;
+	OGRGeometryFactory::destroyGeometry(OgrPoly);
+	return valid;
+}
 
-							bool URLTest = false;//Permet de dire si l'URL existe deja dans texturesList ou non. Si elle n'existe pas, il faut creer un nouveau TextureCityGML pour la stocker.
-							for (TextureCityGML* Tex : *texturesList)
-							{
-								if (Tex->Url == Url)
-								{
-									URLTest = true;
-									Tex->ListPolygons.push_back(Poly);
-									break;
-								}
-							}
-							if (!URLTest)
-							{
-								TextureCityGML* Texture = new TextureCityGML;
-								Texture->Wrap = WrapMode;
-								Texture->Url = Url;
-								Texture->ListPolygons.push_back(Poly);
-								texturesList->push_back(Texture);
-							}
-						}
-					}
-				}
-			}
-			bool test = false;
-			if (Roof->getPolygons().size() > 0)
-			{
-				RoofCO->addGeometry(Roof);
-				Tuile->addCityObject(RoofCO);
-				BuildingCO->insertNode(RoofCO);
-				test = true;
-			}
-			if (Wall->getPolygons().size() > 0)
-			{
-				WallCO->addGeometry(Wall);
-				Tuile->addCityObject(WallCO);
-				BuildingCO->insertNode(WallCO);
-				test = true;
-			}
-			if (Ground->getPolygons().size() > 0)
-			{
-				GroundCO->addGeometry(Ground);
-				Tuile->addCityObject(GroundCO);
-				BuildingCO->insertNode(GroundCO);
-				test = true;
-			}
-			if (test)
-			{
-				Tuile->addCityObject(BuildingCO);
-				Tuile->addCityObjectAsRoot(BuildingCO);
-			}
+////////////////////////////////////////////////////////////////////////////////
+bool GMLCut::computeFootprintCentroid(const std::vector<const citygml::Polygon*>& polygons, const std::function<bool(const TVec2d&, const TVec2d&)>& straddles, TVec2d& centroid)
+{
+	// Native fast path : area weighted centroid of the valid polygons. It is the centroid of their union when they do not overlap,
+	// and in any case a point of their bounding box : if the box is in a single tile, it gives the right tile.
+	bool native = true;
+	double totalArea = 0.;
+	TVec2d sum(0., 0.);
+	TVec2d lower(DBL_MAX, DBL_MAX), upper(-DBL_MAX, -DBL_MAX);
+	for (const citygml::Polygon * PolygonCityGML : polygons)
+	{
+		double area;
+		TVec2d polygonCentroid;
+		RingCheck check = checkRing(PolygonCityGML->getExteriorRing()->getVertices(), _ringPoints, area, polygonCentroid);
+		if (check == RING_UNCHECKED)
+		{
+			native = false;
+			break;
 		}
-		else if (obj->getType() == citygml::COT_Bridge) {
-			std::string Name = obj->getId();
-			citygml::CityObject* BridgeCO = new citygml::Bridge(Name);
-			citygml::Geometry* BridgeGeo = new citygml::Geometry(Name + "_BridgeGeometry", citygml::GT_Unknown, 2);
+		if (check == RING_INVALID)
+			continue;
 
-			OGRMultiPolygon* Bridge = (OGRMultiPolygon*)OGRGeometryFactory::createGeometry(wkbMultiPolygon);//Version OGR du batiment qui va etre remplie
+		totalArea += area;
+		sum = sum + polygonCentroid * area;
+		for (const TVec3d& Point : PolygonCityGML->getExteriorRing()->getVertices())
+		{
+			lower.x = std::min(lower.x, Point.x); lower.y = std::min(lower.y, Point.y);
+			upper.x = std::max(upper.x, Point.x); upper.y = std::max(upper.y, Point.y);
+		}
+	}
+	if (native)
+	{
+		if (totalArea == 0.)
+			return false;
+		if (!straddles(lower, upper))
+		{
+			centroid = sum / totalArea;
+			return true;
+		}
+	}
 
-			// For Bridge node type, we go through Geometries directly
-			for (citygml::Geometry* Geometry : obj->getGeometries()) //pour chaque geometrie
-			{
-				for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons()) //Pour chaque polygone
-				{
-					OGRLinearRing * OgrRing = (OGRLinearRing*)OGRGeometryFactory::createGeometry(wkbLinearRing);
-					for (TVec3d Point : PolygonCityGML->getExteriorRing()->getVertices())
-						OgrRing->addPoint(Point.x, Point.y, Point.z);
+	// The footprint straddles a tile border : exact centroid of the union of the polygons
+	OGRMultiPolygon* Footprint = (OGRMultiPolygon*)OGRGeometryFactory::createGeometry(wkbMultiPolygon);
 
-					OgrRing->closeRings();
-					if (OgrRing->getNumPoints() > 3)
-					{
-						OGRPolygon* OgrPoly = (OGRPolygon*)OGRGeometryFactory::createGeometry(wkbPolygon);
-						OgrPoly->addRingDirectly(OgrRing);
-						if (OgrPoly->IsValid())
-						{
-							Bridge->addGeometryDirectly(OgrPoly);
-						}
-					}
-					else
-						OGRGeometryFactory::destroyGeometry(OgrRing);
-				}
-			}
+	for (const citygml::Polygon * PolygonCityGML : polygons)
+	{
+		OGRLinearRing * OgrRing = (OGRLinearRing*)OGRGeometryFactory::createGeometry(wkbLinearRing);
+		for (const TVec3d& Point : PolygonCityGML->getExteriorRing()->getVertices())
+			OgrRing->addPoint(Point.x, Point.y, Point.z);
 
-			if (Bridge->IsEmpty())
-				continue;
+		OgrRing->closeRings();
+		if (OgrRing->getNumPoints() > 3)
+		{
+			OGRPolygon* OgrPoly = (OGRPolygon*)OGRGeometryFactory::createGeometry(wkbPolygon);
+			OgrPoly->addRingDirectly(OgrRing);
+			if (OgrPoly->IsValid())
+				Footprint->addGeometryDirectly(OgrPoly);
+			else
+				OGRGeometryFactory::destroyGeometry(OgrPoly);
+		}
+		else
+			OGRGeometryFactory::destroyGeometry(OgrRing);
+	}
 
-			OGRMultiPolygon * Enveloppe = GetEnveloppe(Bridge);
+	if (Footprint->IsEmpty())
+	{
+		OGRGeometryFactory::destroyGeometry(Footprint);
+		return false;
+	}
 
-			if (Enveloppe->IsEmpty() || !Enveloppe->IsValid())
-			{
-				OGRGeometryFactory::destroyGeometry(Enveloppe);
-				continue;
-			}
+	OGRMultiPolygon * Enveloppe = GetEnveloppe(Footprint);
+	OGRGeometryFactory::destroyGeometry(Footprint);
 
-			OGRPoint* Centroid = (OGRPoint*)OGRGeometryFactory::createGeometry(wkbPoint);
-			Enveloppe->Centroid(Centroid);
-			if (Centroid->getX() < minTile.x || Centroid->getX() > maxTile.x || Centroid->getY() < minTile.y || Centroid->getY() > maxTile.y) //Si le centroid n'est pas dans la tuile courante, on passe a la suivante.
-			{
-				OGRGeometryFactory::destroyGeometry(Enveloppe);
-				OGRGeometryFactory::destroyGeometry(Centroid);
-				continue;
-			}
-			OGRGeometryFactory::destroyGeometry(Centroid);
+	if (Enveloppe == nullptr || Enveloppe->IsEmpty() || !Enveloppe->IsValid())
+	{
+		if (Enveloppe)
 			OGRGeometryFactory::destroyGeometry(Enveloppe);
+		return false;
+	}
 
-			for (citygml::Geometry* Geometry : obj->getGeometries()) //pour chaque geometrie
-			{
-				for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons()) //Pour chaque polygone
-				{
-					std::vector<TVec2f> TexUV = PolygonCityGML->getTexCoords();
+	OGRPoint Centroid;
+	bool valid = (Enveloppe->Centroid(&Centroid) == OGRERR_NONE);
+	centroid = TVec2d(Centroid.getX(), Centroid.getY());
 
-					bool HasTexture = (PolygonCityGML->getTexture() != nullptr);
+	OGRGeometryFactory::destroyGeometry(Enveloppe);
+	return valid;
+}
 
-					std::string Url;
-					citygml::Texture::WrapMode WrapMode;
-					if (HasTexture)
-					{
-						Url = PolygonCityGML->getTexture()->getUrl();
-						WrapMode = PolygonCityGML->getTexture()->getWrapMode();
-					}
+////////////////////////////////////////////////////////////////////////////////
+void GMLCut::assignBuilding(citygml::CityModel* tile, const std::string& Name, const citygml::CityObject* obj, TexturesCityGML* texturesList)
+{
+	citygml::Geometry* Roof = new citygml::Geometry(Name + "_RoofGeometry", citygml::GT_Roof, 2);
+	citygml::Geometry* Wall = new citygml::Geometry(Name + "_WallGeometry", citygml::GT_Wall, 2);
+	citygml::Geometry* Ground = new citygml::Geometry(Name + "_GroundGeometry", citygml::GT_Ground, 2);
 
-					citygml::Polygon* pol = new citygml::Polygon(*PolygonCityGML);
-					BridgeGeo->addPolygon(pol);
+	for (citygml::CityObject* object : obj->getChildren())//On parcourt les objets (Wall, Roof, ...) du batiment
+	{
+		for (citygml::Geometry* Geometry : object->getGeometries()) //pour chaque geometrie
+		{
+			for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons()) //Pour chaque polygone
+			{
+				if (object->getType() == citygml::COT_RoofSurface)
+					Roof->addPolygon(new citygml::Polygon(*PolygonCityGML));
+				else if (object->getType() == citygml::COT_WallSurface)
+					Wall->addPolygon(new citygml::Polygon(*PolygonCityGML));
+				else if (object->getType() == citygml::COT_GroundSurface)
+					Ground->addPolygon(new citygml::Polygon(*PolygonCityGML));
 
-					if (HasTexture)
-					{
-						TexturePolygonCityGML Poly;
+				addTexture(PolygonCityGML, PolygonCityGML->getTexCoords(), texturesList);
+			}
+		}
+	}
 
-						Poly.Id = PolygonCityGML->getId();
-						Poly.IdRing = PolygonCityGML->getExteriorRing()->getId();
-						Poly.TexUV = TexUV;
+	citygml::CityObject* BuildingCO = new citygml::Building(Name);
+	bool test = false;
+	if (Roof->getPolygons().size() > 0)
+	{
+		citygml::CityObject* RoofCO = new citygml::RoofSurface(Name + "_Roof");
+		RoofCO->addGeometry(Roof);
+		tile->addCityObject(RoofCO);
+		BuildingCO->insertNode(RoofCO);
+		test = true;
+	}
+	else
+		delete Roof;
+	if (Wall->getPolygons().size() > 0)
+	{
+		citygml::CityObject* WallCO = new citygml::WallSurface(Name + "_Wall");
+		WallCO->addGeometry(Wall);
+		tile->addCityObject(WallCO);
+		BuildingCO->insertNode(WallCO);
+		test = true;
+	}
+	else
+		delete Wall;
+	if (Ground->getPolygons().size() > 0)
+	{
+		citygml::CityObject* GroundCO = new citygml::GroundSurface(Name + "_Ground");
+		GroundCO->addGeometry(Ground);
+		tile->addCityObject(GroundCO);
+		BuildingCO->insertNode(GroundCO);
+		test = true;
+	}
+	else
+		delete Ground;
 
-						bool URLTest = false;//Permet de dire si l'URL existe deja dans texturesList ou non. Si elle n'existe pas, il faut creer un nouveau TextureCityGML pour la stocker.
-						for (TextureCityGML* Tex : *texturesList)
-						{
-							if (Tex->Url == Url)
-							{
-								URLTest = true;
-								Tex->ListPolygons.push_back(Poly);
-								break;
-							}
-						}
-						if (!URLTest)
-						{
-							TextureCityGML* Texture = new TextureCityGML;
-							Texture->Wrap = WrapMode;
-							Texture->Url = Url;
-							Texture->ListPolygons.push_back(Poly);
-							texturesList->push_back(Texture);
-						}
-					}
-				}
-			}
-			bool test = false;
-			if (BridgeGeo->getPolygons().size() > 0)
-			{
-				BridgeCO->addGeometry(BridgeGeo);
-				Tuile->addCityObject(BridgeCO);
-				test = true;
-			}
-			if (test)
-			{
-				Tuile->addCityObject(BridgeCO);
-				Tuile->addCityObjectAsRoot(BridgeCO);
-			}
+	if (test)
+	{
+		tile->addCityObject(BuildingCO);
+		tile->addCityObjectAsRoot(BuildingCO);
+	}
+	else
+		delete BuildingCO;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GMLCut::assignBridge(citygml::CityModel* tile, const citygml::CityObject* obj, TexturesCityGML* texturesList)
+{
+	std::string Name = obj->getId();
+	citygml::Geometry* BridgeGeo = new citygml::Geometry(Name + "_BridgeGeometry", citygml::GT_Unknown, 2);
+
+	for (citygml::Geometry* Geometry : obj->getGeometries()) //pour chaque geometrie
+	{
+		for (citygml::Polygon * PolygonCityGML : Geometry->getPolygons()) //Pour chaque polygone
+		{
+			BridgeGeo->addPolygon(new citygml::Polygon(*PolygonCityGML));
+			addTexture(PolygonCityGML, PolygonCityGML->getTexCoords(), texturesList);
 		}
 	}
 
-	OGRGeometryFactory::destroyGeometry(PolyTile);
+	if (BridgeGeo->getPolygons().size() > 0)
+	{
+		citygml::CityObject* BridgeCO = new citygml::Bridge(Name);
+		BridgeCO->addGeometry(BridgeGeo);
+		tile->addCityObject(BridgeCO);
+		tile->addCityObjectAsRoot(BridgeCO);
+	}
+	else
+		delete BridgeGeo;
+}
 
-	return Tuile;
+////////////////////////////////////////////////////////////////////////////////
+void GMLCut::addTexture(const citygml::Polygon* PolygonCityGML, std::vector<TVec2f> TexUV, TexturesCityGML* texturesList)
+{
+	if (PolygonCityGML->getTexture() == nullptr)
+		return;
+
+	//Si l'URL existe deja dans texturesList, le polygone s'ajoute a cette texture
+	TextureCityGML& Texture = texturesList->get(PolygonCityGML->getTexture()->getUrl(), PolygonCityGML->getTexture()->getWrapMode());
+
+	Texture.ListPolygons.push_back(TexturePolygonCityGML());
+	TexturePolygonCityGML& Poly = Texture.ListPolygons.back();
+	Poly.Id = PolygonCityGML->getId();
+	Poly.IdRing = PolygonCityGML->getExteriorRing() ? PolygonCityGML->getExteriorRing()->getId() : "";
+	Poly.TexUV = std::move(TexUV);
 }
 
 void GMLCut::cut(std::string & filename, double xmin, double ymin, double xmax, double ymax, std::string outputLocation)
@@ -423,13 +530,97 @@ void GMLCut::cut(std::string & filename, double xmin, double ymin, double xmax,
 	std::cout << "[GML CUT MODULE]..........................[END]" << std::endl;
 }
 
-int GMLCut::run(std::string & filename, double xmin, double ymin, double xmax, double ymax, std::string outputLocation)
+void GMLCut::cut(std::string & filename, const std::vector<CUT_WINDOW>& windows, std::string outputFolder)
+{
+	std::cout << "[GML CUT MODULE]..........................[START]" << std::endl;
+	std::cout << "\t [FILENAME]........................[" << filename << "]" << std::endl;
+	std::cout << "\t [WINDOWS].........................[" << windows.size() << "]" << std::endl;
+
+	if (outputFolder.empty())
+		outputFolder = "gmlcut_out";
+	std::cout << "\t [OUTPUT LOCATION].................[" << outputFolder << "]" << std::endl;
+
+	runWindows(filename, windows, outputFolder);
+
+	std::cout << "[GML CUT MODULE]..........................[END]" << std::endl;
+}
+
+std::vector<CUT_WINDOW> GMLCut::readWindows(const std::string& filename)
+{
+	std::vector<CUT_WINDOW> windows;
+
+	std::ifstream file(filename);
+	if (!file)
+	{
+		fprintf(stderr, "Cannot open the windows file %s\n", filename.c_str());
+		return windows;
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+	{
+		line = line.substr(0, line.find('#'));
+		std::replace(line.begin(), line.end(), ',', ' ');
+
+		std::istringstream iss(line);
+		CUT_WINDOW window;
+		if (!(iss >> window.xmin >> window.ymin >> window.xmax >> window.ymax))
+		{
+			if (line.find_first_not_of(" \t\r") != std::string::npos)
+				fprintf(stderr, "%s:%d: expected \"xmin ymin xmax ymax [name]\", line ignored\n", filename.c_str(), lineNumber);
+			continue;
+		}
+		if (!(iss >> window.name))
+			window.name = std::to_string(lineNumber);
+
+		windows.push_back(window);
+	}
+
+	return windows;
+}
+
+std::vector<CUT_WINDOW> GMLCut::gridWindows(double xmin, double ymin, double xmax, double ymax, double tileX, double tileY)
+{
+	std::vector<CUT_WINDOW> windows;
+	if (!(tileX > 0.) || !(tileY > 0.) || !(xmin < xmax) || !(ymin < ymax))
+		return windows;
+
+	for (int i = (int)std::floor(xmin / tileX); i * tileX < xmax; i++)
+	{
+		for (int j = (int)std::floor(ymin / tileY); j * tileY < ymax; j++)
+		{
+			CUT_WINDOW window;
+			window.name = std::to_string(i) + "_" + std::to_string(j);
+			window.xmin = i * tileX;
+			window.ymin = j * tileY;
+			window.xmax = (i + 1) * tileX;
+			window.ymax = (j + 1) * tileY;
+			windows.push_back(window);
+		}
+	}
+
+	return windows;
+}
+
+void GMLCut::setThreadCount(unsigned int threadCount)
+{
+	_threadCount = threadCount;
+}
+
+void GMLCut::setWindow(double xmin, double ymin, double xmax, double ymax)
 {
 	G_xmin = xmin;
 	G_xmax = xmax;
 	G_ymin = ymin;
 	G_ymax = ymax;
 
+	_clipper.setBox(xmin, ymin, xmax, ymax);
+}
+
+int GMLCut::run(std::string & filename, double xmin, double ymin, double xmax, double ymax, std::string outputLocation)
+{
+	setWindow(xmin, ymin, xmax, ymax);
+
 	if (VERBOSE)
 		fprintf(stdout, "VERBOSE is ON\n");
 	else
@@ -448,197 +639,499 @@ int GMLCut::run(std::string & filename, double xmin, double ymin, double xmax, d
 	xmlNodePtr copy_node_appearanceMember = NULL;
 	std::set<std::string> UUID_full_set;
 
-	xmlNodePtr nodeToFindUV = NULL;
-	std::map<std::string, xmlNodePtr> UUID_uv_map;
+	std::unordered_map<std::string, xmlNodePtr> UUID_uv_map;		// ring id -> textureCoordinates of the appearanceMember
+	std::unordered_map<std::string, xmlNodePtr> UUID_uv_map_member;	// ring id -> textureCoordinates of the current member
 
-	// ---
-	// 4 planes (normal and point)
-	G_my4planes.n[0].x = 0;					G_my4planes.n[0].y = -1;					G_my4planes.n[0].z = 0; // bottom plane
-	G_my4planes.p0[0].x = (G_xmin + G_xmax) / 2.;	G_my4planes.p0[0].y = G_ymin;				G_my4planes.p0[0].z = 0;
+	// opens document : the input is streamed, only the current cityObjectMember is in memory
+	xmlTextReaderPtr reader = xmlReaderForFile(filename.c_str(), NULL, XML_PARSE_NOBLANKS | XML_PARSE_HUGE); // ignore les noeuds texte composant la mise en forme
+	if (reader == NULL)
+	{
+		fprintf(stderr, "Invalid XML file\n");
+		return EXIT_FAILURE;
+	}
 
-	G_my4planes.n[1].x = -1;					G_my4planes.n[1].y = 0;					G_my4planes.n[1].z = 0; // left plane
-	G_my4planes.p0[1].x = G_xmin;				G_my4planes.p0[1].y = (G_ymin + G_ymax) / 2.;	G_my4planes.p0[1].z = 0;
+	// get root
+	int ret = xmlTextReaderRead(reader);
+	while (ret == 1 && xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+		ret = xmlTextReaderRead(reader);
 
-	G_my4planes.n[2].x = 0;					G_my4planes.n[2].y = 1;					G_my4planes.n[2].z = 0; // up plane
-	G_my4planes.p0[2].x = (G_xmin + G_xmax) / 2.;	G_my4planes.p0[2].y = G_ymax;				G_my4planes.p0[2].z = 0;
+	if (ret != 1)
+	{
+		fprintf(stderr, ret < 0 ? "Invalid XML file\n" : "Empty XML file\n");
+		xmlFreeTextReader(reader);
+		return EXIT_FAILURE;
+	}
 
-	G_my4planes.n[3].x = 1;					G_my4planes.n[3].y = 0;					G_my4planes.n[3].z = 0; // right plane
-	G_my4planes.p0[3].x = G_xmax;				G_my4planes.p0[3].y = (G_ymin + G_ymax) / 2.;	G_my4planes.p0[3].z = 0;
+	// Create output file
+	xmlTextWriterPtr writer = xmlNewTextWriterFilename(outputLocation.c_str(), 0);
+	if (writer) {
+		std::cout << "output success created" << std::endl;
+	}
+	else {
+		std::cout << "output failed created" << std::endl;
+		std::cout << outputLocation << std::endl;
+		xmlFreeTextReader(reader);
+		return EXIT_FAILURE;
+	}
+	xmlTextWriterStartDocument(writer, NULL, "ISO-8859-1", NULL);
 
-	for (int p = 0; p < 4; p++)
-		G_my4planes.n[p] = G_my4planes.n[p].normal(); // normalizing
-	// ---
+	// parcours
+	if (xmlStrEqual(xmlTextReaderConstLocalName(reader), BAD_CAST "CityModel"))
+	{
+		fprintf(stdout, "%s\n", xmlTextReaderConstLocalName(reader));
 
-	xmlDocPtr out_doc = NULL;			// output document pointer
-	xmlNodePtr out_root_node = NULL;	// output root node pointer
+		// root element and its attributes (namespace declarations included), without its children
+		xmlTextWriterStartElement(writer, xmlTextReaderConstName(reader));
+		while (xmlTextReaderMoveToNextAttribute(reader) == 1)
+			xmlTextWriterWriteAttribute(writer, xmlTextReaderConstName(reader), xmlTextReaderConstValue(reader));
+		xmlTextReaderMoveToElement(reader);
 
-	// creates a new document
-	out_doc = xmlNewDoc(BAD_CAST "1.0");
+		ret = xmlTextReaderIsEmptyElement(reader) ? 0 : xmlTextReaderRead(reader);
+		while (ret == 1 && xmlTextReaderDepth(reader) > 0)
+		{
+			if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT || xmlTextReaderDepth(reader) != 1)
+			{
+				ret = xmlTextReaderRead(reader);
+				continue;
+			}
 
-	xmlDocPtr doc;
-	xmlNodePtr racine;
+			if (xmlStrEqual(xmlTextReaderConstLocalName(reader), BAD_CAST "cityObjectMember"))
+			{
+				// subtree of the member only, freed when the reader moves to the next sibling
+				xmlNodePtr n = xmlTextReaderExpand(reader);
+				xmlNodePtr object = n ? xmlFirstElementChild(n) : NULL;
 
-	// opens document
-	xmlKeepBlanksDefault(0); // ignore les noeuds texte composant la mise en forme
-	doc = xmlParseFile(filename.c_str());
-	if (doc == NULL)
+				if (object && ((xmlStrEqual(object->name, BAD_CAST "Building")) || (xmlStrEqual(object->name, BAD_CAST "ReliefFeature")))) // ReliefFeature same principle as Building
+				//if (xmlStrEqual(object->name, BAD_CAST "Building")) // only Building
+				//if (xmlStrEqual(object->name, BAD_CAST "ReliefFeature")) // only ReliefFeature
+				{
+					double xmin_Building, ymin_Building, zmin_Building;
+					double xmax_Building, ymax_Building, zmax_Building;
+					xmin_Building = ymin_Building = zmin_Building = xmax_Building = ymax_Building = zmax_Building = 0.;
+					std::set<std::string> UUID_set;
+
+					// One pass over the member indexes the texture coordinates of its appearances
+					UUID_uv_map_member.clear();
+					if (TEXTURE_PROCESS)
+						parcours_prefixe_All_textureCoordinates(object, &GMLCut::process_All_textureCoordinates, &UUID_uv_map_member);
+
+					bool first = true;
+					parcours_prefixe_Building_ReliefFeature_boundingbox(object, &GMLCut::process_Building_ReliefFeature_boundingbox, &first, &xmin_Building, &ymin_Building, &zmin_Building, &xmax_Building, &ymax_Building, &zmax_Building, &UUID_set, &UUID_uv_map_member, &UUID_uv_map);
+					//printf("\nMIN_Building: (%lf %lf %lf)\n", xmin_Building, ymin_Building, zmin_Building);
+					//printf("MAX_Building: (%lf %lf %lf)\n", xmax_Building, ymax_Building, zmax_Building);
+
+					if (!(xmax_Building < G_xmin) && !(ymax_Building < G_ymin) && !(xmin_Building > G_xmax) && !(ymin_Building > G_ymax))
+					{
+						if (VERBOSE)
+						{
+							xmlChar* id = xmlGetProp(object, BAD_CAST "id");
+							fprintf(stdout, "%s: %s - %s (min: %lf %lf) (max: %lf %lf)\n", n->name, object->name, id ? (char*)id : "(null)", xmin_Building, ymin_Building, xmax_Building, ymax_Building);
+							xmlFree(id);
+						}
+
+						writeNode(writer, n);
+						nbCopied++;
+
+						if (TEXTURE_PROCESS)
+						{
+							for (std::set<std::string>::iterator it = UUID_set.begin(); it != UUID_set.end(); ++it)
+								if (UUID_full_set.find(*it) == UUID_full_set.end())
+									UUID_full_set.insert(*it);
+								else
+								{
+									//printf("FOUND in UUID_full_set\n");
+								}
+
+							//printf("parcours_prefixe_Building_ReliefFeature_textures: %s - %s\n", object->name, xmlGetProp(object, BAD_CAST "id"));
+							parcours_prefixe_Building_ReliefFeature_textures(object, &GMLCut::process_Building_ReliefFeature_textures, &UUID_set, folderIN, folderOUT);
+						}
+					}
+				}
+				else
+				{
+					if (VERBOSE)
+						fprintf(stdout, " -> NOT COPIED: %s: %s\n", xmlTextReaderConstLocalName(reader), object ? (const char*)object->name : "(empty)");
+				}
+			}
+			else if ((xmlStrEqual(xmlTextReaderConstLocalName(reader), BAD_CAST "appearanceMember")) && (TEXTURE_PROCESS == true))
+			{
+				// CAUTION : FOR NOW, WE SUPPOSE ONLY ONE appearanceMember
+				// It is kept in memory (uv coordinates of the next members) and written after the members
+				appearanceMember_node = xmlTextReaderExpand(reader);
+				xmlTextReaderPreserve(reader);
+
+				copy_node_appearanceMember = xmlCopyNode(appearanceMember_node, 2);
+
+				fprintf(stdout, " -> PRE PROCESS TEXTURES (for uv coordinates) BEFORE ALL PARSING\n");
+				parcours_prefixe_All_textureCoordinates(appearanceMember_node, &GMLCut::process_All_textureCoordinates, &UUID_uv_map);
+
+				POST_PROCESS_TEXTURES = true;
+				fprintf(stdout, " -> POST PROCESS TEXTURES (for texture files) AFTER ALL PARSING\n");
+			}
+			else
+				fprintf(stdout, " -> NOT COPIED: %s\n", xmlTextReaderConstLocalName(reader));
+
+			ret = xmlTextReaderNext(reader);
+		}
+
+		if (POST_PROCESS_TEXTURES)
+		{
+			UUID_uv_map.clear();
+
+			fprintf(stdout, "POST PROCESS TEXTURES (for texture files) \n");
+
+			// CAUTION : FOR NOW, WE SUPPOSE ONLY ONE appearanceMember
+			process_textures(appearanceMember_node, copy_node_appearanceMember, &UUID_full_set, folderIN, folderOUT);
+			writeNode(writer, copy_node_appearanceMember);
+			xmlFreeNode(copy_node_appearanceMember);
+		}
+
+		xmlTextWriterWriteRaw(writer, BAD_CAST "\n");
+		xmlTextWriterEndElement(writer);
+	}
+
+	if (ret < 0)
+		fprintf(stderr, "Invalid XML file\n");
+
+	fprintf(stdout, "--> NB COPIED: %d\n", nbCopied);
+
+	// flush and close the output file
+	xmlTextWriterEndDocument(writer);
+	xmlFreeTextWriter(writer);
+	xmlFreeTextReader(reader);
+
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int GMLCut::runWindows(std::string & filename, const std::vector<CUT_WINDOW>& windows, std::string outputFolder)
+{
+	// Job of a writer thread : a copy of the member, clipped to one of its windows then written
+	struct Job
+	{
+		size_t window;
+		xmlNodePtr member;
+		xmlNsPtr reconciledNs;
+	};
+
+	struct Writer
+	{
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Job> jobs;
+		bool done = false;
+	};
+
+	// Bounds the number of member copies waiting for a writer thread
+	const size_t MaxPendingJobs = 8;
+
+	std::vector<std::pair<citygml::Envelope, size_t>> windowEnvelopes;
+	for (size_t w = 0; w < windows.size(); w++)
+	{
+		if (!((windows[w].xmin < windows[w].xmax) && (windows[w].ymin < windows[w].ymax)))
+		{
+			fprintf(stderr, "window %s ignored : xmin must be < xmax AND ymin must be < ymax !\n", windows[w].name.c_str());
+			continue;
+		}
+		windowEnvelopes.push_back(std::make_pair(citygml::Envelope(TVec3d(windows[w].xmin, windows[w].ymin, -DBL_MAX), TVec3d(windows[w].xmax, windows[w].ymax, DBL_MAX)), w));
+	}
+	if (windowEnvelopes.empty())
+		return EXIT_FAILURE;
+
+	citygml::RTree<size_t> windowsIndex;
+	windowsIndex.build(windowEnvelopes);
+
+	if (TEXTURE_PROCESS)
+		fprintf(stdout, "appearanceMember NOT COPIED : textures are only processed when cutting one window\n");
+
+	// opens document : the input is streamed, only the current cityObjectMember and its pending copies are in memory
+	xmlTextReaderPtr reader = xmlReaderForFile(filename.c_str(), NULL, XML_PARSE_NOBLANKS | XML_PARSE_HUGE);
+	if (reader == NULL)
 	{
 		fprintf(stderr, "Invalid XML file\n");
 		return EXIT_FAILURE;
 	}
 
-	// Create output file
-	std::ofstream outputfile = std::ofstream(outputLocation);
-	if (outputfile) {
-		std::cout << "output success created" << std::endl;
-		outputfile.clear();
+	// get root
+	int ret = xmlTextReaderRead(reader);
+	while (ret == 1 && xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+		ret = xmlTextReaderRead(reader);
+
+	if (ret != 1 || !xmlStrEqual(xmlTextReaderConstLocalName(reader), BAD_CAST "CityModel"))
+	{
+		fprintf(stderr, ret < 0 ? "Invalid XML file\n" : "No CityModel in XML file\n");
+		xmlFreeTextReader(reader);
+		return EXIT_FAILURE;
 	}
-	else {
-		std::cout << "output failed created" << std::endl;
-		std::cout << outputLocation << std::endl;
+
+	system(("mkdir " + outputFolder).c_str());
+
+	// One output file per window, they all start with the root element of the input and its attributes
+	std::vector<xmlTextWriterPtr> outputs(windows.size(), (xmlTextWriterPtr)NULL);
+	std::vector<int> nbCopied(windows.size(), 0);
+	for (const std::pair<citygml::Envelope, size_t>& window : windowEnvelopes)
+	{
+		std::string outputLocation = outputFolder + "/" + windows[window.second].name + ".gml";
+		xmlTextWriterPtr writer = xmlNewTextWriterFilename(outputLocation.c_str(), 0);
+		if (!writer)
+		{
+			std::cout << "output failed created" << std::endl;
+			std::cout << outputLocation << std::endl;
+			continue;
+		}
+
+		xmlTextWriterStartDocument(writer, NULL, "ISO-8859-1", NULL);
+		xmlTextWriterStartElement(writer, xmlTextReaderConstName(reader));
+		while (xmlTextReaderMoveToNextAttribute(reader) == 1)
+			xmlTextWriterWriteAttribute(writer, xmlTextReaderConstName(reader), xmlTextReaderConstValue(reader));
+		xmlTextReaderMoveToElement(reader);
+
+		outputs[window.second] = writer;
 	}
 
-	// get root
-	racine = xmlDocGetRootElement(doc);
+	// Window w is always written by thread w % threadCount, so every output file has a single writer
+	unsigned int threadCount = _threadCount > 0 ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = (unsigned int)std::min<size_t>(threadCount, windowEnvelopes.size());
+	std::cout << "\t [THREADS]....................[" << threadCount << "]" << std::endl;
+
+	std::vector<std::unique_ptr<Writer>> writers;
+	for (unsigned int t = 0; t < threadCount; t++)
+		writers.push_back(std::unique_ptr<Writer>(new Writer()));
+
+	auto processJobs = [&](Writer& queue)
+	{
+		// The clipping state (G_xmin..., _clipper, _scratch) is per thread
+		GMLCut clipper(*this);
+
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(queue.mutex);
+				queue.condition.wait(lock, [&]() { return queue.done || !queue.jobs.empty(); });
+				if (queue.jobs.empty())
+					return;
+				job = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+			queue.condition.notify_all();
+
+			const CUT_WINDOW& window = windows[job.window];
+			clipper.setWindow(window.xmin, window.ymin, window.xmax, window.ymax);
 
-	/*std::cout << "Name = " << racine->name << std::endl;
-	std::cout << "Content = " << racine->children->content << std::endl;
-	std::cout << "Properties = " << racine->properties->name << std::endl;
-	std::cout << "Properties2 = " << racine->properties->children->content << std::endl;
+			xmlNodePtr object = xmlFirstElementChild(job.member);
+			double xmin_Building, ymin_Building, zmin_Building;
+			double xmax_Building, ymax_Building, zmax_Building;
+			xmin_Building = ymin_Building = zmin_Building = xmax_Building = ymax_Building = zmax_Building = 0.;
+			std::set<std::string> UUID_set;
+			std::unordered_map<std::string, xmlNodePtr> UUID_uv_map;
+			std::unordered_map<std::string, xmlNodePtr> UUID_uv_map_member;
+			if (TEXTURE_PROCESS)
+				clipper.parcours_prefixe_All_textureCoordinates(object, &GMLCut::process_All_textureCoordinates, &UUID_uv_map_member);
 
-	int a;
-	std::cin >> a;*/
+			bool first = true;
+			clipper.parcours_prefixe_Building_ReliefFeature_boundingbox(object, &GMLCut::process_Building_ReliefFeature_boundingbox, &first, &xmin_Building, &ymin_Building, &zmin_Building, &xmax_Building, &ymax_Building, &zmax_Building, &UUID_set, &UUID_uv_map_member, &UUID_uv_map);
 
-	if (racine == NULL)
-	{
-		fprintf(stderr, "Empty XML file\n");
-		xmlFreeDoc(doc);
-		return EXIT_FAILURE;
-	}
+			if (!(xmax_Building < window.xmin) && !(ymax_Building < window.ymin) && !(xmin_Building > window.xmax) && !(ymin_Building > window.ymax))
+			{
+				if (VERBOSE)
+				{
+					xmlChar* id = xmlGetProp(object, BAD_CAST "id");
+					fprintf(stdout, "%s: %s: %s - %s (min: %lf %lf) (max: %lf %lf)\n", window.name.c_str(), job.member->name, object->name, id ? (char*)id : "(null)", xmin_Building, ymin_Building, xmax_Building, ymax_Building);
+					xmlFree(id);
+				}
+
+				writeNode(outputs[job.window], job.member);
+				nbCopied[job.window]++;
+			}
+
+			xmlFreeNode(job.member);
+			xmlFreeNsList(job.reconciledNs);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < threadCount; t++)
+		threads.push_back(std::thread(processJobs, std::ref(*writers[t])));
 
 	// parcours
-	xmlNodePtr n = racine;
-	if (xmlStrEqual(n->name, BAD_CAST "CityModel"))
+	std::vector<size_t> overlapped;
+	ret = xmlTextReaderIsEmptyElement(reader) ? 0 : xmlTextReaderRead(reader);
+	while (ret == 1 && xmlTextReaderDepth(reader) > 0)
 	{
-		fprintf(stdout, "%s\n", n->name);
-		xmlNodePtr copy_node1 = xmlCopyNode(n, 2);
-		xmlDocSetRootElement(out_doc, copy_node1);
-		out_root_node = xmlDocGetRootElement(out_doc);
+		if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT || xmlTextReaderDepth(reader) != 1)
+		{
+			ret = xmlTextReaderRead(reader);
+			continue;
+		}
 
-		if ((n->type == XML_ELEMENT_NODE) && (n->children != NULL))
+		if (xmlStrEqual(xmlTextReaderConstLocalName(reader), BAD_CAST "cityObjectMember"))
 		{
-			for (n = n->children; n != NULL; n = n->next)
+			xmlNodePtr n = xmlTextReaderExpand(reader);
+			xmlNodePtr object = n ? xmlFirstElementChild(n) : NULL;
+
+			double xmin_Building, ymin_Building, xmax_Building, ymax_Building;
+			if (object && ((xmlStrEqual(object->name, BAD_CAST "Building")) || (xmlStrEqual(object->name, BAD_CAST "ReliefFeature"))) // ReliefFeature same principle as Building
+				&& computeBoundingBox(object, &xmin_Building, &ymin_Building, &xmax_Building, &ymax_Building))
 			{
-				if (xmlStrEqual(n->name, BAD_CAST "cityObjectMember"))
+				overlapped.clear();
+				windowsIndex.query(citygml::Envelope(TVec3d(xmin_Building, ymin_Building, 0.), TVec3d(xmax_Building, ymax_Building, 0.)), overlapped);
+
+				for (size_t w : overlapped)
 				{
-					if ((xmlStrEqual(n->children->name, BAD_CAST "Building")) || (xmlStrEqual(n->children->name, BAD_CAST "ReliefFeature"))) // ReliefFeature same principle as Building
-					//if (xmlStrEqual(n->children->name, BAD_CAST "Building")) // only Building
-					//if (xmlStrEqual(n->children->name, BAD_CAST "ReliefFeature")) // only ReliefFeature
-					{
-						double xmin_Building, ymin_Building, zmin_Building;
-						double xmax_Building, ymax_Building, zmax_Building;
-						xmin_Building = ymin_Building = zmin_Building = xmax_Building = ymax_Building = zmax_Building = 0.;
-						std::set<std::string> UUID_set;
+					if (!outputs[w])
+						continue;
 
-						if (!appearanceMember_node)
-							nodeToFindUV = n->children;
+					// Each window clips its own copy. The namespaces of the ancestors, declared again on the copy,
+					// are already declared by the root element of the outputs : they are detached until the copy is written.
+					Job job;
+					job.window = w;
+					job.member = xmlCopyNode(n, 1);
+					xmlNsPtr* last = &job.member->nsDef;
+					for (xmlNsPtr ns = n->nsDef; ns != NULL && *last != NULL; ns = ns->next)
+						last = &(*last)->next;
+					job.reconciledNs = *last;
+					*last = NULL;
+
+					Writer& queue = *writers[w % threadCount];
+					std::unique_lock<std::mutex> lock(queue.mutex);
+					queue.condition.wait(lock, [&]() { return queue.jobs.size() < MaxPendingJobs; });
+					queue.jobs.push_back(job);
+					lock.unlock();
+					queue.condition.notify_all();
+				}
+			}
+			else
+			{
+				if (VERBOSE)
+					fprintf(stdout, " -> NOT COPIED: %s: %s\n", xmlTextReaderConstLocalName(reader), object ? (const char*)object->name : "(empty)");
+			}
+		}
+		else
+			fprintf(stdout, " -> NOT COPIED: %s\n", xmlTextReaderConstLocalName(reader));
 
-						bool first = true;
-						parcours_prefixe_Building_ReliefFeature_boundingbox(n->children, &GMLCut::process_Building_ReliefFeature_boundingbox, &first, &xmin_Building, &ymin_Building, &zmin_Building, &xmax_Building, &ymax_Building, &zmax_Building, &UUID_set, nodeToFindUV, &UUID_uv_map);
-						//printf("\nMIN_Building: (%lf %lf %lf)\n", xmin_Building, ymin_Building, zmin_Building);
-						//printf("MAX_Building: (%lf %lf %lf)\n", xmax_Building, ymax_Building, zmax_Building);
+		ret = xmlTextReaderNext(reader);
+	}
 
-						if (!(xmax_Building < G_xmin) && !(ymax_Building < G_ymin) && !(xmin_Building > G_xmax) && !(ymin_Building > G_ymax))
-						{
-							if (VERBOSE)
-								fprintf(stdout, "%s: %s - %s (min: %lf %lf) (max: %lf %lf)\n", n->name, n->children->name, xmlGetProp(n->children, BAD_CAST "id"), xmin_Building, ymin_Building, xmax_Building, ymax_Building);
+	for (std::unique_ptr<Writer>& queue : writers)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->done = true;
+		}
+		queue->condition.notify_all();
+	}
+	for (std::thread& thread : threads)
+		thread.join();
 
-							//xmlNs ns = { 0 }; // initialisation a zero de tous les membres
-							xmlNodePtr copy_node2 = xmlCopyNode(n, 1);
-							//xmlSetNs(copy_node2, &ns); //xmlSetNs(copy_node2, NULL);
+	if (ret < 0)
+		fprintf(stderr, "Invalid XML file\n");
 
-							xmlAddChild(out_root_node, copy_node2);
-							nbCopied++;
+	// flush and close the output files
+	int totalCopied = 0;
+	for (size_t w = 0; w < windows.size(); w++)
+	{
+		if (!outputs[w])
+			continue;
 
-							if (TEXTURE_PROCESS)
-							{
-								for (std::set<std::string>::iterator it = UUID_set.begin(); it != UUID_set.end(); ++it)
-									if (UUID_full_set.find(*it) == UUID_full_set.end())
-										UUID_full_set.insert(*it);
-									else
-									{
-										//printf("FOUND in UUID_full_set\n");
-									}
+		xmlTextWriterWriteRaw(outputs[w], BAD_CAST "\n");
+		xmlTextWriterEndElement(outputs[w]);
+		xmlTextWriterEndDocument(outputs[w]);
+		xmlFreeTextWriter(outputs[w]);
 
-								//printf("parcours_prefixe_Building_ReliefFeature_textures: %s - %s\n", n->children->name, xmlGetProp(n->children, BAD_CAST "id"));
-								parcours_prefixe_Building_ReliefFeature_textures(n->children, &GMLCut::process_Building_ReliefFeature_textures, &UUID_set, folderIN, folderOUT);
-							}
-						}
-					}
-					else
-					{
-						if (VERBOSE)
-							fprintf(stdout, " -> NOT COPIED: %s: %s\n", n->name, n->children->name);
-					}
-				}
-				else if ((xmlStrEqual(n->name, BAD_CAST "appearanceMember")) && (TEXTURE_PROCESS == true))
-				{
-					// CAUTION : FOR NOW, WE SUPPOSE ONLY ONE appearanceMember
-					appearanceMember_node = n;
+		if (VERBOSE)
+			fprintf(stdout, "--> %s: NB COPIED: %d\n", windows[w].name.c_str(), nbCopied[w]);
+		totalCopied += nbCopied[w];
+	}
+	fprintf(stdout, "--> NB COPIED: %d\n", totalCopied);
 
-					copy_node_appearanceMember = xmlCopyNode(appearanceMember_node, 2);
-					xmlAddChild(out_root_node, copy_node_appearanceMember);
+	xmlFreeTextReader(reader);
 
-					fprintf(stdout, " -> PRE PROCESS TEXTURES (for uv coordinates) BEFORE ALL PARSING\n");
-					parcours_prefixe_All_textureCoordinates(appearanceMember_node, &GMLCut::process_All_textureCoordinates, &UUID_uv_map);
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-					POST_PROCESS_TEXTURES = true;
-					fprintf(stdout, " -> POST PROCESS TEXTURES (for texture files) AFTER ALL PARSING\n");
-				}
-				else
-					fprintf(stdout, " -> NOT COPIED: %s\n", n->name);
-			}
-		}
+////////////////////////////////////////////////////////////////////////////////
+/**
+* @brief Calcule la boite englobante de toutes les posList d'un Building / ReliefFeature, avec les memes regles que
+* process_Building_ReliefFeature_boundingbox (les coordonnees a 0 sont ignorees) mais sans modifier les noeuds.
+*/
+bool GMLCut::computeBoundingBox(xmlNodePtr noeud, double * xmin, double * ymin, double * xmax, double * ymax)
+{
+	bool found = false;
 
-		if (POST_PROCESS_TEXTURES)
+	for (xmlNodePtr n = noeud; n != NULL; n = n->next)
+	{
+		if (n->type != XML_ELEMENT_NODE)
+			continue;
+
+		if (xmlStrEqual(n->name, BAD_CAST "posList") && n->children != NULL)
 		{
-			UUID_uv_map.clear();
+			xmlChar *contenu = xmlNodeGetContent(n);
+			char *endptr = (char *)contenu;
 
-			fprintf(stdout, "POST PROCESS TEXTURES (for texture files) \n");
+			double x, y, z;
+			do
+			{
+				x = strtod(endptr, &endptr);
+				y = strtod(endptr, &endptr);
+				z = strtod(endptr, &endptr);
 
-			// CAUTION : FOR NOW, WE SUPPOSE ONLY ONE appearanceMember
-			process_textures(appearanceMember_node, copy_node_appearanceMember, &UUID_full_set, folderIN, folderOUT);
+				if (x != 0.) { if (!found || x < *xmin) *xmin = x; if (!found || x > *xmax) *xmax = x; }
+				if (y != 0.) { if (!found || y < *ymin) *ymin = y; if (!found || y > *ymax) *ymax = y; }
+				if (x != 0. && y != 0.) found = true;
+			} while (!((x == 0.) && (y == 0.) && (z == 0.)));
+
+			xmlFree(contenu);
+		}
+		else if (n->children != NULL)
+		{
+			double cxmin, cymin, cxmax, cymax;
+			if (computeBoundingBox(n->children, &cxmin, &cymin, &cxmax, &cymax))
+			{
+				if (!found || cxmin < *xmin) *xmin = cxmin;
+				if (!found || cymin < *ymin) *ymin = cymin;
+				if (!found || cxmax > *xmax) *xmax = cxmax;
+				if (!found || cymax > *ymax) *ymax = cymax;
+				found = true;
+			}
 		}
 	}
 
-	fprintf(stdout, "--> NB COPIED: %d\n", nbCopied);
+	return found;
+}
 
-	// dumping document to file
-	xmlSaveFormatFileEnc(outputLocation.c_str(), out_doc, "ISO-8859-1", 1);
+////////////////////////////////////////////////////////////////////////////////
+/**
+* @brief Ecrit un noeud et son sous-arbre dans le fichier de sortie, indente sous l'element racine.
+* Les namespaces declares par les ancetres du noeud ne sont pas redeclares : ils le sont deja par l'element racine.
+*/
+void GMLCut::writeNode(xmlTextWriterPtr writer, xmlNodePtr node)
+{
+	xmlBufferPtr buffer = xmlBufferCreate();
+	xmlNodeDump(buffer, node->doc, node, 1, 1);
 
-	// free the documents
-	xmlFreeDoc(out_doc);
-	xmlFreeDoc(doc);
+	xmlTextWriterWriteRaw(writer, BAD_CAST "\n  ");
+	xmlTextWriterWriteRaw(writer, xmlBufferContent(buffer));
 
-	return EXIT_SUCCESS;
+	xmlBufferFree(buffer);
 }
 
-void GMLCut::parcours_prefixe_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, fct_process_Building_ReliefFeature_boundingbox f, bool *first, double *xmin, double *ymin, double *zmin, double *xmax, double *ymax, double *zmax, std::set<std::string> *UUID_s, xmlNodePtr b_rf, std::map<std::string, xmlNodePtr> *UUID_uvm)
+void GMLCut::parcours_prefixe_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, fct_process_Building_ReliefFeature_boundingbox f, bool *first, double *xmin, double *ymin, double *zmin, double *xmax, double *ymax, double *zmax, std::set<std::string> *UUID_s, std::unordered_map<std::string, xmlNodePtr> *UUID_uvm_member, std::unordered_map<std::string, xmlNodePtr> *UUID_uvm)
 {
 	xmlNodePtr n;
 
 	for (n = noeud; n != NULL; n = n->next)
 	{
-		(this->*f)(n, first, xmin, ymin, zmin, xmax, ymax, zmax, UUID_s, b_rf, UUID_uvm);
+		(this->*f)(n, first, xmin, ymin, zmin, xmax, ymax, zmax, UUID_s, UUID_uvm_member, UUID_uvm);
 
 		if ((n->type == XML_ELEMENT_NODE) && (n->children != NULL))
 		{
-			parcours_prefixe_Building_ReliefFeature_boundingbox(n->children, f, first, xmin, ymin, zmin, xmax, ymax, zmax, UUID_s, b_rf, UUID_uvm);
+			parcours_prefixe_Building_ReliefFeature_boundingbox(n->children, f, first, xmin, ymin, zmin, xmax, ymax, zmax, UUID_s, UUID_uvm_member, UUID_uvm);
 		}
 	}
 }
 
-void GMLCut::process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool *first_posList, double *xmin, double *ymin, double *zmin, double *xmax, double *ymax, double *zmax, std::set<std::string> *UUID_s, xmlNodePtr nodeToFindUV, std::map<std::string, xmlNodePtr> *UUID_uvm)
+void GMLCut::process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool *first_posList, double *xmin, double *ymin, double *zmin, double *xmax, double *ymax, double *zmax, std::set<std::string> *UUID_s, std::unordered_map<std::string, xmlNodePtr> *UUID_uvm_member, std::unordered_map<std::string, xmlNodePtr> *UUID_uvm)
 {
 	if (noeud->type == XML_ELEMENT_NODE)
 	{
@@ -676,29 +1169,33 @@ void GMLCut::process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool *
 					}
 				}
 
-				// init
-				char *endptr = NULL;
-				bool first = true;
+				// posList parsed once, the (0, 0, 0) ending point is kept at the end of l0
+				std::vector<TVec3d>& l0 = _scratch.l0;
+				l0.clear();
+				char *endptr = (char *)contenu;
+				do
+				{
+					TVec3d v;
+					v.x = strtod(endptr, &endptr);
+					v.y = strtod(endptr, &endptr);
+					v.z = strtod(endptr, &endptr);
+					l0.push_back(v);
+				} while (!((l0.back().x == 0.) && (l0.back().y == 0.) && (l0.back().z == 0.)));
 
-				double x, y, z;
+				bool first = true;
 
 				double xmin_posList, ymin_posList, zmin_posList;
 				double xmax_posList, ymax_posList, zmax_posList;
 				xmin_posList = ymin_posList = zmin_posList = xmax_posList = ymax_posList = zmax_posList = 0.;
 
-				do
+				for (const TVec3d& v : l0)
 				{
-					if (!endptr) endptr = (char *)contenu;
-
-					x = strtod(endptr, &endptr);
+					double x = v.x, y = v.y, z = v.z;
 					if (x != 0. && first) { xmin_posList = xmax_posList = x; } if (x != 0. && !first && x < xmin_posList) { xmin_posList = x; } if (x != 0. && !first && x > xmax_posList) { xmax_posList = x; }
-					y = strtod(endptr, &endptr);
 					if (y != 0. && first) { ymin_posList = ymax_posList = y; } if (y != 0. && !first && y < ymin_posList) { ymin_posList = y; } if (y != 0. && !first && y > ymax_posList) { ymax_posList = y; }
-					z = strtod(endptr, &endptr);
 					if (z != 0. && first) { zmin_posList = zmax_posList = z; } if (z != 0. && !first && z < zmin_posList) { zmin_posList = z; } if (z != 0. && !first && z > zmax_posList) { zmax_posList = z; }
-					//printf("(%lf %lf %lf)\n", x, y, z);
 					first = false;
-				} while (!((x == 0.) && (y == 0.) && (z == 0.)));
+				}
 
 				//printf("MIN_posList: (%lf %lf %lf)\n", xmin_posList, ymin_posList, zmin_posList);
 				//printf("MAX_posList: (%lf %lf %lf)\n", xmax_posList, ymax_posList, zmax_posList);
@@ -719,365 +1216,70 @@ void GMLCut::process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool *
 					char *endptrUV = NULL;
 					if (TEXTURE_PROCESS)
 					{
-						char *pid = (char *)xmlGetProp(noeudLinearRing, BAD_CAST "id");
+						// texture coordinates of the ring : appearances of the member first, then the appearanceMember
+						xmlChar *pid = xmlGetProp(noeudLinearRing, BAD_CAST "id");
 						if (pid)
 						{
-							if (nodeToFindUV)
-								noeudUV = parcours_prefixe_Building_ReliefFeature_textureCoordinates(nodeToFindUV, &GMLCut::process_Building_ReliefFeature_textureCoordinates, noeudLinearRing);
-							else
-								noeudUV = (*UUID_uvm)[std::string(pid)];
+							std::unordered_map<std::string, xmlNodePtr>::const_iterator it = UUID_uvm_member->find((char *)pid);
+							if (it != UUID_uvm_member->end())
+								noeudUV = it->second;
+							else if ((it = UUID_uvm->find((char *)pid)) != UUID_uvm->end())
+								noeudUV = it->second;
+							xmlFree(pid);
 
 							if (noeudUV)
 								contenuUV = xmlNodeGetContent(noeudUV);
 						}
 					}
 
-					// init
-					endptr = NULL;
-					first = true;
+					// Scratch buffers : their capacity is kept from one ring to the next
+					std::vector<TVec2d>& uv0 = _scratch.uv0;
+					MyVectorOfVertices& ring = _scratch.ring;
+					MyVectorOfVertices& clipped = _scratch.clipped;
 
-					TVec3d l0[MAX_POINTS_IN_POSLIST + 1];		// TEMP
-					TVec3d l1[MAX_POINTS_IN_POSLIST + 1 + 1];	// TEMP
-					TVec3d l[MAX_POINTS_IN_POSLIST];		// TEMP
-					int i;
-
-					TVec2d uv0[MAX_POINTS_IN_POSLIST + 1];	// TEMP
-					TVec2d uv1[MAX_POINTS_IN_POSLIST + 1 + 1];	// TEMP
-					TVec2d uv[MAX_POINTS_IN_POSLIST];		// TEMP
-
-					do
+					// uv0 has the same size as l0, (0, 0) after the last texture coordinate
+					uv0.assign(l0.size(), TVec2d(0., 0.));
+					if (noeudUV)
 					{
-						if (!endptr) endptr = (char *)contenu; if (noeudUV) { if (!endptrUV) endptrUV = (char *)contenuUV; }
-						if (first)
-							i = 0;
-						else
-							i++;
-
-						if (i > (MAX_POINTS_IN_POSLIST + 1))	// TEMP
-						{
-							fprintf(stderr, "---> STOP : PLEASE, INCREASE MAX_POINTS_IN_POSLIST IN SOURCE CODE\n");
-							exit(EXIT_FAILURE);
-						}
-
-						l0[i].x = strtod(endptr, &endptr);
-						l0[i].y = strtod(endptr, &endptr);
-						l0[i].z = strtod(endptr, &endptr);
-						//printf("p%d - %lf,%lf,%lf\n", i, l0[i].x, l0[i].y, l0[i].z);
-						first = false;
-
-						if (noeudUV)
+						endptrUV = (char *)contenuUV;
+						for (std::size_t k = 0; k < uv0.size(); k++)
 						{
-							uv0[i].x = strtod(endptrUV, &endptrUV);
-							uv0[i].y = strtod(endptrUV, &endptrUV);
+							uv0[k].x = strtod(endptrUV, &endptrUV);
+							uv0[k].y = strtod(endptrUV, &endptrUV);
 						}
-					} while (!((l0[i].x == 0.) && (l0[i].y == 0.) && (l0[i].z == 0.)));
-					i--;
-					//printf("nb points: %d\n", i);
-
-					for (int s = 0; s < i; s++)
-					{
-						l[s] = l0[s + 1] - l0[s];
-						//l[s]=l[s].normal(); // normalizing
-
-						//printf("s%d - p1: %lf,%lf,%lf - p2: %lf,%lf,%lf\n", s, l0[s].x, l0[s].y, l0[s].z, l0[s+1].x, l0[s+1].y, l0[s+1].z);
-
-						if (noeudUV) { uv[s] = uv0[s + 1] - uv0[s]; }
 					}
 
-					double d;
-					int j = 0;
-					TVec3d l1_temp; TVec2d uv1_temp;
-					bool inter, coin;
+					// Ring without the (0, 0, 0) ending point nor the closing point
+					ring.clear();
+					for (std::size_t k = 0; k + 1 < l0.size(); k++)
+						ring.push_back(TVec5d(l0[k].x, l0[k].y, l0[k].z, uv0[k].x, uv0[k].y));
+					if (ring.size() > 1 && ring.front().x == ring.back().x && ring.front().y == ring.back().y && ring.front().z == ring.back().z)
+						ring.pop_back();
 
-					TVec3d l1_old1; TVec2d uv1_old1;
-					TVec3d l1_old2; TVec2d uv1_old2;
-					TVec3d l1_save; TVec2d uv1_save;
-					double G_x, G_y;
-					int last_plan = -1;
+					_clipper.clip(ring, clipped);
 
-					TVec3d triNormal = l[0].cross(l[1]);
-
-					for (int s = 0; s < i; s++)
+					// new posList, closed again
+					std::string& new_posList = _scratch.posList; std::string& new_uvList = _scratch.uvList;
+					new_posList.clear(); new_uvList.clear();
+					int new_nb_points = 0;
+					for (std::size_t p = 0; !clipped.empty() && p <= clipped.size(); p++)
 					{
-						//printf("segment: %ld\n", s);
-						inter = coin = false;
-
-						for (int p = 0; p < 4; p++)
-						{
-							//printf("plan: %ld\n", p);
-
-							// intersection
-							if ((intersectPlane(G_my4planes.n[p], G_my4planes.p0[p], l0[s], l[s], d)) && d > 0. && d < 1.)
-							{
-								//printf("INTER s%d-p%d - %lf\n", s, p, d);
-
-								if ((l0[s + 1].x >= G_xmin) && (l0[s + 1].x <= G_xmax))
-									if ((l0[s + 1].y >= G_ymin) && (l0[s + 1].y <= G_ymax))
-									{
-										l1_temp = l0[s] + l[s] * d; if (noeudUV) { uv1_temp = uv0[s] + uv[s] * d; }
-										l1_save = l1_temp; uv1_save = uv1_temp;
-										if ((l1_temp.x >= G_xmin) && (l1_temp.x <= G_xmax))
-											if ((l1_temp.y >= G_ymin) && (l1_temp.y <= G_ymax))
-											{
-												//printf(" -> KEEP INTER s+1\n");
-
-												//printf(" -> KEEP INTER s+1 : p: %lf,%lf,%lf\n", l1_temp.x, l1_temp.y, l1_temp.z);												
-												l1_old1 = l1_temp; if (noeudUV) { uv1_old1 = uv1_temp; }
-												if (last_plan == -1)
-													last_plan = p;
-												else
-													if (last_plan != p)
-													{
-														last_plan = -1;
-
-														if (1)
-														{
-															bool GxOK, GyOK; GxOK = false; GyOK = false;
-															if (l1_old2.x == G_xmin) { G_x = G_xmin; GxOK = true; /*printf("1\n");*/ }
-															if (l1_old2.x == G_xmax) { G_x = G_xmax; GxOK = true; /*printf("2\n");*/ }
-															if (l1_old2.y == G_ymin) { G_y = G_ymin; GyOK = true; /*printf("3\n");*/ }
-															if (l1_old2.y == G_ymax) { G_y = G_ymax; GyOK = true; /*printf("4\n");*/ }
-
-															if (l1_old1.x == G_xmin) { G_x = G_xmin; GxOK = true; /*printf("5\n");*/ }
-															if (l1_old1.x == G_xmax) { G_x = G_xmax; GxOK = true; /*printf("6\n");*/ }
-															if (l1_old1.y == G_ymin) { G_y = G_ymin; GyOK = true; /*printf("7\n");*/ }
-															if (l1_old1.y == G_ymax) { G_y = G_ymax; GyOK = true; /*printf("8\n");*/ }
-
-															if (GxOK == true && GyOK == true)
-															{
-																bool found = false;
-																for (int jj = 0; jj < j; jj++)
-																	if ((l1[jj].x == G_x) && (l1[jj].y == G_y))
-																	{
-																		found = true;
-																		break;
-																	}
-
-																if (!found)
-																{
-																	l1_temp.x = G_x; l1_temp.y = G_y; //l1_temp.z = 170.;
-																	if (calcule_Z_uv(l1_old2, l0[s], l1_old1, &l1_temp, noeudUV, uv1_old2, uv0[s], uv1_old1, &uv1_temp))
-																	{
-																		//printf(" -> !!!!!!!!!!!!!!! OK : DIFFERENT s+1 !!!!!!!!!!!!!!!!!!!!!\n");
-																		l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-																		l1[j] = l1_old1; if (noeudUV) { uv1[j] = uv1_old1; } j++;
-																		l1[j] = l1_old2; if (noeudUV) { uv1[j] = uv1_old2; } j++;
-																	}
-																}
-																else
-																{
-																	//printf(" -> !!!!!!!!!!!!!!! NOT OK : DIFFERENT s+1 !!!!!!!!!!!!!!!!!!!!!\n");
-																}
-															}
-														}
-													}
-
-												l1_temp = l1_save; uv1_temp = uv1_save;
-												if ((j == 0) || (l1[j - 1] != l1_temp))
-												{
-													l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-													inter = true;
-												}
-												l1_temp = l0[s + 1]; if (noeudUV) { uv1_temp = uv0[s + 1]; }
-												if ((j == 0) || (l1[j - 1] != l1_temp))
-												{
-													l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-													inter = true;
-												}
-											}
-									}
-
-								if ((l0[s].x >= G_xmin) && (l0[s].x <= G_xmax))
-									if ((l0[s].y >= G_ymin) && (l0[s].y <= G_ymax))
-									{
-										l1_temp = l0[s] + l[s] * d; // just for test below
-										if ((l1_temp.x >= G_xmin) && (l1_temp.x <= G_xmax))
-											if ((l1_temp.y >= G_ymin) && (l1_temp.y <= G_ymax))
-											{
-												//printf(" -> KEEP INTER s\n");
-
-												l1_temp = l0[s]; if (noeudUV) { uv1_temp = uv0[s]; }
-												if ((j == 0) || (l1[j - 1] != l1_temp))
-												{
-													l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-													inter = true;
-												}
-												l1_temp = l0[s] + l[s] * d; if (noeudUV) { uv1_temp = uv0[s] + uv[s] * d; }
-												if ((j == 0) || (l1[j - 1] != l1_temp))
-												{
-													l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-													inter = true;
-												}
-
-												//printf(" -> KEEP INTER s : p: %lf,%lf,%lf\n", l1_temp.x, l1_temp.y, l1_temp.z);
-												l1_old2 = l1_temp; if (noeudUV) { uv1_old2 = uv1_temp; }
-												if (last_plan == -1)
-													last_plan = p;
-												else
-													if (last_plan != p)
-													{
-														last_plan = -1;
-
-														if (1)
-														{
-															bool GxOK, GyOK; GxOK = false; GyOK = false;
-															if (l1_old1.x == G_xmin) { G_x = G_xmin; GxOK = true; /*printf("1\n");*/ }
-															if (l1_old1.x == G_xmax) { G_x = G_xmax; GxOK = true; /*printf("2\n");*/ }
-															if (l1_old1.y == G_ymin) { G_y = G_ymin; GyOK = true; /*printf("3\n");*/ }
-															if (l1_old1.y == G_ymax) { G_y = G_ymax; GyOK = true; /*printf("4\n");*/ }
-
-															if (l1_old2.x == G_xmin) { G_x = G_xmin; GxOK = true; /*printf("5\n");*/ }
-															if (l1_old2.x == G_xmax) { G_x = G_xmax; GxOK = true; /*printf("6\n");*/ }
-															if (l1_old2.y == G_ymin) { G_y = G_ymin; GyOK = true; /*printf("7\n");*/ }
-															if (l1_old2.y == G_ymax) { G_y = G_ymax; GyOK = true; /*printf("8\n");*/ }
-
-															if (GxOK == true && GyOK == true)
-															{
-																bool found = false;
-																for (int jj = 0; jj < j; jj++)
-																	if ((l1[jj].x == G_x) && (l1[jj].y == G_y))
-																	{
-																		found = true;
-																		break;
-																	}
-
-																if (!found)
-																{
-																	l1_temp.x = G_x; l1_temp.y = G_y; //l1_temp.z = 170.;
-																	if (calcule_Z_uv(l1_old1, l0[s + 1], l1_old2, &l1_temp, noeudUV, uv1_old1, uv0[s + 1], uv1_old2, &uv1_temp))
-																	{
-																		//printf(" -> !!!!!!!!!!!!!!! OK : DIFFERENT s !!!!!!!!!!!!!!!!!!!!!\n");
-																		l1[j] = l1_old1; if (noeudUV) { uv1[j] = uv1_old1; } j++;
-																		l1[j] = l1_old2; if (noeudUV) { uv1[j] = uv1_old2; } j++;
-																		l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-																	}
-																}
-																else
-																{
-																	//printf(" -> !!!!!!!!!!!!!!! NOT OK : DIFFERENT s !!!!!!!!!!!!!!!!!!!!!\n");
-																}
-															}
-														}
-													}
-											}
-									}
-							}
-						}
-
-						// gestion des 4 coins
-						if (!inter)
-						{
-							bool ok = false;
-
-							if (triNormal.z)
-							{
-								// new c0
-								if ((l0[s].x < G_xmin) && (l0[s + 1].y < G_ymin))
-								{
-									l1_temp.x = G_xmin; l1_temp.y = G_ymin; //l1_temp.z = (l0[s].z + l0[s+1].z)/2.;
-									ok = true;
-								}
-								// new c3
-								else if ((l0[s + 1].x < G_xmin) && (l0[s].y > G_ymax))
-								{
-									l1_temp.x = G_xmin; l1_temp.y = G_ymax; //l1_temp.z = (l0[s].z + l0[s+1].z)/2.;
-									ok = true;
-								}
-								// new c1
-								else if ((l0[s + 1].x > G_xmax) && (l0[s].y < G_ymin))
-								{
-									l1_temp.x = G_xmax; l1_temp.y = G_ymin; //l1_temp.z = (l0[s+1].z + l0[s].z)/2.;
-									ok = true;
-								}
-								// new c2
-								else if ((l0[s].x > G_xmax) && (l0[s + 1].y > G_ymax))
-								{
-									l1_temp.x = G_xmax; l1_temp.y = G_ymax; //l1_temp.z = (l0[s+1].z + l0[s].z)/2.;
-									ok = true;
-								}
-							}
+						const TVec5d& v = clipped[p % clipped.size()];
+						appendCoordinate(new_posList, v.x);
+						appendCoordinate(new_posList, v.y);
+						appendCoordinate(new_posList, v.z);
 
-							if (ok)
-							{
-								if ((j == 0) || (l1[j - 1] != l1_temp))
-								{
-									// pas utile (?) de s'assurer que M est bien dans ABC car on teste la valeur de Z...
-									if (calcule_Z_uv(l0[s], l0[s + 1], l0[s + 2], &l1_temp, noeudUV, uv0[s], uv0[s + 1], uv0[s + 2], &uv1_temp))
-									{
-										l1[j] = l1_temp; if (noeudUV) { uv1[j] = uv1_temp; } j++;
-										coin = true;
-
-										if (i > 3)
-											//fprintf(stderr, "--> WARNING : noeudLinearRing: %lu, COIN WITH (i > 3)!\n", (unsigned long)noeudLinearRing); // TEMP
-											fprintf(stderr, "--> WARNING : COIN WITH (i > 3)!\n"); // TEMP
-									}
-								}
-							}
-						}
-
-						if ((!inter) && (!coin))
+						if (noeudUV)
 						{
-							if ((j == 0) || (l1[j - 1] != l0[s]))
-							{
-								l1[j] = l0[s]; if (noeudUV) { uv1[j] = uv0[s]; } j++;
-							}
+							appendCoordinate(new_uvList, v.U);
+							appendCoordinate(new_uvList, v.V);
 						}
-					}
-
-					std::string new_posList = ""; std::string new_uvList = "";
-					int new_nb_points = 0;
-					bool first_point = true; int first_p, last_p;
-					for (int p = 0; p < j; p++)
-					{
-						if ((l1[p].x >= G_xmin) && (l1[p].x <= G_xmax))
-							if ((l1[p].y >= G_ymin) && (l1[p].y <= G_ymax))
-							{
-								new_posList += std::to_string(l1[p].x); new_posList += " ";
-								new_posList += std::to_string(l1[p].y); new_posList += " ";
-								new_posList += std::to_string(l1[p].z); new_posList += " ";
-
-								if (noeudUV)
-								{
-									new_uvList += std::to_string(uv1[p].x); new_uvList += " ";
-									new_uvList += std::to_string(uv1[p].y); new_uvList += " ";
-								}
-
-								if (first_point)
-								{
-									first_point = false;
-									first_p = p;
-								}
-								last_p = p;
 
-								new_nb_points++;
-							}
+						new_nb_points++;
 					}
 
 					//std::cout << "new posList (nb points: " << new_nb_points << "): " << new_posList << std::endl;
 
-					if (new_nb_points)
-					{
-						if ((l1[first_p].x == l1[last_p].x) && (l1[first_p].y == l1[last_p].y) && (l1[first_p].z == l1[last_p].z))
-						{
-							//std::cout << "new posList (nb points: " << new_nb_points << "): " << new_posList << std::endl;
-						}
-						else
-						{
-							new_posList += std::to_string(l1[first_p].x); new_posList += " ";
-							new_posList += std::to_string(l1[first_p].y); new_posList += " ";
-							new_posList += std::to_string(l1[first_p].z); new_posList += " ";
-
-							if (noeudUV)
-							{
-								new_uvList += std::to_string(uv1[first_p].x); new_uvList += " ";
-								new_uvList += std::to_string(uv1[first_p].y); new_uvList += " ";
-							}
-
-							new_nb_points++;
-							//std::cout << "ADD ONE POINT: new posList (new nb points: " << new_nb_points << "): " << new_posList << std::endl;
-						}
-					}
-
 					if (new_nb_points >= 4)
 					{
 						xmlNodePtr noeudTriangle = noeudLinearRing->parent->parent;
@@ -1085,89 +1287,42 @@ void GMLCut::process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool *
 						{
 							//printf("must triangulate this polygon : %s has %d points\n", xmlGetProp(noeudLinearRing, BAD_CAST "id"), (new_nb_points-1));						
 
-							TVec5d pp;
-							char *endpos = (char *)new_posList.c_str(); char *endposUV = (char *)new_uvList.c_str();
-							MyVectorOfVertices vv;
-
-							bool same = false;
-							for (int ii = 0; ii < (new_nb_points - 1); ii++)
-							{
-								pp.x = strtod(endpos, &endpos);
-								pp.y = strtod(endpos, &endpos);
-								pp.z = strtod(endpos, &endpos);
-
-								if (noeudUV)
-								{
-									pp.U = strtod(endposUV, &endposUV);
-									pp.V = strtod(endposUV, &endposUV);
-								}
-								else
-								{
-									pp.U = 0;
-									pp.V = 0;
-								}
-
-								//printf("point %2d - (%lf %lf %lf - uv: %lf %lf)\n", ii, pp.x, pp.y, pp.z, pp.U, pp.V);
-								bool pfound = false;
-								for (std::size_t dd = 0; dd < vv.size(); dd++)
-								{
-									if ((vv[dd].x == pp.x) && (vv[dd].y == pp.y) && (vv[dd].z == pp.z))
-									{
-										pfound = true;
-										break;
-									}
-								}
-								if (pfound == true)
-								{
-									same = true;
-									//fprintf(stderr, "--> WARNING : noeudLinearRing: %lu, same point in polygon with %d points!\n", (unsigned long)noeudLinearRing, (new_nb_points-1)); // TEMP									
-								}
-								else
-									vv.push_back(pp);
-							}
+							// Indices of the triangles into the clipped ring
+							std::vector<uint32_t>& triangles = _scratch.triangles;
+							triangles.clear();
+							Triangulate::Process(clipped, triangles);
 
-							if (same)
-							{
-								/*for (int dd=0; dd<vv.size(); dd++)
-									printf("point %2d - (%lf %lf %lf - uv: %lf %lf)\n", dd, vv[dd].x, vv[dd].y, vv[dd].z, vv[dd].U, vv[dd].V);*/
-									//fprintf(stderr, " ----> noeudLinearRing: %lu, polygon NOW with %lu points\n", (unsigned long)noeudLinearRing, vv.size()); // TEMP	
-							}
-
-							MyVectorOfVertices result;
-							Triangulate::Process(vv, result);
-
-							int tcount = (int)(result.size() / 3);
+							int tcount = (int)(triangles.size() / 3);
 							for (int ii = 0; ii < tcount; ii++)
 							{
-								const TVec5d &p1 = result[ii * 3 + 0];
-								const TVec5d &p2 = result[ii * 3 + 1];
-								const TVec5d &p3 = result[ii * 3 + 2];
-								//if (same) fprintf(stderr, "Triangle %d => (%lf %lf %lf - uv: %lf %lf) (%lf %lf %lf - uv: %lf %lf) (%lf %lf %lf - uv: %lf %lf)\n", ii+1, p1.x,p1.y,p1.z,p1.U,p1.V, p2.x,p2.y,p2.z,p2.U,p2.V, p3.x,p3.y,p3.z,p3.U,p3.V);
-								new_posList = "";
-								new_posList += std::to_string(p1.x); new_posList += " ";
-								new_posList += std::to_string(p1.y); new_posList += " ";
-								new_posList += std::to_string(p1.z); new_posList += " ";
-								new_posList += std::to_string(p2.x); new_posList += " ";
-								new_posList += std::to_string(p2.y); new_posList += " ";
-								new_posList += std::to_string(p2.z); new_posList += " ";
-								new_posList += std::to_string(p3.x); new_posList += " ";
-								new_posList += std::to_string(p3.y); new_posList += " ";
-								new_posList += std::to_string(p3.z); new_posList += " ";
-								new_posList += std::to_string(p1.x); new_posList += " ";
-								new_posList += std::to_string(p1.y); new_posList += " ";
-								new_posList += std::to_string(p1.z); new_posList += " ";
+								const TVec5d &p1 = clipped[triangles[ii * 3 + 0]];
+								const TVec5d &p2 = clipped[triangles[ii * 3 + 1]];
+								const TVec5d &p3 = clipped[triangles[ii * 3 + 2]];
+								new_posList.clear();
+								appendCoordinate(new_posList, p1.x);
+								appendCoordinate(new_posList, p1.y);
+								appendCoordinate(new_posList, p1.z);
+								appendCoordinate(new_posList, p2.x);
+								appendCoordinate(new_posList, p2.y);
+								appendCoordinate(new_posList, p2.z);
+								appendCoordinate(new_posList, p3.x);
+								appendCoordinate(new_posList, p3.y);
+								appendCoordinate(new_posList, p3.z);
+								appendCoordinate(new_posList, p1.x);
+								appendCoordinate(new_posList, p1.y);
+								appendCoordinate(new_posList, p1.z);
 
 								if (noeudUV)
 								{
-									new_uvList = "";
-									new_uvList += std::to_string(p1.U); new_uvList += " ";
-									new_uvList += std::to_string(p1.V); new_uvList += " ";
-									new_uvList += std::to_string(p2.U); new_uvList += " ";
-									new_uvList += std::to_string(p2.V); new_uvList += " ";
-									new_uvList += std::to_string(p3.U); new_uvList += " ";
-									new_uvList += std::to_string(p3.V); new_uvList += " ";
-									new_uvList += std::to_string(p1.U); new_uvList += " ";
-									new_uvList += std::to_string(p1.V); new_uvList += " ";
+									new_uvList.clear();
+									appendCoordinate(new_uvList, p1.U);
+									appendCoordinate(new_uvList, p1.V);
+									appendCoordinate(new_uvList, p2.U);
+									appendCoordinate(new_uvList, p2.V);
+									appendCoordinate(new_uvList, p3.U);
+									appendCoordinate(new_uvList, p3.V);
+									appendCoordinate(new_uvList, p1.U);
+									appendCoordinate(new_uvList, p1.V);
 								}
 
 								xmlNodePtr copy_tr = xmlCopyNode(noeudTriangle, 1);
@@ -1245,51 +1400,6 @@ void GMLCut::process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool *
 	}
 }
 
-xmlNodePtr GMLCut::parcours_prefixe_Building_ReliefFeature_textureCoordinates(xmlNodePtr noeud, fct_process_Building_ReliefFeature_textureCoordinates f, xmlNodePtr noeud_id)
-{
-	xmlNodePtr n;
-	xmlNodePtr noeud_find;
-
-	for (n = noeud; n != NULL; n = n->next)
-	{
-		noeud_find = (this->*f)(n, noeud_id);
-		if (noeud_find)
-			return noeud_find;
-
-		if ((n->type == XML_ELEMENT_NODE) && (n->children != NULL))
-		{
-			noeud_find = parcours_prefixe_Building_ReliefFeature_textureCoordinates(n->children, f, noeud_id);
-			if (noeud_find)
-				return noeud_find;
-		}
-	}
-
-	return NULL;
-}
-
-xmlNodePtr GMLCut::process_Building_ReliefFeature_textureCoordinates(xmlNodePtr noeud, xmlNodePtr noeud_id)
-{
-	if (noeud->type == XML_ELEMENT_NODE)
-	{
-		if (noeud->children != NULL)
-		{
-			if (xmlStrEqual(noeud->name, BAD_CAST "textureCoordinates"))
-			{
-				char *p = (char *)xmlGetProp(noeud, BAD_CAST "ring");
-				p++;
-
-				char *pid = (char *)xmlGetProp(noeud_id, BAD_CAST "id");
-				if (strcmp(pid, p) == 0)
-				{
-					return noeud;
-				}
-			}
-		}
-	}
-
-	return NULL;
-}
-
 void GMLCut::parcours_prefixe_Building_ReliefFeature_textures(xmlNodePtr noeud, fct_process_Building_ReliefFeature_textures f, std::set<std::string> *UUID_s, std::string folderIN, std::string folderOUT)
 {
 	xmlNodePtr n;
@@ -1510,7 +1620,7 @@ void GMLCut::copy_texture_files(xmlNodePtr noeud, std::string folderIN, std::str
 	//xmlFree(imageURI);
 }
 
-void GMLCut::parcours_prefixe_All_textureCoordinates(xmlNodePtr noeud, fct_process_All_textureCoordinates f, std::map<std::string, xmlNodePtr> *UUID_uvm)
+void GMLCut::parcours_prefixe_All_textureCoordinates(xmlNodePtr noeud, fct_process_All_textureCoordinates f, std::unordered_map<std::string, xmlNodePtr> *UUID_uvm)
 {
 	xmlNodePtr n;
 
@@ -1523,7 +1633,7 @@ void GMLCut::parcours_prefixe_All_textureCoordinates(xmlNodePtr noeud, fct_proce
 	}
 }
 
-void GMLCut::process_All_textureCoordinates(xmlNodePtr noeud, std::map<std::string, xmlNodePtr> *UUID_uvm)
+void GMLCut::process_All_textureCoordinates(xmlNodePtr noeud, std::unordered_map<std::string, xmlNodePtr> *UUID_uvm)
 {
 	if (noeud->type == XML_ELEMENT_NODE)
 	{
@@ -1531,66 +1641,16 @@ void GMLCut::process_All_textureCoordinates(xmlNodePtr noeud, std::map<std::stri
 		{
 			if (xmlStrEqual(noeud->name, BAD_CAST "textureCoordinates"))
 			{
-				char *p = (char *)xmlGetProp(noeud, BAD_CAST "ring");
-				p++;
+				xmlChar *ring = xmlGetProp(noeud, BAD_CAST "ring");
+				if (ring)
+				{
+					const char *p = (const char *)ring;
+					if (*p == '#') p++;
 
-				(*UUID_uvm)[std::string(p)] = noeud;
+					(*UUID_uvm)[std::string(p)] = noeud;
+					xmlFree(ring);
+				}
 			}
 		}
 	}
 }
-
-// adapted from http://www.scratchapixel.com/lessons/3d-basic-lessons/lesson-7-intersecting-simple-shapes/ray-plane-and-ray-disk-intersection/
-bool GMLCut::intersectPlane(const TVec3d &n, const TVec3d &p0, const TVec3d& l0, const TVec3d &l, double &d)
-{
-	// assuming vectors are all normalized
-	double denom = n.dot(l);
-	if (fabs(denom) > 1e-6) // fabs add by MM-MT
-	{
-		TVec3d p0l0 = p0 - l0;
-		d = n.dot(p0l0) / denom;
-		return (d >= 0);
-	}
-	return false;
-}
-
-// ABC forment un triangle
-// M est le point ou on fait le calcul (M est dans ABC)
-bool GMLCut::calcule_Z_uv(TVec3d A, TVec3d B, TVec3d C, TVec3d *M,
-	bool uv, TVec2d uvA, TVec2d uvB, TVec2d uvC, TVec2d *uvM)
-{
-	// On va se servir des coordonnees x et y qui sont toutes connues pour
-	// determiner s et t qui nous permettrons ensuite de calculer le z du point M
-
-	TVec3d AB = B - A;
-	TVec3d AC = C - A;
-
-	TVec2d uvAB, uvAC;
-
-	if (uv)
-	{
-		uvAB = uvB - uvA;
-		uvAC = uvC - uvA;
-	}
-
-	double s, t;
-	t = (A.y * AB.x - A.x * AB.y + AB.y * M->x - AB.x * M->y) / (AB.y * AC.x - AB.x * AC.y);
-	s = (M->x - A.x - t * AC.x) / AB.x;
-
-	// AM = sAB + tAC
-	M->z = A.z + s * AB.z + t * AC.z;
-
-	// imaginons qu'on a les coords de textures (u,v) dans les points: ex : A.u et A.v
-	if (uv)
-	{
-		uvM->x = uvA.x + s * uvAB.x + t * uvAC.x;
-		uvM->y = uvA.y + s * uvAB.y + t * uvAC.y;
-	}
-
-	return !(is_inf_or_nan(M->z));
-}
-
-bool GMLCut::is_inf_or_nan(double x)
-{
-	return !(x <= DBL_MAX && x >= -DBL_MAX);
-}
\ No newline at end of file
@@ -3,8 +3,12 @@
 
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <cmath>
 #include <vector>
 #include <fstream>
+#include <functional>
+#include <string>
 
 #ifdef _MSC_VER                // Inhibit dll-interface warnings concerning
 # pragma warning(disable:4251) // gdal-1.11.4 internals (cpl_string.h) when
@@ -12,6 +16,8 @@
 #include <ogrsf_frmts.h>
 
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
 #include "../Module.hpp"
 #include "../../CityModel/CityGML.hpp"
 #include "../../CityModel/CityModel.hpp"
@@ -20,42 +26,101 @@
 #include "OGRGDALtools.hpp"
 
 #include "Triangulate.hpp"
+#include "BoxClipper.hpp"
 
 #include <float.h> // MT : for DBL_MAX on MAC OS X
 
-struct FOUR_PLANES
+// Window of the CUT mode, the output file is <name>.gml
+struct CUT_WINDOW
 {
-	TVec3d n[4];
-	TVec3d p0[4];
+	std::string name;
+	double xmin;
+	double ymin;
+	double xmax;
+	double ymax;
 };
 
-#define MAX_POINTS_IN_POSLIST 200
+// Buffers of the ring clipping, reused from one ring to the next (every thread has its own GMLCut)
+struct CLIP_SCRATCH
+{
+	std::vector<TVec3d> l0;	// points of the posList
+	std::vector<TVec2d> uv0;	// texture coordinates
+	MyVectorOfVertices ring;
+	MyVectorOfVertices clipped;
+	std::vector<uint32_t> triangles;	// indices into clipped
+	std::string posList;	// new posList / texture coordinates
+	std::string uvList;
+};
 
 class GMLCut : public Module
 {
 public:
 	GMLCut(std::string name);
 
-	citygml::CityModel* assign(citygml::CityModel* model, std::vector<TextureCityGML*>* texturesList, TVec2d minTile, TVec2d maxTile, std::string pathFolder);
+	citygml::CityModel* assign(citygml::CityModel* model, TexturesCityGML* texturesList, TVec2d minTile, TVec2d maxTile, std::string pathFolder);
+
+	// Same as assign for a whole grid of tiles, in a single pass over the model : the centroid of every building / bridge
+	// (or TIN / water polygon) is computed once and gives the index of its tile. Tile (i, j) covers
+	// [origin + (i, j) * tileSize, origin + (i + 1, j + 1) * tileSize[ and its textures go to (*texturesLists)[(i, j)].
+	// Only the tiles receiving objects are created. With only, the other tiles are left out and only the roots
+	// overlapping the tiles of only (spatial index of the model) are visited.
+	std::map<std::pair<int, int>, citygml::CityModel*> assignTiles(citygml::CityModel* model, std::map<std::pair<int, int>, TexturesCityGML>* texturesLists, TVec2d origin, TVec2d tileSize, const std::set<std::pair<int, int>>* only = nullptr);
 
 	void cut(std::string & filename, double xmin, double ymin, double xmax, double ymax, std::string outputLocation);
 
+	// Same as cut for many windows, in a single pass over the input : every cityObjectMember is clipped and written
+	// for each window it overlaps, the output files (outputFolder/<window name>.gml) are written by concurrent threads
+	void cut(std::string & filename, const std::vector<CUT_WINDOW>& windows, std::string outputFolder);
+
+	// Windows file : one "xmin ymin xmax ymax [name]" window per line (spaces or commas), '#' for comments.
+	// Windows without name are named after their line number.
+	static std::vector<CUT_WINDOW> readWindows(const std::string& filename);
+
+	// Regular grid of tileX x tileY windows covering [xmin, xmax] x [ymin, ymax], aligned on multiples of the tile size
+	// and named "<x / tileX>_<y / tileY>" like the GMLSplit tiles
+	static std::vector<CUT_WINDOW> gridWindows(double xmin, double ymin, double xmax, double ymax, double tileX, double tileY);
+
+	// Number of threads writing the windows (0 : one per hardware thread)
+	void setThreadCount(unsigned int threadCount);
+
 private:
-	typedef void(GMLCut::*fct_process_All_textureCoordinates)(xmlNodePtr, std::map<std::string, xmlNodePtr> *);
-	typedef xmlNodePtr(GMLCut::*fct_process_Building_ReliefFeature_textureCoordinates)(xmlNodePtr, xmlNodePtr);
-	typedef void(GMLCut::*fct_process_Building_ReliefFeature_boundingbox)(xmlNodePtr, bool *, double *, double *, double *, double *, double *, double *, std::set<std::string> *, xmlNodePtr, std::map<std::string, xmlNodePtr> *);
+	typedef void(GMLCut::*fct_process_All_textureCoordinates)(xmlNodePtr, std::unordered_map<std::string, xmlNodePtr> *);
+	typedef void(GMLCut::*fct_process_Building_ReliefFeature_boundingbox)(xmlNodePtr, bool *, double *, double *, double *, double *, double *, double *, std::set<std::string> *, std::unordered_map<std::string, xmlNodePtr> *, std::unordered_map<std::string, xmlNodePtr> *);
 	typedef void(GMLCut::*fct_process_Building_ReliefFeature_textures)(xmlNodePtr, std::set<std::string> *, std::string, std::string);
 
 
+	// Assign the root objects to the tile returned by tileOf for their centroid (nullptr : not assigned).
+	// tileOf also gives the textures list of the tile. Texture urls are relative to basePath.
+	// straddles(lower, upper) tells if a bounding box can have points in different tiles (or in and out of the tile).
+	void assignObjects(const citygml::CityObjects& objects, const std::string& basePath, const std::function<citygml::CityModel*(const TVec2d&, TexturesCityGML*&)>& tileOf, const std::function<bool(const TVec2d&, const TVec2d&)>& straddles);
+
+	// Centroids used to assign the objects, false if the geometry is not valid. They are computed natively on the ring
+	// vertices, OGR / GEOS is only used for very long rings and for the footprints straddling a tile border.
+	bool computePolygonCentroid(const citygml::Polygon* polygon, TVec2d& centroid);
+	bool computeFootprintCentroid(const std::vector<const citygml::Polygon*>& polygons, const std::function<bool(const TVec2d&, const TVec2d&)>& straddles, TVec2d& centroid);
+
+	// Copy an object into a tile
+	void assignBuilding(citygml::CityModel* tile, const std::string& Name, const citygml::CityObject* obj, TexturesCityGML* texturesList);
+	void assignBridge(citygml::CityModel* tile, const citygml::CityObject* obj, TexturesCityGML* texturesList);
+	// TexUV is moved to the texture of the url of the polygon
+	void addTexture(const citygml::Polygon* PolygonCityGML, std::vector<TVec2f> TexUV, TexturesCityGML* texturesList);
+
+	// Streaming cut : the input is read with an xmlTextReader one cityObjectMember at a time and the members
+	// intersecting the window are written to an xmlTextWriter, memory is bounded by the largest member
 	int run(std::string & filename, double xmin, double ymin, double xmax, double ymax, std::string outputLocation);
 
-	void parcours_prefixe_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, fct_process_Building_ReliefFeature_boundingbox f, bool * first, double * xmin, double * ymin, double * zmin, double * xmax, double * ymax, double * zmax, std::set<std::string>* UUID_s, xmlNodePtr b_rf, std::map<std::string, xmlNodePtr>* UUID_uvm);
+	int runWindows(std::string & filename, const std::vector<CUT_WINDOW>& windows, std::string outputFolder);
+
+	void setWindow(double xmin, double ymin, double xmax, double ymax);
 
-	void process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool * first_posList, double * xmin, double * ymin, double * zmin, double * xmax, double * ymax, double * zmax, std::set<std::string>* UUID_s, xmlNodePtr nodeToFindUV, std::map<std::string, xmlNodePtr>* UUID_uvm);
+	// Bounding box of the posList of a Building / ReliefFeature, before any clipping
+	bool computeBoundingBox(xmlNodePtr noeud, double * xmin, double * ymin, double * xmax, double * ymax);
 
-	xmlNodePtr parcours_prefixe_Building_ReliefFeature_textureCoordinates(xmlNodePtr noeud, fct_process_Building_ReliefFeature_textureCoordinates f, xmlNodePtr noeud_id);
+	void writeNode(xmlTextWriterPtr writer, xmlNodePtr node);
 
-	xmlNodePtr process_Building_ReliefFeature_textureCoordinates(xmlNodePtr noeud, xmlNodePtr noeud_id);
+	void parcours_prefixe_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, fct_process_Building_ReliefFeature_boundingbox f, bool * first, double * xmin, double * ymin, double * zmin, double * xmax, double * ymax, double * zmax, std::set<std::string>* UUID_s, std::unordered_map<std::string, xmlNodePtr>* UUID_uvm_member, std::unordered_map<std::string, xmlNodePtr>* UUID_uvm);
+
+	void process_Building_ReliefFeature_boundingbox(xmlNodePtr noeud, bool * first_posList, double * xmin, double * ymin, double * zmin, double * xmax, double * ymax, double * zmax, std::set<std::string>* UUID_s, std::unordered_map<std::string, xmlNodePtr>* UUID_uvm_member, std::unordered_map<std::string, xmlNodePtr>* UUID_uvm);
 
 	void parcours_prefixe_Building_ReliefFeature_textures(xmlNodePtr noeud, fct_process_Building_ReliefFeature_textures f, std::set<std::string>* UUID_s, std::string folderIN, std::string folderOUT);
 
@@ -65,25 +130,23 @@ private:
 
 	void copy_texture_files(xmlNodePtr noeud, std::string folderIN, std::string folderOUT);
 
-	void parcours_prefixe_All_textureCoordinates(xmlNodePtr noeud, fct_process_All_textureCoordinates f, std::map<std::string, xmlNodePtr>* UUID_uvm);
-
-	void process_All_textureCoordinates(xmlNodePtr noeud, std::map<std::string, xmlNodePtr>* UUID_uvm);
-
-	bool intersectPlane(const TVec3d & n, const TVec3d & p0, const TVec3d & l0, const TVec3d & l, double & d);
+	void parcours_prefixe_All_textureCoordinates(xmlNodePtr noeud, fct_process_All_textureCoordinates f, std::unordered_map<std::string, xmlNodePtr>* UUID_uvm);
 
-	bool calcule_Z_uv(TVec3d A, TVec3d B, TVec3d C, TVec3d * M, bool uv, TVec2d uvA, TVec2d uvB, TVec2d uvC, TVec2d * uvM);
+	void process_All_textureCoordinates(xmlNodePtr noeud, std::unordered_map<std::string, xmlNodePtr>* UUID_uvm);
 
-	bool is_inf_or_nan(double x);
 
 
 	double G_xmin;
 	double G_xmax;
 	double G_ymin;
 	double G_ymax;
-	FOUR_PLANES G_my4planes;
+	BoxClipper _clipper;
+	CLIP_SCRATCH _scratch;
+	std::vector<TVec2d> _ringPoints;	// buffer of the native centroid computation
 	bool TEXTURE_PROCESS = false;
 	bool TRIANGULATE_PROCESS = true;
 	bool VERBOSE = true;
+	unsigned int _threadCount = 0;
 };
 
 #endif // !GMLCUT_HPP
@@ -4,7 +4,10 @@
 //  https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html )
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include "OGRGDALtools.hpp"
+#include "TriangleBVH.hpp"
 
 /**
 * @brief Recupere l'enveloppe d'une geometry en faisant une succession d'unions sur tous les polygones
@@ -155,233 +158,104 @@ OGRPoint* ProjectPointOnPolygon3D(OGRPoint* Point, OGRPolygon* Polygon)
 }
 
 /**
-* @brief Calcule la distance de Hausdorff unidirectionnelle entre un nuage de points et un ensemble de triangles
-* @param GeoPoints Correspond a la geometrie contenant le nuage de points et que l'on va projeter sur la seconde geometrie
-* @param Geo Correspond aux triangles sur lesquels seront projetes les points
+* @brief Recupere les sommets des anneaux exterieurs des polygones de Geo, sous forme de tableau de coordonnees
 */
-double Hausdorff(OGRMultiPolygon * GeoPoints, OGRMultiPolygon * Geo)
+static void GetExteriorPoints(OGRMultiPolygon * Geo, std::vector<TVec3d>& Points)
 {
-	std::vector<OGRPoint *> Points;
-
-	for (int i = 0; i < GeoPoints->getNumGeometries(); ++i)
+	for (int i = 0; i < Geo->getNumGeometries(); ++i)
 	{
-		OGRPolygon * Poly = (OGRPolygon *)GeoPoints->getGeometryRef(i);
-		OGRLinearRing * Ring = Poly->getExteriorRing();
+		OGRLinearRing * Ring = ((OGRPolygon *)Geo->getGeometryRef(i))->getExteriorRing();
+		if (Ring == nullptr)
+			continue;
 		for (int j = 0; j < Ring->getNumPoints(); ++j)
-		{
-			OGRPoint * Point = new OGRPoint;
-			Ring->getPoint(j, Point);
-			Points.push_back(Point);
-		}
+			Points.push_back(TVec3d(Ring->getX(j), Ring->getY(j), Ring->getZ(j)));
 	}
+}
 
-	for (int i = 0; i < Geo->getNumGeometries(); ++i) //On parcourt tous les polygones pour transformer les eventuels rectangles (ou autres polygones convexes a 4 cates) en deux triangles : temporaire, ne fonctionne que pour ces polygones precis
+/**
+* @brief Recupere les triangles de Geo (3 sommets par triangle) : les polygones a 4 cotes sont coupes en deux triangles, les autres polygones et les triangles d'aire inferieure a 0.01 sont ignores
+*/
+static void GetTriangles(OGRMultiPolygon * Geo, std::vector<TVec3d>& Triangles)
+{
+	for (int i = 0; i < Geo->getNumGeometries(); ++i)
 	{
-		OGRPolygon * Poly = (OGRPolygon *)Geo->getGeometryRef(i);
-		OGRLinearRing * Ring = Poly->getExteriorRing();
-		if (Ring->getNumPoints() == 5)
-		{
-			OGRPoint * P1 = new OGRPoint;
-			OGRPoint * P2 = new OGRPoint;
-			OGRPoint * P3 = new OGRPoint;
-			OGRPoint * P4 = new OGRPoint;
-			Ring->getPoint(0, P1);
-			Ring->getPoint(1, P2);
-			Ring->getPoint(2, P3);
-			Ring->getPoint(3, P4);
-			OGRLinearRing * Ring1 = new OGRLinearRing;
-			OGRLinearRing * Ring2 = new OGRLinearRing;
-			Ring1->addPoint(P1);
-			Ring1->addPoint(P2);
-			Ring1->addPoint(P3);
-			Ring1->addPoint(P1);
-			Ring2->addPoint(P1);
-			Ring2->addPoint(P3);
-			Ring2->addPoint(P4);
-			Ring2->addPoint(P1);
-
-			OGRPolygon * Poly1 = new OGRPolygon;
-			OGRPolygon * Poly2 = new OGRPolygon;
-			Poly1->addRingDirectly(Ring1);
-			Poly2->addRingDirectly(Ring2);
-
-			Geo->removeGeometry(i);
-			--i;
-			Geo->addGeometry(Poly1);
-			Geo->addGeometry(Poly2);
-		}
-	}
+		OGRLinearRing * Ring = ((OGRPolygon *)Geo->getGeometryRef(i))->getExteriorRing();
+		if (Ring == nullptr || Ring->getNumPoints() < 4 || Ring->getNumPoints() > 5) //Si la geometrie courante n'est ni un triangle ni un quadrilatere
+			continue;
 
-	double D = 0;
-	for (size_t i = 0; i < Points.size(); ++i)
-	{
-		int J = -1;
-		double D_1 = 10000;
-		OGRPoint * OgrP0 = Points.at(i);
-		TVec3d P0(OgrP0->getX(), OgrP0->getY(), OgrP0->getZ());
-		for (int j = 0; j < Geo->getNumGeometries(); ++j)
+		TVec3d P[4];
+		for (int j = 0; j < Ring->getNumPoints() - 1; ++j)
+			P[j] = TVec3d(Ring->getX(j), Ring->getY(j), Ring->getZ(j));
+
+		int Tri[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+		for (int t = 0; t < Ring->getNumPoints() - 3; ++t)
 		{
-			double D_2;
-			OGRPolygon * PolyTriangle = (OGRPolygon *)Geo->getGeometryRef(j);
-			OGRLinearRing * Triangle = PolyTriangle->getExteriorRing();
-			if (Triangle->getNumPoints() > 4 || Triangle->get_Area() < 0.01)//Si la geometry courante n'est pas un triangle
-			{
+			const TVec3d& P1 = P[Tri[t][0]];
+			const TVec3d& P2 = P[Tri[t][1]];
+			const TVec3d& P3 = P[Tri[t][2]];
+			if ((P2 - P1).cross(P3 - P1).length() * 0.5 < 0.01)
 				continue;
-			}
-			OGRPoint * OgrP1 = new OGRPoint; //Point du triangle
-			OGRPoint * OgrP2 = new OGRPoint;
-			OGRPoint * OgrP3 = new OGRPoint;
-			Triangle->getPoint(0, OgrP1);
-			Triangle->getPoint(1, OgrP2);
-			Triangle->getPoint(2, OgrP3);
-
-			TVec3d P1(OgrP1->getX(), OgrP1->getY(), OgrP1->getZ());
-			TVec3d P2(OgrP2->getX(), OgrP2->getY(), OgrP2->getZ());
-			TVec3d P3(OgrP3->getX(), OgrP3->getY(), OgrP3->getZ());
-
-			delete OgrP1;
-			delete OgrP2;
-			delete OgrP3;
-
-			TVec3d P1P0 = P0 - P1; //Vecteur P1P0
-			TVec3d P2P0 = P0 - P2;
-			TVec3d P3P0 = P0 - P3;
-
-			double nP1P0 = P1P0.length(); //Norme du vecteur P1P0
-			double nP2P0 = P2P0.length();
-			double nP3P0 = P3P0.length();
-
-			if (nP1P0 == 0 || nP2P0 == 0 || nP3P0 == 0) // Si le point P0 est confondu avec l'un des points du triangle
-			{
-				J = j;
-				D_1 = 0;
-				break;
-			}
-
-			TVec3d P1P2 = P2 - P1;//Vecteur P1P2
-			TVec3d P1P3 = P3 - P1;
-			TVec3d P2P3 = P3 - P2;
-
-			TVec3d Np(P1P2.y * P1P3.z - P1P2.z * P1P3.y, P1P2.z * P1P3.x - P1P2.x * P1P3.z, P1P2.x * P1P3.y - P1P2.y * P1P3.x); //Normal du triangle
-			double nNp = Np.length();
-
-			double cosa = (P1P0.x * Np.x + P1P0.y * Np.y + P1P0.z * Np.z) / (nP1P0 * nNp); //Calcul du cosinus de langle a entre Np et P1P0
-
-			double nP0P0_ = nP1P0 * cosa;
-			TVec3d P0P0_(-nP0P0_ * Np.x / nNp, -nP0P0_ * Np.y / nNp, -nP0P0_ * Np.z / nNp); //Vecteur P0P0_, P0_ etant le projete de P0 sur le plan du triangle
-
-			TVec3d P0_(P0.x + P0P0_.x, P0.y + P0P0_.y, P0.z + P0P0_.z); // Position du projete de P0 sur le plan du triangle
-
-			double s, t;//Coordonnees barycentriques du point P0_ par rapport au point P1 et aux vecteurs P1P2 et P1P3
-
-			t = (P1.y * P1P2.x - P1.x * P1P2.y + P1P2.y * P0_.x - P1P2.x * P0_.y) / (P1P2.y * P1P3.x - P1P2.x * P1P3.y);
-			s = (P0_.x - P1.x - t * P1P3.x) / P1P2.x;
-
-			if (t >= 0 && s >= 0 && t + s <= 1)//Le projete est dans le triangle
-			{
-				D_2 = nP0P0_;
-				if (D_1 > D_2)
-				{
-					J = j;
-					D_1 = D_2;
-				}
-			}
-			else//Le projete est en dehors du triangle
-			{
-				//On va donc le comparer aux trois arretes du triangle en le projetant a nouveau sur celles-ci
-				TVec3d P0_P1 = P1 - P0_;//Vecteur P0_P1
-				TVec3d P0_P2 = P2 - P0_;
-				TVec3d P0_P3 = P3 - P0_;
-				double nP0_P1 = P0_P1.length();//Norme du vecteur P0_P1
-				double nP0_P2 = P0_P2.length();
-
-				//Sur P1P2 :
-				TVec3d Temp(P0_P2.y * P0_P1.z - P0_P2.z * P0_P1.y, P0_P2.z * P0_P1.x - P0_P2.x * P0_P1.z, P0_P2.x * P0_P1.y - P0_P2.y * P0_P1.x);
-				TVec3d R(Temp.y * P1P2.z - Temp.z * P1P2.y, Temp.z * P1P2.x - Temp.x * P1P2.z, Temp.x * P1P2.y - Temp.y * P1P2.x); //Direction de P0_ -> P0__
-				double nR = R.length();
-
-				double cosg = (P0_P1.x * R.x + P0_P1.y * R.y + P0_P1.z * R.z) / (nP0_P1 * nR); //Calcul du cosinus de langle g entre R et P0_P1
-
-				double nP0_P0__ = nP0_P1 * cosg;
-				TVec3d P0_P0__(nP0_P0__ * R.x / nR, nP0_P0__ * R.y / nR, nP0_P0__ * R.z / nR); //Vecteur P0_P0__, P0__etant le projete de P0_ sur l'arrete courante du triangle
-				TVec3d P0__(P0_.x + P0_P0__.x, P0_.y + P0_P0__.y, P0_.z + P0_P0__.z); // Position du projete de P0_ sur l'arrete du triangle
-
-				double u = (P0__.x - P1.x) / (P1P2.x); //Position relative de P0__ sur le segment P1P2
-
-				if (u <= 0)
-					D_2 = nP1P0; //P0 est le plus proche de P1
-				else if (u >= 1)
-					D_2 = nP2P0; //P0 est le plus proche de P2
-				else
-					D_2 = sqrt(nP0_P0__ * nP0_P0__ + nP0P0_ * nP0P0_); //P0 est le plus proche de P0__
-
-				if (D_1 > D_2)
-				{
-					J = j;
-					D_1 = D_2;
-				}
-
-				//Sur P1P3 :
-				Temp = TVec3d(P0_P3.y * P0_P1.z - P0_P3.z * P0_P1.y, P0_P3.z * P0_P1.x - P0_P3.x * P0_P1.z, P0_P3.x * P0_P1.y - P0_P3.y * P0_P1.x);
-				R = TVec3d(Temp.y * P1P3.z - Temp.z * P1P3.y, Temp.z * P1P3.x - Temp.x * P1P3.z, Temp.x * P1P3.y - Temp.y * P1P3.x); //Direction de P0_ -> P0__
-				nR = R.length();
-
-				cosg = (P0_P1.x * R.x + P0_P1.y * R.y + P0_P1.z * R.z) / (nP0_P1 * nR); //Calcul du cosinus de langle g entre R et P0_P1
-
-				nP0_P0__ = nP0_P1 * cosg;
-				P0_P0__ = TVec3d(nP0_P0__ * R.x / nR, nP0_P0__ * R.y / nR, nP0_P0__ * R.z / nR); //Vecteur P0_P0__, P0__etant le projete de P0_ sur l'arrete courante du triangle
-				P0__ = TVec3d(P0_.x + P0_P0__.x, P0_.y + P0_P0__.y, P0_.z + P0_P0__.z); // Position du projete de P0_ sur l'arrete du triangle
-
-				u = (P0__.x - P1.x) / (P1P3.x); //Position relative de P0__ sur le segment P1P3
-
-				if (u <= 0)
-					D_2 = nP1P0; //P0 est le plus proche de P1
-				else if (u >= 1)
-					D_2 = nP3P0; //P0 est le plus proche de P3
-				else
-					D_2 = sqrt(nP0_P0__ * nP0_P0__ + nP0P0_ * nP0P0_); //P0 est le plus proche de P0__
-
-				if (D_1 > D_2)
-				{
-					J = j;
-					D_1 = D_2;
-				}
+			Triangles.push_back(P1);
+			Triangles.push_back(P2);
+			Triangles.push_back(P3);
+		}
+	}
+}
 
-				//Sur P2P3 :
-				Temp = TVec3d(P0_P3.y * P0_P2.z - P0_P3.z * P0_P2.y, P0_P3.z * P0_P2.x - P0_P3.x * P0_P2.z, P0_P3.x * P0_P2.y - P0_P3.y * P0_P2.x);
-				R = TVec3d(Temp.y * P2P3.z - Temp.z * P2P3.y, Temp.z * P2P3.x - Temp.x * P2P3.z, Temp.x * P2P3.y - Temp.y * P2P3.x); //Direction de P0_ -> P0__
-				nR = R.length();
+/**
+* @brief Calcule la distance de Hausdorff unidirectionnelle entre un nuage de points et un ensemble de triangles
+* @param GeoPoints Correspond a la geometrie contenant le nuage de points et que l'on va projeter sur la seconde geometrie
+* @param Geo Correspond aux triangles sur lesquels seront projetes les points
+*
+* Les coordonnees sont extraites une seule fois dans des tableaux, les triangles sont ranges dans un BVH (TriangleBVH) :
+* chaque point n'est compare qu'aux triangles proches. Les grands nuages de points sont repartis entre plusieurs threads.
+* Les distances sont bornees a 10000 (aucun triangle).
+*/
+double Hausdorff(OGRMultiPolygon * GeoPoints, OGRMultiPolygon * Geo)
+{
+	std::vector<TVec3d> Points;
+	GetExteriorPoints(GeoPoints, Points);
 
-				cosg = (P0_P2.x * R.x + P0_P2.y * R.y + P0_P2.z * R.z) / (nP0_P2 * nR); //Calcul du cosinus de langle g entre R et P0_P2
+	std::vector<TVec3d> Triangles;
+	GetTriangles(Geo, Triangles);
 
-				nP0_P0__ = nP0_P2 * cosg;
-				P0_P0__ = TVec3d(nP0_P0__ * R.x / nR, nP0_P0__ * R.y / nR, nP0_P0__ * R.z / nR); //Vecteur P0_P0__, P0__etant le projete de P0_ sur l'arrete courante du triangle
-				P0__ = TVec3d(P0_.x + P0_P0__.x, P0_.y + P0_P0__.y, P0_.z + P0_P0__.z); // Position du projete de P0_ sur l'arrete du triangle
+	const TriangleBVH BVH(Triangles);
+	const double DMax = 10000;
 
-				u = (P0__.x - P2.x) / (P2P3.x); //Position relative de P0__ sur le segment P2P3
+	// Distance maximale des points [First, Last) aux triangles
+	auto MaxDistance = [&Points, &BVH, DMax](size_t First, size_t Last)
+	{
+		double D2 = 0;
+		for (size_t i = First; i < Last; ++i)
+			D2 = std::max(D2, BVH.squaredDistance(Points[i], DMax * DMax));
+		return D2;
+	};
 
-				if (u <= 0)
-					D_2 = nP2P0; //P0 est le plus proche de P2
-				else if (u >= 1)
-					D_2 = nP3P0; //P0 est le plus proche de P3
-				else
-					D_2 = sqrt(nP0_P0__ * nP0_P0__ + nP0P0_ * nP0P0_); //P0 est le plus proche de P0__
+	const size_t BlockSize = 4096;
+	size_t BlockCount = (Points.size() + BlockSize - 1) / BlockSize;
+	unsigned int ThreadCount = (unsigned int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), BlockCount);
+	if (ThreadCount <= 1)
+		return sqrt(MaxDistance(0, Points.size()));
 
-				if (D_1 > D_2)
-				{
-					D_1 = D_2;
-					J = j;
-				}
-			}
-		}
-		if (D_1 > D)
-			D = D_1;
+	std::atomic<size_t> NextBlock(0);
+	std::vector<double> D2(ThreadCount, 0);
+	std::vector<std::thread> Threads;
+	for (unsigned int t = 0; t < ThreadCount; ++t)
+	{
+		Threads.push_back(std::thread([&, t]()
+		{
+			for (size_t Block = NextBlock++; Block < BlockCount; Block = NextBlock++)
+				D2[t] = std::max(D2[t], MaxDistance(Block * BlockSize, std::min(Points.size(), (Block + 1) * BlockSize)));
+		}));
 	}
-	return D;
+	for (std::thread& Thread : Threads)
+		Thread.join();
+
+	return sqrt(*std::max_element(D2.begin(), D2.end()));
 }
 
 /**
-* @brief Calcule la distance de Hausdorff entre deux batiments composes de triangles : methode basee sur "3D Distance from a Point to a Triangle", Mark W.Jones, 1995 (DistancePointTriangle.pdf).
+* @brief Calcule la distance de Hausdorff entre deux batiments composes de triangles : distance exacte des points aux triangles (point le plus proche de la face, d'une arete ou d'un sommet, cf. TriangleBVH).
 * @param Geo1 Geometrie correspondant au premier batiment
 * @param Geo2 Geometrie correspondant au second batiment
 */
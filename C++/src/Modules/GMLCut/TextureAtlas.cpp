@@ -0,0 +1,420 @@
+#include "TextureAtlas.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <gdal.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+
+// Call f(i) for i in [0, count[ on threadCount threads (0 : one per hardware thread)
+static void forEachParallel(size_t count, unsigned int threadCount, const std::function<void(size_t)>& f)
+{
+	threadCount = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = (unsigned int)std::min<size_t>(threadCount, count);
+
+	std::atomic<size_t> next(0);
+	auto work = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+			f(i);
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threadCount; t++)
+		workers.push_back(std::thread(work));
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+TextureAtlas::TextureAtlas(int maxSize, int padding) : _maxSize(maxSize), _padding(padding), _threadCount(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	for (citygml::Texture* texture : _textures)
+		delete texture;
+}
+
+void TextureAtlas::setThreadCount(unsigned int threadCount)
+{
+	_threadCount = threadCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int TextureAtlas::pack(TexturesCityGML* texturesList, const std::string& folderIN, const std::string& folderOUT, const std::string& name)
+{
+	static std::once_flag registered;
+	std::call_once(registered, []() { GDALAllRegister(); });
+
+	std::vector<Source> sources(texturesList->size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		Source& source = sources[i];
+		source.texture = &texturesList->getTextures()[i];
+		source.width = source.height = source.bands = 0;
+		source.packed = false;
+
+		const std::string& url = source.texture->Url;
+		bool absolute = !url.empty() && (url[0] == '/' || url[0] == '\\' || url.find(':') != std::string::npos);
+		source.path = (absolute || folderIN.empty()) ? url : folderIN + "/" + url;
+	}
+
+	forEachParallel(sources.size(), _threadCount, [&](size_t i)
+	{
+		sources[i].packed = prepareSource(sources[i]);
+	});
+
+	std::vector<Page> pages;
+	packRegions(sources, pages);
+	_pageUrls.clear();
+	if (pages.empty())
+		return 0;
+
+	forEachParallel(sources.size(), _threadCount, [&](size_t i)
+	{
+		if (sources[i].packed)
+			copyRegions(sources[i], pages);
+	});
+
+	VSIMkdir(folderOUT.c_str(), 0755); // fails if it already exists
+
+	std::vector<std::string>& urls = _pageUrls;
+	urls.assign(pages.size(), std::string());
+	forEachParallel(pages.size(), _threadCount, [&](size_t k)
+	{
+		urls[k] = name + "_atlas_" + std::to_string(k) + (pages[k].bands == 4 ? ".png" : ".jpg");
+		if (!writePage(pages[k], folderOUT + "/" + urls[k]))
+			std::cout << "TextureAtlas:.............................:[FAILED]: Cannot write '" << folderOUT << "/" << urls[k] << "'" << std::endl;
+	});
+
+	// One texture per page, the texture coordinates now refer to the page
+	std::vector<TextureCityGML> textures = texturesList->takeTextures();
+	std::vector<int> pageTextures(pages.size(), -1);
+	std::vector<TextureCityGML> result;
+	for (size_t t = 0; t < sources.size(); t++)
+	{
+		const Source& source = sources[t];
+		if (!source.packed)
+		{
+			result.push_back(std::move(textures[t]));
+			continue;
+		}
+
+		for (size_t i = 0; i < textures[t].ListPolygons.size(); i++)
+		{
+			TexturePolygonCityGML& poly = textures[t].ListPolygons[i];
+			if (source.polygonRegions[i] < 0)
+				continue;
+
+			const Region& region = source.regions[source.polygonRegions[i]];
+			const Page& page = pages[region.page];
+			for (TVec2f& uv : poly.TexUV)
+			{
+				double x = uv.x * source.width - region.x0 + region.x;
+				double y = (1. - uv.y) * source.height - region.y0 + region.y;
+				uv.x = (float)(x / page.width);
+				uv.y = (float)(1. - y / page.height);
+			}
+
+			int& pageTexture = pageTextures[region.page];
+			if (pageTexture < 0)
+			{
+				pageTexture = (int)result.size();
+				result.push_back(TextureCityGML());
+				result.back().Url = urls[region.page];
+				result.back().Wrap = citygml::Texture::WM_CLAMP;
+			}
+			result[pageTexture].ListPolygons.push_back(std::move(poly));
+		}
+	}
+	texturesList->setTextures(std::move(result));
+
+	return (int)pages.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool TextureAtlas::prepareSource(Source& source)
+{
+	const std::vector<TexturePolygonCityGML>& polygons = source.texture->ListPolygons;
+
+	GDALDatasetH dataset = GDALOpen(source.path.c_str(), GA_ReadOnly);
+	if (!dataset)
+		return false;
+	source.width = GDALGetRasterXSize(dataset);
+	source.height = GDALGetRasterYSize(dataset);
+	source.bands = GDALGetRasterCount(dataset);
+	GDALClose(dataset);
+	if (source.width <= 0 || source.height <= 0 || source.bands <= 0)
+		return false;
+
+	// Pixel rectangle of every polygon, with its margin
+	const double eps = 1e-3;
+	std::vector<Region> rects;
+	std::vector<int> owner(polygons.size(), -1);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		const std::vector<TVec2f>& TexUV = polygons[i].TexUV;
+		if (TexUV.empty())
+			continue;
+
+		double umin = DBL_MAX, vmin = DBL_MAX, umax = -DBL_MAX, vmax = -DBL_MAX;
+		for (const TVec2f& uv : TexUV)
+		{
+			umin = std::min<double>(umin, uv.x); umax = std::max<double>(umax, uv.x);
+			vmin = std::min<double>(vmin, uv.y); vmax = std::max<double>(vmax, uv.y);
+		}
+		if (umin < -eps || vmin < -eps || umax > 1. + eps || vmax > 1. + eps) // repeated texture
+			return false;
+
+		Region rect;
+		rect.x0 = std::max(0, (int)std::floor(umin * source.width) - _padding);
+		rect.x1 = std::min(source.width, (int)std::ceil(umax * source.width) + _padding);
+		rect.y0 = std::max(0, (int)std::floor((1. - vmax) * source.height) - _padding);
+		rect.y1 = std::min(source.height, (int)std::ceil((1. - vmin) * source.height) + _padding);
+		if (rect.x1 <= rect.x0) // degenerated polygon, at least one pixel
+		{
+			rect.x0 = std::min(rect.x0, source.width - 1);
+			rect.x1 = rect.x0 + 1;
+		}
+		if (rect.y1 <= rect.y0)
+		{
+			rect.y0 = std::min(rect.y0, source.height - 1);
+			rect.y1 = rect.y0 + 1;
+		}
+		rect.page = -1;
+		rect.x = rect.y = 0;
+
+		owner[i] = (int)rects.size();
+		rects.push_back(rect);
+	}
+
+	// Overlapping rectangles are merged until they are all disjoint, merged rectangles point to the one they were merged in
+	std::vector<int> mergedInto(rects.size(), -1);
+	for (bool merged = true; merged;)
+	{
+		merged = false;
+		for (size_t a = 0; a < rects.size(); a++)
+		{
+			if (mergedInto[a] >= 0)
+				continue;
+			for (size_t b = a + 1; b < rects.size(); b++)
+			{
+				if (mergedInto[b] >= 0)
+					continue;
+				if (rects[a].x0 < rects[b].x1 && rects[b].x0 < rects[a].x1 && rects[a].y0 < rects[b].y1 && rects[b].y0 < rects[a].y1)
+				{
+					rects[a].x0 = std::min(rects[a].x0, rects[b].x0); rects[a].x1 = std::max(rects[a].x1, rects[b].x1);
+					rects[a].y0 = std::min(rects[a].y0, rects[b].y0); rects[a].y1 = std::max(rects[a].y1, rects[b].y1);
+					mergedInto[b] = (int)a;
+					merged = true;
+				}
+			}
+		}
+	}
+
+	std::vector<int> index(rects.size(), -1);
+	source.regions.clear();
+	for (size_t r = 0; r < rects.size(); r++)
+	{
+		if (mergedInto[r] >= 0)
+			continue;
+		if (rects[r].x1 - rects[r].x0 > _maxSize || rects[r].y1 - rects[r].y0 > _maxSize)
+			return false;
+		index[r] = (int)source.regions.size();
+		source.regions.push_back(rects[r]);
+	}
+
+	source.polygonRegions.assign(polygons.size(), -1);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		int r = owner[i];
+		if (r < 0)
+			continue;
+		while (mergedInto[r] >= 0)
+			r = mergedInto[r];
+		source.polygonRegions[i] = index[r];
+	}
+
+	return !source.regions.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureAtlas::packRegions(std::vector<Source>& sources, std::vector<Page>& pages)
+{
+	std::vector<Region*> regions;
+	std::vector<int> bands;
+	for (Source& source : sources)
+	{
+		if (!source.packed)
+			continue;
+		for (Region& region : source.regions)
+		{
+			regions.push_back(&region);
+			bands.push_back((source.bands == 2 || source.bands >= 4) ? 4 : 3);
+		}
+	}
+
+	std::vector<size_t> order(regions.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+	{
+		return regions[a]->y1 - regions[a]->y0 > regions[b]->y1 - regions[b]->y0;
+	});
+
+	// Shelves of decreasing heights, a new page when the current one is full
+	int shelfX = 0, shelfY = 0, shelfHeight = 0;
+	for (size_t i : order)
+	{
+		Region& region = *regions[i];
+		int width = region.x1 - region.x0;
+		int height = region.y1 - region.y0;
+
+		if (shelfX + width > _maxSize)
+		{
+			shelfY += shelfHeight;
+			shelfX = shelfHeight = 0;
+		}
+		if (pages.empty() || shelfY + height > _maxSize)
+		{
+			Page page;
+			page.width = page.height = 0;
+			page.bands = 3;
+			pages.push_back(page);
+			shelfX = shelfY = shelfHeight = 0;
+		}
+
+		Page& page = pages.back();
+		region.page = (int)pages.size() - 1;
+		region.x = shelfX;
+		region.y = shelfY;
+		page.width = std::max(page.width, shelfX + width);
+		page.height = std::max(page.height, shelfY + height);
+		page.bands = std::max(page.bands, bands[i]);
+
+		shelfX += width;
+		shelfHeight = std::max(shelfHeight, height);
+	}
+
+	for (Page& page : pages)
+		page.pixels.assign((size_t)page.width * page.height * page.bands, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureAtlas::copyRegions(const Source& source, std::vector<Page>& pages)
+{
+	GDALDatasetH dataset = GDALOpen(source.path.c_str(), GA_ReadOnly);
+	if (!dataset)
+		return;
+
+	// Gray (+ alpha) or RGB (+ alpha) sources
+	bool gray = source.bands < 3;
+	int colorBands[3] = { 1, gray ? 1 : 2, gray ? 1 : 3 };
+	int alphaBand = gray ? (source.bands == 2 ? 2 : 0) : (source.bands >= 4 ? 4 : 0);
+
+	// The regions are disjoint in the pages : the sources are copied concurrently
+	for (const Region& region : source.regions)
+	{
+		Page& page = pages[region.page];
+		int width = region.x1 - region.x0;
+		int height = region.y1 - region.y0;
+		unsigned char* pixels = &page.pixels[((size_t)region.y * page.width + region.x) * page.bands];
+
+		GDALDatasetRasterIO(dataset, GF_Read, region.x0, region.y0, width, height, pixels, width, height, GDT_Byte,
+			3, colorBands, page.bands, page.width * page.bands, 1);
+
+		if (page.bands < 4)
+			continue;
+		if (alphaBand)
+		{
+			GDALDatasetRasterIO(dataset, GF_Read, region.x0, region.y0, width, height, pixels + 3, width, height, GDT_Byte,
+				1, &alphaBand, page.bands, page.width * page.bands, 1);
+		}
+		else
+		{
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+					pixels[((size_t)y * page.width + x) * page.bands + 3] = 255;
+		}
+	}
+
+	GDALClose(dataset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool TextureAtlas::writePage(const Page& page, const std::string& filename)
+{
+	GDALDriverH memory = GDALGetDriverByName("MEM");
+	GDALDriverH driver = GDALGetDriverByName(page.bands == 4 ? "PNG" : "JPEG");
+	if (!memory || !driver)
+		return false;
+
+	GDALDatasetH dataset = GDALCreate(memory, "", page.width, page.height, page.bands, GDT_Byte, nullptr);
+	if (!dataset)
+		return false;
+	GDALDatasetRasterIO(dataset, GF_Write, 0, 0, page.width, page.height, (void*)page.pixels.data(), page.width, page.height, GDT_Byte,
+		page.bands, nullptr, page.bands, page.width * page.bands, 1);
+
+	char** options = nullptr;
+	if (page.bands != 4)
+		options = CSLSetNameValue(options, "QUALITY", "90");
+	GDALDatasetH output = GDALCreateCopy(driver, filename.c_str(), dataset, FALSE, options, nullptr, nullptr);
+	CSLDestroy(options);
+	GDALClose(dataset);
+
+	if (!output)
+		return false;
+	GDALClose(output);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureAtlas::apply(citygml::CityModel* tile, const TexturesCityGML& texturesList)
+{
+	std::unordered_map<std::string, std::pair<const TexturePolygonCityGML*, citygml::Texture*>> polygons;
+	for (const TextureCityGML& Tex : texturesList.getTextures())
+	{
+		if (std::find(_pageUrls.begin(), _pageUrls.end(), Tex.Url) == _pageUrls.end())
+			continue;
+
+		citygml::Texture* texture = new citygml::Texture(Tex.Url);
+		texture->setUrl(Tex.Url);
+		_textures.push_back(texture);
+
+		for (const TexturePolygonCityGML& poly : Tex.ListPolygons)
+			polygons.insert(std::make_pair(poly.Id, std::make_pair(&poly, texture)));
+	}
+	if (polygons.empty())
+		return;
+
+	std::function<void(citygml::CityObject*)> applyObject = [&](citygml::CityObject* obj)
+	{
+		for (citygml::Geometry* Geometry : obj->getGeometries())
+		{
+			for (citygml::Polygon* PolygonCityGML : Geometry->getPolygons())
+			{
+				auto it = polygons.find(PolygonCityGML->getId());
+				if (it == polygons.end() || !PolygonCityGML->getTexture())
+					continue;
+
+				PolygonCityGML->getTexCoords() = it->second.first->TexUV;
+				PolygonCityGML->setTexture(it->second.second);
+			}
+		}
+		for (citygml::CityObject* child : obj->getChildren())
+			applyObject(child);
+	};
+
+	for (citygml::CityObject* obj : tile->getCityObjectsRoots())
+		applyObject(obj);
+}
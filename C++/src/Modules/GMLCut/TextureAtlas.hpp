@@ -0,0 +1,76 @@
+#ifndef TEXTUREATLAS_HPP
+#define TEXTUREATLAS_HPP
+
+#include <string>
+#include <vector>
+#include "../../CityModel/CityModel.hpp"
+#include "TextureCityGML.hpp"
+
+// Texture atlases of a tile : only the parts of the source images referenced by the texture coordinates of the
+// tile polygons are cropped (one region per group of overlapping polygons, with a margin of padding pixels
+// against bleeding) and packed in pages of at most maxSize x maxSize pixels, written next to the tile.
+//
+// Sources whose texture coordinates leave [0, 1] (repeated textures) or that cannot be read are left untouched.
+// The images are read and the pages written by a pool of threads, with GDAL.
+class TextureAtlas
+{
+public:
+	TextureAtlas(int maxSize = 4096, int padding = 2);
+	~TextureAtlas();
+
+	// Number of threads reading the sources and writing the pages (0, default : one per hardware thread)
+	void setThreadCount(unsigned int threadCount);
+
+	// Pack the textures of the list, whose urls are relative to folderIN, into the pages folderOUT/<name>_atlas_<k>.jpg
+	// (.png if a source has an alpha channel). The polygons of each page are moved to a single TextureCityGML
+	// whose Url is the page file name, and their TexUV are rewritten for the page. Returns the number of pages.
+	int pack(TexturesCityGML* texturesList, const std::string& folderIN, const std::string& folderOUT, const std::string& name);
+
+	// Make the polygons of tile (found by id) use the pages and the texture coordinates of texturesList.
+	// The page textures belong to this atlas, which must outlive the tile.
+	void apply(citygml::CityModel* tile, const TexturesCityGML& texturesList);
+
+private:
+	// Rectangle of a source image, in pixels (y downwards)
+	struct Region
+	{
+		int x0, y0, x1, y1;
+		int page;
+		int x, y;	// position in the page
+	};
+
+	struct Source
+	{
+		const TextureCityGML* texture;
+		std::string path;
+		int width, height, bands;
+		std::vector<Region> regions;
+		std::vector<int> polygonRegions;	// region of each polygon of the texture, -1 if it has no texture coordinates
+		bool packed;
+	};
+
+	struct Page
+	{
+		int width, height, bands;
+		std::vector<unsigned char> pixels;	// interleaved by pixel
+	};
+
+	// Read the size of the image and compute its regions, false if it cannot be packed
+	bool prepareSource(Source& source);
+
+	// Shelf packing of the regions of the packed sources, by decreasing height
+	void packRegions(std::vector<Source>& sources, std::vector<Page>& pages);
+
+	void copyRegions(const Source& source, std::vector<Page>& pages);
+
+	bool writePage(const Page& page, const std::string& filename);
+
+	int _maxSize;
+	int _padding;
+	unsigned int _threadCount;
+
+	std::vector<std::string> _pageUrls;	// file names of the pages written by the last pack
+	std::vector<citygml::Texture*> _textures;	// page textures given to the polygons by apply
+};
+
+#endif // !TEXTUREATLAS_HPP
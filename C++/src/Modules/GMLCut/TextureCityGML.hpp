@@ -8,6 +8,9 @@
 #ifndef __TEXTURECITYGML_HPP_
 #define __TEXTURECITYGML_HPP_
 ////////////////////////////////////////////////////////////////////////////////
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "../../CityModel/Vecs.hpp"
 #include "../../CityModel/CityModel.hpp"
@@ -22,4 +25,49 @@ struct TextureCityGML {
 	citygml::Texture::WrapMode Wrap;
 	std::vector<TexturePolygonCityGML> ListPolygons;
 };
+////////////////////////////////////////////////////////////////////////////////
+/// Textures of a tile, one per url in the order of their first use. The urls are interned in a hash map
+/// giving the index of their texture, the textures belong to the list.
+class TexturesCityGML {
+public:
+	/// Texture of url, created with wrap the first time url is seen
+	TextureCityGML& get(const std::string& url, citygml::Texture::WrapMode wrap)
+	{
+		std::pair<std::unordered_map<std::string, size_t>::iterator, bool> inserted = _index.insert(std::make_pair(url, _textures.size()));
+		if (inserted.second)
+		{
+			_textures.push_back(TextureCityGML());
+			_textures.back().Url = url;
+			_textures.back().Wrap = wrap;
+		}
+		return _textures[inserted.first->second];
+	}
+
+	const std::vector<TextureCityGML>& getTextures() const { return _textures; }
+
+	/// Move the textures out of the list, which is left empty
+	std::vector<TextureCityGML> takeTextures()
+	{
+		std::vector<TextureCityGML> textures;
+		textures.swap(_textures);
+		_index.clear();
+		return textures;
+	}
+
+	/// Replace all the textures, their urls must be distinct
+	void setTextures(std::vector<TextureCityGML>&& textures)
+	{
+		_textures = std::move(textures);
+		_index.clear();
+		for (size_t i = 0; i < _textures.size(); i++)
+			_index[_textures[i].Url] = i;
+	}
+
+	size_t size() const { return _textures.size(); }
+	bool empty() const { return _textures.empty(); }
+
+private:
+	std::vector<TextureCityGML> _textures;
+	std::unordered_map<std::string, size_t> _index;
+};
 #endif // __TEXTURECITYGML_HPP_
@@ -0,0 +1,198 @@
+#include "TriangleBVH.hpp"
+
+#include <algorithm>
+
+// Triangles per leaf
+static const uint32_t LEAF_SIZE = 4;
+
+TriangleBVH::TriangleBVH(const std::vector<TVec3d>& triangles)
+{
+	uint32_t count = (uint32_t)(triangles.size() / 3);
+	if (count == 0)
+		return;
+
+	std::vector<uint32_t> order(count);
+	std::vector<TVec3d> centroids(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		order[i] = i;
+		centroids[i] = (triangles[3 * i] + triangles[3 * i + 1] + triangles[3 * i + 2]) / 3.0;
+	}
+
+	_nodes.reserve(2 * (count / LEAF_SIZE + 1));
+	_nodes.push_back(Node());
+	build(0, 0, count, order, centroids);
+
+	// Triangles in the order of the leaves : the triangles of a leaf are read from a single block
+	_triangles.resize(3 * (size_t)count);
+	for (uint32_t i = 0; i < count; ++i)
+		for (int j = 0; j < 3; ++j)
+			_triangles[3 * (size_t)i + j] = triangles[3 * (size_t)order[i] + j];
+
+	// Boxes of the leaves, then of the inner nodes (children are always after their parent)
+	for (size_t n = _nodes.size(); n-- > 0;)
+	{
+		Node& node = _nodes[n];
+		for (int k = 0; k < 3; ++k)
+		{
+			node.min[k] = 1e300;
+			node.max[k] = -1e300;
+		}
+		if (node.count > 0)
+		{
+			for (size_t v = 3 * (size_t)node.first; v < 3 * (size_t)(node.first + node.count); ++v)
+				for (int k = 0; k < 3; ++k)
+				{
+					node.min[k] = std::min(node.min[k], _triangles[v][k]);
+					node.max[k] = std::max(node.max[k], _triangles[v][k]);
+				}
+		}
+		else
+		{
+			for (uint32_t c = node.first; c < node.first + 2; ++c)
+				for (int k = 0; k < 3; ++k)
+				{
+					node.min[k] = std::min(node.min[k], _nodes[c].min[k]);
+					node.max[k] = std::max(node.max[k], _nodes[c].max[k]);
+				}
+		}
+	}
+}
+
+void TriangleBVH::build(uint32_t node, uint32_t first, uint32_t count, std::vector<uint32_t>& order, const std::vector<TVec3d>& centroids)
+{
+	_nodes[node].first = first;
+	_nodes[node].count = count;
+	if (count <= LEAF_SIZE)
+		return;
+
+	double min[3] = { 1e300, 1e300, 1e300 };
+	double max[3] = { -1e300, -1e300, -1e300 };
+	for (uint32_t i = first; i < first + count; ++i)
+		for (int k = 0; k < 3; ++k)
+		{
+			min[k] = std::min(min[k], centroids[order[i]][k]);
+			max[k] = std::max(max[k], centroids[order[i]][k]);
+		}
+
+	int axis = 0;
+	for (int k = 1; k < 3; ++k)
+		if (max[k] - min[k] > max[axis] - min[axis])
+			axis = k;
+	if (max[axis] == min[axis]) // all the centroids are the same point : no split can separate them
+		return;
+
+	uint32_t half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&centroids, axis](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	uint32_t child = (uint32_t)_nodes.size();
+	_nodes.push_back(Node());
+	_nodes.push_back(Node());
+	_nodes[node].first = child;
+	_nodes[node].count = 0;
+
+	build(child, first, half, order, centroids);
+	build(child + 1, first + half, count - half, order, centroids);
+}
+
+double TriangleBVH::squaredDistance(const TVec3d& p, double maxSquaredDistance) const
+{
+	double best = maxSquaredDistance;
+	if (_nodes.empty() || squaredDistance(p, _nodes[0]) >= best)
+		return best;
+
+	uint32_t stack[64];
+	int size = 0;
+	stack[size++] = 0;
+	while (size > 0)
+	{
+		const Node& node = _nodes[stack[--size]];
+		if (node.count > 0)
+		{
+			const TVec3d* t = &_triangles[3 * (size_t)node.first];
+			for (uint32_t i = 0; i < node.count; ++i, t += 3)
+				best = std::min(best, squaredDistance(p, t[0], t[1], t[2]));
+			if (best == 0)
+				break;
+			continue;
+		}
+
+		// Nearest child visited first (pushed last), children farther than the best triangle are skipped
+		double d0 = squaredDistance(p, _nodes[node.first]);
+		double d1 = squaredDistance(p, _nodes[node.first + 1]);
+		uint32_t near = node.first, far = node.first + 1;
+		if (d1 < d0)
+		{
+			std::swap(d0, d1);
+			std::swap(near, far);
+		}
+		if (d1 < best)
+			stack[size++] = far;
+		if (d0 < best)
+			stack[size++] = near;
+	}
+	return best;
+}
+
+double TriangleBVH::squaredDistance(const TVec3d& p, const Node& node)
+{
+	double d = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		double e = std::max(std::max(node.min[k] - p[k], p[k] - node.max[k]), 0.0);
+		d += e * e;
+	}
+	return d;
+}
+
+// Closest point of the triangle by the Voronoi regions of its vertices, edges and face (Ericson, Real-Time Collision
+// Detection, 5.1.5).
+double TriangleBVH::squaredDistance(const TVec3d& p, const TVec3d& a, const TVec3d& b, const TVec3d& c)
+{
+	TVec3d ab = b - a;
+	TVec3d ac = c - a;
+	TVec3d ap = p - a;
+	double d1 = ab.dot(ap);
+	double d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0) // vertex a
+		return ap.dot(ap);
+
+	TVec3d bp = p - b;
+	double d3 = ab.dot(bp);
+	double d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3) // vertex b
+		return bp.dot(bp);
+
+	double vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) // edge ab
+	{
+		TVec3d q = ap - ab * (d1 / (d1 - d3));
+		return q.dot(q);
+	}
+
+	TVec3d cp = p - c;
+	double d5 = ab.dot(cp);
+	double d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6) // vertex c
+		return cp.dot(cp);
+
+	double vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) // edge ac
+	{
+		TVec3d q = ap - ac * (d2 / (d2 - d6));
+		return q.dot(q);
+	}
+
+	double va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) // edge bc
+	{
+		TVec3d q = bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		return q.dot(q);
+	}
+
+	// inside the face
+	double denom = 1 / (va + vb + vc);
+	TVec3d q = ap - ab * (vb * denom) - ac * (vc * denom);
+	return q.dot(q);
+}
@@ -0,0 +1,48 @@
+#ifndef TRIANGLEBVH_HPP
+#define TRIANGLEBVH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "../../CityModel/Vecs.hpp"
+
+// Bounding volume hierarchy over a triangle soup, for the nearest triangle queries of the Hausdorff distance.
+//
+// The triangles are flat arrays of coordinates (3 vertices per triangle), sorted so that the triangles of a node are
+// contiguous. Nodes are split at the median of the triangle centroids along the largest axis of their box, down to
+// leaves of a few triangles. A query visits the nearest child first and skips the nodes whose box is farther than
+// the closest triangle found so far : the distance of a point is O(log n) triangle tests for compact geometries.
+//
+// The tree is read only once built : queries may run concurrently.
+class TriangleBVH
+{
+public:
+	// triangles : 3 vertices per triangle
+	TriangleBVH(const std::vector<TVec3d>& triangles);
+
+	size_t getTriangleCount() const { return _triangles.size() / 3; }
+
+	// Squared distance from p to the nearest triangle, or maxSquaredDistance if no triangle is closer
+	double squaredDistance(const TVec3d& p, double maxSquaredDistance) const;
+
+	// Squared distance from p to the triangle abc (exact : closest point of the face, of an edge or a vertex)
+	static double squaredDistance(const TVec3d& p, const TVec3d& a, const TVec3d& b, const TVec3d& c);
+
+private:
+	struct Node
+	{
+		double min[3];
+		double max[3];
+		uint32_t first;	// leaf : first triangle, inner node : index of the first child (the second follows it)
+		uint32_t count;	// number of triangles of a leaf, 0 for an inner node
+	};
+
+	void build(uint32_t node, uint32_t first, uint32_t count, std::vector<uint32_t>& order, const std::vector<TVec3d>& centroids);
+
+	static double squaredDistance(const TVec3d& p, const Node& node);
+
+	std::vector<TVec3d> _triangles;	// 3 vertices per triangle, in the order of the leaves
+	std::vector<Node> _nodes;		// _nodes[0] is the root
+};
+
+#endif // !TRIANGLEBVH_HPP
@@ -1,124 +1,707 @@
 #include "Triangulate.hpp"
 
-bool Triangulate::Process(const MyVectorOfVertices & contour, MyVectorOfVertices & result)
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+namespace
 {
-	/* allocate and initialize list of Vertices in polygon */
+	// Vertex of a ring, in the circular list of its ring and in the list sorted by z-order
+	struct Node
+	{
+		Node(uint32_t index, double x, double y) : i(index), x(x), y(y) {}
+
+		uint32_t i;	// index in the contour
+		double x, y;	// projected coordinates
+		Node* prev = nullptr;
+		Node* next = nullptr;
+		int32_t z = 0;
+		Node* prevZ = nullptr;
+		Node* nextZ = nullptr;
+		bool steiner = false;
+	};
+
+	class Earcut
+	{
+	public:
+		Earcut(const std::vector<TVec2d>& points, std::vector<uint32_t>& triangles) : _points(points), _triangles(triangles) {}
+
+		void run(const std::vector<uint32_t>& holeIndices);
+
+	private:
+		Node* linkedList(uint32_t start, uint32_t end, bool clockwise);
+		Node* filterPoints(Node* start, Node* end = nullptr);
+		void earcutLinked(Node* ear, int pass);
+		bool isEar(Node* ear) const;
+		bool isEarHashed(Node* ear) const;
+		Node* cureLocalIntersections(Node* start);
+		void splitEarcut(Node* start);
+		Node* eliminateHoles(const std::vector<uint32_t>& holeIndices, Node* outerNode);
+		Node* eliminateHole(Node* hole, Node* outerNode);
+		Node* findHoleBridge(Node* hole, Node* outerNode) const;
+		void indexCurve(Node* start) const;
+		int32_t zOrder(double x, double y) const;
+		Node* splitPolygon(Node* a, Node* b);
+		Node* insertNode(uint32_t i, Node* last);
+		void addTriangle(const Node* a, const Node* b, const Node* c);
+
+		const std::vector<TVec2d>& _points;
+		std::vector<uint32_t>& _triangles;
+		std::deque<Node> _nodes;	// stable addresses
+
+		bool _hashed = false;
+		double _minX = 0., _minY = 0., _invSize = 0.;
+	};
+
+	double area(const Node* p, const Node* q, const Node* r)
+	{
+		return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+	}
 
-	int n = (int)contour.size();
-	if (n < 3) return false;
+	bool equals(const Node* p1, const Node* p2)
+	{
+		return p1->x == p2->x && p1->y == p2->y;
+	}
+
+	int sign(double value)
+	{
+		return (value > 0.) - (value < 0.);
+	}
+
+	// q on the segment pr, knowing that p, q and r are collinear
+	bool onSegment(const Node* p, const Node* q, const Node* r)
+	{
+		return q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) && q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+	}
+
+	bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2)
+	{
+		int o1 = sign(area(p1, q1, p2));
+		int o2 = sign(area(p1, q1, q2));
+		int o3 = sign(area(p2, q2, p1));
+		int o4 = sign(area(p2, q2, q1));
+
+		if (o1 != o2 && o3 != o4) return true;
+		if (o1 == 0 && onSegment(p1, p2, q1)) return true;
+		if (o2 == 0 && onSegment(p1, q2, q1)) return true;
+		if (o3 == 0 && onSegment(p2, p1, q2)) return true;
+		if (o4 == 0 && onSegment(p2, q1, q2)) return true;
+		return false;
+	}
+
+	bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+	{
+		return (cx - px) * (ay - py) >= (ax - px) * (cy - py)
+			&& (ax - px) * (by - py) >= (bx - px) * (ay - py)
+			&& (bx - px) * (cy - py) >= (cx - px) * (by - py);
+	}
+
+	// Diagonal ab intersects an edge of the polygon
+	bool intersectsPolygon(const Node* a, const Node* b)
+	{
+		const Node* p = a;
+		do
+		{
+			if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i && intersects(p, p->next, a, b))
+				return true;
+			p = p->next;
+		} while (p != a);
+		return false;
+	}
 
-	int *V = new int[n];
+	// Diagonal ab inside the polygon, near a
+	bool locallyInside(const Node* a, const Node* b)
+	{
+		return area(a->prev, a, a->next) < 0 ?
+			area(a, b, a->next) >= 0 && area(a, a->prev, b) >= 0 :
+			area(a, b, a->prev) < 0 || area(a, a->next, b) < 0;
+	}
 
-	/* we want a counter-clockwise polygon in V */
+	// Middle of the diagonal ab inside the polygon
+	bool middleInside(const Node* a, const Node* b)
+	{
+		const Node* p = a;
+		bool inside = false;
+		double px = (a->x + b->x) / 2.;
+		double py = (a->y + b->y) / 2.;
+		do
+		{
+			if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y && (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+				inside = !inside;
+			p = p->next;
+		} while (p != a);
+		return inside;
+	}
 
-	if (0.0f < Area(contour))
-		for (int v = 0; v < n; v++) V[v] = v;
-	else
-		for (int v = 0; v < n; v++) V[v] = (n - 1) - v;
+	bool isValidDiagonal(const Node* a, const Node* b)
+	{
+		return a->next->i != b->i && a->prev->i != b->i && !intersectsPolygon(a, b)
+			&& ((locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b) && (area(a->prev, a, b->prev) != 0. || area(a, b->prev, b) != 0.))
+				|| (equals(a, b) && area(a->prev, a, a->next) > 0 && area(b->prev, b, b->next) > 0));
+	}
+
+	bool sectorContainsSector(const Node* m, const Node* p)
+	{
+		return area(m->prev, m, p->prev) < 0 && area(p->next, m, m->next) < 0;
+	}
+
+	Node* getLeftmost(Node* start)
+	{
+		Node* p = start;
+		Node* leftmost = start;
+		do
+		{
+			if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+				leftmost = p;
+			p = p->next;
+		} while (p != start);
+		return leftmost;
+	}
 
-	int nv = n;
+	void removeNode(Node* p)
+	{
+		p->next->prev = p->prev;
+		p->prev->next = p->next;
+		if (p->prevZ) p->prevZ->nextZ = p->nextZ;
+		if (p->nextZ) p->nextZ->prevZ = p->prevZ;
+	}
 
-	/*  remove nv-2 Vertices, creating 1 triangle every time */
-	int count = 2 * nv;   /* error detection */
+	// Simon Tatham's linked list merge sort, on z
+	Node* sortLinked(Node* list)
+	{
+		int inSize = 1;
+		int numMerges;
+		do
+		{
+			Node* p = list;
+			Node* tail = nullptr;
+			list = nullptr;
+			numMerges = 0;
+
+			while (p)
+			{
+				numMerges++;
+				Node* q = p;
+				int pSize = 0;
+				for (int i = 0; i < inSize; i++)
+				{
+					pSize++;
+					q = q->nextZ;
+					if (!q) break;
+				}
+				int qSize = inSize;
+
+				while (pSize > 0 || (qSize > 0 && q))
+				{
+					Node* e;
+					if (pSize != 0 && (qSize == 0 || !q || p->z <= q->z))
+					{
+						e = p;
+						p = p->nextZ;
+						pSize--;
+					}
+					else
+					{
+						e = q;
+						q = q->nextZ;
+						qSize--;
+					}
+
+					if (tail) tail->nextZ = e;
+					else list = e;
+					e->prevZ = tail;
+					tail = e;
+				}
+				p = q;
+			}
+			tail->nextZ = nullptr;
+			inSize *= 2;
+		} while (numMerges > 1);
+
+		return list;
+	}
 
-	for (int m = 0, v = nv - 1; nv > 2; )
+	void Earcut::run(const std::vector<uint32_t>& holeIndices)
 	{
-		/* if we loop, it is probably a non-simple polygon */
-		if (0 >= (count--))
+		uint32_t outerLen = holeIndices.empty() ? (uint32_t)_points.size() : holeIndices[0];
+		Node* outerNode = linkedList(0, outerLen, true);
+		if (!outerNode || outerNode->next == outerNode->prev)
+			return;
+
+		if (!holeIndices.empty())
+			outerNode = eliminateHoles(holeIndices, outerNode);
+
+		// Large rings : z-order hashing of the vertices, within the bounding box of the outer ring
+		if (_points.size() > 80)
 		{
-			//** Triangulate: ERROR - probable bad polygon!
-			return false;
+			double maxX = _points[0].x, maxY = _points[0].y;
+			_minX = maxX;
+			_minY = maxY;
+			for (uint32_t i = 1; i < outerLen; i++)
+			{
+				_minX = std::min(_minX, _points[i].x);
+				_minY = std::min(_minY, _points[i].y);
+				maxX = std::max(maxX, _points[i].x);
+				maxY = std::max(maxY, _points[i].y);
+			}
+			double size = std::max(maxX - _minX, maxY - _minY);
+			_invSize = size != 0. ? 32767. / size : 0.;
+			_hashed = _invSize != 0.;
 		}
 
-		/* three consecutive vertices in current polygon, <u,v,w> */
-		int u = v; if (nv <= u) u = 0;     /* previous */
-		v = u + 1; if (nv <= v) v = 0;     /* new v    */
-		int w = v + 1; if (nv <= w) w = 0;     /* next     */
+		earcutLinked(outerNode, 0);
+	}
+
+	// Circular list of the ring [start, end), with the given winding
+	Node* Earcut::linkedList(uint32_t start, uint32_t end, bool clockwise)
+	{
+		double sum = 0.;
+		for (uint32_t i = start, j = end - 1; i < end; j = i++)
+			sum += (_points[j].x - _points[i].x) * (_points[i].y + _points[j].y);
 
-		if (Snip(contour, u, v, w, nv, V))
+		Node* last = nullptr;
+		if (clockwise == (sum > 0.))
+			for (uint32_t i = start; i < end; i++) last = insertNode(i, last);
+		else
+			for (uint32_t i = end; i-- > start; ) last = insertNode(i, last);
+
+		if (last && equals(last, last->next))
 		{
-			int a, b, c, s, t;
+			removeNode(last);
+			last = last->next;
+		}
+		return last;
+	}
 
-			/* true names of the vertices */
-			a = V[u]; b = V[v]; c = V[w];
+	// Remove duplicated and collinear points
+	Node* Earcut::filterPoints(Node* start, Node* end)
+	{
+		if (!start) return start;
+		if (!end) end = start;
 
-			/* output Triangle */
-			result.push_back(contour[a]);
-			result.push_back(contour[b]);
-			result.push_back(contour[c]);
+		Node* p = start;
+		bool again;
+		do
+		{
+			again = false;
+			if (!p->steiner && (equals(p, p->next) || area(p->prev, p, p->next) == 0.))
+			{
+				removeNode(p);
+				p = end = p->prev;
+				if (p == p->next) break;
+				again = true;
+			}
+			else
+				p = p->next;
+		} while (again || p != end);
+
+		return end;
+	}
 
-			m++;
+	// Clip the ears of the ring. Pass 0 : plain ear clipping, 1 : after filtering, 2 : after curing the local
+	// self-intersections, then the ring is split in two.
+	void Earcut::earcutLinked(Node* ear, int pass)
+	{
+		if (!ear) return;
 
-			/* remove v from remaining polygon */
-			for (s = v, t = v + 1; t < nv; s++, t++) V[s] = V[t]; nv--;
+		if (pass == 0 && _hashed)
+			indexCurve(ear);
 
-			/* resest error detection counter */
-			count = 2 * nv;
+		Node* stop = ear;
+		while (ear->prev != ear->next)
+		{
+			Node* prev = ear->prev;
+			Node* next = ear->next;
+
+			if (_hashed ? isEarHashed(ear) : isEar(ear))
+			{
+				addTriangle(prev, ear, next);
+				removeNode(ear);
+
+				// skipping the next vertex leads to less sliver triangles
+				ear = next->next;
+				stop = next->next;
+				continue;
+			}
+
+			ear = next;
+
+			// A whole loop without ear
+			if (ear == stop)
+			{
+				if (pass == 0)
+					earcutLinked(filterPoints(ear), 1);
+				else if (pass == 1)
+					earcutLinked(cureLocalIntersections(filterPoints(ear)), 2);
+				else if (pass == 2)
+					splitEarcut(ear);
+				break;
+			}
 		}
 	}
 
+	// No other vertex of the ring inside the triangle of the ear
+	bool Earcut::isEar(Node* ear) const
+	{
+		const Node* a = ear->prev;
+		const Node* b = ear;
+		const Node* c = ear->next;
+		if (area(a, b, c) >= 0) return false; // reflex
 
+		double x0 = std::min(a->x, std::min(b->x, c->x)), y0 = std::min(a->y, std::min(b->y, c->y));
+		double x1 = std::max(a->x, std::max(b->x, c->x)), y1 = std::max(a->y, std::max(b->y, c->y));
 
-	delete[] V;
+		const Node* p = c->next;
+		while (p != a)
+		{
+			if (p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1
+				&& pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && area(p->prev, p, p->next) >= 0)
+				return false;
+			p = p->next;
+		}
+		return true;
+	}
 
-	return true;
-}
+	// Same, only for the vertices whose z-order is within the one of the bounding box of the ear
+	bool Earcut::isEarHashed(Node* ear) const
+	{
+		const Node* a = ear->prev;
+		const Node* b = ear;
+		const Node* c = ear->next;
+		if (area(a, b, c) >= 0) return false; // reflex
 
-double Triangulate::Area(const MyVectorOfVertices & contour)
-{
-	int n = (int)contour.size();
+		double x0 = std::min(a->x, std::min(b->x, c->x)), y0 = std::min(a->y, std::min(b->y, c->y));
+		double x1 = std::max(a->x, std::max(b->x, c->x)), y1 = std::max(a->y, std::max(b->y, c->y));
 
-	double A = 0.0f;
+		int32_t minZ = zOrder(x0, y0);
+		int32_t maxZ = zOrder(x1, y1);
 
-	for (int p = n - 1, q = 0; q < n; p = q++)
+		auto blocks = [&](const Node* p)
+		{
+			return p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 && p != a && p != c
+				&& pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && area(p->prev, p, p->next) >= 0;
+		};
+
+		// look for points inside the triangle in both directions
+		const Node* p = ear->prevZ;
+		const Node* n = ear->nextZ;
+		while (p && p->z >= minZ && n && n->z <= maxZ)
+		{
+			if (blocks(p)) return false;
+			p = p->prevZ;
+			if (blocks(n)) return false;
+			n = n->nextZ;
+		}
+		while (p && p->z >= minZ)
+		{
+			if (blocks(p)) return false;
+			p = p->prevZ;
+		}
+		while (n && n->z <= maxZ)
+		{
+			if (blocks(n)) return false;
+			n = n->nextZ;
+		}
+		return true;
+	}
+
+	// Clip the triangles of the local self-intersections (a, p, p->next, b with ab crossing p p->next)
+	Node* Earcut::cureLocalIntersections(Node* start)
 	{
-		A += contour[p].x/*GetX()*/*contour[q].y/*GetY()*/ - contour[q].x/*GetX()*/*contour[p].y/*GetY()*/;
+		Node* p = start;
+		do
+		{
+			Node* a = p->prev;
+			Node* b = p->next->next;
+
+			if (!equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a))
+			{
+				addTriangle(a, p, b);
+				removeNode(p);
+				removeNode(p->next);
+				p = start = b;
+			}
+			p = p->next;
+		} while (p != start);
+
+		return filterPoints(p);
 	}
-	return A * 0.5f;
-}
 
-bool Triangulate::InsideTriangle(double Ax, double Ay, double Bx, double By, double Cx, double Cy, double Px, double Py)
-{
-	double ax, ay, bx, by, cx, cy, apx, apy, bpx, bpy, cpx, cpy;
-	double cCROSSap, bCROSScp, aCROSSbp;
+	// Split the ring along a valid diagonal and triangulate both halves
+	void Earcut::splitEarcut(Node* start)
+	{
+		Node* a = start;
+		do
+		{
+			Node* b = a->next->next;
+			while (b != a->prev)
+			{
+				if (a->i != b->i && isValidDiagonal(a, b))
+				{
+					Node* c = splitPolygon(a, b);
+
+					a = filterPoints(a, a->next);
+					c = filterPoints(c, c->next);
+
+					earcutLinked(a, 0);
+					earcutLinked(c, 0);
+					return;
+				}
+				b = b->next;
+			}
+			a = a->next;
+		} while (a != start);
+	}
+
+	// Link every hole to the outer ring, from the leftmost hole to the rightmost one
+	Node* Earcut::eliminateHoles(const std::vector<uint32_t>& holeIndices, Node* outerNode)
+	{
+		std::vector<Node*> queue;
+		for (size_t i = 0; i < holeIndices.size(); i++)
+		{
+			uint32_t start = holeIndices[i];
+			uint32_t end = i + 1 < holeIndices.size() ? holeIndices[i + 1] : (uint32_t)_points.size();
+			if (start >= end)
+				continue;
+			Node* list = linkedList(start, end, false);
+			if (!list)
+				continue;
+			if (list == list->next) list->steiner = true;
+			queue.push_back(getLeftmost(list));
+		}
+
+		std::sort(queue.begin(), queue.end(), [](const Node* a, const Node* b) { return a->x < b->x; });
+
+		for (Node* hole : queue)
+			outerNode = eliminateHole(hole, outerNode);
+
+		return outerNode;
+	}
+
+	Node* Earcut::eliminateHole(Node* hole, Node* outerNode)
+	{
+		Node* bridge = findHoleBridge(hole, outerNode);
+		if (!bridge)
+			return outerNode;
 
-	ax = Cx - Bx;  ay = Cy - By;
-	bx = Ax - Cx;  by = Ay - Cy;
-	cx = Bx - Ax;  cy = By - Ay;
-	apx = Px - Ax;  apy = Py - Ay;
-	bpx = Px - Bx;  bpy = Py - By;
-	cpx = Px - Cx;  cpy = Py - Cy;
+		Node* bridgeReverse = splitPolygon(bridge, hole);
 
-	aCROSSbp = ax * bpy - ay * bpx;
-	cCROSSap = cx * apy - cy * apx;
-	bCROSScp = bx * cpy - by * cpx;
+		// filter the collinear points around the cuts
+		filterPoints(bridgeReverse, bridgeReverse->next);
+		return filterPoints(bridge, bridge->next);
+	}
+
+	// David Eberly's algorithm : vertex of the outer ring visible from the leftmost vertex of the hole
+	Node* Earcut::findHoleBridge(Node* hole, Node* outerNode) const
+	{
+		Node* p = outerNode;
+		double hx = hole->x;
+		double hy = hole->y;
+		double qx = -std::numeric_limits<double>::infinity();
+		Node* m = nullptr;
+
+		// segment of the outer ring left of the hole point and the closest to it on the horizontal ray
+		do
+		{
+			if (hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+			{
+				double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+				if (x <= hx && x > qx)
+				{
+					qx = x;
+					m = p->x < p->next->x ? p : p->next;
+					if (x == hx) return m; // the hole touches the outer segment
+				}
+			}
+			p = p->next;
+		} while (p != outerNode);
+
+		if (!m) return nullptr;
+
+		// the vertices inside the triangle (hole point, intersection, segment end) may block the view : keep the one
+		// with the smallest angle to the ray
+		const Node* stop = m;
+		double mx = m->x;
+		double my = m->y;
+		double tanMin = std::numeric_limits<double>::infinity();
+
+		p = m;
+		do
+		{
+			if (hx >= p->x && p->x >= mx && hx != p->x
+				&& pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+			{
+				double tan = std::fabs(hy - p->y) / (hx - p->x);
+				if (locallyInside(p, hole) && (tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && sectorContainsSector(m, p))))))
+				{
+					m = p;
+					tanMin = tan;
+				}
+			}
+			p = p->next;
+		} while (p != stop);
+
+		return m;
+	}
+
+	// z-order of every vertex, and list sorted by z
+	void Earcut::indexCurve(Node* start) const
+	{
+		Node* p = start;
+		do
+		{
+			if (p->z == 0)
+				p->z = zOrder(p->x, p->y);
+			p->prevZ = p->prev;
+			p->nextZ = p->next;
+			p = p->next;
+		} while (p != start);
+
+		p->prevZ->nextZ = nullptr;
+		p->prevZ = nullptr;
 
-	return ((aCROSSbp >= 0.0f) && (bCROSScp >= 0.0f) && (cCROSSap >= 0.0f));
+		sortLinked(p);
+	}
+
+	// Interleaved bits of the coordinates, on 15 bits each within the bounding box
+	int32_t Earcut::zOrder(double x, double y) const
+	{
+		int32_t ix = (int32_t)((x - _minX) * _invSize);
+		int32_t iy = (int32_t)((y - _minY) * _invSize);
+
+		ix = (ix | (ix << 8)) & 0x00FF00FF;
+		ix = (ix | (ix << 4)) & 0x0F0F0F0F;
+		ix = (ix | (ix << 2)) & 0x33333333;
+		ix = (ix | (ix << 1)) & 0x55555555;
+
+		iy = (iy | (iy << 8)) & 0x00FF00FF;
+		iy = (iy | (iy << 4)) & 0x0F0F0F0F;
+		iy = (iy | (iy << 2)) & 0x33333333;
+		iy = (iy | (iy << 1)) & 0x55555555;
+
+		return ix | (iy << 1);
+	}
+
+	// Link a and b with a bridge : the ring is split in two if a and b are on the same ring, a hole is merged
+	// into the outer ring otherwise. Returns the copy of b.
+	Node* Earcut::splitPolygon(Node* a, Node* b)
+	{
+		_nodes.emplace_back(a->i, a->x, a->y);
+		Node* a2 = &_nodes.back();
+		_nodes.emplace_back(b->i, b->x, b->y);
+		Node* b2 = &_nodes.back();
+		Node* an = a->next;
+		Node* bp = b->prev;
+
+		a->next = b;
+		b->prev = a;
+
+		a2->next = an;
+		an->prev = a2;
+
+		b2->next = a2;
+		a2->prev = b2;
+
+		bp->next = b2;
+		b2->prev = bp;
+
+		return b2;
+	}
+
+	Node* Earcut::insertNode(uint32_t i, Node* last)
+	{
+		_nodes.emplace_back(i, _points[i].x, _points[i].y);
+		Node* p = &_nodes.back();
+
+		if (!last)
+		{
+			p->prev = p;
+			p->next = p;
+		}
+		else
+		{
+			p->next = last->next;
+			p->prev = last;
+			last->next->prev = p;
+			last->next = p;
+		}
+		return p;
+	}
+
+	void Earcut::addTriangle(const Node* a, const Node* b, const Node* c)
+	{
+		_triangles.push_back(a->i);
+		_triangles.push_back(b->i);
+		_triangles.push_back(c->i);
+	}
 }
 
-bool Triangulate::Snip(const MyVectorOfVertices & contour, int u, int v, int w, int n, int * V)
+bool Triangulate::Process(const MyVectorOfVertices & contour, std::vector<uint32_t> & triangles)
 {
-	int p;
-	double Ax, Ay, Bx, By, Cx, Cy, Px, Py;
-
-	Ax = contour[V[u]].x/*GetX()*/;
-	Ay = contour[V[u]].y/*GetY()*/;
+	return Process(contour, std::vector<uint32_t>(), triangles);
+}
 
-	Bx = contour[V[v]].x/*GetX()*/;
-	By = contour[V[v]].y/*GetY()*/;
+bool Triangulate::Process(const MyVectorOfVertices & contour, const std::vector<uint32_t> & holeIndices, std::vector<uint32_t> & triangles)
+{
+	uint32_t outerLen = holeIndices.empty() ? (uint32_t)contour.size() : holeIndices[0];
+	if (outerLen < 3 || outerLen > contour.size())
+		return false;
 
-	Cx = contour[V[w]].x/*GetX()*/;
-	Cy = contour[V[w]].y/*GetY()*/;
+	// Normal of the outer ring (Newell), the polygon is projected along its largest coordinate
+	TVec3d normal;
+	for (uint32_t i = 0, j = outerLen - 1; i < outerLen; j = i++)
+	{
+		normal.x += (contour[j].y - contour[i].y) * (contour[j].z + contour[i].z);
+		normal.y += (contour[j].z - contour[i].z) * (contour[j].x + contour[i].x);
+		normal.z += (contour[j].x - contour[i].x) * (contour[j].y + contour[i].y);
+	}
+	double nx = std::fabs(normal.x), ny = std::fabs(normal.y), nz = std::fabs(normal.z);
+	if (nx == 0. && ny == 0. && nz == 0.)
+		return false;
 
-	if (EPSILON > (((Bx - Ax)*(Cy - Ay)) - ((By - Ay)*(Cx - Ax)))) return false;
+	std::vector<TVec2d> points;
+	points.reserve(contour.size());
+	for (const TVec5d& v : contour)
+	{
+		if (nz >= nx && nz >= ny) points.push_back(TVec2d(v.x, v.y));
+		else if (nx >= ny) points.push_back(TVec2d(v.y, v.z));
+		else points.push_back(TVec2d(v.z, v.x));
+	}
 
-	for (p = 0; p < n; p++)
+	size_t first = triangles.size();
+	Earcut(points, triangles).run(holeIndices);
+	if (triangles.size() == first)
+		return false;
+
+	// The triangles all have the same winding : give them the one of the outer ring
+	double ringArea = 0.;
+	for (uint32_t i = 0, j = outerLen - 1; i < outerLen; j = i++)
+		ringArea += points[j].x * points[i].y - points[i].x * points[j].y;
+	double triangleArea = 0.;
+	for (size_t t = first; t < triangles.size(); t += 3)
 	{
-		if ((p == u) || (p == v) || (p == w)) continue;
-		Px = contour[V[p]].x/*GetX()*/;
-		Py = contour[V[p]].y/*GetY()*/;
-		if (InsideTriangle(Ax, Ay, Bx, By, Cx, Cy, Px, Py)) return false;
+		const TVec2d& a = points[triangles[t]];
+		const TVec2d& b = points[triangles[t + 1]];
+		const TVec2d& c = points[triangles[t + 2]];
+		triangleArea += (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
 	}
+	if ((ringArea > 0.) != (triangleArea > 0.))
+		for (size_t t = first; t < triangles.size(); t += 3)
+			std::swap(triangles[t + 1], triangles[t + 2]);
 
 	return true;
 }
+
+double Triangulate::Area(const MyVectorOfVertices & contour)
+{
+	int n = (int)contour.size();
+
+	double A = 0.0f;
+
+	for (int p = n - 1, q = 0; q < n; p = q++)
+	{
+		A += contour[p].x/*GetX()*/*contour[q].y/*GetY()*/ - contour[q].x/*GetX()*/*contour[p].y/*GetY()*/;
+	}
+	return A * 0.5f;
+}
@@ -1,119 +1,35 @@
-// COTD Entry submitted by John W. Ratcliff [jratcliff@verant.com]
-
-// ** THIS IS A CODE SNIPPET WHICH WILL EFFICIEINTLY TRIANGULATE ANY
-// ** POLYGON/CONTOUR (without holes) AS A STATIC CLASS.  THIS SNIPPET
-// ** IS COMPRISED OF 3 FILES, TRIANGULATE.H, THE HEADER FILE FOR THE
-// ** TRIANGULATE BASE CLASS, TRIANGULATE.CPP, THE IMPLEMENTATION OF
-// ** THE TRIANGULATE BASE CLASS, AND TEST.CPP, A SMALL TEST PROGRAM
-// ** DEMONSTRATING THE USAGE OF THE TRIANGULATOR.  THE TRIANGULATE
-// ** BASE CLASS ALSO PROVIDES TWO USEFUL HELPER METHODS, ONE WHICH
-// ** COMPUTES THE AREA OF A POLYGON, AND ANOTHER WHICH DOES AN EFFICENT
-// ** POINT IN A TRIANGLE TEST.
-// ** SUBMITTED BY JOHN W. RATCLIFF (jratcliff@verant.com) July 22, 2000
-
 #ifndef TRIANGULATE_HPP
-
 #define TRIANGULATE_HPP
 
-/*****************************************************************/
-/** Static class to triangulate any contour/polygon efficiently **/
-/** You should replace Vector2d with whatever your own Vector   **/
-/** class might be.  Does not support polygons with holes.      **/
-/** Uses STL vectors to represent a dynamic array of vertices.  **/
-/** This code snippet was submitted to FlipCode.com by          **/
-/** John W. Ratcliff (jratcliff@verant.com) on July 22, 2000    **/
-/** I did not write the original code/algorithm for this        **/
-/** this triangulator, in fact, I can't even remember where I   **/
-/** found it in the first place.  However, I did rework it into **/
-/** the following black-box static class so you can make easy   **/
-/** use of it in your own code.  Simply replace Vector2d with   **/
-/** whatever your own Vector implementation might be.           **/
-/*****************************************************************/
-
+#include <cstdint>
+#include <vector>
 
-#include <vector>  // Include STL vector class.
-
-#include "../../CityModel/Vecs.hpp" // MT
-class Vector3d // MT
-{
-public:
-	Vector3d(double x, double y, double z)
-	{
-		Set(x, y, z);
-	};
+#include "../../CityModel/Vecs.hpp"
 
-	double GetX(void) const { return mX; };
-
-	double GetY(void) const { return mY; };
-
-	double GetZ(void) const { return mZ; };
-
-	void Set(double x, double y, double z)
-	{
-		mX = x;
-		mY = y;
-		mZ = z;
-	};
-private:
-	double mX;
-	double mY;
-	double mZ;
-};
-
-class Vector2d
-{
-public:
-	Vector2d(double x, double y)
-	{
-		Set(x, y);
-	};
-
-	double GetX(void) const { return mX; };
-
-	double GetY(void) const { return mY; };
-
-	void  Set(double x, double y)
-	{
-		mX = x;
-		mY = y;
-	};
-private:
-	double mX;
-	double mY;
-};
-
-// Typedef an STL vector of vertices which are used to represent
-// a polygon/contour and a series of triangles.
-//typedef std::vector< Vector2d > MyVectorOfVertices;
-//typedef std::vector< Vector3d > MyVectorOfVertices;
 typedef std::vector< TVec5d > MyVectorOfVertices; // TVec5d (for 3D + UV) // MT
 
-static const double EPSILON = 0.0000000001f;
-
+// Ear clipping triangulation of polygons with holes, after earcut (https://github.com/mapbox/earcut, ISC license),
+// the triangulator of the Unity side (earcut.cs).
+//
+// The rings are circular doubly linked lists of their vertices : removing an ear is O(1). Above 80 vertices, the
+// vertices are also sorted along a z-order curve, so that an ear is only checked against the vertices of its bounding
+// box. Holes are bridged to the outer ring first. Self-intersecting rings are cured (local intersections), then
+// split along a valid diagonal when no ear is left.
+//
+// The polygon is triangulated in the plane of its largest projection (x, y for the terrain), the triangles have the
+// winding of the outer ring.
 class Triangulate
 {
 public:
+	// Triangulate the open ring contour : 3 indices into contour per triangle, appended to triangles.
+	// Returns false if no triangle could be made (less than 3 vertices, or a flat ring).
+	static bool Process(const MyVectorOfVertices &contour, std::vector<uint32_t> &triangles);
 
-	// triangulate a contour/polygon, places results in STL vector
-	// as series of triangles.
-	static bool Process(const MyVectorOfVertices &contour,
-		MyVectorOfVertices &result);
+	// Same, contour holds the outer ring then the holes, holeIndices the index of the first vertex of every hole
+	static bool Process(const MyVectorOfVertices &contour, const std::vector<uint32_t> &holeIndices, std::vector<uint32_t> &triangles);
 
-	// compute area of a contour/polygon
+	// compute area of a contour/polygon (x, y)
 	static double Area(const MyVectorOfVertices &contour);
-
-	// decide if point Px/Py is inside triangle defined by
-	// (Ax,Ay) (Bx,By) (Cx,Cy)
-	static bool InsideTriangle(double Ax, double Ay,
-		double Bx, double By,
-		double Cx, double Cy,
-		double Px, double Py);
-
-
-private:
-	static bool Snip(const MyVectorOfVertices &contour, int u, int v, int w, int n, int *V);
-
 };
 
 #endif
-
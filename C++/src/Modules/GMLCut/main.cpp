@@ -63,7 +63,7 @@ int main(int argc, char* argv[])
 
 	if (assignOrCut) {
         // Assign mode
-		std::vector<TextureCityGML*> texturesList;
+		TexturesCityGML texturesList;
 		CityModel* tile = gmlcut->assign(cityModel, &texturesList, TVec2d(xmin, ymin), TVec2d(xmin + xmax, ymin + ymax), filename);
 
 		// Convert to .obj only if there is at least one CityObject
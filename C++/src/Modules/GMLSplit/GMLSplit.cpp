@@ -1,7 +1,50 @@
 #include "GMLSplit.hpp"
 
-GMLSplit::GMLSplit(std::string name) : Module(name)
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <thread>
+
+GMLSplit::GMLSplit(std::string name) : Module(name), _threadCount(0), _textureAtlas(false), _gmlOutput(false)
+{
+}
+
+void GMLSplit::setThreadCount(unsigned int threadCount)
+{
+	_threadCount = threadCount;
+}
+
+void GMLSplit::setTextureAtlas(bool textureAtlas)
+{
+	_textureAtlas = textureAtlas;
+}
+
+void GMLSplit::setGMLOutput(bool gmlOutput)
+{
+	_gmlOutput = gmlOutput;
+}
+
+void GMLSplit::setChangedAreas(const std::vector<citygml::Envelope>& areas)
 {
+	_changedAreas = areas;
+}
+
+// Remove the files of a tile written by a previous split : .obj, .mtl, .qmesh, .gml and atlas pages
+static void removeTileFiles(const std::string& outputFolder, const std::string& name)
+{
+	std::string path = outputFolder + "/" + name;
+	for (const char* extension : { ".obj", ".mtl", ".qmesh", ".gml" })
+		std::remove((path + extension).c_str());
+	for (int k = 0; ; k++)
+	{
+		std::string page = path + "_atlas_" + std::to_string(k);
+		bool png = std::remove((page + ".png").c_str()) == 0;
+		bool jpg = std::remove((page + ".jpg").c_str()) == 0;
+		if (!png && !jpg)
+			break;
+	}
 }
 
 void GMLSplit::split(std::string & filename, citygml::CityModel * cityModel, GMLCut * gmlCut, GMLtoOBJ * gmlToObj, int tileX, int tileY, std::string outputLocation)
@@ -16,25 +59,87 @@ void GMLSplit::split(std::string & filename, citygml::CityModel * cityModel, GML
 	TVec3d Upper = cityModel->getEnvelope().getUpperBound();
 
 	TVec2d MinTile((int)(Lower.x / tileX) * tileX, (int)(Lower.y / tileY) * tileY);
-	TVec2d MaxTile((int)(Upper.x / tileX) * tileX, (int)(Upper.y / tileY) * tileY);
 
-	for (int x = (int)MinTile.x; x <= (int)MaxTile.x; x += tileX)
+	// Tiles overlapping the changed areas
+	std::set<std::pair<int, int>> changedTiles;
+	for (const citygml::Envelope& area : _changedAreas)
+		for (int i = (int)std::floor((area.getLowerBound().x - MinTile.x) / tileX); i <= (int)std::floor((area.getUpperBound().x - MinTile.x) / tileX); i++)
+			for (int j = (int)std::floor((area.getLowerBound().y - MinTile.y) / tileY); j <= (int)std::floor((area.getUpperBound().y - MinTile.y) / tileY); j++)
+				changedTiles.insert(std::make_pair(i, j));
+
+	// Single pass over the model : every object goes to the tile containing its centroid, empty tiles are never visited
+	std::map<std::pair<int, int>, TexturesCityGML> texturesLists;
+	std::map<std::pair<int, int>, citygml::CityModel*> assigned = gmlCut->assignTiles(cityModel, &texturesLists, MinTile, TVec2d(tileX, tileY), _changedAreas.empty() ? nullptr : &changedTiles);
+	std::vector<std::pair<std::pair<int, int>, citygml::CityModel*>> tiles(assigned.begin(), assigned.end());
+	const std::string outputFolder = "cut_output_obj";
+	if (!_changedAreas.empty())
 	{
-		for (int y = (int)MinTile.y; y <= (int)MaxTile.y; y += tileY)
+		// A tile left without objects is not written : its files from a previous split are outdated
+		for (const std::pair<int, int>& index : changedTiles)
 		{
-			std::vector<TextureCityGML*> texturesList;
-			citygml::CityModel* tile = gmlCut->assign(cityModel, &texturesList, TVec2d(x, y), TVec2d(x + tileX, y + tileY), filename);
+			if (assigned.count(index))
+				continue;
+			std::string name = std::to_string((int)(MinTile.x / tileX) + index.first) + "_" + std::to_string((int)(MinTile.y / tileY) + index.second);
+			std::cout << "\t [EMPTY TILE]....................[" << name << "]" << std::endl;
+			removeTileFiles(outputFolder, name);
+		}
+	}
+
+	unsigned int threadCount = _threadCount > 0 ? _threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = (unsigned int)std::min<size_t>(threadCount, tiles.size());
+	std::cout << "\t [TILES]....................[" << tiles.size() << "]" << std::endl;
+	std::cout << "\t [THREADS]....................[" << threadCount << "]" << std::endl;
+
+	// Texture urls are relative to the CityGML file
+	std::string folderIN = filename.find_last_of("/\\") != std::string::npos ? filename.substr(0, filename.find_last_of("/\\")) : ".";
+
+	// The export state (file, vertex counter, materials) is per thread
+	std::atomic<size_t> nextTile(0);
+	auto processTiles = [&]()
+	{
+		std::unique_ptr<GMLtoOBJ> exporter(gmlToObj->Clone());
+		CityGMLWriter writer("citygmlwriter");
+
+		for (size_t i = nextTile++; i < tiles.size(); i = nextTile++)
+		{
+			int x = (int)MinTile.x + tiles[i].first.first * tileX;
+			int y = (int)MinTile.y + tiles[i].first.second * tileY;
+			citygml::CityModel* tile = tiles[i].second;
+			std::string name = std::to_string((int)(x / tileX)) + "_" + std::to_string((int)(y / tileY));
 
 			// Convert to .obj only if there is at least one CityObject
 			if (tile->getCityObjectsRoots().size() > 0) {
-				std::string outputFolder = "cut_output_obj";
-				std::string filename = outputFolder + "/" + std::to_string((int)(x / tileX)) + "_" + std::to_string((int)(y / tileY)) + ".gml";
+				std::string filename = outputFolder + "/" + name + ".gml";
+
+				// The atlas owns the page textures of the tile until it is exported
+				TextureAtlas atlas;
+				if (_textureAtlas) {
+					TexturesCityGML& textures = texturesLists.find(tiles[i].first)->second;
+					atlas.setThreadCount(threadCount > 1 ? 1 : 0); // tiles are already processed in parallel
+					atlas.pack(&textures, folderIN, outputFolder, name);
+					atlas.apply(tile, textures);
+				}
 
-				gmlToObj->setGMLFilename(filename);
-				gmlToObj->createMyOBJ(*tile, outputFolder);
+				exporter->setGMLFilename(filename);
+				// Tiles share the same quantisation grid, so that their borders match
+				exporter->setQuantizationBounds(TVec3d(x, y, Lower.z), TVec3d(x + tileX, y + tileY, Upper.z));
+				exporter->createMyOBJ(*tile, outputFolder);
+
+				// Same textures (and atlases) as the .obj
+				if (_gmlOutput)
+					writer.write(*tile, filename);
 			}
+			else if (!_changedAreas.empty())
+				removeTileFiles(outputFolder, name);
 		}
-	}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threadCount; t++)
+		workers.push_back(std::thread(processTiles));
+	processTiles();
+	for (std::thread& worker : workers)
+		worker.join();
 
 
 	std::cout << "[SPLIT GML FILE]...............................[DONE]" << std::endl;
@@ -4,7 +4,9 @@
 #include <iostream>
 #include "../Module.hpp"
 #include "../GMLCut/GMLCut.hpp"
+#include "../GMLCut/TextureAtlas.hpp"
 #include "../GMLtoOBJ/GMLtoOBJ.hpp"
+#include "../XMLParser/CityGMLWriter.hpp"
 #include "../../CityModel/CityModel.hpp"
 
 class GMLSplit : public Module
@@ -12,10 +14,27 @@ class GMLSplit : public Module
 public:
 	GMLSplit(std::string name);
 
+	// Tiles are processed in parallel, each thread exports with its own copy of gmlToObj
 	void split(std::string & filename, citygml::CityModel * cityModel, GMLCut * gmlCut, GMLtoOBJ * gmlToObj, int tileX, int tileY, std::string outputLocation);
 
-private:
+	// Number of threads used by split, 0 (default) : one per core
+	void setThreadCount(unsigned int threadCount);
+
+	// Pack the textures of every tile into atlases written next to its .obj (see TextureAtlas)
+	void setTextureAtlas(bool textureAtlas);
+
+	// Also write every tile as a CityGML file next to its .obj, from the model (see CityGMLWriter)
+	void setGMLOutput(bool gmlOutput);
 
+	// Only export the tiles overlapping one of these areas (the envelopes returned by CityModel::applyTransition),
+	// the other tiles are not assigned nor written. Empty (default) : every tile.
+	void setChangedAreas(const std::vector<citygml::Envelope>& areas);
+
+private:
+	unsigned int _threadCount;
+	bool _textureAtlas;
+	bool _gmlOutput;
+	std::vector<citygml::Envelope> _changedAreas;
 };
 
 #endif // !GMLSPLIT_HPP
@@ -1,9 +1,31 @@
 #include "GMLtoOBJ.hpp"
 
+#include <filesystem>
+#include <mutex>
+
 GMLtoOBJ::GMLtoOBJ(std::string name) : Module(name)
 {
 }
 
+GMLtoOBJ* GMLtoOBJ::Clone() const
+{
+	GMLtoOBJ* clone = new GMLtoOBJ(_name);
+	clone->setLowerBoundCoord(lowerBoundX, lowerBoundY, lowerBoundZ);
+	clone->setQuantizedOutput(m_quantized);
+	return clone;
+}
+
+void GMLtoOBJ::makeDirectory(const std::string& path)
+{
+	static std::mutex mutex;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::error_code error;
+	std::filesystem::create_directories(path, error);
+	if (error)
+		std::cout << "[ERROR]:.............................:[Cannot create " << path << ": " << error.message() << "]" << std::endl;
+}
+
 void GMLtoOBJ::processOutputLocation(std::string & arg)
 {
 	std::string toMatch = ".obj";
@@ -12,22 +34,10 @@ void GMLtoOBJ::processOutputLocation(std::string & arg)
 	if (arg.empty()) {
 		// Default procedure, output location : "output/obj/<filename>.obj"
 
-		// Create output directory
-		int cmdResult = system("mkdir output");
-		if (cmdResult == 0) {
-			//std::cout << "[DIRECTORY CREATED] : 'output'." << std::endl;
-		}
+		// Create output and obj directories
+		makeDirectory("output/obj");
 
-		// Create obj directory
-		cmdResult = system("cd output && mkdir obj");
-		if (cmdResult == 0) {
-			//std::cout << "[DIRECTORY CREATED] : 'output/obj'." << std::endl;
-
-			outputLocation = "output/obj/" + eraseExtension(this->gmlFilename) + ".obj";
-		}
-		else { // already exist
-			outputLocation = "output/obj/" + eraseExtension(this->gmlFilename) + ".obj";
-		}
+		outputLocation = "output/obj/" + eraseExtension(this->gmlFilename) + ".obj";
 	}
 	// 2. Test if arg is filename (.obj)
 	else if (arg.size() >= toMatch.size() && arg.compare(arg.size() - toMatch.size(), toMatch.size(), toMatch) == 0) {
@@ -36,18 +46,10 @@ void GMLtoOBJ::processOutputLocation(std::string & arg)
 	}
 	// 3. Test if it's a directory and test if it exists
 	else {
-		std::string cmd;
-		if (arg.back() == '/' || arg.back() == '\\') {
-			cmd = "mkdir " + arg.substr(0, arg.size() - 1);
-		}
-		else {
-			cmd = "mkdir " + arg;
+		if (arg.back() != '/' && arg.back() != '\\')
 			arg.append("/");
-		}
-
-		std::cout << "[COMMAND]: " << cmd << std::endl;
 
-		int cmdResult = system(cmd.c_str());
+		makeDirectory(arg);
 		outputLocation = arg.append(eraseExtension(this->gmlFilename).append(".obj"));
 	}
 }
@@ -69,12 +71,22 @@ void GMLtoOBJ::processOutputLocation(std::string & arg)
 		vertexCounter = 1;
 		texturCounter = 0;
 
+		m_compressor = MeshCompressor();
+		if (m_hasQuantizationBounds)
+			m_compressor.setBounds(m_quantizationMin, m_quantizationMax);
+		m_hasQuantizationBounds = false;
+
 		processCityModel(cityModel);
 
 		file.close();
 		std::string mtlOutput = outputLocation;
 		exportMaterials(mtlOutput.replace(mtlOutput.end() - 3,mtlOutput.end(),"mtl"));
 
+		if (m_quantized) {
+			std::string qmeshOutput = outputLocation;
+			exportQuantizedMesh(qmeshOutput.replace(qmeshOutput.end() - 3, qmeshOutput.end(), "qmesh"));
+		}
+
 		std::cout << "OBJconverter:.............................:[OK]" << std::endl;
 	}else {
 	 	std::cout << "OBJconverter:.............................:[FAILED]: Problem with filepath: '" << outputLocation << "'" << std::endl;
@@ -135,14 +147,18 @@ void GMLtoOBJ::processGeometries(const citygml::CityObject & cityObject)
 
 			citygml::Polygon * poly = cityObject.getGeometry(geoIdx)->getPolygons()[polygonIdx];
 
+			std::string mat;
 			if (poly->getTexture()) {
-				std::string mat = poly->getTexture()->getUrl();
+				mat = poly->getTexture()->getUrl();
 				mat = mat.substr(mat.find_last_of('/') + 1);
 				mat = mat.substr(0, mat.find_last_of('.'));
 				file << "usemtl " << mat << "\n";
 				m_materials[mat] = poly->getTexture()->getUrl(); // add material to map, will be used by exportMaterials
 			}
 
+			if (m_quantized)
+				m_compressor.addPolygon(*poly, mat);
+
 			int size = poly->getVertices().size();
 			for (const TVec3d& v : poly->getVertices())
 			{
@@ -213,6 +229,49 @@ void GMLtoOBJ::exportMaterials(const std::string& filename)
 	mat.close();
 }
 
+void GMLtoOBJ::exportQuantizedMesh(const std::string& filename)
+{
+	QuantizedMesh mesh, decoded;
+	std::vector<uint8_t> data = m_compressor.compress(&mesh);
+	std::ofstream qmesh(filename, std::ios::out | std::ios::binary);
+	qmesh.write((const char*)data.data(), data.size());
+	if (!qmesh) {
+		std::cout << "QMESHconverter:...........................:[FAILED]: Problem with filepath: '" << filename << "'" << std::endl;
+		return;
+	}
+	qmesh.close();
+
+	// Size report : text OBJ, plain binary mesh (floats, 32-bit indices) and quantised + compressed mesh
+	std::ifstream obj(outputLocation, std::ios::in | std::ios::binary | std::ios::ate);
+	size_t objSize = obj ? (size_t)obj.tellg() : 0;
+	size_t triangles = m_compressor.getTriangleCount();
+	double perTriangle = triangles > 0 ? 1.0 / triangles : 0.0;
+
+	std::cout << "QMESH filename =>" << filename << std::endl;
+	std::cout << "\t [TRIANGLES]....................[" << triangles << "]" << std::endl;
+	std::cout << "\t [BYTES/TRIANGLE OBJ]....................[" << objSize * perTriangle << "]" << std::endl;
+	std::cout << "\t [BYTES/TRIANGLE BINARY]....................[" << m_compressor.getRawSize() * perTriangle << "]" << std::endl;
+	std::cout << "\t [BYTES/TRIANGLE QMESH]....................[" << data.size() * perTriangle << "]" << std::endl;
+
+	// Round trip : the file must decode to the mesh that was encoded
+	bool roundTrip = MeshCompressor::decompress(data, decoded) && decoded == mesh;
+	std::cout << "\t [ROUND TRIP]....................[" << (roundTrip ? "OK" : "FAILED") << "]" << std::endl;
+
+	m_compressor = MeshCompressor();
+}
+
+void GMLtoOBJ::setQuantizedOutput(bool quantized)
+{
+	this->m_quantized = quantized;
+}
+
+void GMLtoOBJ::setQuantizationBounds(const TVec3d& boundsMin, const TVec3d& boundsMax)
+{
+	this->m_hasQuantizationBounds = true;
+	this->m_quantizationMin = boundsMin;
+	this->m_quantizationMax = boundsMax;
+}
+
 void GMLtoOBJ::setLowerBoundCoord(double newX, double newY, double newZ)
 {
 	this->lowerBoundX = newX;
@@ -7,6 +7,7 @@
 #include <float.h>
 #include "../Module.hpp"
 #include "../../CityModel/CityModel.hpp"
+#include "MeshCompressor.hpp"
 
 using namespace citygml;
 
@@ -15,6 +16,10 @@ class GMLtoOBJ : public Module
 public:
     GMLtoOBJ(std::string name);
 
+	// New exporter with the same settings (lower bound, .qmesh output) and its own output state (file, counters, materials).
+	// Used to export several tiles in parallel.
+	GMLtoOBJ* Clone() const;
+
 	void processOutputLocation(std::string & arg);
 
     void createMyOBJ(const citygml::CityModel& cModel, std::string argOutputLoc);
@@ -28,8 +33,18 @@ public:
 	void setGMLFilename(const std::string & filename);
 	void setLowerBoundCoord(double newX, double newY, double newZ);
 
+	// Also write a quantised and compressed binary mesh (.qmesh) next to each .obj (see MeshCompressor)
+	void setQuantizedOutput(bool quantized);
+	// Quantisation bounds of the next .qmesh (world coordinates), e.g. the tile bounds.
+	// Without bounds the mesh bounding box is used.
+	void setQuantizationBounds(const TVec3d& boundsMin, const TVec3d& boundsMax);
+
 private:
+	// Create a directory and its parents if they do not exist, the calls from several exporters are serialised
+	static void makeDirectory(const std::string& path);
+
 	void exportMaterials(const std::string& filename);
+	void exportQuantizedMesh(const std::string& filename);
 
 	std::ofstream file;
 	std::string gmlFilename;
@@ -42,6 +57,12 @@ private:
 	double lowerBoundX = 0.0;
 	double lowerBoundY = 0.0;
 	double lowerBoundZ = 0.0;
+
+	bool m_quantized = false;
+	bool m_hasQuantizationBounds = false;
+	TVec3d m_quantizationMin;
+	TVec3d m_quantizationMax;
+	MeshCompressor m_compressor;
 };
 
 #endif // !GMLTOOBJ_HPP
@@ -0,0 +1,862 @@
+#include "MeshCompressor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+////////////////////////////////////////////////////////////////////////////////
+// Quantisation
+
+static uint16_t quantize(double value, double min, double max)
+{
+	if (max <= min)
+		return 0;
+	double q = (value - min) / (max - min) * 65535.0;
+	return (uint16_t)std::max(0.0, std::min(65535.0, std::floor(q + 0.5)));
+}
+
+static double dequantize(uint16_t value, double min, double max)
+{
+	return min + (max - min) * value / 65535.0;
+}
+
+static float signNotZero(float v)
+{
+	return v < 0.f ? -1.f : 1.f;
+}
+
+// Octahedral mapping of an unit vector on 2 x 8 bits
+static void encodeOctahedral(const TVec3f& n, uint8_t& ox, uint8_t& oy)
+{
+	float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	float px = 0.f, py = 0.f;
+	if (l1 > 0.f)
+	{
+		px = n.x / l1;
+		py = n.y / l1;
+		if (n.z < 0.f)
+		{
+			float tx = (1.f - std::fabs(py)) * signNotZero(px);
+			float ty = (1.f - std::fabs(px)) * signNotZero(py);
+			px = tx;
+			py = ty;
+		}
+	}
+	ox = (uint8_t)std::floor((px * 0.5f + 0.5f) * 255.f + 0.5f);
+	oy = (uint8_t)std::floor((py * 0.5f + 0.5f) * 255.f + 0.5f);
+}
+
+static TVec3f decodeOctahedral(uint8_t ox, uint8_t oy)
+{
+	float px = ox / 255.f * 2.f - 1.f;
+	float py = oy / 255.f * 2.f - 1.f;
+	float pz = 1.f - std::fabs(px) - std::fabs(py);
+	if (pz < 0.f)
+	{
+		float tx = (1.f - std::fabs(py)) * signNotZero(px);
+		float ty = (1.f - std::fabs(px)) * signNotZero(py);
+		px = tx;
+		py = ty;
+	}
+	return TVec3f(px, py, pz).normal();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Byte streams
+
+static void writeVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static bool readVarint(const uint8_t*& cur, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && cur < end; shift += 7)
+	{
+		uint8_t b = *cur++;
+		value |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static void writeDouble(std::vector<uint8_t>& out, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 8; i++)
+		out.push_back((uint8_t)(bits >> (8 * i)));
+}
+
+static bool readDouble(const uint8_t*& cur, const uint8_t* end, double& value)
+{
+	if (end - cur < 8)
+		return false;
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; i++)
+		bits |= (uint64_t)cur[i] << (8 * i);
+	cur += 8;
+	memcpy(&value, &bits, sizeof(bits));
+	return true;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+	return (uint64_t)((v << 1) ^ (v >> 63));
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Entropy coding : static order-0 rANS with 12-bit probabilities, one frequency table per stream
+
+static const uint32_t RANS_SCALE_BITS = 12;
+static const uint32_t RANS_SCALE = 1u << RANS_SCALE_BITS;
+static const uint32_t RANS_LOW = 1u << 23;
+
+enum StreamMode { STREAM_RAW = 0, STREAM_RANS = 1 };
+
+static void normalizeFrequencies(const std::vector<uint8_t>& data, uint32_t freqs[256])
+{
+	uint64_t counts[256] = { 0 };
+	for (uint8_t b : data)
+		counts[b]++;
+
+	uint32_t total = 0;
+	int largest = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		freqs[s] = 0;
+		if (counts[s] == 0)
+			continue;
+		freqs[s] = std::max<uint32_t>(1, (uint32_t)(counts[s] * RANS_SCALE / data.size()));
+		total += freqs[s];
+		if (counts[s] > counts[largest])
+			largest = s;
+	}
+
+	// Give the rounding error to the most frequent symbol, take it from the others if it is not enough
+	while (total != RANS_SCALE)
+	{
+		if (total < RANS_SCALE)
+		{
+			freqs[largest] += RANS_SCALE - total;
+			total = RANS_SCALE;
+		}
+		else
+		{
+			uint32_t excess = total - RANS_SCALE;
+			if (freqs[largest] > excess)
+			{
+				freqs[largest] -= excess;
+				total = RANS_SCALE;
+			}
+			else
+			{
+				for (int s = 0; s < 256 && total > RANS_SCALE; s++)
+				{
+					if (freqs[s] > 1)
+					{
+						freqs[s]--;
+						total--;
+					}
+				}
+			}
+		}
+	}
+}
+
+static void writeStream(std::vector<uint8_t>& out, const std::vector<uint8_t>& data)
+{
+	writeVarint(out, data.size());
+	if (data.empty())
+		return;
+
+	uint32_t freqs[256], starts[256];
+	normalizeFrequencies(data, freqs);
+	uint32_t start = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		starts[s] = start;
+		start += freqs[s];
+	}
+
+	std::vector<uint8_t> table;
+	int used = 0;
+	for (int s = 0; s < 256; s++)
+		if (freqs[s])
+			used++;
+	writeVarint(table, used);
+	for (int s = 0; s < 256; s++)
+	{
+		if (!freqs[s])
+			continue;
+		table.push_back((uint8_t)s);
+		writeVarint(table, freqs[s]);
+	}
+
+	// Symbols are encoded backwards so that the decoder reads them forwards
+	std::vector<uint8_t> encoded;
+	encoded.reserve(data.size());
+	uint32_t x = RANS_LOW;
+	for (size_t i = data.size(); i-- > 0;)
+	{
+		uint32_t freq = freqs[data[i]];
+		uint32_t xMax = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * freq;
+		while (x >= xMax)
+		{
+			encoded.push_back((uint8_t)x);
+			x >>= 8;
+		}
+		x = ((x / freq) << RANS_SCALE_BITS) + (x % freq) + starts[data[i]];
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		encoded.push_back((uint8_t)x);
+		x >>= 8;
+	}
+	std::reverse(encoded.begin(), encoded.end());
+
+	if (table.size() + encoded.size() < data.size())
+	{
+		out.push_back(STREAM_RANS);
+		out.insert(out.end(), table.begin(), table.end());
+		writeVarint(out, encoded.size());
+		out.insert(out.end(), encoded.begin(), encoded.end());
+	}
+	else
+	{
+		out.push_back(STREAM_RAW);
+		out.insert(out.end(), data.begin(), data.end());
+	}
+}
+
+static bool readStream(const uint8_t*& cur, const uint8_t* end, std::vector<uint8_t>& data)
+{
+	uint64_t size;
+	if (!readVarint(cur, end, size))
+		return false;
+	data.clear();
+	if (size == 0)
+		return true;
+	if (cur >= end)
+		return false;
+
+	uint8_t mode = *cur++;
+	if (mode == STREAM_RAW)
+	{
+		if ((uint64_t)(end - cur) < size)
+			return false;
+		data.assign(cur, cur + size);
+		cur += size;
+		return true;
+	}
+	if (mode != STREAM_RANS)
+		return false;
+
+	uint32_t freqs[256] = { 0 }, starts[256];
+	uint64_t used, freq, encodedSize;
+	if (!readVarint(cur, end, used) || used > 256)
+		return false;
+	for (uint64_t i = 0; i < used; i++)
+	{
+		if (cur >= end)
+			return false;
+		uint8_t s = *cur++;
+		if (!readVarint(cur, end, freq) || freq > RANS_SCALE)
+			return false;
+		freqs[s] = (uint32_t)freq;
+	}
+
+	std::vector<uint8_t> symbols(RANS_SCALE);
+	uint32_t start = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		starts[s] = start;
+		if (start + freqs[s] > RANS_SCALE)
+			return false;
+		std::fill(symbols.begin() + start, symbols.begin() + start + freqs[s], (uint8_t)s);
+		start += freqs[s];
+	}
+	if (start != RANS_SCALE)
+		return false;
+
+	if (!readVarint(cur, end, encodedSize) || encodedSize < 4 || (uint64_t)(end - cur) < encodedSize)
+		return false;
+	const uint8_t* in = cur;
+	const uint8_t* inEnd = cur + encodedSize;
+	cur = inEnd;
+
+	uint32_t x = ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+	in += 4;
+	data.resize(size);
+	for (size_t i = 0; i < size; i++)
+	{
+		uint32_t slot = x & (RANS_SCALE - 1);
+		uint8_t s = symbols[slot];
+		data[i] = s;
+		x = freqs[s] * (x >> RANS_SCALE_BITS) + slot - starts[s];
+		while (x < RANS_LOW)
+		{
+			if (in >= inEnd)
+				return false;
+			x = (x << 8) | *in++;
+		}
+	}
+	return true;
+}
+
+// Delta + zigzag of one component of an interleaved 16-bit attribute, split in low and high byte planes
+static void encodeComponent(const std::vector<uint16_t>& values, size_t component, size_t stride, std::vector<uint8_t>& out)
+{
+	size_t count = values.size() / stride;
+	std::vector<uint8_t> low(count), high(count);
+	uint16_t last = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint16_t v = values[i * stride + component];
+		int16_t delta = (int16_t)(uint16_t)(v - last);
+		uint16_t z = (uint16_t)((delta << 1) ^ (delta >> 15));
+		low[i] = (uint8_t)z;
+		high[i] = (uint8_t)(z >> 8);
+		last = v;
+	}
+	writeStream(out, low);
+	writeStream(out, high);
+}
+
+static bool decodeComponent(const uint8_t*& cur, const uint8_t* end, std::vector<uint16_t>& values, size_t component, size_t stride)
+{
+	std::vector<uint8_t> low, high;
+	size_t count = values.size() / stride;
+	if (!readStream(cur, end, low) || !readStream(cur, end, high) || low.size() != count || high.size() != count)
+		return false;
+
+	uint16_t last = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint16_t z = (uint16_t)(low[i] | (high[i] << 8));
+		uint16_t delta = (uint16_t)((z >> 1) ^ (uint16_t)-(int16_t)(z & 1));
+		last = (uint16_t)(last + delta);
+		values[i * stride + component] = last;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Triangle order
+
+// Tipsify (Sander, Nehab & Barczak 2007) : vertex cache friendly triangle order in linear time.
+// Return the triangle order, clusterStarts receives the position of the first triangle of each cluster
+// (a new cluster starts each time the fan walk hits a dead end).
+static std::vector<uint32_t> tipsify(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, std::vector<size_t>& clusterStarts)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t idx : indices)
+		liveTriangles[idx]++;
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnd;
+	deadEnd.reserve(indices.size());
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	long long fanning = triangleCount > 0 ? (long long)indices[0] : -1;
+	bool newCluster = true;
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+		for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++)
+		{
+			uint32_t t = adjacency[k];
+			if (emitted[t])
+				continue;
+
+			if (newCluster)
+			{
+				clusterStarts.push_back(order.size());
+				newCluster = false;
+			}
+
+			for (int j = 0; j < 3; j++)
+			{
+				uint32_t v = indices[t * 3 + j];
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = 1;
+			order.push_back(t);
+		}
+
+		// Next fanning vertex : the one which will still be in the cache, with the most remaining triangles
+		long long best = -1;
+		long long bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+			long long priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = time - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				best = v;
+				bestPriority = priority;
+			}
+		}
+
+		if (best < 0)
+		{
+			newCluster = true;
+			while (!deadEnd.empty())
+			{
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0)
+				{
+					best = v;
+					break;
+				}
+			}
+			while (best < 0 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+					best = (long long)cursor;
+				else
+					cursor++;
+			}
+		}
+		fanning = best;
+	}
+
+	return order;
+}
+
+// Sort the clusters so that those facing outwards are drawn first (Sander et al. 2007, same idea as meshoptimizer) :
+// hidden triangles are then rejected by the depth test instead of being shaded twice.
+static void sortClustersForOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& order,
+	const std::vector<size_t>& clusterStarts, const std::vector<uint16_t>& positions)
+{
+	TVec3d meshCentroid;
+	for (uint32_t idx : indices)
+		meshCentroid = meshCentroid + TVec3d(positions[idx * 3], positions[idx * 3 + 1], positions[idx * 3 + 2]);
+	if (!indices.empty())
+		meshCentroid = meshCentroid / (double)indices.size();
+
+	std::vector<std::pair<double, size_t>> sortKeys(clusterStarts.size());
+	for (size_t c = 0; c < clusterStarts.size(); c++)
+	{
+		size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : order.size();
+		TVec3d centroid, normal;
+		double area = 0.;
+		for (size_t i = clusterStarts[c]; i < end; i++)
+		{
+			uint32_t t = order[i];
+			TVec3d p[3];
+			for (int j = 0; j < 3; j++)
+			{
+				uint32_t idx = indices[t * 3 + j];
+				p[j] = TVec3d(positions[idx * 3], positions[idx * 3 + 1], positions[idx * 3 + 2]);
+			}
+			TVec3d n = (p[1] - p[0]).cross(p[2] - p[0]);
+			double a = n.length();
+			centroid = centroid + (p[0] + p[1] + p[2]) * (a / 3.);
+			normal = normal + n;
+			area += a;
+		}
+		if (area > 0.)
+			centroid = centroid / area;
+		double length = normal.length();
+		sortKeys[c] = std::make_pair(length > 0. ? -(centroid - meshCentroid).dot(normal) / length : 0., c);
+	}
+	std::stable_sort(sortKeys.begin(), sortKeys.end());
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const std::pair<double, size_t>& key : sortKeys)
+	{
+		size_t c = key.second;
+		size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : order.size();
+		for (size_t i = clusterStarts[c]; i < end; i++)
+			for (int j = 0; j < 3; j++)
+				sorted.push_back(indices[order[i] * 3 + j]);
+	}
+	indices.swap(sorted);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TVec3d QuantizedMesh::getPosition(size_t vertex) const
+{
+	return TVec3d(dequantize(positions[vertex * 3], boundsMin.x, boundsMax.x),
+		dequantize(positions[vertex * 3 + 1], boundsMin.y, boundsMax.y),
+		dequantize(positions[vertex * 3 + 2], boundsMin.z, boundsMax.z));
+}
+////////////////////////////////////////////////////////////////////////////////
+TVec2d QuantizedMesh::getTexCoord(size_t vertex) const
+{
+	return TVec2d(dequantize(texCoords[vertex * 2], uvMin.x, uvMax.x), dequantize(texCoords[vertex * 2 + 1], uvMin.y, uvMax.y));
+}
+////////////////////////////////////////////////////////////////////////////////
+TVec3f QuantizedMesh::getNormal(size_t vertex) const
+{
+	return decodeOctahedral(normals[vertex * 2], normals[vertex * 2 + 1]);
+}
+////////////////////////////////////////////////////////////////////////////////
+bool QuantizedMesh::operator==(const QuantizedMesh& other) const
+{
+	for (int c = 0; c < 3; c++)
+		if (boundsMin[c] != other.boundsMin[c] || boundsMax[c] != other.boundsMax[c])
+			return false;
+	for (int c = 0; c < 2; c++)
+		if (uvMin[c] != other.uvMin[c] || uvMax[c] != other.uvMax[c])
+			return false;
+	if (subMeshes.size() != other.subMeshes.size())
+		return false;
+	for (size_t i = 0; i < subMeshes.size(); i++)
+		if (subMeshes[i].material != other.subMeshes[i].material || subMeshes[i].indexOffset != other.subMeshes[i].indexOffset || subMeshes[i].indexCount != other.subMeshes[i].indexCount)
+			return false;
+	return positions == other.positions && texCoords == other.texCoords && normals == other.normals && indices == other.indices;
+}
+////////////////////////////////////////////////////////////////////////////////
+MeshCompressor::MeshCompressor() : _hasBounds(false), _rawVertexCount(0)
+{
+}
+////////////////////////////////////////////////////////////////////////////////
+void MeshCompressor::setBounds(const TVec3d& boundsMin, const TVec3d& boundsMax)
+{
+	_hasBounds = true;
+	_boundsMin = boundsMin;
+	_boundsMax = boundsMax;
+}
+////////////////////////////////////////////////////////////////////////////////
+void MeshCompressor::addPolygon(const citygml::Polygon& poly, const std::string& material)
+{
+	const std::vector<TVec3d>& vertices = poly.getVertices();
+	const std::vector<TVec3f>& normals = poly.getNormals();
+	const citygml::TexCoords& texCoords = poly.getTexCoords();
+	if (vertices.empty() || poly.getIndices().empty())
+		return;
+
+	uint32_t first = (uint32_t)_vertices.size();
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		Vertex v;
+		v.position = vertices[i];
+		v.normal = i < normals.size() ? normals[i] : TVec3f(0.f, 0.f, 1.f);
+		v.texCoord = i < texCoords.size() ? texCoords[i] : TVec2f(0.f, 0.f);
+		_vertices.push_back(v);
+	}
+	_rawVertexCount += vertices.size();
+
+	std::vector<uint32_t>& indices = _subMeshes[material];
+	for (unsigned int idx : poly.getIndices())
+		indices.push_back(first + idx);
+}
+////////////////////////////////////////////////////////////////////////////////
+size_t MeshCompressor::getTriangleCount() const
+{
+	size_t count = 0;
+	for (const std::pair<const std::string, std::vector<uint32_t>>& subMesh : _subMeshes)
+		count += subMesh.second.size() / 3;
+	return count;
+}
+////////////////////////////////////////////////////////////////////////////////
+size_t MeshCompressor::getRawSize() const
+{
+	return _rawVertexCount * (3 + 3 + 2) * sizeof(float) + getTriangleCount() * 3 * sizeof(uint32_t);
+}
+////////////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t> MeshCompressor::compress(QuantizedMesh* quantized) const
+{
+	QuantizedMesh mesh;
+
+	// 1. Quantisation bounds
+	mesh.boundsMin = _hasBounds ? _boundsMin : TVec3d(std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+	mesh.boundsMax = _hasBounds ? _boundsMax : TVec3d(std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest());
+	mesh.uvMin = TVec2d(std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+	mesh.uvMax = TVec2d(std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest());
+	for (const Vertex& v : _vertices)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			mesh.boundsMin[c] = std::min(mesh.boundsMin[c], v.position[c]);
+			mesh.boundsMax[c] = std::max(mesh.boundsMax[c], v.position[c]);
+		}
+		for (int c = 0; c < 2; c++)
+		{
+			mesh.uvMin[c] = std::min(mesh.uvMin[c], (double)v.texCoord[c]);
+			mesh.uvMax[c] = std::max(mesh.uvMax[c], (double)v.texCoord[c]);
+		}
+	}
+	if (_vertices.empty())
+	{
+		mesh.boundsMin = mesh.boundsMax = TVec3d();
+		mesh.uvMin = mesh.uvMax = TVec2d();
+	}
+
+	// 2. Quantise and weld the vertices which become identical
+	struct Key
+	{
+		uint64_t a, b;
+		bool operator==(const Key& other) const { return a == other.a && b == other.b; }
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& k) const { return std::hash<uint64_t>()(k.a ^ (k.b * 0x9e3779b97f4a7c15ULL)); }
+	};
+
+	std::unordered_map<Key, uint32_t, KeyHash> welded;
+	welded.reserve(_vertices.size());
+	std::vector<uint32_t> remap(_vertices.size());
+	std::vector<uint16_t> positions, texCoords;
+	std::vector<uint8_t> normals;
+	for (size_t i = 0; i < _vertices.size(); i++)
+	{
+		const Vertex& v = _vertices[i];
+		uint16_t q[5];
+		for (int c = 0; c < 3; c++)
+			q[c] = quantize(v.position[c], mesh.boundsMin[c], mesh.boundsMax[c]);
+		for (int c = 0; c < 2; c++)
+			q[3 + c] = quantize(v.texCoord[c], mesh.uvMin[c], mesh.uvMax[c]);
+		uint8_t nx, ny;
+		encodeOctahedral(v.normal, nx, ny);
+
+		Key key;
+		key.a = (uint64_t)q[0] | ((uint64_t)q[1] << 16) | ((uint64_t)q[2] << 32) | ((uint64_t)q[3] << 48);
+		key.b = (uint64_t)q[4] | ((uint64_t)nx << 16) | ((uint64_t)ny << 24);
+
+		std::unordered_map<Key, uint32_t, KeyHash>::const_iterator it = welded.find(key);
+		if (it != welded.end())
+		{
+			remap[i] = it->second;
+			continue;
+		}
+		uint32_t index = (uint32_t)(positions.size() / 3);
+		welded[key] = index;
+		remap[i] = index;
+		positions.insert(positions.end(), q, q + 3);
+		texCoords.insert(texCoords.end(), q + 3, q + 5);
+		normals.push_back(nx);
+		normals.push_back(ny);
+	}
+	size_t vertexCount = positions.size() / 3;
+
+	// 3. Triangle order per material : vertex cache then overdraw. Each material is reordered on its own vertices,
+	// renumbered locally, so that the cost does not grow with the vertices of the other materials.
+	const uint32_t unused = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> localIndex(vertexCount, unused);
+	std::vector<uint32_t> globalIndex;
+	std::vector<uint16_t> localPositions;
+	for (const std::pair<const std::string, std::vector<uint32_t>>& subMesh : _subMeshes)
+	{
+		std::vector<uint32_t> indices;
+		indices.reserve(subMesh.second.size());
+		globalIndex.clear();
+		localPositions.clear();
+		for (size_t i = 0; i + 2 < subMesh.second.size(); i += 3)
+		{
+			uint32_t t[3] = { remap[subMesh.second[i]], remap[subMesh.second[i + 1]], remap[subMesh.second[i + 2]] };
+			if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2])
+				continue; // degenerated by the quantisation
+			for (uint32_t v : t)
+			{
+				if (localIndex[v] == unused)
+				{
+					localIndex[v] = (uint32_t)globalIndex.size();
+					globalIndex.push_back(v);
+					localPositions.insert(localPositions.end(), positions.begin() + v * 3, positions.begin() + v * 3 + 3);
+				}
+				indices.push_back(localIndex[v]);
+			}
+		}
+		for (uint32_t v : globalIndex)
+			localIndex[v] = unused;
+		if (indices.empty())
+			continue;
+
+		std::vector<size_t> clusterStarts;
+		std::vector<uint32_t> order = tipsify(indices, globalIndex.size(), 16, clusterStarts);
+		sortClustersForOverdraw(indices, order, clusterStarts, localPositions);
+
+		QuantizedMesh::SubMesh sub;
+		sub.material = subMesh.first;
+		sub.indexOffset = (uint32_t)mesh.indices.size();
+		sub.indexCount = (uint32_t)indices.size();
+		mesh.subMeshes.push_back(sub);
+		for (uint32_t idx : indices)
+			mesh.indices.push_back(globalIndex[idx]);
+	}
+
+	// 4. Vertices in fetch order, unused ones are dropped
+	std::vector<uint32_t> fetchRemap(vertexCount, std::numeric_limits<uint32_t>::max());
+	uint32_t next = 0;
+	for (uint32_t& idx : mesh.indices)
+	{
+		if (fetchRemap[idx] == std::numeric_limits<uint32_t>::max())
+		{
+			fetchRemap[idx] = next++;
+			mesh.positions.insert(mesh.positions.end(), positions.begin() + idx * 3, positions.begin() + idx * 3 + 3);
+			mesh.texCoords.insert(mesh.texCoords.end(), texCoords.begin() + idx * 2, texCoords.begin() + idx * 2 + 2);
+			mesh.normals.insert(mesh.normals.end(), normals.begin() + idx * 2, normals.begin() + idx * 2 + 2);
+		}
+		idx = fetchRemap[idx];
+	}
+
+	// 5. Encoding
+	std::vector<uint8_t> out;
+	out.reserve(64 + mesh.indices.size() + mesh.getVertexCount() * 10);
+	out.insert(out.end(), { 'Q', 'M', 'S', 'H', 1 });
+	writeVarint(out, mesh.getVertexCount());
+	writeVarint(out, mesh.indices.size());
+	for (int c = 0; c < 3; c++) writeDouble(out, mesh.boundsMin[c]);
+	for (int c = 0; c < 3; c++) writeDouble(out, mesh.boundsMax[c]);
+	for (int c = 0; c < 2; c++) writeDouble(out, mesh.uvMin[c]);
+	for (int c = 0; c < 2; c++) writeDouble(out, mesh.uvMax[c]);
+
+	writeVarint(out, mesh.subMeshes.size());
+	for (const QuantizedMesh::SubMesh& sub : mesh.subMeshes)
+	{
+		writeVarint(out, sub.material.size());
+		out.insert(out.end(), sub.material.begin(), sub.material.end());
+		writeVarint(out, sub.indexOffset);
+		writeVarint(out, sub.indexCount);
+	}
+
+	std::vector<uint8_t> indexBytes;
+	int64_t last = 0;
+	for (uint32_t idx : mesh.indices)
+	{
+		writeVarint(indexBytes, zigzag((int64_t)idx - last));
+		last = idx;
+	}
+	writeStream(out, indexBytes);
+
+	for (size_t c = 0; c < 3; c++)
+		encodeComponent(mesh.positions, c, 3, out);
+	for (size_t c = 0; c < 2; c++)
+		encodeComponent(mesh.texCoords, c, 2, out);
+	for (size_t c = 0; c < 2; c++)
+	{
+		std::vector<uint8_t> plane(mesh.getVertexCount());
+		uint8_t lastByte = 0;
+		for (size_t i = 0; i < plane.size(); i++)
+		{
+			uint8_t v = mesh.normals[i * 2 + c];
+			plane[i] = (uint8_t)(v - lastByte);
+			lastByte = v;
+		}
+		writeStream(out, plane);
+	}
+
+	if (quantized)
+		*quantized = std::move(mesh);
+	return out;
+}
+////////////////////////////////////////////////////////////////////////////////
+bool MeshCompressor::decompress(const std::vector<uint8_t>& data, QuantizedMesh& mesh)
+{
+	const uint8_t* cur = data.data();
+	const uint8_t* end = cur + data.size();
+	if (data.size() < 5 || memcmp(cur, "QMSH", 4) != 0 || cur[4] != 1)
+		return false;
+	cur += 5;
+
+	uint64_t vertexCount, indexCount, subMeshCount;
+	if (!readVarint(cur, end, vertexCount) || !readVarint(cur, end, indexCount))
+		return false;
+	for (int c = 0; c < 3; c++) if (!readDouble(cur, end, mesh.boundsMin[c])) return false;
+	for (int c = 0; c < 3; c++) if (!readDouble(cur, end, mesh.boundsMax[c])) return false;
+	for (int c = 0; c < 2; c++) if (!readDouble(cur, end, mesh.uvMin[c])) return false;
+	for (int c = 0; c < 2; c++) if (!readDouble(cur, end, mesh.uvMax[c])) return false;
+
+	if (!readVarint(cur, end, subMeshCount))
+		return false;
+	mesh.subMeshes.clear();
+	for (uint64_t i = 0; i < subMeshCount; i++)
+	{
+		uint64_t length, offset, count;
+		if (!readVarint(cur, end, length) || (uint64_t)(end - cur) < length)
+			return false;
+		QuantizedMesh::SubMesh sub;
+		sub.material.assign((const char*)cur, length);
+		cur += length;
+		if (!readVarint(cur, end, offset) || !readVarint(cur, end, count) || offset + count > indexCount)
+			return false;
+		sub.indexOffset = (uint32_t)offset;
+		sub.indexCount = (uint32_t)count;
+		mesh.subMeshes.push_back(sub);
+	}
+
+	std::vector<uint8_t> bytes;
+	if (!readStream(cur, end, bytes))
+		return false;
+	mesh.indices.resize(indexCount);
+	const uint8_t* in = bytes.data();
+	const uint8_t* inEnd = in + bytes.size();
+	int64_t last = 0;
+	for (uint64_t i = 0; i < indexCount; i++)
+	{
+		uint64_t z;
+		if (!readVarint(in, inEnd, z))
+			return false;
+		last += unzigzag(z);
+		if (last < 0 || (uint64_t)last >= vertexCount)
+			return false;
+		mesh.indices[i] = (uint32_t)last;
+	}
+
+	mesh.positions.resize(vertexCount * 3);
+	mesh.texCoords.resize(vertexCount * 2);
+	mesh.normals.resize(vertexCount * 2);
+	for (size_t c = 0; c < 3; c++)
+		if (!decodeComponent(cur, end, mesh.positions, c, 3))
+			return false;
+	for (size_t c = 0; c < 2; c++)
+		if (!decodeComponent(cur, end, mesh.texCoords, c, 2))
+			return false;
+	for (size_t c = 0; c < 2; c++)
+	{
+		if (!readStream(cur, end, bytes) || bytes.size() != vertexCount)
+			return false;
+		uint8_t lastByte = 0;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			lastByte = (uint8_t)(lastByte + bytes[i]);
+			mesh.normals[i * 2 + c] = lastByte;
+		}
+	}
+
+	return cur == end;
+}
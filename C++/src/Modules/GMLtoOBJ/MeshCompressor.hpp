@@ -0,0 +1,86 @@
+#ifndef MESHCOMPRESSOR_HPP
+#define MESHCOMPRESSOR_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../../CityModel/CityModel.hpp"
+
+// Content of a .qmesh file (see MeshCompressor)
+struct QuantizedMesh
+{
+	struct SubMesh
+	{
+		std::string material;	// same name as the "usemtl" of the .obj file
+		uint32_t indexOffset;
+		uint32_t indexCount;
+	};
+
+	TVec3d boundsMin;				// positions are quantised on 16 bits within these bounds
+	TVec3d boundsMax;
+	TVec2d uvMin;					// texture coordinates are quantised on 16 bits within these bounds
+	TVec2d uvMax;
+
+	std::vector<uint16_t> positions;	// x, y, z per vertex
+	std::vector<uint16_t> texCoords;	// u, v per vertex
+	std::vector<uint8_t> normals;		// octahedral x, y per vertex
+	std::vector<uint32_t> indices;		// triangles
+	std::vector<SubMesh> subMeshes;
+
+	size_t getVertexCount() const { return positions.size() / 3; }
+
+	TVec3d getPosition(size_t vertex) const;
+	TVec2d getTexCoord(size_t vertex) const;
+	TVec3f getNormal(size_t vertex) const;
+
+	bool operator==(const QuantizedMesh& other) const;
+};
+
+// Builds a compact binary mesh (.qmesh) from the polygons written by GMLtoOBJ :
+//  - positions are quantised to 16 bits within the given bounds (the tile bounds for GMLSplit),
+//    texture coordinates to 16 bits and normals to 2 x 8 bits (octahedral encoding)
+//  - vertices are welded, triangles are reordered for the vertex cache (Tipsify) then by clusters to
+//    reduce overdraw, and vertices are reordered in fetch order
+//  - indices and vertex components are delta encoded then entropy coded (rANS)
+class MeshCompressor
+{
+public:
+	MeshCompressor();
+
+	// Quantisation bounds, they are grown if some vertices are outside (buildings overlapping the tile border)
+	void setBounds(const TVec3d& boundsMin, const TVec3d& boundsMax);
+
+	void addPolygon(const citygml::Polygon& poly, const std::string& material);
+
+	size_t getTriangleCount() const;
+
+	// Size of the same triangles as a plain binary mesh : float positions, normals and texture coordinates
+	// for every polygon vertex and 32-bit indices
+	size_t getRawSize() const;
+
+	// quantized : if not null, receives the mesh as it is encoded (see decompress)
+	std::vector<uint8_t> compress(QuantizedMesh* quantized = nullptr) const;
+
+	// Decode a .qmesh file : compress then decompress gives back the quantized mesh exactly
+	static bool decompress(const std::vector<uint8_t>& data, QuantizedMesh& mesh);
+
+private:
+	struct Vertex
+	{
+		TVec3d position;
+		TVec3f normal;
+		TVec2f texCoord;
+	};
+
+	std::vector<Vertex> _vertices;
+	std::map<std::string, std::vector<uint32_t>> _subMeshes;	// material -> triangles
+
+	bool _hasBounds;
+	TVec3d _boundsMin;
+	TVec3d _boundsMax;
+
+	size_t _rawVertexCount;
+};
+
+#endif // !MESHCOMPRESSOR_HPP
@@ -50,14 +50,16 @@ int main(int argc, char* argv[])
 		dataProfile.m_bboxLowerBound.y,
 		dataProfile.m_bboxLowerBound.z
     );
-    // Check if there is optional output
-    if (argc > 2) {
-        std::string output (argv[2]);
-	    gmlToObj->createMyOBJ(*cityModel, output);
-    } else {
-        // No optional output -> default : ./output/obj/
-	    gmlToObj->createMyOBJ(*cityModel, "");
+    // Optional arguments : output location and --qmesh (compressed binary mesh next to the .obj)
+    std::string output;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--qmesh") == 0)
+            gmlToObj->setQuantizedOutput(true);
+        else
+            output = argv[i];
     }
+    // No optional output -> default : ./output/obj/
+    gmlToObj->createMyOBJ(*cityModel, output);
 
     delete parser;
     delete cityModel;
@@ -300,23 +300,19 @@ template<class T> inline void parseVecList(std::stringstream &s, std::vector<T>
 
 template<class T> inline void parseVecList(std::stringstream &s, std::vector<T> &vec, GeoTransform* transform, const TVec3d &translate)
 {
-	T v;
 	unsigned int oldSize(vec.size());
-	while (s >> v)
-	{
-		if (transform) transform->transform(v);
+	parseVecList(s, vec);
+	if (vec.size() == oldSize) return;
 
-		// Translate based on bounding box of whole model
-		v[0] -= translate[0];
-		v[1] -= translate[1];
-		v[2] -= translate[2];
+	// The whole list is transformed at once
+	if (transform) transform->transform(vec, oldSize);
 
-		vec.push_back(v);
-	}
-	if (!s.eof())
+	// Translate based on bounding box of whole model
+	for (size_t i = oldSize; i < vec.size(); i++)
 	{
-		std::cerr << "Error ! Mismatch type: " << typeid(T).name() << " expected. Ring/Polygon discarded!" << std::endl;
-		vec.resize(oldSize);
+		vec[i][0] -= translate[0];
+		vec[i][1] -= translate[1];
+		vec[i][2] -= translate[2];
 	}
 }
 
@@ -338,6 +334,47 @@ std::string CityGMLHandler::getNodeName(const std::string& name)
 	return name;
 }
 
+CityObjectsType CityGMLHandler::getCityObjectsType(CityGMLNodeType nodeType)
+{
+	switch (nodeType)
+	{
+#define OBJECTTYPE(_t_) case CG_ ## _t_ : return COT_ ## _t_;
+		OBJECTTYPE(GenericCityObject);
+		OBJECTTYPE(Building);
+		OBJECTTYPE(BuildingPart);
+		OBJECTTYPE(Room);
+		OBJECTTYPE(BuildingInstallation);
+		OBJECTTYPE(BuildingFurniture);
+		OBJECTTYPE(Door);
+		OBJECTTYPE(Window);
+		OBJECTTYPE(CityFurniture);
+		OBJECTTYPE(Track);
+		OBJECTTYPE(Road);
+		OBJECTTYPE(Railway);
+		OBJECTTYPE(Square);
+		OBJECTTYPE(PlantCover);
+		OBJECTTYPE(SolitaryVegetationObject);
+		OBJECTTYPE(WaterBody);
+		OBJECTTYPE(TINRelief);
+		OBJECTTYPE(LandUse);
+		OBJECTTYPE(Tunnel);
+		OBJECTTYPE(Bridge);
+		OBJECTTYPE(BridgeConstructionElement);
+		OBJECTTYPE(BridgeInstallation);
+		OBJECTTYPE(BridgePart);
+		OBJECTTYPE(WallSurface);
+		OBJECTTYPE(RoofSurface);
+		OBJECTTYPE(GroundSurface);
+		OBJECTTYPE(ClosureSurface);
+		OBJECTTYPE(FloorSurface);
+		OBJECTTYPE(InteriorWallSurface);
+		OBJECTTYPE(CeilingSurface);
+#undef OBJECTTYPE
+	default:
+		return (CityObjectsType)0;
+	}
+}
+
 std::string CityGMLHandler::getXLinkQueryIdentifier(const std::string& query)
 {
 	// query should be under the format "//identifier[text()='XXXXXXXX']/.."
@@ -607,9 +644,10 @@ void CityGMLHandler::endElement(const std::string& name)
 		return;
 	}*/
 
-	// Trim the char buffer  
-	std::stringstream buffer;
-	buffer << trim(_buff.str());
+	// Trim the char buffer (in a stream kept from one element to the next : creating one costs more than most elements)
+	std::stringstream& buffer = _value;
+	buffer.str(trim(_buff.str()));
+	buffer.clear();
 
 	// set the LOD level if node name starts with 'lod'
 	if (localname.find("lod") == 0) _currentLOD = _params.minLOD;
@@ -668,12 +706,18 @@ void CityGMLHandler::endElement(const std::string& name)
 	case NODETYPE(InteriorWallSurface):
 	case NODETYPE(CeilingSurface):
 		MODEL_FILTER();
-		if (_currentCityObject && (_currentCityObject->size() > 0 || _currentCityObject->getChildCount() > 0 || !_params.pruneEmptyObjects))
+		// geometries not parsed yet (lazy geometry) are counted without being loaded
+		if (_currentCityObject && (_currentCityObject->_geometries.size() > 0 || _currentCityObject->getGeometryLoader() || _currentCityObject->getChildCount() > 0 || !_params.pruneEmptyObjects))
 		{
 			_model->addCityObject(_currentCityObject);
 			if (_cityObjectStack.size() == 1) _model->addCityObjectAsRoot(_currentCityObject);
 		}
-		else delete _currentCityObject;
+		else
+		{
+			// pruned : out of its parent before it is deleted
+			if (_currentCityObject && _currentCityObject->_parent) _currentCityObject->_parent->deleteNode(_currentCityObject);
+			delete _currentCityObject;
+		}
 		popCityObject();
 		popObject();
 		_filterNodeType = false;
@@ -1042,8 +1086,8 @@ void CityGMLHandler::createGeoTransform(std::string srsName)
 
 	if (_params.destSRS == "") return;
 
-	delete (GeoTransform*)_geoTransform;
-	_geoTransform = new GeoTransform(proj4Name, _params.destSRS);
+	// Shared with the next srsName of the same SRS, and with the next documents parsed by this thread
+	_geoTransform = GeoTransform::get(proj4Name, _params.destSRS);
 }
 
 void CityGMLHandler::endDocument()
@@ -298,6 +298,9 @@ namespace citygml
 
 		static CityGMLNodeType getNodeTypeFromName(const std::string&);
 
+		// City object type of a node, 0 if the node is not a city object
+		static CityObjectsType getCityObjectsType(CityGMLNodeType);
+
 		static std::string getXLinkQueryIdentifier(const std::string&);
 
 		void fetchVersionedCityObjectsRec(CityObject*);
@@ -310,6 +313,7 @@ namespace citygml
 		std::vector< std::string > _nodePath;
 
 		std::stringstream _buff;
+		std::stringstream _value;	// trimmed _buff of the element ended
 
 		ParserParams _params;
 
@@ -353,7 +357,7 @@ namespace citygml
 
 		GeometryType _currentGeometryType;
 
-		void* _geoTransform;
+		void* _geoTransform;	// GeoTransform of the current srsName, owned by the cache of GeoTransform::get
 
 		bool _useXLink;
 
@@ -17,10 +17,14 @@
 // This is the implementation file for LibXml2 parser
 
 #include "CityGMLHandler.hpp"
+#include "LazyGeometryLoader.hpp"
 #include "../../CityModel/CityGML.hpp"
+#include "../../CityModel/Transform.hpp"
 
+#include <cctype>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <libxml/parser.h>
 #include <libxml/SAX.h>
 
@@ -38,24 +42,50 @@ using namespace citygml;
 class CityGMLHandlerLibXml2 : public CityGMLHandler
 {
 public:
-	CityGMLHandlerLibXml2(const ParserParams& params) : CityGMLHandler(params) {}
+	CityGMLHandlerLibXml2(const ParserParams& params) : CityGMLHandler(params), _context(0), _lazyLoader(0), _skipDepth(0), _skipRange(false) {}
 	virtual ~CityGMLHandlerLibXml2() { xmlCleanupParser(); }
 
+	// Skip the geometries of the city objects of filename parsed by context (ParserParams::lazyGeometry) : their
+	// ranges are given to a LazyGeometryLoader of the model, which parses them on demand
+	void setLazyGeometry(xmlParserCtxtPtr context, const std::string& filename)
+	{
+		_context = context;
+		_filename = filename;
+	}
+
 	using CityGMLHandler::startElement;
 	void startElement(const xmlChar* name, const xmlChar** attrs)
 	{
+		if (_skipDepth > 0) { _skipDepth++; return; }
+
+		if (skipElement(name)) return;
+
 		CityGMLHandler::startElement(wstos(name), attrs);
+
+		if (_context && _model && !_lazyLoader)
+		{
+			_lazyLoader = new LazyGeometryLoader(_filename, _params, _model);
+			_model->setGeometryLoader(_lazyLoader);
+		}
 	}
 
 	using CityGMLHandler::endElement;
 	void endElement(const xmlChar* name)
 	{
+		if (_skipDepth > 0)
+		{
+			if (--_skipDepth == 0 && _skipRange)
+				_lazyLoader->addRange(_currentCityObject, _skipBegin, xmlByteConsumed(_context), _skipLOD, _currentGeometryType,
+					_geoTransform ? ((GeoTransform*)_geoTransform)->getSourceURN() : "");
+			return;
+		}
+
 		CityGMLHandler::endElement(wstos(name));
 	}
 
 	void characters(const xmlChar *chars, int length)
 	{
-		for (int i = 0; i < length; i++) _buff << (char)chars[i];
+		if (_skipDepth == 0) _buff.write((const char*)chars, length);
 	}
 
 	static inline std::string wstos(const xmlChar* const str)
@@ -72,6 +102,78 @@ protected:
 			if (wstos(attrs[i]) == attname) return wstos(attrs[i + 1]);
 		return defvalue;
 	}
+
+private:
+	// Skip the subtree of name before the CityGMLHandler sees it (no buffering, no node path) : the city objects of
+	// the types filtered by objectsMask, the geometry properties (lodNxxx, or tin with the LOD of dem:lod) out of
+	// [minLOD, maxLOD] and, with lazy geometry, the other geometry properties of the city objects, whose ranges are
+	// recorded
+	bool skipElement(const xmlChar* name)
+	{
+		const char* localname = strchr((const char*)name, ':');
+		localname = localname ? localname + 1 : (const char*)name;
+
+		int lod = -1;
+		if (strncmp(localname, "lod", 3) == 0 && isdigit((unsigned char)localname[3]) && localname[4] != '\0')
+			lod = localname[3] - '0';
+		else if (strcmp(localname, "tin") == 0)
+			lod = _currentLOD;
+
+		if (lod >= 0)
+		{
+			if (lod < (int)_params.minLOD || lod > (int)_params.maxLOD)
+			{
+				_skipDepth = 1;
+				_skipRange = false;
+				return true;
+			}
+			return _lazyLoader && _currentCityObject && skipGeometry(lod);
+		}
+
+		// The city objects are the only elements filtered by type : their names start with an upper case letter
+		if (_objectsMask != COT_All && isupper((unsigned char)localname[0]))
+		{
+			CityObjectsType type = getCityObjectsType(getNodeTypeFromName(getNodeName(wstos(name))));
+			if (type != 0 && !(_objectsMask & type))
+			{
+				_skipDepth = 1;
+				_skipRange = false;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Skip a geometry property of the current city object, its range is recorded at its end
+	bool skipGeometry(int lod)
+	{
+		// The ranges are read back as UTF-8 : the files in another encoding are parsed completely
+		if (_context->input->buf && _context->input->buf->encoder)
+		{
+			_params.lazyGeometry = false;
+			_context = 0;
+			_lazyLoader = 0;
+			return false;
+		}
+
+		// The parser is at the end of the start tag : the range starts at its '<'
+		const xmlChar* tag = _context->input->cur;
+		while (tag > _context->input->base && *tag != '<') --tag;
+		_skipBegin = (uint64_t)xmlByteConsumed(_context) - (uint64_t)(_context->input->cur - tag);
+		_skipLOD = lod;
+		_skipDepth = 1;
+		_skipRange = true;
+		return true;
+	}
+
+	xmlParserCtxtPtr _context;			// context of the parsing, when the geometries are skipped
+	std::string _filename;
+	LazyGeometryLoader* _lazyLoader;	// owned by the model
+
+	unsigned int _skipDepth;			// depth in the skipped subtree, 0 outside
+	bool _skipRange;					// the skipped subtree is a geometry property to record
+	uint64_t _skipBegin;
+	int _skipLOD;
 };
 
 namespace citygml
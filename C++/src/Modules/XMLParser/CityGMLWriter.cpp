@@ -0,0 +1,496 @@
+#include "CityGMLWriter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <map>
+
+#define BC (const xmlChar*)
+
+static bool isBoundarySurface(CityObjectsType type)
+{
+	return type >= COT_WallSurface && type <= COT_CeilingSurface;
+}
+
+// Namespace prefix of the CityGML 2.0 module of a CityObject type, boundary surfaces use the one of their parent
+static const char* getNamespace(CityObjectsType type)
+{
+	switch (type)
+	{
+	case COT_Building: case COT_BuildingPart: case COT_Room: case COT_BuildingInstallation:
+	case COT_BuildingFurniture: case COT_Door: case COT_Window:
+		return "bldg";
+	case COT_Bridge: case COT_BridgePart: case COT_BridgeConstructionElement: case COT_BridgeInstallation:
+		return "brid";
+	case COT_Tunnel: return "tun";
+	case COT_Track: case COT_Road: case COT_Railway: case COT_Square: return "tran";
+	case COT_PlantCover: case COT_SolitaryVegetationObject: return "veg";
+	case COT_WaterBody: return "wtr";
+	case COT_TINRelief: return "dem";
+	case COT_LandUse: return "luse";
+	case COT_CityFurniture: return "frn";
+	default: return "gen";
+	}
+}
+
+// Property linking a child to its parent, nullptr if CityGML has none (the child is then written as a root)
+static const char* getChildProperty(CityObjectsType type)
+{
+	if (isBoundarySurface(type))
+		return "boundedBy";
+
+	switch (type)
+	{
+	case COT_BuildingPart: return "consistsOfBuildingPart";
+	case COT_BuildingInstallation: return "outerBuildingInstallation";
+	case COT_Room: return "interiorRoom";
+	case COT_BuildingFurniture: return "interiorFurniture";
+	case COT_Door: case COT_Window: return "opening";
+	case COT_BridgePart: return "consistsOfBridgePart";
+	case COT_BridgeConstructionElement: return "outerBridgeConstruction";
+	case COT_BridgeInstallation: return "outerBridgeInstallation";
+	default: return nullptr;
+	}
+}
+
+// Objects whose geometry is a lodNGeometry (any GML geometry) rather than a lodNMultiSurface
+static bool hasLodGeometry(CityObjectsType type)
+{
+	return type == COT_GenericCityObject || type == COT_CityFurniture || type == COT_SolitaryVegetationObject
+		|| type == COT_BuildingInstallation || type == COT_BridgeInstallation;
+}
+
+static const char* getWrapMode(Texture::WrapMode mode)
+{
+	switch (mode)
+	{
+	case Texture::WM_WRAP: return "wrap";
+	case Texture::WM_MIRROR: return "mirror";
+	case Texture::WM_CLAMP: return "clamp";
+	case Texture::WM_BORDER: return "border";
+	default: return "none";
+	}
+}
+
+CityGMLWriter::CityGMLWriter(std::string name) : Module(name), _writer(NULL), _generatedIds(0)
+{
+}
+
+bool CityGMLWriter::write(const CityModel& model, const std::string& filename)
+{
+	std::cout << "[CITYGML WRITER]...............................[START]" << std::endl;
+
+	_writer = xmlNewTextWriterFilename(filename.c_str(), 0);
+	if (!_writer)
+	{
+		std::cout << "[CITYGML WRITER]...............................[FAILED]: Problem with filepath: '" << filename << "'" << std::endl;
+		return false;
+	}
+	xmlTextWriterSetIndent(_writer, 1);
+	xmlTextWriterSetIndentString(_writer, BC "\t");
+
+	_generatedIds = 0;
+	_ids.clear();
+	_textures.clear();
+	_textureIndex.clear();
+	_materials.clear();
+	_materialIndex.clear();
+
+	xmlTextWriterStartDocument(_writer, NULL, "UTF-8", NULL);
+	xmlTextWriterStartElement(_writer, BC "core:CityModel");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:core", BC "http://www.opengis.net/citygml/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:gml", BC "http://www.opengis.net/gml");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:gen", BC "http://www.opengis.net/citygml/generics/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:app", BC "http://www.opengis.net/citygml/appearance/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:bldg", BC "http://www.opengis.net/citygml/building/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:brid", BC "http://www.opengis.net/citygml/bridge/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:tun", BC "http://www.opengis.net/citygml/tunnel/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:tran", BC "http://www.opengis.net/citygml/transportation/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:veg", BC "http://www.opengis.net/citygml/vegetation/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:wtr", BC "http://www.opengis.net/citygml/waterbody/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:dem", BC "http://www.opengis.net/citygml/relief/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:luse", BC "http://www.opengis.net/citygml/landuse/2.0");
+	xmlTextWriterWriteAttribute(_writer, BC "xmlns:frn", BC "http://www.opengis.net/citygml/cityfurniture/2.0");
+
+	// Envelope of the model, or of its rings when it has none (tiles built by GMLCut)
+	Envelope envelope = model.getEnvelope();
+	if (envelope.getLowerBound().x > envelope.getUpperBound().x)
+	{
+		envelope = Envelope();
+		for (const CityObject* root : model.getCityObjectsRoots())
+			computeEnvelope(*root, envelope);
+	}
+	if (envelope.getLowerBound().x <= envelope.getUpperBound().x)
+	{
+		xmlTextWriterStartElement(_writer, BC "gml:boundedBy");
+		xmlTextWriterStartElement(_writer, BC "gml:Envelope");
+		if (!model.getSRSName().empty())
+			xmlTextWriterWriteAttribute(_writer, BC "srsName", BC model.getSRSName().c_str());
+		xmlTextWriterWriteAttribute(_writer, BC "srsDimension", BC "3");
+		writePosList(std::vector<TVec3d>(1, envelope.getLowerBound()), false);
+		xmlTextWriterWriteElement(_writer, BC "gml:lowerCorner", BC _buffer.c_str());
+		writePosList(std::vector<TVec3d>(1, envelope.getUpperBound()), false);
+		xmlTextWriterWriteElement(_writer, BC "gml:upperCorner", BC _buffer.c_str());
+		xmlTextWriterEndElement(_writer);
+		xmlTextWriterEndElement(_writer);
+	}
+
+	// Children without a CityGML property to their parent are written as roots, after it
+	size_t count = 0;
+	std::vector<const CityObject*> roots(model.getCityObjectsRoots().begin(), model.getCityObjectsRoots().end());
+	for (size_t i = 0; i < roots.size(); i++)
+	{
+		std::vector<const CityObject*> stack(1, roots[i]);
+		while (!stack.empty())
+		{
+			const CityObject* obj = stack.back();
+			stack.pop_back();
+			count++;
+			for (const CityObject* child : obj->getChildren())
+			{
+				if (getChildProperty(child->getType()))
+					stack.push_back(child);
+				else
+					roots.push_back(child);
+			}
+		}
+
+		xmlTextWriterStartElement(_writer, BC "core:cityObjectMember");
+		writeCityObject(*roots[i], getNamespace(roots[i]->getType()));
+		xmlTextWriterEndElement(_writer);
+	}
+
+	writeAppearances();
+
+	xmlTextWriterEndElement(_writer);
+	xmlTextWriterEndDocument(_writer);
+	xmlFreeTextWriter(_writer);
+	_writer = NULL;
+
+	std::cout << "\t [CITYOBJECTS]....................[" << count << "]" << std::endl;
+	std::cout << "\t [TEXTURES]....................[" << _textures.size() << "]" << std::endl;
+	std::cout << "[CITYGML WRITER]...............................[DONE]" << std::endl;
+
+	_ids.clear();
+	_textures.clear();
+	_textureIndex.clear();
+	_materials.clear();
+	_materialIndex.clear();
+
+	return true;
+}
+
+void CityGMLWriter::computeEnvelope(const CityObject& obj, Envelope& envelope) const
+{
+	for (const Geometry* geom : obj.getGeometries())
+		for (const Polygon* poly : geom->getParsedPolygons())
+			if (poly->getExteriorRing())
+				for (const TVec3d& v : poly->getExteriorRing()->getVertices())
+					envelope.merge(v);
+
+	for (const CityObject* child : obj.getChildren())
+		computeEnvelope(*child, envelope);
+}
+
+void CityGMLWriter::writeCityObject(const CityObject& obj, const char* ns)
+{
+	std::string element = std::string(ns) + ":" + obj.getTypeAsString();
+	xmlTextWriterStartElement(_writer, BC element.c_str());
+	if (!obj.getId().empty())
+		xmlTextWriterWriteAttribute(_writer, BC "gml:id", BC obj.getId().c_str());
+
+	writeAttributes(obj);
+
+	// Content of the object : boundary surfaces before its own geometry, then the other children
+	for (const CityObject* child : obj.getChildren())
+	{
+		if (!isBoundarySurface(child->getType()))
+			continue;
+		std::string property = std::string(ns) + ":boundedBy";
+		xmlTextWriterStartElement(_writer, BC property.c_str());
+		writeCityObject(*child, ns);
+		xmlTextWriterEndElement(_writer);
+	}
+
+	writeGeometries(obj, ns);
+
+	for (const CityObject* child : obj.getChildren())
+	{
+		const char* property = getChildProperty(child->getType());
+		if (!property || isBoundarySurface(child->getType()))
+			continue;
+		const char* childNs = getNamespace(child->getType());
+		std::string name = std::string(childNs) + ":" + property;
+		xmlTextWriterStartElement(_writer, BC name.c_str());
+		writeCityObject(*child, childNs);
+		xmlTextWriterEndElement(_writer);
+	}
+
+	xmlTextWriterEndElement(_writer);
+}
+
+void CityGMLWriter::writeAttributes(const CityObject& obj)
+{
+	// gml properties first, then the generic attributes (every other attribute read by the parser)
+	const AttributesMap& attributes = obj.getAttributes();
+	AttributesMap::const_iterator description = attributes.find("description");
+	if (description != attributes.end())
+		xmlTextWriterWriteElement(_writer, BC "gml:description", BC description->second.c_str());
+	AttributesMap::const_iterator name = attributes.find("name");
+	if (name != attributes.end())
+		xmlTextWriterWriteElement(_writer, BC "gml:name", BC name->second.c_str());
+
+	for (const std::pair<const std::string, std::string>& attribute : attributes)
+	{
+		if (attribute.first == "xlink" || attribute.first == "description" || attribute.first == "name")
+			continue;
+		xmlTextWriterStartElement(_writer, BC "gen:stringAttribute");
+		xmlTextWriterWriteAttribute(_writer, BC "name", BC attribute.first.c_str());
+		xmlTextWriterWriteElement(_writer, BC "gen:value", BC attribute.second.c_str());
+		xmlTextWriterEndElement(_writer);
+	}
+}
+
+void CityGMLWriter::writeGeometries(const CityObject& obj, const char* ns)
+{
+	// The parser makes one Geometry per surfaceMember : polygons are grouped back into one surface per LOD
+	std::map<unsigned int, std::vector<const Polygon*>> polygonsByLOD;
+	for (const Geometry* geom : obj.getGeometries())
+		for (const Polygon* poly : geom->getParsedPolygons())
+			if (poly->getExteriorRing())
+				polygonsByLOD[std::max(1u, std::min(4u, geom->getLOD()))].push_back(poly);
+
+	if (polygonsByLOD.empty())
+		return;
+
+	if (obj.getType() == COT_TINRelief)
+	{
+		// A TIN has a single LOD. The triangles keep their gml:id, which the textures target.
+		std::string lod = std::to_string(polygonsByLOD.begin()->first);
+		xmlTextWriterWriteElement(_writer, BC "dem:lod", BC lod.c_str());
+		xmlTextWriterStartElement(_writer, BC "dem:tin");
+		xmlTextWriterStartElement(_writer, BC "gml:TriangulatedSurface");
+		xmlTextWriterStartElement(_writer, BC "gml:trianglePatches");
+		for (const std::pair<const unsigned int, std::vector<const Polygon*>>& lodPolygons : polygonsByLOD)
+		{
+			for (const Polygon* poly : lodPolygons.second)
+			{
+				xmlTextWriterStartElement(_writer, BC "gml:Triangle");
+				xmlTextWriterWriteAttribute(_writer, BC "gml:id", BC getPolygonId(*poly).c_str());
+				writeRing(*poly->getExteriorRing(), "gml:exterior");
+				xmlTextWriterEndElement(_writer);
+				addAppearances(*poly);
+			}
+		}
+		xmlTextWriterEndElement(_writer);
+		xmlTextWriterEndElement(_writer);
+		xmlTextWriterEndElement(_writer);
+		return;
+	}
+
+	for (const std::pair<const unsigned int, std::vector<const Polygon*>>& lodPolygons : polygonsByLOD)
+	{
+		std::string property = std::string(ns) + ":lod" + std::to_string(lodPolygons.first) + (hasLodGeometry(obj.getType()) ? "Geometry" : "MultiSurface");
+		xmlTextWriterStartElement(_writer, BC property.c_str());
+		xmlTextWriterStartElement(_writer, BC "gml:MultiSurface");
+		for (const Polygon* poly : lodPolygons.second)
+		{
+			xmlTextWriterStartElement(_writer, BC "gml:surfaceMember");
+			writePolygon(*poly);
+			xmlTextWriterEndElement(_writer);
+		}
+		xmlTextWriterEndElement(_writer);
+		xmlTextWriterEndElement(_writer);
+	}
+}
+
+void CityGMLWriter::writePolygon(const Polygon& polygon)
+{
+	xmlTextWriterStartElement(_writer, BC "gml:Polygon");
+	xmlTextWriterWriteAttribute(_writer, BC "gml:id", BC getPolygonId(polygon).c_str());
+	writeRing(*polygon.getExteriorRing(), "gml:exterior");
+	for (const LinearRing* ring : polygon.getInteriorRings())
+		writeRing(*ring, "gml:interior");
+	xmlTextWriterEndElement(_writer);
+
+	addAppearances(polygon);
+}
+
+void CityGMLWriter::writeRing(const LinearRing& ring, const char* element)
+{
+	xmlTextWriterStartElement(_writer, BC element);
+	xmlTextWriterStartElement(_writer, BC "gml:LinearRing");
+	xmlTextWriterWriteAttribute(_writer, BC "gml:id", BC getRingId(ring).c_str());
+	writePosList(ring.getVertices(), true);
+	xmlTextWriterStartElement(_writer, BC "gml:posList");
+	xmlTextWriterWriteAttribute(_writer, BC "srsDimension", BC "3");
+	xmlTextWriterWriteRaw(_writer, BC _buffer.c_str());
+	xmlTextWriterEndElement(_writer);
+	xmlTextWriterEndElement(_writer);
+	xmlTextWriterEndElement(_writer);
+}
+
+void CityGMLWriter::writePosList(const std::vector<TVec3d>& points, bool closed)
+{
+	// The parser removes the closing vertex of the rings, GML rings are closed
+	_buffer.clear();
+	char number[96];
+	size_t n = points.size();
+	bool close = closed && n > 0 && (points[0] - points[n - 1]).sqrLength() > std::numeric_limits<double>::epsilon();
+	for (size_t i = 0; i < n + (close ? 1 : 0); i++)
+	{
+		const TVec3d& p = points[i < n ? i : 0];
+		snprintf(number, sizeof(number), i == 0 ? "%.15g %.15g %.15g" : " %.15g %.15g %.15g", p.x, p.y, p.z);
+		_buffer += number;
+	}
+}
+
+const std::string& CityGMLWriter::getPolygonId(const Polygon& polygon)
+{
+	if (!polygon.getId().empty())
+		return polygon.getId();
+	std::string& id = _ids[&polygon];
+	if (id.empty())
+		id = "PolyID_" + std::to_string(++_generatedIds);
+	return id;
+}
+
+const std::string& CityGMLWriter::getRingId(const LinearRing& ring)
+{
+	if (!ring.getId().empty())
+		return ring.getId();
+	std::string& id = _ids[&ring];
+	if (id.empty())
+		id = "RingID_" + std::to_string(++_generatedIds);
+	return id;
+}
+
+void CityGMLWriter::addAppearances(const Polygon& polygon)
+{
+	if (const Texture* texture = polygon.getTexture())
+	{
+		std::pair<std::unordered_map<std::string, size_t>::iterator, bool> inserted = _textureIndex.insert(std::make_pair(texture->getUrl(), _textures.size()));
+		if (inserted.second)
+			_textures.push_back(AppearanceTargets<Texture>{ texture, std::vector<const Polygon*>() });
+		_textures[inserted.first->second].polygons.push_back(&polygon);
+	}
+	if (const Material* material = polygon.getMaterial())
+	{
+		std::pair<std::unordered_map<const Material*, size_t>::iterator, bool> inserted = _materialIndex.insert(std::make_pair(material, _materials.size()));
+		if (inserted.second)
+			_materials.push_back(AppearanceTargets<Material>{ material, std::vector<const Polygon*>() });
+		_materials[inserted.first->second].polygons.push_back(&polygon);
+	}
+}
+
+void CityGMLWriter::writeAppearances()
+{
+	if (_textures.empty() && _materials.empty())
+		return;
+
+	xmlTextWriterStartElement(_writer, BC "app:appearanceMember");
+	xmlTextWriterStartElement(_writer, BC "app:Appearance");
+	xmlTextWriterWriteElement(_writer, BC "app:theme", BC "rgbTexture");
+
+	char number[64];
+	for (const AppearanceTargets<Material>& material : _materials)
+	{
+		const Material* m = material.appearance;
+		xmlTextWriterStartElement(_writer, BC "app:surfaceDataMember");
+		xmlTextWriterStartElement(_writer, BC "app:X3DMaterial");
+		snprintf(number, sizeof(number), "%g", m->getAmbientIntensity());
+		xmlTextWriterWriteElement(_writer, BC "app:ambientIntensity", BC number);
+		snprintf(number, sizeof(number), "%g %g %g", m->getDiffuse().r, m->getDiffuse().g, m->getDiffuse().b);
+		xmlTextWriterWriteElement(_writer, BC "app:diffuseColor", BC number);
+		snprintf(number, sizeof(number), "%g %g %g", m->getEmissive().r, m->getEmissive().g, m->getEmissive().b);
+		xmlTextWriterWriteElement(_writer, BC "app:emissiveColor", BC number);
+		snprintf(number, sizeof(number), "%g %g %g", m->getSpecular().r, m->getSpecular().g, m->getSpecular().b);
+		xmlTextWriterWriteElement(_writer, BC "app:specularColor", BC number);
+		snprintf(number, sizeof(number), "%g", m->getShininess());
+		xmlTextWriterWriteElement(_writer, BC "app:shininess", BC number);
+		snprintf(number, sizeof(number), "%g", m->getTransparency());
+		xmlTextWriterWriteElement(_writer, BC "app:transparency", BC number);
+		for (const Polygon* poly : material.polygons)
+		{
+			std::string uri = "#" + getPolygonId(*poly);
+			xmlTextWriterWriteElement(_writer, BC "app:target", BC uri.c_str());
+		}
+		xmlTextWriterEndElement(_writer);
+		xmlTextWriterEndElement(_writer);
+	}
+
+	for (const AppearanceTargets<Texture>& texture : _textures)
+	{
+		// Georeferenced textures are placed by their world file, the others by the texture coordinates of every ring
+		bool georeferenced = texture.appearance->getType() == "GeoreferencedTexture";
+		xmlTextWriterStartElement(_writer, BC "app:surfaceDataMember");
+		xmlTextWriterStartElement(_writer, georeferenced ? BC "app:GeoreferencedTexture" : BC "app:ParameterizedTexture");
+		xmlTextWriterWriteElement(_writer, BC "app:imageURI", BC texture.appearance->getUrl().c_str());
+		xmlTextWriterWriteElement(_writer, BC "app:wrapMode", BC getWrapMode(texture.appearance->getWrapMode()));
+		for (const Polygon* poly : texture.polygons)
+		{
+			std::string uri = "#" + getPolygonId(*poly);
+			if (georeferenced)
+			{
+				xmlTextWriterWriteElement(_writer, BC "app:target", BC uri.c_str());
+				continue;
+			}
+			xmlTextWriterStartElement(_writer, BC "app:target");
+			xmlTextWriterWriteAttribute(_writer, BC "uri", BC uri.c_str());
+			writeTextureCoordinates(*poly);
+			xmlTextWriterEndElement(_writer);
+		}
+		xmlTextWriterEndElement(_writer);
+		xmlTextWriterEndElement(_writer);
+	}
+
+	xmlTextWriterEndElement(_writer);
+	xmlTextWriterEndElement(_writer);
+}
+
+void CityGMLWriter::writeTextureCoordinates(const Polygon& polygon)
+{
+	// The texture coordinates of the polygon are those of its rings, one after the other, as read from the file :
+	// with or without the closing coordinate of every ring
+	std::vector<const LinearRing*> rings(1, polygon.getExteriorRing());
+	rings.insert(rings.end(), polygon.getInteriorRings().begin(), polygon.getInteriorRings().end());
+
+	const TexCoords& texCoords = polygon.getTexCoords();
+	size_t open = 0;
+	for (const LinearRing* ring : rings)
+		open += ring->getVertices().size();
+	size_t stride;
+	if (texCoords.size() == open)
+		stride = 0;
+	else if (texCoords.size() == open + rings.size())
+		stride = 1;
+	else
+		return;
+
+	xmlTextWriterStartElement(_writer, BC "app:TexCoordList");
+	char number[32];
+	size_t offset = 0;
+	for (const LinearRing* ring : rings)
+	{
+		const std::vector<TVec3d>& points = ring->getVertices();
+		size_t n = points.size();
+		bool close = n > 0 && (points[0] - points[n - 1]).sqrLength() > std::numeric_limits<double>::epsilon();
+
+		_buffer.clear();
+		for (size_t i = 0; i < n + (close ? 1 : 0); i++)
+		{
+			const TVec2f& uv = texCoords[offset + (i < n ? i : 0)];
+			snprintf(number, sizeof(number), i == 0 ? "%.7g %.7g" : " %.7g %.7g", uv.x, uv.y);
+			_buffer += number;
+		}
+		offset += n + stride;
+
+		std::string ringUri = "#" + getRingId(*ring);
+		xmlTextWriterStartElement(_writer, BC "app:textureCoordinates");
+		xmlTextWriterWriteAttribute(_writer, BC "ring", BC ringUri.c_str());
+		xmlTextWriterWriteRaw(_writer, BC _buffer.c_str());
+		xmlTextWriterEndElement(_writer);
+	}
+	xmlTextWriterEndElement(_writer);
+}
@@ -0,0 +1,63 @@
+#ifndef CITYGMLWRITER_HPP
+#define CITYGMLWRITER_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <libxml/xmlwriter.h>
+
+#include "../Module.hpp"
+#include "../../CityModel/CityModel.hpp"
+
+using namespace citygml;
+
+class CityGMLWriter : public Module
+{
+public:
+	CityGMLWriter(std::string name);
+
+	// Write the CityModel as a CityGML 2.0 file, streamed through a (buffered) xmlTextWriter : no DOM is built.
+	// Objects keep their hierarchy (boundedBy, consistsOfBuildingPart, ...), polygons are written with their rings
+	// (one lodNMultiSurface per object and LOD), attributes as generic attributes and appearances as a single
+	// appearanceMember : one texture per image url and one material per material of the model, targeting the polygons.
+	// Missing polygon and ring identifiers are generated. Not thread safe : use one writer per thread.
+	bool write(const CityModel& model, const std::string& filename);
+
+private:
+	// Polygons sharing an appearance, in the order they are written
+	template <typename T>
+	struct AppearanceTargets
+	{
+		const T* appearance;
+		std::vector<const Polygon*> polygons;
+	};
+
+	void writeCityObject(const CityObject& obj, const char* ns);
+	void writeAttributes(const CityObject& obj);
+	void writeGeometries(const CityObject& obj, const char* ns);
+	void writePolygon(const Polygon& polygon);
+	void writeRing(const LinearRing& ring, const char* element);
+	void writeAppearances();
+	void writeTextureCoordinates(const Polygon& polygon);
+
+	void writePosList(const std::vector<TVec3d>& points, bool closed);
+	const std::string& getPolygonId(const Polygon& polygon);
+	const std::string& getRingId(const LinearRing& ring);
+	void addAppearances(const Polygon& polygon);
+
+	void computeEnvelope(const CityObject& obj, Envelope& envelope) const;
+
+	xmlTextWriterPtr _writer;
+
+	std::string _buffer;	// text of the current posList / textureCoordinates, reused
+	unsigned int _generatedIds;
+	std::unordered_map<const Object*, std::string> _ids;	// identifiers generated for the polygons and rings without one
+
+	std::vector<AppearanceTargets<Texture>> _textures;
+	std::unordered_map<std::string, size_t> _textureIndex;	// url -> index in _textures
+	std::vector<AppearanceTargets<Material>> _materials;
+	std::unordered_map<const Material*, size_t> _materialIndex;
+};
+
+#endif // !CITYGMLWRITER_HPP
@@ -0,0 +1,101 @@
+#include "LazyGeometryLoader.hpp"
+#include "XMLParser.hpp"
+#include "../../CityModel/Transform.hpp"
+
+LazyGeometryLoader::LazyGeometryLoader(const std::string& filename, const citygml::ParserParams& params, citygml::CityModel* model)
+	: _filename(filename), _params(params), _model(model), _handler(nullptr), _loading(nullptr)
+{
+	// the ranges are parsed completely
+	_params.lazyGeometry = false;
+}
+
+LazyGeometryLoader::~LazyGeometryLoader()
+{
+	delete _handler;
+}
+
+void LazyGeometryLoader::addRange(citygml::CityObject* object, uint64_t begin, uint64_t end, int lod, citygml::GeometryType type, const std::string& srs)
+{
+	// a file has a few SRS : the last one is almost always the right one
+	size_t index = _srsNames.size();
+	while (index > 0 && _srsNames[index - 1] != srs)
+		--index;
+	if (index == 0)
+	{
+		_srsNames.push_back(srs);
+		index = _srsNames.size();
+	}
+
+	_ranges[object].push_back(Range{ begin, end, lod, type, index - 1 });
+	object->setGeometryLoader(this);
+}
+
+void LazyGeometryLoader::load(citygml::CityObject* object)
+{
+	// a reader of an object being loaded by another thread waits here until the geometries are complete
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	if (object->getGeometryLoader() != this) // loaded by another thread meanwhile
+		return;
+	if (object == _loading) // access to the object by its own load (addGeometry, ...)
+		return;
+
+	std::unordered_map<citygml::CityObject*, std::vector<Range>>::iterator it = _ranges.find(object);
+	if (it == _ranges.end())
+	{
+		object->setGeometryLoader(nullptr);
+		return;
+	}
+	std::vector<Range> ranges;
+	ranges.swap(it->second);
+	_ranges.erase(it);
+
+	if (!_handler)
+	{
+		_handler = new CityGMLHandlerLibXml2(_params);
+		_handler->_model = _model;
+	}
+	if (!_file.is_open())
+		_file.open(_filename, std::ios::binary);
+
+	// no startDocument / endDocument : the ADE handlers and the xlinks are done with the whole document
+	xmlSAXHandler sh = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
+	sh.startElement = citygml::startElement;
+	sh.endElement = citygml::endElement;
+	sh.characters = citygml::characters;
+	sh.error = citygml::fatalError;
+	sh.fatalError = citygml::fatalError;
+
+	_loading = object;
+	for (const Range& range : ranges)
+	{
+		_buffer.resize(range.end - range.begin);
+		_file.clear();
+		_file.seekg(range.begin);
+		if (!_file.read(_buffer.data(), _buffer.size()))
+		{
+			std::cerr << "ERROR: unable to read the geometries of " << object->getId() << " in " << _filename << std::endl;
+			break;
+		}
+
+		_handler->_currentCityObject = object;
+		_handler->_currentLOD = range.lod;
+		_handler->_currentGeometryType = range.type;
+		_handler->_geoTransform = _srsNames[range.srs].empty() ? nullptr : GeoTransform::get(_srsNames[range.srs], _params.destSRS);
+
+		try
+		{
+			xmlSAXUserParseMemory(&sh, _handler, _buffer.data(), (int)_buffer.size());
+		}
+		catch (...)
+		{
+		}
+		_handler->_nodePath.clear();
+	}
+	_handler->_currentCityObject = nullptr;
+
+	object->finish(*_model->getAppearanceManager(), _params);
+	_loading = nullptr;
+
+	// the readers see the geometries once they are finished
+	object->setGeometryLoader(nullptr);
+}
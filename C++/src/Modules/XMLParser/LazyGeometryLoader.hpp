@@ -0,0 +1,60 @@
+#ifndef LAZYGEOMETRYLOADER_HPP
+#define LAZYGEOMETRYLOADER_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../CityModel/CityModel.hpp"
+
+class CityGMLHandlerLibXml2;
+
+// Geometries of the city objects of a CityGML file, parsed on demand (ParserParams::lazyGeometry).
+//
+// While the file is parsed, the geometry properties of the city objects (lodNSolid, lodNMultiSurface, ..., tin) are
+// skipped : their byte ranges in the file are recorded here. The first access to the geometries of an object reads
+// its ranges back from the file and parses them alone, with the object as current city object, then finishes the
+// geometries (appearances of the model, tesselation) as CityModel::finish does.
+//
+// Loads are serialized : the objects of the model can be accessed from concurrent threads. The loader of an object is
+// reset once its geometries are finished, a thread accessing them meanwhile waits for the load in progress.
+class LazyGeometryLoader : public citygml::GeometryLoader
+{
+public:
+	LazyGeometryLoader(const std::string& filename, const citygml::ParserParams& params, citygml::CityModel* model);
+	~LazyGeometryLoader() override;
+
+	// Record the geometry property of object at [begin, end) in the file. lod, type : LOD and type of its geometries,
+	// srs : source SRS of the transformation of its coordinates ("" if they are not transformed)
+	void addRange(citygml::CityObject* object, uint64_t begin, uint64_t end, int lod, citygml::GeometryType type, const std::string& srs);
+
+	void load(citygml::CityObject* object) override;
+
+private:
+	struct Range
+	{
+		uint64_t begin;
+		uint64_t end;
+		int lod;
+		citygml::GeometryType type;
+		size_t srs;		// index in _srsNames
+	};
+
+	std::string _filename;
+	citygml::ParserParams _params;
+	citygml::CityModel* _model;
+
+	std::unordered_map<citygml::CityObject*, std::vector<Range>> _ranges;
+	std::vector<std::string> _srsNames;
+
+	std::ifstream _file;				// opened on the first load
+	std::vector<char> _buffer;
+	CityGMLHandlerLibXml2* _handler;	// parser of the ranges, created on the first load
+	citygml::CityObject* _loading;		// object being loaded, its accesses during the load don't load it again
+	std::recursive_mutex _mutex;
+};
+
+#endif // !LAZYGEOMETRYLOADER_HPP
@@ -22,7 +22,7 @@ namespace citygml
 {
 	////////////////////////////////////////////////////////////////////////////////
 	ParserParams::ParserParams(void)
-		: objectsMask("All"), minLOD(0), maxLOD(4), optimize(false), pruneEmptyObjects(false), tesselate(true), temporalImport(true), destSRS("")
+		: objectsMask("All"), minLOD(0), maxLOD(4), optimize(false), mergePolygons(true), pruneEmptyObjects(false), tesselate(true), temporalImport(true), lazyGeometry(false), destSRS("")
 	{ }
 	////////////////////////////////////////////////////////////////////////////////
 } // namespace citygml
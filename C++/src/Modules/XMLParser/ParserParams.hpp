@@ -36,8 +36,10 @@ namespace citygml
 	// minLOD: the minimal LOD that will be parsed
 	// maxLOD: the maximal LOD that will be parsed
 	// optimize: merge geometries & polygons that share the same appearance in the same object in order to reduce the global hierarchy
+	// mergePolygons: with optimize, also merge the polygons (default), otherwise only the geometries are merged
 	// pruneEmptyObjects: remove the objects which do not contains any geometrical entity
 	// tesselate: convert the interior & exteriors polygons to triangles
+	// lazyGeometry: skip the geometries while parsing, they are read back from the file on the first access to the geometries of each object (CityObject::getGeometries)
 	// destSRS: the SRS (WKT, EPSG, OGC URN, etc.) where the coordinates must be transformed, default ("") is no transformation
 	// m_basePath : base path used to find textures
 	class /*CITYGML_EXPORT*/ ParserParams
@@ -50,9 +52,11 @@ namespace citygml
 		unsigned int minLOD;
 		unsigned int maxLOD;
 		bool optimize;
+		bool mergePolygons;
 		bool pruneEmptyObjects;
 		bool tesselate;
 		bool temporalImport;
+		bool lazyGeometry;
 		std::string destSRS;
 		std::string m_basePath;
 	};
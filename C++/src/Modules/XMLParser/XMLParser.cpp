@@ -1,5 +1,7 @@
 #include "XMLParser.hpp"
 
+#include <fstream>
+
 XMLParser::XMLParser(std::string name) : Module(name)
 {
 }
@@ -10,7 +12,18 @@ CityModel * XMLParser::load(const std::string & fname, ParserParams & params)
 	params.m_basePath = fname.substr(0, fname.find_last_of('/') + 1);
 	params.m_basePath.push_back('/');
 
-	CityGMLHandlerLibXml2* handler = new CityGMLHandlerLibXml2(params);
+	// The skipped geometries are read back from the file : its offsets must be those of the parser (not compressed)
+	ParserParams handlerParams = params;
+	if (handlerParams.lazyGeometry)
+	{
+		std::ifstream file(fname, std::ios::binary);
+		char magic[2] = { 0, 0 };
+		file.read(magic, 2);
+		if ((unsigned char)magic[0] == 0x1f && (unsigned char)magic[1] == 0x8b)
+			handlerParams.lazyGeometry = false;
+	}
+
+	CityGMLHandlerLibXml2* handler = new CityGMLHandlerLibXml2(handlerParams);
 
 	xmlSAXHandler sh = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
 	sh.startDocument = citygml::startDocument;
@@ -45,6 +58,8 @@ CityModel * XMLParser::load(const std::string & fname, ParserParams & params)
 	}
 
 	context->validate = 0;
+	if (handlerParams.lazyGeometry)
+		handler->setLazyGeometry(context, fname);
 
 	try
 	{
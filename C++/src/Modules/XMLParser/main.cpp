@@ -1,6 +1,8 @@
 #include <string.h>
+#include <cstdio>
 #include <iostream>
 #include "XMLParser.hpp"
+#include "CityGMLWriter.hpp"
 #include "../../CityModel/CityModel.hpp"
 
 /* Return true if there is a CityGML (.gml) file, false otherwise */
@@ -14,6 +16,27 @@ bool assertCityGMLFile(int argc, char* argv[])
     return strcmp(ext, toMatch) == 0;
 }
 
+/* Count the polygons and the rings, as written by CityGMLWriter (the polygons kept by the merged ones) */
+void countPolygons(const citygml::CityObject* obj, size_t& polygons, size_t& rings)
+{
+    for (const citygml::Geometry* geom : obj->getGeometries())
+        for (const citygml::Polygon* poly : geom->getParsedPolygons())
+        {
+            if (!poly->getExteriorRing()) continue;
+            polygons++;
+            rings += 1 + poly->getInteriorRings().size();
+        }
+    for (const citygml::CityObject* child : obj->getChildren())
+        countPolygons(child, polygons, rings);
+}
+
+void countPolygons(const CityModel* cityModel, size_t& polygons, size_t& rings)
+{
+    polygons = rings = 0;
+    for (const citygml::CityObject* obj : cityModel->getCityObjectsRoots())
+        countPolygons(obj, polygons, rings);
+}
+
 int main(int argc, char* argv[]) 
 {
     // Check if there is a CityGML (.gml) file, exit if not
@@ -23,10 +46,12 @@ int main(int argc, char* argv[])
     }
 
     std::string filename (argv[1]);
+    bool optimize = argc > 2 && strcmp(argv[2], "--optimize") == 0;
 
     XMLParser * parser = new XMLParser("xmlparser");
 
     citygml::ParserParams params = citygml::ParserParams();
+    params.optimize = optimize;
 	CityModel * cityModel = parser->load(filename, params);
 
     // == 0 if the parsing failed, file name/location may be wrong
@@ -38,8 +63,37 @@ int main(int argc, char* argv[])
 
 	std::cout << "[PARSING]:.............................:[DONE]" << std::endl;
 
+    // Round trip : the model merged by --optimize, written then read back, must have the polygons and rings of the file
+    int status = 0;
+    if (optimize)
+    {
+        citygml::ParserParams readParams = citygml::ParserParams();
+        CityModel * reference = parser->load(filename, readParams);
+        size_t polygons = 0, rings = 0;
+        if (reference)
+            countPolygons(reference, polygons, rings);
+        std::cout << "\t [POLYGONS]....................[" << polygons << "]" << std::endl;
+        std::cout << "\t [RINGS]....................[" << rings << "]" << std::endl;
+
+        std::string output = filename.substr(0, filename.size() - 4) + "_roundtrip.gml";
+        CityGMLWriter writer("citygmlwriter");
+        CityModel * written = writer.write(*cityModel, output) ? parser->load(output, readParams) : 0;
+
+        size_t writtenPolygons = 0, writtenRings = 0;
+        if (written)
+            countPolygons(written, writtenPolygons, writtenRings);
+        bool roundTrip = reference && written && writtenPolygons == polygons && writtenRings == rings;
+        std::cout << "\t [ROUND TRIP]....................[" << (roundTrip ? "OK" : "FAILED") << "]" << std::endl;
+        if (!roundTrip)
+            status = 1;
+
+        delete reference;
+        delete written;
+        remove(output.c_str());
+    }
+
     delete parser;
     delete cityModel;
 
-    return 0;
+    return status;
 }
\ No newline at end of file